@@ -0,0 +1,68 @@
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#include <cstdint>
+#include <string>
+
+// Headless timings, started with --bench instead of the engine. Nothing here creates a window or a Vulkan device.
+
+// Welds and generates tangents for a batch of generated meshes with 1, 2, 4 ... maxThreads job threads (0 means every
+// hardware thread) and logs the best of a few runs next to the speedup over one thread.
+void benchmark_job_scaling(uint32_t maxThreads = 0);
+
+// Welds a generated grid, the same grid with every corner on its own OBJ lines and every .obj in res/models with
+// weld_obj_vertices and with the unordered_map welder it replaced. Logs both times and whether the vertex and index
+// buffers are identical.
+void benchmark_vertex_welding();
+
+// Reorders a shuffled welded grid and every .obj in res/models with Tipsify and with Forsyth and logs the ACMR and ATVR
+// each reaches next to the time it took.
+void benchmark_vertex_cache();
+
+// Loads res/data/user/<scenePath> through the scene loader with the null uploader, once on a single job thread and
+// once on all of them, and logs the time of every stage. Skipped if the scene file is missing.
+void benchmark_scene_loading(const std::string& scenePath);
+
+// Decodes every image in res/textures from its mapped file, spread over 1, 2, 4 ... maxThreads job threads (0 means
+// every hardware thread), and logs decoded megapixels per second and the speedup over one thread. Skipped if there
+// are no images.
+void benchmark_image_decoding(uint32_t maxThreads = 0);
+
+// Builds the mip chain of every image in res/textures (generated ones if there are none) with the box and the Kaiser
+// filter and logs MPix/s next to the time stb took to decode it. Names containing "normal" are filtered as normal maps.
+void benchmark_mip_generation();
+
+// Encodes a generated albedo (BC7) and normal map (BC5) with their mip chains and logs throughput, size and PSNR
+void benchmark_texture_compression();
+
+// Streams a generated texture through a virtual texture with a small tile cache while a simulated camera pans across
+// it, feeding the residency manager synthetic feedback, and logs hit rate, loads, evictions and CPU time per frame
+void benchmark_virtual_texture();
+
+// Packs the object data of objectCount generated models for a number of frames, into host memory instead of the
+// mapped ring. Logs CPU time per frame with the camera and light matrices recomputed for every model, the way the update
+// loop used to, and computed once per frame with every, 1% and none of the transforms changing. The last case packs
+// with parallel_for on the job system like drawFrame.
+void benchmark_frame_update(uint32_t objectCount = 10000);
+
+// Builds the world matrices of objectCount random transforms with glm one Model at a time, the way
+// update_model_transform does, and through the transform store with the scalar kernel, the AVX2 kernel and the AVX2
+// kernel over parallel_for. Logs the time per update and the speedup over glm.
+void benchmark_transform_batch(uint32_t objectCount = 50000);
+
+// Builds a deep hierarchy (a few long chains) and a wide one (a root with two levels of many children below it) of nodeCount
+// nodes. Logs how long sorting them from random order takes, and the time per update with every node, 1% of the
+// nodes, the root and one leaf changing.
+void benchmark_transform_hierarchy(uint32_t nodeCount = 100000);
+
+// Writes a generated grid of two million triangles as an OBJ file and parses it with parse_obj on one and on every
+// hardware thread, then once with tinyobj. Logs MB/s and whether both parsers produced the same mesh.
+void benchmark_obj_parse();
+
+// Loads every .obj in res/models with load_model, once after removing its mesh cache entry and once from the entry
+// that load wrote, and logs both times. Skipped without models or with ENGINE_DISABLE_MESH_CACHE.
+void benchmark_mesh_cache();
+
+void run_benchmarks();
+
+#endif
@@ -5,6 +5,7 @@
 #include <stdexcept>
 
 #include "Image.h"
+#include "DeviceAllocator.h"
 #include "Command.h"
 
 
@@ -13,9 +14,12 @@ struct it_Buffer {
 };
 
 void copy_buffer(VkDevice* device, VkCommandPool commandPool, VkQueue graphicsQueue, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+void copy_buffer_region(VkDevice* device, VkCommandPool commandPool, VkQueue graphicsQueue, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize srcOffset, VkDeviceSize dstOffset, VkDeviceSize size);
 void copy_buffer_to_image(VkDevice* device, VkCommandPool commandPool, VkQueue graphicsQueue, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+// Same copy recorded into an open command buffer, for batched uploads
+void record_copy_buffer_to_image(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width, uint32_t height);
 
 
-void create_buffer(VkDevice* device, VkPhysicalDevice* physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+void create_buffer(VkDevice* device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, it_Allocation& bufferMemory);
 
 #endif
\ No newline at end of file
@@ -27,7 +27,6 @@
 class Camera {
 public:
 	float width, height;
-	glm::mat4 model;
 	glm::mat4 view;
 	glm::mat4 proj;
 	
@@ -39,6 +38,7 @@ public:
 	glm::vec3 lightRot = glm::vec3(0.0f, 0.0f, 0.0f);
 	GLFWmonitor* monitor;
 	glm::mat4 lightMat;
+	glm::mat4 lightSpaceMat;  // with the bias into shadow map coordinates
 
 	float velocity = 0.1f;
 	float sensitivity = 100.0f;
@@ -51,12 +51,25 @@ public:
 	
 	Camera(float width, float height);
 
-	void UpdateMatrices(Model* model);
+	// The frame constants: camera and light matrices, once per frame before the models are updated
+	void UpdateMatrices();
 	int  pickModel(std::vector<Model*> scene, GLFWwindow* window);
 	void UpdateInputs(GLFWwindow* window, std::function<void(GLFWwindow*, Camera*)> cameraFunction = 0);
 };
 
-void update_model_uniform_buffers(Model* cModel, Camera* camera, uint32_t currentImage);
+struct it_BindlessSet;
+
+// Models per parallel_for item when a frame's object data is written, packing one takes well under a microsecond
+#define OBJECT_UPDATE_BATCH_SIZE 256
+
+// The model's element of the object buffer, from its current transform
+void pack_object_data(const Model* cModel, ObjectData* object);
+// Writes the model's packed object data, and its material when that changed, into the frame's bindless buffers.
+// Returns the bytes written. Only touches the model's own object index, models with different indices can be updated
+// on different threads.
+size_t update_model_uniform_buffers(Model* cModel, it_BindlessSet* bindless, uint32_t currentImage);
+// Writes the camera's frame constants into the frame's block, once per frame. Returns the bytes written.
+size_t update_frame_uniform_buffer(Camera* camera, it_BindlessSet* bindless, uint32_t currentImage);
 
 
 #endif
\ No newline at end of file
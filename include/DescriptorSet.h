@@ -3,24 +3,101 @@
 
 #include <vulkan/vulkan.h>
 #include <array>
+#include <mutex>
 #include <stdexcept>
+#include <vector>
 
 #include "Model.h"
 #include "ResourceBuffer.h"
 
-struct it_DescriptorSetLayout
+// Bindless resources: every shader of the scene reads from one descriptor set per frame in flight. Textures sit in a
+// descriptor indexed array, per object data and materials in storage buffers. A draw's first instance is its object
+// index and it pushes the texture indices as push constants. Sets are allocated once, not per model, and bound once
+// per command buffer.
+#define BINDLESS_MAX_OBJECTS 4096   // models with resources at once, the old scene's included while a new one streams in
+#define BINDLESS_MAX_TEXTURES 4096  // must match the textures[] array in the fragment shaders
+
+#define BINDING_OBJECTS 0    // ObjectData[BINDLESS_MAX_OBJECTS], storage buffer, indexed with gl_InstanceIndex
+#define BINDING_TEXTURES 1   // sampler2D[BINDLESS_MAX_TEXTURES], partially bound, updated after bind
+#define BINDING_MATERIALS 2  // Material[BINDLESS_MAX_OBJECTS], storage buffer
+#define BINDING_LIGHTS 3     // LightsUniformBufferObject
+#define BINDING_SHADOW_MAP 4
+#define BINDING_FRAME 5      // FrameUniformBufferObject
+#define BINDING_VIRTUAL_TEXTURES 6  // it_VtShaderInfo[VT_MAX_TEXTURES] and the page tables, storage buffer, per frame
+#define BINDING_VT_FEEDBACK 7       // the pages the frame's samples wanted, storage buffer written by the fragment stage
+
+#define BINDLESS_INVALID UINT32_MAX
+
+// Pushed before each draw, read by the fragment stage. The object comes from the instance index and its material
+// from the object.
+struct it_DrawIndices
 {
-	VkDescriptorSetLayout descriptorSetLayout;
+	uint32_t texture = 0;   // into the texture array
+	uint32_t normal = 0;
+	uint32_t virtualTexture = BINDLESS_INVALID;  // into the virtual textures, sampled instead of texture
 };
 
+#define DRAW_INDICES_STAGES VK_SHADER_STAGE_FRAGMENT_BIT
+
+struct it_BindlessSet
+{
+	VkDevice device = VK_NULL_HANDLE;
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> sets;  // per frame in flight
+
+	// One persistently mapped buffer with a region per frame in flight: the frame block, the objects, the materials,
+	// each at the offset alignment the device needs
+	VkBuffer ring = VK_NULL_HANDLE;
+	it_Allocation ringMemory;
+	VkDeviceSize frameStride = 0;
+	VkDeviceSize objectOffset = 0;
+	VkDeviceSize materialOffset = 0;
+
+	// Materials rarely change, so a frame's copy is only rewritten when it is out of date
+	std::vector<Material> materials;      // per object, the last one written
+	std::vector<uint8_t> staleMaterials;  // per object, a bit per frame in flight whose copy differs from it
 
+	// Models are set up and textures created on loader threads. The mutex guards the free lists and the descriptor
+	// writes, which only touch array elements no pending frame uses.
+	std::mutex mutex;
+	std::vector<uint32_t> freeObjects;
+	std::vector<uint32_t> freeTextures;
+};
+
+// True when the device has the descriptor indexing features and limits the bindless set needs
+bool bindless_supported(VkPhysicalDevice physicalDevice);
+
+// The layout every pipeline of the scene is created with
 void create_descriptor_set_layout(VkDevice* device, VkDescriptorSetLayout* descriptorSetLayout);
 
-void create_descriptor_set_layout(VkDevice* device, Model* cModel);
+// Allocates the per frame sets and the ring and points them at the light buffers and the shadow map
+void create_bindless_set(VkDevice* device, VkPhysicalDevice* physicalDevice, VkDescriptorSetLayout descriptorSetLayout, it_ImageResource* shadowRes,
+	const std::vector<VkBuffer>& lightBuffers, it_BindlessSet* bindless);
+void destroy_bindless_set(it_BindlessSet* bindless);
+
+// A slot in the object and material buffers, throws when all BINDLESS_MAX_OBJECTS are taken. Thread safe.
+uint32_t bindless_add_object(it_BindlessSet* bindless);
+// Only once no frame in flight draws the object. BINDLESS_INVALID is ignored.
+void bindless_remove_object(it_BindlessSet* bindless, uint32_t index);
+
+// Writes the texture into a free element of the array in every set, throws when the array is full. Thread safe.
+uint32_t bindless_add_texture(it_BindlessSet* bindless, VkImageView view, VkSampler sampler);
+// Only once no frame in flight samples it. BINDLESS_INVALID is ignored.
+void bindless_remove_texture(it_BindlessSet* bindless, uint32_t index);
+
+// Mapped per frame storage of the frame block and of an object's data. Write only, the memory may be write combined.
+FrameUniformBufferObject* bindless_frame(it_BindlessSet* bindless, uint32_t frame);
+ObjectData* bindless_object(it_BindlessSet* bindless, uint32_t frame, uint32_t index);
+// Copies material into frame's material buffer unless that copy is up to date, returns the bytes written. Reads and
+// writes only index's CPU copy and stale bits, so different indices can be written from different threads.
+size_t bindless_write_material(it_BindlessSet* bindless, uint32_t frame, uint32_t index, const Material& material);
 
-void create_descriptor_pool(VkDevice* device, Model* cModel);
+// Points every frame's virtual texture bindings at its region of the two buffers, which stay alive as long as the set.
+// Called once by init_virtual_textures.
+void bindless_set_virtual_textures(it_BindlessSet* bindless, VkBuffer tables, VkDeviceSize tableStride, VkDeviceSize tableBytes, VkBuffer feedback,
+	VkDeviceSize feedbackStride, VkDeviceSize feedbackBytes);
 
-void create_descriptor_sets(VkDevice* device, Model* cModel, it_ImageResource* shadowRes, std::vector<VkBuffer> lightBuffers);
+// Binds frame's set, stays bound across every pipeline created with the same layout
+void bind_bindless_set(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const it_BindlessSet* bindless, uint32_t frame);
 
-void update_descriptor_set(VkDevice device, VkDescriptorSet descriptorSet, VkImageView imageView, VkSampler sampler, VkImageLayout layout, uint32_t binding);
-#endif
\ No newline at end of file
+#endif
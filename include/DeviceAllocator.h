@@ -0,0 +1,62 @@
+#ifndef __DEVICE_ALLOCATOR_H__
+#define __DEVICE_ALLOCATOR_H__
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+// Size of the VkDeviceMemory blocks resources are sub-allocated from. Heaps smaller than 8 blocks use heapSize / 8.
+#define DEVICE_MEMORY_BLOCK_SIZE (64ull << 20)
+// Resources at least this large get their own VkDeviceMemory, as do resources the driver prefers dedicated
+#define DEVICE_MEMORY_DEDICATED_THRESHOLD (16ull << 20)
+
+#define DEVICE_MEMORY_DEDICATED UINT32_MAX
+
+// A range of device memory bound to one buffer or image. mapped points at offset for host visible memory, blocks stay
+// persistently mapped so there is nothing to map or unmap per use.
+struct it_Allocation
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	VkDeviceSize alignment = 1;
+	void* mapped = nullptr;
+	uint32_t pool = DEVICE_MEMORY_DEDICATED;
+	uint32_t block = 0;
+};
+
+struct it_MemoryStats
+{
+	uint32_t blockCount = 0;
+	uint32_t allocationCount = 0;
+	uint32_t dedicatedCount = 0;
+	uint32_t vkAllocationCount = 0;   // live vkAllocateMemory objects, blocks plus dedicated
+	VkDeviceSize blockBytes = 0;
+	VkDeviceSize usedBytes = 0;       // sub-allocated bytes inside blocks
+	VkDeviceSize dedicatedBytes = 0;
+	VkDeviceSize largestFree = 0;
+	float fragmentation = 0.0f;       // worst block, see range_fragmentation
+};
+
+// Called for every allocation defragment_device_memory wants to move. The callback creates the resource again on
+// target (or aliases it there), copies the contents and returns true; on false the allocation stays where it is.
+typedef bool (*it_DefragmentMove)(void* userData, uint32_t index, const it_Allocation* source, const it_Allocation* target);
+
+void init_device_allocator(VkDevice device, VkPhysicalDevice physicalDevice);
+// Every allocation must be freed before this, leftovers are reported and released
+void destroy_device_allocator();
+
+// Allocate and bind. Throws like the old vkAllocateMemory paths when no memory type or no memory is left.
+void allocate_buffer_memory(VkBuffer buffer, VkMemoryPropertyFlags properties, it_Allocation* allocation);
+void allocate_image_memory(VkImage image, VkMemoryPropertyFlags properties, it_Allocation* allocation);
+
+// Safe on an empty allocation; resets it
+void free_device_memory(it_Allocation* allocation);
+
+// Moves up to maxMoves of the given allocations out of the emptiest block of their pool into fuller ones, so empty
+// blocks can be released. The allocations are updated in place for every move the callback accepted. Returns the
+// number of moves.
+uint32_t defragment_device_memory(it_Allocation** allocations, uint32_t count, uint32_t maxMoves, it_DefragmentMove move, void* userData);
+
+it_MemoryStats device_memory_stats();
+
+#endif
@@ -28,6 +28,11 @@
 #include "GraphicsPipeline.h"
 #include "File.h"
 #include "World.h"
+#include "JobSystem.h"
+#include "Parallel.h"
+#include "SceneLoader.h"
+#include "TextureCache.h"
+#include "VirtualTextureSet.h"
 
 
 #include <imgui.h>
@@ -69,6 +74,16 @@ enum SCENE_STATE
 };
 
 
+// Frame times while a scene streams in, from the request until the old scene is destroyed
+struct it_SceneSwapStats
+{
+	uint32_t frames = 0;
+	double worstFrameSeconds = 0.0;
+	double totalFrameSeconds = 0.0;
+	double swapSeconds = 0.0;     // request to the first frame of the new scene
+	double loadSeconds = 0.0;     // request to the last model being resident
+};
+
 class Engine {
 
 public:
@@ -139,6 +154,7 @@ private:
     double lastTimeWindowTitle = 0.0; // for window title
     double lastTime = 0.0; // for physics to be processed
     double fps = 0.0;
+    it_FrameStats frameStats; // last recorded frame
     int nbFrames = 0;
     int currentPipeline = 0;
 
@@ -162,11 +178,43 @@ private:
     VkDevice device;
     VkQueue graphicsQueue;
     VkQueue presentQueue;
+    VkQueue uploadQueue;
+    uint32_t uploadQueueFamily;
+    // Held around every use of uploadQueue, which may be graphicsQueue, and around the render thread's own queue
+    // submissions and idle waits: the scene stream submits from its thread at any time
+    std::mutex uploadQueueMutex;
+    it_UploadContext uploadContext;  // main thread uploads, the first scene load included
+    it_UploadContext streamUploadContext;  // the scene stream's thread
+
+    // Loading a scene in the background: the old scene keeps rendering until the first new model is resident, then both
+    // are swapped at a frame boundary and the rest of the new models join the scene as they arrive. The old scene and
+    // pipelines are destroyed once the frames that drew them are done.
+    it_SceneStream sceneStream;
+    std::vector<std::string> streamShaderPaths;  // written by the stream's prepare
+    std::vector<std::vector<int>> streamShaderIndices;
+    std::vector<VkPipeline> streamPipelines;
+    std::vector<VkPipelineLayout> streamPipelineLayouts;
+    bool sceneSwapped = false;    // the streamed scene is the one being drawn
+    bool measuringSwap = false;
+    std::chrono::high_resolution_clock::time_point swapStart;
+    it_SceneSwapStats swapStats;  // last streamed load
+    std::vector<Model*> retiredScene;
+    std::vector<VkPipeline> retiredPipelines;
+    std::vector<VkPipelineLayout> retiredPipelineLayouts;
+    uint64_t retireFrame = 0;     // last frame that drew the retired scene
+
+    uint64_t frameNumber = 0;     // frames begun so far, the first one is 1
+    std::vector<uint64_t> slotFrames;  // frame last submitted with each of inFlightFences
+    std::chrono::high_resolution_clock::time_point lastFrameStart;
+    VkBuffer frameVertexBuffer = VK_NULL_HANDLE;  // geometry heap buffers bound by the frame being recorded
+    VkBuffer frameIndexBuffer = VK_NULL_HANDLE;
     VkSurfaceKHR surface;
     
     it_SwapChainHandle swapChainHandle;
 
     Camera* camera;
+
+    it_GeometryHeap geometryHeap;
     
     VkFramebuffer shadowFramebuffer;
     
@@ -180,7 +228,8 @@ private:
     VkPipelineLayout shadowPipelineLayout;
 
     VkCommandPool commandPool;
-    VkDescriptorPool descriptorPool;
+    it_BindlessSet bindless;
+    it_ModelHierarchy modelHierarchy;  // parent links of the scene, rebuilt when they or the models change
     it_ImageResource depthImageRes;
     it_ImageResource colorImageRes;
     it_ImageResource shadowImageRes;
@@ -232,16 +281,27 @@ private:
     void drawWindowTitle();
     void renderImGui();
     void loadShaders();
+    void createPipelines(const std::vector<std::string>& paths, const std::vector<std::vector<int>>& indices, std::vector<VkPipelineLayout>* layouts, std::vector<VkPipeline>* pipelines);
+    void destroyPipelines(std::vector<VkPipelineLayout>* layouts, std::vector<VkPipeline>* pipelines);
+    void waitForGraphicsQueue();
     void resetScene(bool toUpdate = false);
     void traceDir(std::string modelDirectory, std::string textureDirectory);
     void createImGuiDP();
     
     void updateImGui(VkCommandBuffer commandBuffer);
     void processState();
+    void loadScene();
+    void logTextureCache();
+    void startSceneStream();
+    void updateSceneStream();
+    void cancelSceneStream();
+    void swapScene(std::vector<Model*>* arrived);
+    void destroyRetiredScene(uint64_t completedFrame);
     
 
     //bool hasStencilComponent(VkFormat format);
     void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void bindGeometryHeap(VkCommandBuffer commandBuffer);
     void cleanup();
 
     static void mouse_callback(GLFWwindow* window, int key, int action, int mods);
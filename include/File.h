@@ -20,12 +20,15 @@ enum EXTENSION {
 
 void delete_file(std::string fileName);
 
+// Applies the scene's transforms to the first sceneSize models, the camera and light to camera (may be null) and
+// reads the shader setup
 void load_file(std::string filename, std::vector<std::string>* shader_paths, std::vector<std::vector<int>>* shader_indices, std::vector<Model*>* scene, size_t sceneSize, Camera* camera);
 
 void write_file(std::vector<Model*> scene, std::string scene_path, std::vector<std::string>* shader_paths, std::vector<std::vector<int>>* shader_indices, Camera* camera);
 
 void find_files(std::vector<std::string>* scene_paths, std::string sceneDirectory, std::string fileExtension);
 
+// Creates the scene's models from the JSON, placed but without their meshes. load_scene_pipelined does the rest.
 void load_scene(std::string scene_path, std::vector<Model*>* scene, size_t* sceneSize);
 
 std::string pick_file(EXTENSION ext);
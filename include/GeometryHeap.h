@@ -0,0 +1,63 @@
+#ifndef __GEOMETRY_HEAP_H__
+#define __GEOMETRY_HEAP_H__
+
+#include <vulkan/vulkan.h>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <cstdint>
+
+#include "RangeAllocator.h"
+#include "DeviceAllocator.h"
+#include "UploadContext.h"
+
+// Initial sizes in elements, the heap doubles when a model does not fit
+#define GEOMETRY_HEAP_INITIAL_VERTICES (1u << 20)
+#define GEOMETRY_HEAP_INITIAL_INDICES  (4u << 20)
+
+// Buffer the heap grew out of, frames recorded up to frame may still read it
+struct it_RetiredHeapBuffer
+{
+	VkBuffer buffer = VK_NULL_HANDLE;
+	it_Allocation memory;
+	uint64_t frame = 0;
+};
+
+// One vertex and one index buffer shared by every model in the scene. Models keep element offsets into them
+// (Model::baseVertex, Model::baseIndex), so a pass binds the geometry once and draws with vertexOffset/firstIndex.
+struct it_GeometryHeap
+{
+	VkBuffer vertexBuffer = VK_NULL_HANDLE;
+	it_Allocation vertexMemory;
+	VkBuffer indexBuffer = VK_NULL_HANDLE;
+	it_Allocation indexMemory;
+	it_RangeAllocator vertices;  // GpuVertex elements
+	it_RangeAllocator indices;   // uint32_t elements
+	std::mutex mutex;
+	uint32_t pendingUploads = 0;  // recorded copies into the buffers that have not executed yet
+	std::condition_variable idle;
+	uint64_t frame = 0;  // frame the renderer is recording, see geometry_heap_begin_frame
+	std::vector<it_RetiredHeapBuffer> retired;
+};
+
+void create_geometry_heap(VkDevice* device, it_GeometryHeap* heap);
+
+void destroy_geometry_heap(VkDevice device, it_GeometryHeap* heap);
+
+// Reserve a range, stage the elements and record the copy into the upload context; the data is there once the context
+// is flushed. vertices are GpuVertex elements. Returns the first element of the range. If the range does not fit, the
+// heap waits for every pending upload and grows, copying the old contents. The old buffers are kept until the frames
+// that may have bound them are done, so a load can grow the heap while the scene renders.
+uint32_t geometry_heap_upload_vertices(it_UploadContext* uploadContext, it_GeometryHeap* heap, const void* vertices, uint32_t count);
+uint32_t geometry_heap_upload_indices(it_UploadContext* uploadContext, it_GeometryHeap* heap, const uint32_t* indices, uint32_t count);
+
+// Grows the heap up front so a scene load does not stall its loader threads on a resize
+void geometry_heap_reserve(it_UploadContext* uploadContext, it_GeometryHeap* heap, uint64_t vertexCount, uint64_t indexCount);
+
+// Called by the renderer before it records frame, once every frame up to completedFrame has finished on the GPU.
+// Destroys the buffers retired no later than completedFrame and returns the buffers to bind for this frame.
+void geometry_heap_begin_frame(VkDevice device, it_GeometryHeap* heap, uint64_t frame, uint64_t completedFrame, VkBuffer* vertexBuffer, VkBuffer* indexBuffer);
+
+void geometry_heap_release(it_GeometryHeap* heap, uint32_t baseVertex, uint32_t vertexCount, uint32_t baseIndex, uint32_t indexCount);
+
+#endif
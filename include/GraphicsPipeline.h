@@ -8,6 +8,9 @@
 #include "util.h"
 
 
+// Maps a vertex shader path to the variant matching GpuVertex
+std::string vertex_shader_variant(const std::string& vertShaderPath);
+
 VkShaderModule create_shader_module(VkDevice* device, const std::vector<char>& code);
 
 void create_graphics_pipeline(VkDevice* device, int index, std::string vertShaderPath, std::string fragShaderPath,
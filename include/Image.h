@@ -6,22 +6,24 @@
 #include <vector>
 
 #include "Command.h"
+#include "DeviceAllocator.h"
 
 struct it_ImageResource
 {
 	VkImageView		imageView;
 	VkImage			image;
-	VkDeviceMemory  memory;
+	it_Allocation   memory;
 	VkSampler       sampler;
 };
 
 void transition_image_layout(VkDevice* device, VkCommandPool commandPool, VkQueue graphicsQueue, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
+void record_image_layout_transition(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
 
 VkFormat findDepthFormat(VkPhysicalDevice physicalDevice);
 
 uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
-void createImage(VkDevice* device, VkPhysicalDevice* physicalDevice, uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+void createImage(VkDevice* device, uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, it_Allocation& imageMemory);
 
 VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
 
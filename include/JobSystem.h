@@ -0,0 +1,78 @@
+#ifndef __JOB_SYSTEM_H__
+#define __JOB_SYSTEM_H__
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <functional>
+#include <exception>
+#include <cstdint>
+
+// Jobs each worker can have queued before job_run falls back to running the job in place. Power of two.
+#define JOB_QUEUE_CAPACITY 4096
+// Jobs job_parallel_for queues per job thread. Items are handed out one at a time, the extra jobs let threads that
+// free up late still join in.
+#define JOB_PARALLEL_SPLIT 4
+
+struct it_Job;
+
+// Counts unfinished jobs. job_run adds one, the job removes it when it returns. Jobs started with job_run_after wait in
+// continuations until the counter they depend on reaches zero. A counter can be reused once it is back at zero.
+struct it_JobCounter
+{
+	std::atomic<uint32_t> pending{ 0 };
+	std::mutex mutex;                     // guards continuations, error and the final decrement
+	std::vector<it_Job*> continuations;
+	std::exception_ptr error;             // first exception thrown by one of the jobs, job_wait rethrows it
+};
+
+// job_system_init default, one worker per hardware thread besides the caller
+#define JOB_WORKERS_AUTO UINT32_MAX
+
+// Starts workerCount threads. The calling thread becomes job thread 0: it runs jobs while it waits in job_wait, so 0
+// workers still works, serially. Every worker owns a lock free deque (Chase-Lev), pushes and pops its own end and
+// steals from the other end of the others when it runs dry. Thread 0 renders: while there are workers it neither
+// steals nor takes jobs queued by other threads, it only runs the ones it queued itself.
+void job_system_init(uint32_t workerCount = JOB_WORKERS_AUTO);
+
+// Waits for the queued jobs and joins the workers
+void job_system_shutdown();
+
+bool job_system_running();
+
+// Workers plus the thread that called job_system_init
+uint32_t job_thread_count();
+
+// 0 to job_thread_count() - 1 on job threads, -1 anywhere else. Lets jobs pick per thread resources.
+int job_thread_index();
+
+// Queues fn. counter may be null, an exception from a job without one is logged and counted in it_JobStats::failed.
+void job_run(std::function<void()> fn, it_JobCounter* counter);
+
+// Queues fn once dependency has reached zero
+void job_run_after(it_JobCounter* dependency, std::function<void()> fn, it_JobCounter* counter);
+
+// Returns once counter is zero and rethrows the first exception one of its jobs threw. Job threads run queued jobs
+// meanwhile, so waiting inside a job cannot deadlock the pool. Other threads just yield. Jobs queued by other threads
+// only run on thread 0 when there are no workers, then once it waits or calls job_try_run.
+void job_wait(it_JobCounter* counter);
+
+// Runs one queued job on the calling job thread. False if nothing was queued or the caller is not a job thread. For
+// threads that wait on something other than a counter and should not idle meanwhile.
+bool job_try_run();
+
+// fn(i) for every i in [0, count), returns when all calls finished
+void job_parallel_for(size_t count, const std::function<void(size_t)>& fn);
+
+struct it_JobStats
+{
+	uint64_t executed = 0;
+	uint64_t stolen = 0;
+	uint64_t inlined = 0;  // ran in place because the worker's deque was full
+	uint64_t sleeps = 0;
+	uint64_t failed = 0;   // jobs without a counter that threw
+};
+
+it_JobStats job_system_stats();
+
+#endif
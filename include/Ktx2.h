@@ -0,0 +1,48 @@
+#ifndef __KTX2_H__
+#define __KTX2_H__
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+#include "MappedFile.h"
+
+// Offsets of level data are multiples of this, enough for the 16 byte BC blocks, RGBA8 texels and staging copies
+#define KTX2_LEVEL_ALIGNMENT 16
+
+struct it_Ktx2Level
+{
+	uint64_t offset = 0;  // into the file, or the data write_ktx2 is given
+	uint64_t size = 0;
+};
+
+// A KTX2 file mapped for reading. Only what the cooker writes is accepted: one 2D image in BC7, BC5 or RGBA8 (the
+// cached mip chains), no array layers, cube faces or supercompression.
+struct it_Ktx2File
+{
+	it_MappedFile file;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<it_Ktx2Level> levels;  // level 0, the full size, first
+	uint32_t kvdOffset = 0;
+	uint32_t kvdLength = 0;
+};
+
+// False if the file is missing or not one open_ktx2 understands; nothing stays mapped then
+bool open_ktx2(const std::string& path, it_Ktx2File* ktx);
+void close_ktx2(it_Ktx2File* ktx);
+
+// The value of key in the key/value data, nullptr if it is not there
+const uint8_t* ktx2_value(const it_Ktx2File* ktx, const std::string& key, uint32_t* size);
+
+// Writes the levels of an image in format (BC7, BC5 or RGBA8) with its data format descriptor. levels says where the
+// blocks or texels of each mip lie in data, level 0 first. Levels are stored smallest first as the specification asks.
+// keyValues must not use the reserved "KTX" prefix apart from KTXwriter. Written to a temporary file and renamed, false
+// on any I/O error.
+bool write_ktx2(const std::string& path, VkFormat format, uint32_t width, uint32_t height, const std::vector<it_Ktx2Level>& levels, const uint8_t* data,
+	std::vector<std::pair<std::string, std::string>> keyValues);
+
+#endif
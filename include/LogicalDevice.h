@@ -15,7 +15,8 @@ struct it_Device {
 	VkDevice device;
 };
 
-void create_logical_device(VkDevice* device, VkPhysicalDevice* physicalDevice, VkSurfaceKHR* surface, VkQueue* graphicsQueue, VkQueue* presentQueue);
+// uploadQueue is a second queue of the graphics family when it has one, otherwise the graphics queue itself
+void create_logical_device(VkDevice* device, VkPhysicalDevice* physicalDevice, VkSurfaceKHR* surface, VkQueue* graphicsQueue, VkQueue* presentQueue, VkQueue* uploadQueue);
 
 #endif
 
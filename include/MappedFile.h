@@ -0,0 +1,21 @@
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. data is nullptr for empty or missing files.
+struct it_MappedFile
+{
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+};
+
+bool map_file(const std::string& path, it_MappedFile* file);
+
+void unmap_file(it_MappedFile* file);
+
+#endif
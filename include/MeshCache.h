@@ -0,0 +1,81 @@
+#ifndef __MESH_CACHE_H__
+#define __MESH_CACHE_H__
+
+#include <string>
+#include <cstdint>
+
+#include "Model.h"
+
+#define MESH_CACHE_DIR "res/cache/meshes/"
+#define MESH_CACHE_MAGIC 0x48534D56 // "VMSH"
+#define MESH_CACHE_VERSION 5
+
+// Compile time options that change the processed vertex data, an entry built with other options is rebuilt
+#define MESH_CACHE_FLAG_ANGLE_WEIGHTED 0x1
+#define MESH_CACHE_FLAG_UNOPTIMIZED    0x2
+#define MESH_CACHE_FLAG_MESHLETS       0x4
+
+#ifdef ENGINE_ANGLE_WEIGHTED_TANGENTS
+#define MESH_CACHE_TANGENT_FLAGS MESH_CACHE_FLAG_ANGLE_WEIGHTED
+#else
+#define MESH_CACHE_TANGENT_FLAGS 0
+#endif
+
+#ifdef ENGINE_DISABLE_MESH_OPTIMIZATION
+#define MESH_CACHE_OPTIMIZE_FLAGS MESH_CACHE_FLAG_UNOPTIMIZED
+#else
+#define MESH_CACHE_OPTIMIZE_FLAGS 0
+#endif
+
+#ifdef ENGINE_BUILD_MESHLETS
+#define MESH_CACHE_MESHLET_FLAGS MESH_CACHE_FLAG_MESHLETS
+#else
+#define MESH_CACHE_MESHLET_FLAGS 0
+#endif
+
+#define MESH_CACHE_BUILD_FLAGS (MESH_CACHE_TANGENT_FLAGS | MESH_CACHE_OPTIMIZE_FLAGS | MESH_CACHE_MESHLET_FLAGS)
+
+// On-disk layout: header, then vertex data at vertexOffset, index data at indexOffset, the LOD table at lodOffset and
+// the meshlets of LOD 0 with their vertex and micro index arrays (all 16 byte aligned, the meshlet arrays are empty
+// unless the entry was built with ENGINE_BUILD_MESHLETS).
+// A cache entry is valid for a source file while its path, mtime and size match; if only the mtime changed
+// the content hash decides.
+struct it_MeshCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexStride;
+	uint32_t indexStride;
+	uint32_t buildFlags;
+	uint32_t reserved;
+	uint64_t pathHash;
+	int64_t  sourceMTime;
+	uint64_t sourceSize;
+	uint64_t sourceHash;
+	uint64_t vertexCount;
+	uint64_t indexCount;
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t lodCount;
+	uint64_t lodOffset;
+	uint64_t meshletCount;
+	uint64_t meshletOffset;
+	uint64_t meshletVertexCount;
+	uint64_t meshletVertexOffset;
+	uint64_t meshletTriangleBytes;
+	uint64_t meshletTriangleOffset;
+	float    boundsMin[3];
+	float    boundsMax[3];
+	Material material;
+};
+
+uint64_t hash_bytes(const void* data, size_t size);
+
+// Entries are keyed on baseDir + MODEL_PATH, the same relative path under two directories is two entries
+std::string mesh_cache_path(const std::string& sourcePath);
+
+bool load_mesh_cache(Model* cModel);
+
+void write_mesh_cache(Model* cModel);
+
+#endif
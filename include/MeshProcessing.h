@@ -0,0 +1,82 @@
+#ifndef __MESH_PROCESSING_H__
+#define __MESH_PROCESSING_H__
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Vulkan free mesh stages that run between parsing and upload. Everything works on plain arrays so the stages can be
+// driven from tools or headless code without a device.
+
+#define TANGENT_MODE_LEGACY         0   // per triangle frames summed per vertex, same results as the old load_model loop
+#define TANGENT_MODE_ANGLE_WEIGHTED 1   // angle weighted, orthogonalized against the vertex normal, handedness in tangentSign.
+                                        // Vertices are not split where the frame flips (mirrored uv seams), so this is not
+                                        // MikkTSpace: a vertex shared across such a seam gets the average of both sides.
+
+// Structure of arrays view of a mesh for tangent generation. Inputs must all hold vertexCount entries; the outputs are
+// resized by compute_tangents.
+struct it_TangentStreams
+{
+	std::vector<float> px, py, pz;
+	std::vector<float> nx, ny, nz;
+	std::vector<float> u, v;
+
+	std::vector<float> tx, ty, tz;
+	std::vector<float> bx, by, bz;
+	std::vector<float> tangentSign;
+};
+
+// Computes per vertex tangent and bitangent for an indexed triangle list. Triangles are processed in parallel ranges
+// with AVX kernels (SSE where the CPU has no AVX) and the per vertex sums are gathered in triangle order, so the
+// output depends on neither the thread count nor the instruction set.
+void compute_tangents(it_TangentStreams* streams, const uint32_t* indices, size_t indexCount, int mode);
+
+// True if the CPU and OS support AVX, checked once
+bool tangent_avx_supported();
+// Switches the legacy triangle kernel between AVX and SSE, for tests and benchmarks. On by default.
+void tangent_use_avx(bool enabled);
+
+// Post transform cache size the reordering targets and the statistics simulate (FIFO)
+#define MESH_VERTEX_CACHE_SIZE 16
+
+struct it_VertexCacheStats
+{
+	float acmr = 0.0f;  // transformed vertices per triangle
+	float atvr = 0.0f;  // transformed vertices per referenced vertex, 1.0 is optimal
+};
+
+it_VertexCacheStats analyze_vertex_cache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize);
+
+// Tipsify (Sander et al. 2007) triangle reordering for a FIFO cache of cacheSize entries. Winding is preserved.
+void optimize_vertex_cache(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize);
+
+// Forsyth (2006) triangle reordering: greedily emits the triangle whose vertices score best in a simulated LRU cache of
+// cacheSize entries. Slower than Tipsify, compared against it by benchmark_vertex_cache. Winding is preserved.
+void optimize_vertex_cache_forsyth(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize);
+
+// Renumbers vertices in first use order so vertex fetches walk memory linearly. Rewrites indices and returns
+// remap[oldVertex] = newVertex; unreferenced vertices are moved to the end.
+std::vector<uint32_t> optimize_vertex_fetch(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+
+// Level 0 plus up to four simplified levels, each targeting half the triangles of the previous one
+#define MESH_MAX_LODS 5
+
+struct it_SimplifyResult
+{
+	std::vector<uint32_t> indices;
+	std::vector<uint32_t> collapse;  // collapse[v] is the vertex v was merged into, v itself if it was kept
+	float error = 0.0f;              // object space bound on the distance between a kept vertex and the planes it replaced
+};
+
+// Quadric error edge collapse (Garland and Heckbert 1997). Vertices are only merged into existing vertices so the
+// result indexes the same vertex buffer. Vertices on borders and attribute seams (a position shared by several
+// vertices) never move. Stops at targetIndexCount or once a collapse would exceed maxError.
+it_SimplifyResult simplify_mesh(const float* positions, size_t positionStride, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+	size_t targetIndexCount, float maxError);
+
+// Largest distance between an original triangle plane and the vertices its corners were collapsed into. Never exceeds
+// it_SimplifyResult::error, test_simplification checks that on fixed meshes so LOD selection can trust the bound.
+float measure_simplification_error(const float* positions, size_t positionStride, const uint32_t* indices, size_t indexCount, const std::vector<uint32_t>& collapse);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef __MESHLET_BUILDER_H__
+#define __MESHLET_BUILDER_H__
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Limits match the common mesh shader sweet spot; 124 triangles keep a meshlet's micro index block under 384 bytes
+#define MESHLET_MAX_VERTICES  64
+#define MESHLET_MAX_TRIANGLES 124
+
+// One cluster of a mesh. Triangles are taken in index buffer order, so meshlet i covers indices
+// [firstIndex, firstIndex + triangleCount * 3) of the source and can be drawn straight from the existing index buffer.
+// The local vertex list and 8 bit micro indices describe the same triangles for mesh shaders.
+struct it_Meshlet
+{
+	uint32_t vertexOffset;    // first entry in it_MeshletData::vertices
+	uint32_t triangleOffset;  // first byte in it_MeshletData::triangles, three per triangle
+	uint32_t firstIndex;
+	uint16_t vertexCount;
+	uint16_t triangleCount;
+
+	float center[3];          // bounding sphere
+	float radius;
+	float coneApex[3];        // normal cone, see meshlet_backfacing
+	float coneCutoff;         // sine of the cone half angle, above 1 when the cone is too wide to ever cull
+	float coneAxis[3];
+	uint32_t padding;
+};
+
+struct it_MeshletData
+{
+	std::vector<it_Meshlet> meshlets;
+	std::vector<uint32_t> vertices;
+	std::vector<uint8_t> triangles;
+};
+
+// Splits an indexed triangle list into meshlets in a single pass over the triangles and computes their bounds.
+// The output only depends on the input, not on the thread count.
+void build_meshlets(const float* positions, size_t positionStride, size_t vertexCount, const uint32_t* indices, size_t indexCount, it_MeshletData* out);
+
+// Checks limits, that the meshlets reproduce the source triangles in order, that every sphere holds its vertices and
+// that every triangle lies behind its cone apex. Returns false with a description of the first failure. Run by
+// test_meshlets, not at load time.
+bool validate_meshlets(const it_MeshletData& data, const float* positions, size_t positionStride, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+	std::string* err);
+
+// True if every triangle of the meshlet faces away from cameraPos (counter clockwise front faces). cameraPos must be in
+// the space the meshlet was built in.
+bool meshlet_backfacing(const it_Meshlet& meshlet, const float cameraPos[3]);
+
+// True if the bounding sphere is fully outside one of the planes (xyz normal, w offset, positive side inside).
+// radiusScale converts the radius into the planes' space.
+bool meshlet_outside_frustum(const it_Meshlet& meshlet, const float planes[6][4], float radiusScale);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef __MIP_GENERATOR_H__
+#define __MIP_GENERATOR_H__
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+#include "Texture.h"
+
+// Filters a level is reduced with, always from the level above it
+enum it_MipFilter
+{
+	MIP_FILTER_BOX = 0,     // area average of the texels a target texel covers
+	MIP_FILTER_KAISER = 1,  // Kaiser windowed sinc, keeps detail the box blurs away in the smaller levels
+};
+
+#ifdef ENGINE_BOX_MIPMAPS
+#define MIP_FILTER_DEFAULT MIP_FILTER_BOX
+#else
+#define MIP_FILTER_DEFAULT MIP_FILTER_KAISER
+#endif
+
+// Builds the mip chain of image down to 1x1 on the CPU, levels halve like Vulkan's (rounding down). format says what
+// the texels are: TEXTURE_FORMAT_COLOR is averaged in linear light and stored back as sRGB, TEXTURE_FORMAT_NORMAL as
+// vectors renormalized in every level, anything else as plain linear values. Alpha is always linear. Rows are spread
+// over parallel_for and filtered four channels at a time with SSE.
+void generate_mip_chain(const it_ImageData* image, VkFormat format, it_MipFilter filter, it_MipChain* chain);
+
+#endif
@@ -1,6 +1,8 @@
 #pragma once
 #define __MODEL_CLASS__
 #include <Vertex.h>
+#include <MeshletBuilder.h>
+#include <GeometryHeap.h>
 #include <Image.h>
 #include <string>
 #include <tinylogger.h>
@@ -23,11 +25,31 @@
 #include "glmIncludes.h"
 #include <vulkan/vulkan.h>
 #include <PxPhysicsAPI.h>
+#include "TransformHierarchy.h"
 
 
 
 
 
+struct it_Texture;
+struct it_BindlessSet;
+
+// Per frame counters shown in the GUI, covers every pass
+struct it_FrameStats
+{
+	uint32_t triangles = 0;
+	uint32_t binds = 0;  // pipeline, vertex/index buffer and descriptor set binds
+	size_t uniformBytes = 0;  // written to the frame's object, material and frame buffers
+};
+
+// Index range of one level of detail inside Model::indices
+struct it_MeshLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;  // object space simplification error bound, 0 for the full mesh
+};
+
 struct Model
 {
 	std::string MODEL_PATH;
@@ -39,6 +61,14 @@ struct Model
 	//Model(std::string MODEL_PATH, std::string TEXTURE_PATH);
 	std::vector<Vertex> vertices;
 	std::vector<uint32_t> indices;
+	std::vector<it_MeshLod> lods;
+	int currentLod = 0;
+	it_MeshletData meshlets;  // of LOD 0, only built with ENGINE_BUILD_MESHLETS, stored in the mesh cache
+	std::vector<VkDrawIndexedIndirectCommand> visibleDraws;
+	bool meshletCulling = false;  // visibleDraws holds this frame's surviving meshlet ranges
+	std::vector<PackedVertex> packedVertices;
+	glm::mat4 dequantize = glm::mat4(1.0f);
+	glm::vec4 uvScaleBias = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
 	
 	union {
 		physx::PxRigidStatic* rigidStatic;
@@ -48,43 +78,65 @@ struct Model
 	glm::vec3 scaleVec = glm::vec3(1.0f);
 	glm::vec3 translationVec = glm::vec3(0.0);
 	glm::vec3 rotationVec = glm::vec3(0.0f);
+	bool transformDirty = true;  // TRS changed since transform was built, set by everything that writes them
+	std::string parentUUID;  // empty for roots, the TRS are relative to the parent's transform
+	Model* parent = nullptr;  // resolved from parentUUID by update_model_hierarchy
+	uint32_t hierarchyNode = UINT32_MAX;
+
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
 
 	int pipelineIndex = 0;
 
 	Material material;
 	unsigned int statsFaces = 0;
 	int isStatic = 0;
-	VkBuffer vertexBuffer;
-	VkDeviceMemory vertexBufferMemory;
-	VkBuffer indexBuffer;
-	VkDeviceMemory indexBufferMemory;
-	VkImage textureImage;
-	VkDeviceMemory textureImageMemory;
-	VkImageView textureImageView;
-	VkSampler textureSampler;
-	VkImage normalImage;
-	VkDeviceMemory normalImageMemory;
-	VkImageView normalImageView;
-	VkSampler normalSampler;
-	
-	uint32_t mipLevels;
-	std::vector<VkDescriptorSet> descriptorSets;
-	VkDescriptorSetLayout descriptorSetLayout;
-	VkDescriptorPool descriptorPool;
-	std::vector<VkBuffer> uniformBuffers;
-	std::vector<VkDeviceMemory> uniformBuffersMemory;
-	std::vector<void*> uniformBuffersMapped;
+	uint32_t baseVertex = 0;  // first element of the model's ranges in the geometry heap
+	uint32_t baseIndex = 0;
+	it_Texture* texture = nullptr;  // references into the texture cache, shared with every model using the same file
+	it_Texture* normal = nullptr;
+	uint32_t virtualTexture = UINT32_MAX;  // into the virtual textures when the colour texture is one, texture is unused then
+	uint32_t objectIndex = UINT32_MAX;  // element of the bindless object and material buffers, every model owns one of each
 
 };
 
 void init_model(Model* cModel, std::string MODEL_PATH, std::string TEXTURE_PATH);
 
-void cleanup_model(VkDevice* device, Model* cModel);
+void cleanup_model(it_GeometryHeap* geometryHeap, it_BindlessSet* bindless, Model* cModel);
 
 void load_model(Model* cModel);
 
-void init_model_resources(VkDevice* device, VkPhysicalDevice* physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue, Model* cModel, it_ImageResource* depthRes, std::vector<VkBuffer>* lightBuffers);
-void mt_init_model_resources(VkDevice* device, VkPhysicalDevice* physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue, Model* cModel, it_ImageResource* depthRes, std::vector<VkBuffer>* lightBuffers, std::mutex& queueMutex);
+struct it_ModelImages;
+
+// Records the model's uploads into uploadContext, flush it before drawing the model. Safe to call from several threads
+// at once as long as each has its own context. A colour texture with a current virtual texture is sampled as one, else
+// it and the normal map come from the texture cache, mip chains that are missing or empty are decoded here unless the
+// cache already holds them. The model gets its slot in the bindless
+// object and material buffers. If a step throws, whatever the earlier ones acquired is released again.
+void init_model_resources(it_UploadContext* uploadContext, it_GeometryHeap* geometryHeap, it_BindlessSet* bindless, Model* cModel,
+	const it_ModelImages* images = nullptr);
+
+// Rebuilds transform from the TRS if they changed, returns whether it did
+bool update_model_transform(Model* cModel);
+
+// The scene's models as a transform hierarchy, node order is parents first
+struct it_ModelHierarchy
+{
+	it_TransformHierarchy nodes;
+	std::vector<Model*> models;            // per node
+	std::vector<std::string> UUIDs;        // per node, as of the last rebuild
+	std::vector<std::string> parentUUIDs;
+};
+
+// Pushes the TRS of dirty models into the hierarchy and rebuilds transform for them and everything parented below them.
+// The hierarchy is rebuilt first when models were added or removed or a UUID or parentUUID changed; unknown parents and
+// cycles leave the model as a root. Returns how many transforms were rebuilt.
+size_t update_model_hierarchy(std::vector<Model*>& scene, it_ModelHierarchy* hierarchy);
+
+void select_model_lod(Model* cModel, glm::vec3 cameraPos, float pixelsPerUnit);
+
+void cull_model_meshlets(Model* cModel, const glm::mat4& viewProj, glm::vec3 cameraPos);
 
-void draw_model(Model* cModel, VkCommandBuffer commandBuffer, VkPipelineLayout graphicsPipelineLayout, int currentFrame);
+// Expects the geometry heap and the frame's bindless set to be bound, pushes the model's indices
+void draw_model(Model* cModel, VkCommandBuffer commandBuffer, VkPipelineLayout graphicsPipelineLayout, it_FrameStats* stats);
 
@@ -0,0 +1,25 @@
+#ifndef __OBJ_PARSER_H__
+#define __OBJ_PARSER_H__
+
+#include <string>
+#include <vector>
+
+#include <tiny_obj_loader.h>
+
+// Flattened contents of an OBJ file. indices holds three corners per triangle in file order (polygons are
+// fan triangulated like tinyobj does) with all indices resolved to zero based; a missing texcoord or normal is -1.
+struct it_ObjMesh
+{
+	std::vector<float> positions;
+	std::vector<float> normals;
+	std::vector<float> texcoords;
+	std::vector<tinyobj::index_t> indices;
+	std::vector<tinyobj::material_t> materials;
+	size_t fileSize = 0;
+};
+
+// Memory maps the file, splits it at line boundaries and parses the chunks on all hardware threads.
+// Materials referenced by mtllib are loaded from mtlBaseDir.
+bool parse_obj(const std::string& path, const std::string& mtlBaseDir, it_ObjMesh* mesh, std::string* err);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <mutex>
+#include <exception>
+
+#include "JobSystem.h"
+
+// Calls fn(i) for every i in [0, count) spread over the hardware threads and returns once all calls finished.
+// Items are handed out one at a time, so uneven work per item balances itself. Runs on the job system when it is up,
+// tools and headless code without one get threads of their own. The first exception fn throws is rethrown here once
+// every thread stopped.
+inline void parallel_for(size_t count, const std::function<void(size_t)>& fn)
+{
+	if (job_system_running())
+	{
+		job_parallel_for(count, fn);
+		return;
+	}
+
+	size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), count);
+	if (threadCount <= 1)
+	{
+		for (size_t i = 0; i < count; ++i)
+			fn(i);
+		return;
+	}
+
+	// the first exception stops handing out items and is rethrown here, never on the threads
+	std::atomic<size_t> next{ 0 };
+	std::mutex errorMutex;
+	std::exception_ptr error;
+	auto worker = [&]() {
+		try
+		{
+			for (size_t i = next++; i < count; i = next++)
+				fn(i);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(errorMutex);
+			if (!error)
+				error = std::current_exception();
+			next = count;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for (size_t t = 0; t + 1 < threadCount; ++t)
+		threads.emplace_back(worker);
+	worker();
+	for (auto& thread : threads)
+		thread.join();
+	if (error)
+		std::rethrow_exception(error);
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef __RANGE_ALLOCATOR_H__
+#define __RANGE_ALLOCATOR_H__
+
+#include <map>
+#include <cstdint>
+
+// Best fit free list over [0, capacity), in whatever unit the owner uses (elements, bytes). Free ranges are indexed by
+// offset for merging and by size for the search, so allocation and free are O(log n) in the number of free ranges.
+// No Vulkan types, so it can be exercised without a device.
+struct it_RangeAllocator
+{
+	std::map<uint64_t, uint64_t> freeRanges;      // offset -> size, neighbours are always merged
+	std::multimap<uint64_t, uint64_t> freeSizes;  // size -> offset
+	uint64_t capacity = 0;
+	uint64_t used = 0;
+	uint32_t allocationCount = 0;
+};
+
+void range_allocator_init(it_RangeAllocator* allocator, uint64_t capacity);
+
+bool range_alloc(it_RangeAllocator* allocator, uint64_t size, uint64_t* offset);
+
+// alignment must be a power of two; the skipped head of a free range stays free
+bool range_alloc_aligned(it_RangeAllocator* allocator, uint64_t size, uint64_t alignment, uint64_t* offset);
+
+void range_free(it_RangeAllocator* allocator, uint64_t offset, uint64_t size);
+
+// Extends the range to newCapacity, the new space joins a free range that ends at the old capacity
+void range_allocator_grow(it_RangeAllocator* allocator, uint64_t newCapacity);
+
+uint64_t range_largest_free(const it_RangeAllocator* allocator);
+
+// 0 when all free space is one range, approaching 1 as it splits into many small ones
+float range_fragmentation(const it_RangeAllocator* allocator);
+
+#endif
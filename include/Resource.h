@@ -6,10 +6,10 @@
 
 #include "Image.h"
 
-void create_color_resources(VkDevice* device, VkPhysicalDevice* physicalDevice, it_ImageResource* colorImageRes, VkFormat swapChainImageFormat, VkExtent2D swapChainExtent, VkSampleCountFlagBits msaaSamples);
+void create_color_resources(VkDevice* device, it_ImageResource* colorImageRes, VkFormat swapChainImageFormat, VkExtent2D swapChainExtent, VkSampleCountFlagBits msaaSamples);
 
 void create_depth_resources(VkDevice* device, VkPhysicalDevice* physicalDevice, it_ImageResource* depthImageRes, VkFormat swapChainImageFormat, VkExtent2D swapChainExtent, VkSampleCountFlagBits msaaSamples);
 
-void create_shadow_resources(VkDevice* device, VkPhysicalDevice* physicalDevice, it_ImageResource* shadowImageRes, VkFormat swapChainImageFormat, VkExtent2D swapChainExtent, VkSampleCountFlagBits msaaSamples);
+void create_shadow_resources(VkDevice* device, it_ImageResource* shadowImageRes, VkFormat swapChainImageFormat, VkExtent2D swapChainExtent, VkSampleCountFlagBits msaaSamples);
 
 #endif
\ No newline at end of file
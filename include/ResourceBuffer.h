@@ -3,22 +3,40 @@
 
 #include <vulkan/vulkan.h>
 #include <stdexcept>
+#include <cstddef>
 
 #include "Model.h"
 #include "Buffer.h"
+#include "GeometryHeap.h"
+#include "UploadContext.h"
 
 
-struct UniformBufferObject
+// Written once per frame, everything the objects of the frame share (std140)
+struct FrameUniformBufferObject
 {
-	glm::mat4 transform;
 	glm::mat4 view;
 	glm::mat4 proj;
 	glm::mat4 lightSpaceMat;
-	glm::vec3 cameraPos;
-	Material material;
-	float time;
+	glm::vec4 cameraPos;  // w is the time in seconds
 };
 
+// An object's element of the bindless object buffer (std430), 80 bytes. The transform is affine, so only its first
+// three rows are stored, the shader multiplies with a row vector.
+struct ObjectData
+{
+	glm::vec4 transformRows[3];
+	glm::vec4 uvScaleBias;
+	uint32_t material;  // into the material buffer
+	uint32_t padding[3];
+};
+
+// The shaders declare both blocks by hand, these offsets are what they assume
+static_assert(offsetof(FrameUniformBufferObject, view) == 0 && offsetof(FrameUniformBufferObject, proj) == 64, "frame block layout");
+static_assert(offsetof(FrameUniformBufferObject, lightSpaceMat) == 128 && offsetof(FrameUniformBufferObject, cameraPos) == 192, "frame block layout");
+static_assert(sizeof(FrameUniformBufferObject) == 208, "frame block size");
+static_assert(offsetof(ObjectData, transformRows) == 0 && offsetof(ObjectData, uvScaleBias) == 48 && offsetof(ObjectData, material) == 64, "object layout");
+static_assert(sizeof(ObjectData) == 80, "object stride of the std430 array");
+
 struct LightsUniformBufferObject
 {
 	glm::vec3 lightPos = glm::vec3(0.0f);
@@ -29,17 +47,17 @@ struct LightsUniformBufferObject
 struct it_lightBufferResource
 {
 	std::vector<VkBuffer> lightBuffers;
-	std::vector<VkDeviceMemory> lightBuffersMemory;
+	std::vector<it_Allocation> lightBuffersMemory;
 	std::vector<void*> lightBuffersMapped;
 };
 
-void create_vertex_buffer(VkDevice* device, VkPhysicalDevice* physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue, Model* cModel);
-
-void create_index_buffer(VkDevice* device, VkPhysicalDevice* physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue, Model* cModel);
+// Both upload into a range of the scene's geometry heap and store its first element in the model. The data is in
+// place once the upload context is flushed.
+void create_vertex_buffer(it_UploadContext* uploadContext, it_GeometryHeap* geometryHeap, Model* cModel);
 
-void create_uniform_buffers(VkDevice* device, VkPhysicalDevice* physicalDevice, Model* cModel);
+void create_index_buffer(it_UploadContext* uploadContext, it_GeometryHeap* geometryHeap, Model* cModel);
 
-void create_light_uniform_buffer(VkDevice* device, VkPhysicalDevice* physicalDevice, it_lightBufferResource* lightRes);
+void create_light_uniform_buffer(VkDevice* device, it_lightBufferResource* lightRes);
 
 void cleanup_light_uniform_buffer(VkDevice device, it_lightBufferResource* lightRes);
 
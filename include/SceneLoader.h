@@ -0,0 +1,107 @@
+#ifndef __SCENE_LOADER_H__
+#define __SCENE_LOADER_H__
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <exception>
+
+#include "Model.h"
+#include "Texture.h"
+#include "UploadContext.h"
+#include "GeometryHeap.h"
+
+// Scene loading runs as a pipeline: the JSON is read on the loading thread, every model's mesh (parse, weld,
+// processing) and images (decode from the mapped file and mip generation, texture_cache_decode) are separate jobs, and
+// the loading thread uploads models as they become ready, a single staging copy per image. Models that are started
+// but not uploaded yet hold their mip chains, so the loader only keeps a window of them in flight and stops starting
+// new ones while their pixels exceed the budget. Memory stays flat however big the scene.
+#define SCENE_LOAD_WINDOW 8
+#define SCENE_LOAD_DECODE_BUDGET (256ull << 20)
+
+// Last stage of the pipeline, called on the loading thread in completion order rather than scene order. images is
+// freed after upload returns.
+struct it_SceneUploader
+{
+	void* userData = nullptr;
+	void (*upload)(void* userData, Model* model, const it_ModelImages* images) = nullptr;
+	void (*finish)(void* userData) = nullptr;  // after the last model, may be null
+	void (*poll)(void* userData) = nullptr;    // while the loading thread waits for the next model, may be null
+	// Takes every model of a load that failed, whether or not upload ran or returned for it, once no job uses it.
+	// May be null, then the models are deleted.
+	void (*discard)(void* userData, Model* model) = nullptr;
+};
+
+struct it_SceneLoadStats
+{
+	uint32_t models = 0;
+	double parseSeconds = 0.0;     // scene JSON on the loading thread
+	double meshSeconds = 0.0;      // load_model, summed over jobs
+	double decodeSeconds = 0.0;    // image decode and mips, summed over jobs
+	double uploadSeconds = 0.0;    // uploader on the loading thread
+	double waitSeconds = 0.0;      // loading thread waiting for the next ready model, running jobs meanwhile
+	double totalSeconds = 0.0;
+	uint64_t decodedBytes = 0;
+	uint64_t peakDecodedBytes = 0; // most mip chain bytes held at once
+	uint32_t skippedDecodes = 0;   // images already in the texture cache, cooked, cached on disk or decoded for another model
+};
+
+// What the Vulkan uploader records into. Only the loading thread touches uploadContext.
+struct it_SceneUploadTarget
+{
+	it_UploadContext* uploadContext = nullptr;
+	it_GeometryHeap* geometryHeap = nullptr;
+	it_BindlessSet* bindless = nullptr;
+};
+
+// init_model_resources per model, submitting after each so the GPU copies while the next model is recorded. finish
+// flushes the context.
+it_SceneUploader vulkan_scene_uploader(it_SceneUploadTarget* target);
+
+// Drops the images, for timing the CPU stages headless
+it_SceneUploader null_scene_uploader();
+
+// Loads res/data/user/<scenePath> into scene (file order). Needs the job system; the calling thread runs jobs while
+// it waits for the next model. The first error of any stage is rethrown once the models in flight have finished,
+// after every model went to uploader.discard and scene was cleared.
+void load_scene_pipelined(const std::string& scenePath, it_SceneUploader uploader, std::vector<Model*>* scene, it_SceneLoadStats* stats);
+
+// A scene load on its own thread while the current scene keeps rendering. The thread runs prepare (pipelines for the
+// new scene, say) and then load_scene_pipelined into target, which needs an upload context of its own. A model is
+// handed over once its uploads have finished on the GPU, the renderer takes them at frame boundaries with
+// scene_stream_take. The thread is not a job thread: with no workers its stages only run when the render thread calls
+// job_try_run.
+struct it_SceneStream
+{
+	std::thread thread;
+	std::atomic<bool> cancel{ false };
+	bool running = false;  // started and not yet joined
+	it_SceneUploadTarget target;
+	std::vector<Model*> scene;     // every model of the load, loading thread only
+	std::vector<Model*> uploaded;  // models whose uploads were recorded, loading thread only
+
+	std::mutex mutex;                 // guards everything below
+	std::vector<Model*> resident;     // uploaded, not taken yet
+	bool finished = false;
+	std::exception_ptr error;
+	it_SceneLoadStats stats;
+	std::chrono::high_resolution_clock::time_point start;
+};
+
+void scene_stream_start(it_SceneStream* stream, const std::string& scenePath, it_SceneUploadTarget target, std::function<void()> prepare);
+
+// Appends the models that became resident since the last call to models. Returns true once the load is over, then
+// the thread is joined and an error of the load is rethrown (models that were never uploaded are deleted by then).
+bool scene_stream_take(it_SceneStream* stream, std::vector<Model*>* models);
+
+// Stops starting models and waits for the thread. Models uploaded meanwhile still go to the next
+// scene_stream_take, the load's error is dropped.
+void scene_stream_cancel(it_SceneStream* stream);
+
+#endif
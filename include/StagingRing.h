@@ -0,0 +1,43 @@
+#ifndef __STAGING_RING_H__
+#define __STAGING_RING_H__
+
+#include <deque>
+#include <cstdint>
+
+// Where the ring learns that the GPU is done with a submission. Tickets are handed out by the owner in increasing
+// order; completed returns the highest ticket known to have finished and wait blocks until ticket has. A test can
+// drive the ring with a fake source instead of VkFences.
+struct it_FenceSource
+{
+	void* userData = nullptr;
+	uint64_t (*completed)(void* userData) = nullptr;
+	void (*wait)(void* userData, uint64_t ticket) = nullptr;
+};
+
+// Byte ring over a persistently mapped staging buffer. head and tail only grow, the position in the buffer is
+// head % capacity. Allocations never straddle the end: the rest of the buffer is skipped and released together
+// with the allocation that skipped it.
+struct it_StagingRing
+{
+	uint64_t capacity = 0;
+	uint64_t head = 0;       // bytes handed out so far, skipped bytes included
+	uint64_t tail = 0;       // bytes released so far
+	uint64_t submitted = 0;  // head at the last submit, everything after it belongs to the open batch
+	std::deque<std::pair<uint64_t, uint64_t>> inFlight;  // (ticket, head at submit), oldest first
+	it_FenceSource fences;
+	uint32_t waits = 0;      // allocations that had to block on the oldest submission
+};
+
+void staging_ring_init(it_StagingRing* ring, uint64_t capacity, it_FenceSource fences);
+
+// Offset of size free bytes, waiting on in flight submissions if needed. Returns false if size can never fit
+// (larger than the ring) or if only the open batch holds the space; submit it and try again.
+bool staging_ring_alloc(it_StagingRing* ring, uint64_t size, uint64_t alignment, uint64_t* offset);
+
+// Everything allocated since the last submit is released once ticket completes
+void staging_ring_submit(it_StagingRing* ring, uint64_t ticket);
+
+// Releases the space of every completed submission
+void staging_ring_retire(it_StagingRing* ring);
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef __TESTS_H__
+#define __TESTS_H__
+
+// Headless correctness checks, started with --test instead of the engine. Like the benchmarks nothing here creates a
+// window or a Vulkan device. Every failed check is logged; each test returns how many of its checks failed.
+
+// Legacy tangents against the scalar glm loop load_model used to run, the AVX kernel against the SSE one, and the
+// angle weighted mode for unit, orthogonal frames that agree with legacy on flat and mirrored grids.
+int test_tangents();
+
+// Packs and unpacks generated vertices, axis and octahedral fold directions and a flat mesh, and checks position, uv,
+// normal and tangent error against the quantization step and that no tangent handedness flips.
+int test_vertex_packing();
+
+// Tipsify and Forsyth on a shuffled grid with degenerate and duplicate triangles, each followed by the fetch remap.
+// Checks that the triangle multiset and winding survive, the remap is a first use permutation and ACMR improves.
+int test_mesh_optimization();
+
+// Simplifies a flat grid, a wavy grid and a uv seamed sphere to every LOD target. Checks the measured deviation stays
+// within the reported bound, no border or seam vertex moves, no output triangle is degenerate or uses a collapsed
+// vertex, and the flat grid reaches its target without error.
+int test_simplification();
+
+// Builds meshlets for the simplification meshes and validates them, makes sure the validator rejects broken meshlets,
+// checks the cone and frustum tests on a flat grid, round trips meshlets through a mesh cache entry and makes sure
+// entries with out of range or overflowing offsets, counts, indices and meshlet ranges are rejected.
+int test_meshlets();
+
+// Random aligned allocations, frees and grows on a range allocator, checked after every step against the live set:
+// alignment, no overlaps, best fit, merged and consistent free lists, and the fragmentation it reports. Logs the
+// fragmentation seen over the run.
+int test_range_allocator();
+
+// Drives a staging ring with a fake in order fence source: alignment, wraparound with the skipped tail released
+// together with the allocation that wrapped, waiting on the oldest batch only, refusing when only the open batch holds
+// the space, and random allocations checked against the batches still running.
+int test_staging_ring();
+
+// Streams synthetic feedback through a small virtual texture with synchronous loads: pinned levels load first and are
+// never evicted, misses load parents first, LRU order and eviction skip tiles touched this frame, absent pages fall
+// back to the nearest resident ancestor, tiles carry their borders and replaying a stream gives the same uploads.
+int test_virtual_texture();
+
+// Builds random transforms, degenerate Euler angles and mirroring scales with the scalar kernel, the AVX2 kernel and the
+// chunked update, and checks each against the glm matrices update_model_transform builds. Also checks that rebuilding a
+// range that is not lane aligned leaves the matrices around it alone.
+int test_transform_store();
+
+// A random multi level hierarchy against glm matrices multiplied up the parent chain: after a full update, after moving
+// an inner node (exactly its subtree is rebuilt and flagged) and as scene models after reparenting a subtree. Also
+// checks that hierarchy_sort cuts every cycle at one node, the same one each run, and sorts trees depth first.
+int test_transform_hierarchy();
+
+// Starts a job system with three workers: counters complete and can be reused, continuations wait for their dependency,
+// workers steal from a busy thread 0, thread 0 never runs jobs queued by another thread, job_wait nests inside jobs and
+// exceptions reach job_wait or parallel_for, or are counted when no counter waits for them.
+int test_job_system();
+
+// BC7 mode 6 and BC5 blocks whose colours are exact endpoints come back exactly, and a small smooth image with an
+// uneven size encodes deterministically above a PSNR floor in both formats, partial edge blocks included.
+int test_texture_compression();
+
+// Mip chains on known inputs: a black and white 2x2 averages to half the light in sRGB, alpha and linear formats to
+// half the byte, tilted normals renormalize to unit length in every level, and odd sizes halve rounding down with box
+// weights that split the middle texel and flat images that stay flat up to the edges.
+int test_mip_generator();
+
+// Parses OBJ files written for the test: v, v/vt, v//vn and v/vt/vn corners with -1 for what is missing, quads and
+// polygons as fans around the first corner, negative indices, also across parse chunks, and malformed or unknown lines.
+int test_obj_parser();
+
+// Welds two quads sharing an edge: repeated triples and equal values, negative zero included, become one vertex, a
+// UV seam or a hard edge keeps its corners apart and the index buffer numbers vertices by first use. A random mesh with
+// many duplicates, enough to grow both tables, has to weld exactly like a value keyed map.
+int test_vertex_welder();
+
+// Runs every test and returns the number of failed checks
+int run_tests();
+
+#endif
@@ -3,21 +3,68 @@
 
 #include <vulkan/vulkan.h>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "Image.h"
 #include "Model.h"
 #include "Buffer.h"
+#include "UploadContext.h"
+#include "Ktx2.h"
 
-// !! TEMPORARY !! MUST NOT BE EXPOSED (using it until normal implimentation is moved here)
-void generateMipmaps(VkDevice* device, VkPhysicalDevice* physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue, VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+// Formats models sample their maps in. Normal maps hold vectors, not colours, so they are read without the sRGB curve.
+#define TEXTURE_FORMAT_COLOR VK_FORMAT_R8G8B8A8_SRGB
+#define TEXTURE_FORMAT_NORMAL VK_FORMAT_R8G8B8A8_UNORM
 
+// Decoded RGBA8 pixels waiting to be staged
+struct it_ImageData
+{
+	unsigned char* pixels = nullptr;
+	int width = 0;
+	int height = 0;
+};
 
-void create_texture_image(VkDevice* device, VkPhysicalDevice* physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue, Model* cModel);
-void create_imageview(VkDevice* device, Model* cModel);
-void create_texture_sampler(VkDevice* device, VkPhysicalDevice* physicalDevice, Model* cModel);
+struct it_MipLevel
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	size_t offset = 0;  // into it_MipChain::pixels
+};
 
-void create_normal_image(VkDevice* device, VkPhysicalDevice* physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue, Model* cModel);
-void create_normalview(VkDevice* device, Model* cModel);
-void create_normal_sampler(VkDevice* device, VkPhysicalDevice* physicalDevice, Model* cModel);
+// RGBA8 levels back to back, level 0 first, laid out as they are staged so the upload is a single copy. Built by
+// generate_mip_chain (MipGenerator.h).
+struct it_MipChain
+{
+	std::vector<it_MipLevel> levels;
+	std::vector<uint8_t> pixels;
+};
+
+// The textures init_model_resources uploads for a model, decoded with their mips ahead of time by the scene loader.
+// An empty chain was skipped because the texture cache already has it or has it on disk.
+struct it_ModelImages
+{
+	it_MipChain texture;
+	it_MipChain normal;
+};
+
+// Decodes any format stb_image reads into RGBA8, throws if the file cannot be read. The file is mapped rather than
+// read, stb decodes from the mapping. Thread safe.
+void decode_image(const std::string& path, it_ImageData* image);
+void free_image(it_ImageData* image);
+size_t image_bytes(const it_ImageData* image);
+
+// Bytes the chains of images hold
+size_t model_images_bytes(const it_ModelImages* images);
+void free_model_images(it_ModelImages* images);
+
+uint32_t texture_mip_levels(int width, int height);
+
+// Records the upload of every level of chain into the upload context. The image is ready once the
+// context is flushed. The pixels are copied into staging memory, the caller still owns chain. Models get their textures
+// from the texture cache, which calls this on a miss.
+void create_texture_image(VkDevice* device, it_UploadContext* uploadContext, const it_MipChain* chain, VkFormat format, VkImage* textureImage, it_Allocation* textureImageMemory);
+// Uploads the levels of a cooked texture or cached mip chain as they are. The file must stay mapped until this returns.
+void create_cooked_texture_image(VkDevice* device, it_UploadContext* uploadContext, const it_Ktx2File* ktx, VkImage* textureImage, it_Allocation* textureImageMemory);
+void create_texture_sampler(VkDevice* device, VkPhysicalDevice* physicalDevice, VkSampler* sampler);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef __TEXTURE_CACHE_H__
+#define __TEXTURE_CACHE_H__
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <cstdint>
+
+#include "DeviceAllocator.h"
+#include "UploadContext.h"
+#include "Texture.h"
+
+struct it_UploadContext;
+struct it_BindlessSet;
+
+// One resident image, shared by every model that samples the same file in the same format (TEXTURE_FORMAT_COLOR or
+// TEXTURE_FORMAT_NORMAL, a file used as both is resident twice). Owned by the cache, models only hold references.
+struct it_Texture
+{
+	std::string path;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkImage image = VK_NULL_HANDLE;
+	it_Allocation memory;
+	VkImageView view = VK_NULL_HANDLE;
+	VkSampler sampler = VK_NULL_HANDLE;  // the cache's, shared by all textures
+	uint32_t index = UINT32_MAX;         // element of the bindless texture array
+	uint32_t mipLevels = 0;
+	VkDeviceSize bytes = 0;              // every mip level
+
+	// guarded by the cache
+	uint32_t refCount = 0;
+	it_UploadContext* uploadContext = nullptr;  // recorded the upload, null once it finished on the GPU
+	bool recorded = false;
+	bool released = false;  // last reference dropped before the upload finished, destroyed when it does
+};
+
+struct it_TextureCacheStats
+{
+	uint32_t textures = 0;
+	uint32_t references = 0;
+	uint64_t residentBytes = 0;  // images actually allocated
+	uint64_t unsharedBytes = 0;  // what a copy per reference, the old per model images, would take
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+};
+
+// The cache is process wide like the device allocator. Creates the shared sampler. Every texture is added to bindless
+// when it is created and removed when it is destroyed.
+void init_texture_cache(VkDevice device, VkPhysicalDevice physicalDevice, it_BindlessSet* bindless);
+// Every texture should have been released by now, leftovers are reported and destroyed
+void destroy_texture_cache();
+
+// Returns path in format with one more reference. On a miss the cooked KTX2 or cached mip chain of path is uploaded if
+// it is current (see TextureCook.h), else chain (made here with texture_cache_decode when null or empty). Usable once
+// that context's current batch has finished. Batches on one queue finish in submission order, so a model recorded
+// into the same context later can use it right away. A texture still being uploaded by another context is waited for,
+// that context's thread must keep submitting. Thread safe.
+it_Texture* texture_cache_acquire(it_UploadContext* uploadContext, const std::string& path, VkFormat format, const it_MipChain* chain);
+
+// Drops a reference, the last one destroys the texture. Only once no frame in flight samples it. Null is ignored.
+void texture_cache_release(it_Texture* texture);
+
+// The decode stage of a texture: maps and decodes path, builds the mips with MIP_FILTER_DEFAULT and caches them on
+// disk for the next run. Touches no Vulkan object and takes no lock, the scene loader runs it on job threads.
+void texture_cache_decode(const std::string& path, VkFormat format, it_MipChain* chain);
+
+// False when path is resident (or being uploaded) in format or has a current cooked file the device can use or cached
+// mips, so the decode can be skipped. The texture can still be evicted before the acquire, which then decodes it after all.
+bool texture_cache_needs_pixels(const std::string& path, VkFormat format);
+
+it_TextureCacheStats texture_cache_stats();
+
+#endif
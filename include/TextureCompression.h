@@ -0,0 +1,53 @@
+#ifndef __TEXTURE_COMPRESSION_H__
+#define __TEXTURE_COMPRESSION_H__
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "Texture.h"
+#include "MipGenerator.h"
+
+// Both formats store a 4x4 texel block in 16 bytes, a quarter of RGBA8
+#define BC_BLOCK_BYTES 16
+
+// Encoder effort: least squares refinements of the endpoints after the principal axis fit
+#define BC7_REFINE_PASSES 2
+
+// CPU block encoders for the offline texture cooker. Blocks are 4x4 RGBA8 texels, row major (64 bytes).
+
+// BC7 mode 6 only: one subset, RGBA endpoints with 7 bits and a p-bit per channel, 4 bit indices. The mode suits
+// smooth albedo and is quick to search. sRGB textures are encoded as stored, BC7_SRGB decodes them the same way.
+void encode_bc7_block(const uint8_t* texels, uint8_t* block);
+// Mode 6 blocks, what encode_bc7_block writes. Returns false for any other mode.
+bool decode_bc7_block(const uint8_t* block, uint8_t* texels);
+
+// Red and green as two BC4 blocks, for tangent space normal maps: the shader rebuilds z. Blue and alpha are dropped.
+void encode_bc5_block(const uint8_t* texels, uint8_t* block);
+// Blue decodes as 0 and alpha as 255
+void decode_bc5_block(const uint8_t* block, uint8_t* texels);
+
+struct it_CompressedLevel
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> blocks;  // ceil(width / 4) * ceil(height / 4) blocks, row major
+};
+
+// BC block format image encodes to, VK_FORMAT_UNDEFINED when it has none: BC7 for TEXTURE_FORMAT_COLOR, BC5 for
+// TEXTURE_FORMAT_NORMAL
+VkFormat compressed_texture_format(VkFormat format);
+
+// Encodes every level of chain into blockFormat (BC7 or BC5). Blocks along the right and bottom edge repeat the last
+// texel. Block rows are spread over parallel_for.
+void compress_mip_chain(const it_MipChain* chain, VkFormat blockFormat, std::vector<it_CompressedLevel>* levels);
+
+// Decodes a level back to RGBA8, for measuring the encoder
+void decompress_level(const it_CompressedLevel* level, VkFormat blockFormat, it_ImageData* image);
+
+// Peak signal to noise ratio of level against image, in dB, over the channels blockFormat keeps (RGBA for BC7, RG for
+// BC5). 99 for an exact match.
+double compressed_psnr(const it_ImageData* image, const it_CompressedLevel* level, VkFormat blockFormat);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef __TEXTURE_COOK_H__
+#define __TEXTURE_COOK_H__
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <cstdint>
+
+#include "Ktx2.h"
+#include "MipGenerator.h"
+
+// Cooked textures: KTX2 files with BC7 (colour) or BC5 (normal map) blocks and the whole mip chain, built offline with
+// --cook so loading only copies them to the GPU. One per source image and format, next to the mesh cache. Textures
+// loaded without one leave their RGBA8 mip chain in the same directory for the next run.
+#define TEXTURE_COOK_DIR "res/cache/textures/"
+#define TEXTURE_COOK_VERSION 2
+// KTX2 key holding the it_TextureCookSource a file was built from
+#define TEXTURE_COOK_KEY "engine.source"
+// Colour textures with a side at least this long also get a virtual texture file (VirtualTexture.h, tagged with the
+// it_TextureCookSource), the renderer streams their tiles instead of keeping the whole chain resident
+#define TEXTURE_COOK_VIRTUAL_SIZE 4096
+
+// A cooked file is valid for its source while the version, mip filter, size and mtime match; if only the mtime changed
+// the content hash decides, like the mesh cache.
+struct it_TextureCookSource
+{
+	uint32_t version;
+	uint32_t format;     // the format the texture is requested in
+	uint32_t mipFilter;  // it_MipFilter the levels were made with
+	uint32_t reserved;
+	int64_t sourceMTime;
+	uint64_t sourceSize;
+	uint64_t sourceHash;
+};
+
+struct it_TextureCookStats
+{
+	uint32_t levels = 0;
+	uint64_t sourceBytes = 0;   // the PNG/JPG file
+	uint64_t rgbaBytes = 0;     // what the uncooked path uploads, RGBA8 with mips
+	uint64_t cookedBytes = 0;   // the KTX2 file
+	double psnr = 0.0;          // of level 0 against the decoded source
+	double seconds = 0.0;
+	bool upToDate = false;      // the KTX2 was current and not written
+	uint64_t virtualBytes = 0;  // the virtual texture file if one was written
+};
+
+std::string cooked_texture_path(const std::string& sourcePath, VkFormat format);
+std::string virtual_texture_path(const std::string& sourcePath);
+
+// Whether the virtual texture file of sourcePath was cooked from its current contents
+bool virtual_texture_current(const std::string& sourcePath);
+
+// Maps the cooked file of sourcePath in format if it is current. format is TEXTURE_FORMAT_COLOR or
+// TEXTURE_FORMAT_NORMAL.
+bool open_cooked_texture(const std::string& sourcePath, VkFormat format, it_Ktx2File* ktx);
+
+// Decodes sourcePath, builds the mip chain with MIP_FILTER_DEFAULT, encodes every level and writes the KTX2, and the
+// virtual texture for colour textures of TEXTURE_COOK_VIRTUAL_SIZE. Skipped unless force when the cooked files are
+// current. Throws when the source cannot be read or a file cannot be written.
+void cook_texture(const std::string& sourcePath, VkFormat format, bool force, it_TextureCookStats* stats);
+
+// The RGBA8 mip chain of sourcePath in format that cache_mips left, if it is current. Lets a texture without a cooked
+// file, or a device without BC, skip the decode and the filtering.
+bool open_cached_mips(const std::string& sourcePath, VkFormat format, it_Ktx2File* ktx);
+// Writes chain, made from sourcePath with MIP_FILTER_DEFAULT, for open_cached_mips. False if the source or the file
+// cannot be accessed, the texture just is not cached then.
+bool cache_mips(const std::string& sourcePath, VkFormat format, const it_MipChain* chain);
+
+// Cooks the albedo and normal maps of every model of res/data/user/<scenePath> and logs size and PSNR per texture,
+// then the totals. Blocks are encoded on the job system if it is up.
+void cook_scene_textures(const std::string& scenePath, bool force);
+
+#endif
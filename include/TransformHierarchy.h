@@ -0,0 +1,44 @@
+#ifndef __TRANSFORM_HIERARCHY_H__
+#define __TRANSFORM_HIERARCHY_H__
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "TransformStore.h"
+
+// Parent/child transforms in flat arrays. Nodes are kept in topological order, every parent before its children, so a
+// single forward pass propagates world matrices. Only nodes whose local TRS was set since the last update, and
+// everything below them, are rebuilt; local matrices come from the transform store's batch kernels.
+#define HIERARCHY_ROOT UINT32_MAX
+
+struct it_TransformHierarchy
+{
+	it_TransformStore local;       // local TRS, local.world holds the local matrices
+	std::vector<uint32_t> parent;  // HIERARCHY_ROOT or an earlier node
+	std::vector<glm::mat4> world;
+	std::vector<uint8_t> dirty;    // local TRS set since the last update
+	std::vector<uint8_t> changed;  // world matrix rebuilt by the last update
+	size_t firstDirty = SIZE_MAX;  // nodes before it cannot change, SIZE_MAX when none is dirty
+};
+
+void hierarchy_reserve(it_TransformHierarchy* hierarchy, size_t capacity);
+void hierarchy_clear(it_TransformHierarchy* hierarchy);
+
+// Appends a node below parent, which must already be in the hierarchy, or HIERARCHY_ROOT. Returns its index.
+uint32_t hierarchy_add(it_TransformHierarchy* hierarchy, uint32_t parent, const glm::vec3& position, const glm::vec3& euler, const glm::vec3& scale);
+// TRS relative to the parent, Euler angles as in Model::rotationVec
+void hierarchy_set_local(it_TransformHierarchy* hierarchy, uint32_t node, const glm::vec3& position, const glm::vec3& euler, const glm::vec3& scale);
+
+// Rebuilds the local matrices of dirty nodes, then the world matrices of their subtrees. Returns how many world
+// matrices were rebuilt, changed flags the nodes.
+size_t hierarchy_update(it_TransformHierarchy* hierarchy);
+
+// Orders nodes given by their parent index (HIERARCHY_ROOT for roots) depth first, so every parent comes before its
+// children and siblings keep their order. order receives the input indices in sorted order. A node on a cycle is
+// turned into a root in parents to break it, returns false if that happened.
+bool hierarchy_sort(std::vector<uint32_t>* parents, std::vector<uint32_t>* order);
+
+#endif
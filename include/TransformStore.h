@@ -0,0 +1,47 @@
+#ifndef __TRANSFORM_STORE_H__
+#define __TRANSFORM_STORE_H__
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+// Structure of arrays store of translation, rotation and scale, and the world matrices built from them. Rotations are
+// kept as unit quaternions so the batch kernel needs no trigonometry: the sines and cosines of Euler angles are taken
+// once, when a transform is set. World matrices are built eight at a time with AVX2 when the CPU has it, one at a time
+// otherwise, and batches bigger than a chunk are spread over parallel_for.
+#define TRANSFORM_BATCH 8      // lanes of the AVX2 kernel
+#define TRANSFORM_CHUNK 2048   // transforms per parallel_for item, a multiple of TRANSFORM_BATCH
+
+struct it_TransformStore
+{
+	std::vector<float> px, py, pz;
+	std::vector<float> qx, qy, qz, qw;
+	std::vector<float> sx, sy, sz;
+	std::vector<glm::mat4> world;  // translate * rotate * scale, column major like Model::transform
+	size_t count = 0;
+};
+
+void transform_store_reserve(it_TransformStore* store, size_t capacity);
+// Keeps the capacity, for stores refilled every frame
+void transform_store_clear(it_TransformStore* store);
+
+// Euler angles as in Model::rotationVec: radians, applied around x, then y, then z
+glm::vec4 euler_to_quaternion(const glm::vec3& euler);
+
+// Appends a transform and returns its index. The world matrix is only valid after the next update.
+uint32_t transform_push(it_TransformStore* store, const glm::vec3& position, const glm::vec3& euler, const glm::vec3& scale);
+void transform_set(it_TransformStore* store, uint32_t index, const glm::vec3& position, const glm::vec3& euler, const glm::vec3& scale);
+
+// Builds the world matrices of [first, first + count) on the calling thread
+void transform_update_range(it_TransformStore* store, size_t first, size_t count);
+// Builds every world matrix, in TRANSFORM_CHUNK sized pieces over parallel_for when there is more than one
+void transform_update_world(it_TransformStore* store);
+
+// Whether transform_update_range runs the AVX2 kernel on this CPU
+bool transform_simd_supported();
+// Turns the AVX2 kernel off, so the benchmark can time the scalar one. On by default where supported.
+void transform_use_simd(bool enabled);
+
+#endif
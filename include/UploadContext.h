@@ -0,0 +1,89 @@
+#ifndef __UPLOAD_CONTEXT_H__
+#define __UPLOAD_CONTEXT_H__
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+
+#include "DeviceAllocator.h"
+#include "StagingRing.h"
+
+// Persistently mapped staging ring per context. Bigger uploads get a temporary buffer that lives until their batch
+// completes.
+#define UPLOAD_STAGING_SIZE (16ull << 20)
+// bufferOffset of a buffer to image copy must be a multiple of the texel size and of 4
+#define UPLOAD_STAGING_ALIGNMENT 16
+// Batches a context can have on the GPU before recording has to wait for the oldest
+#define UPLOAD_MAX_BATCHES 4
+
+struct it_UploadStats
+{
+	uint32_t uploads = 0;      // staged ranges
+	uint32_t submits = 0;
+	uint32_t overflows = 0;    // uploads too large for the ring
+	uint64_t bytes = 0;
+	double stallSeconds = 0.0; // waiting for the queue lock and for batches to finish
+};
+
+struct it_UploadBatch
+{
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	VkFence fence = VK_NULL_HANDLE;
+	uint64_t ticket = 0;  // 0 while the slot is free
+	std::vector<VkBuffer> overflowBuffers;
+	std::vector<it_Allocation> overflowMemory;
+	std::vector<std::function<void()>> completions;
+};
+
+// Records every transfer of a batch of models into one command buffer and submits it once, instead of one
+// submit and vkQueueWaitIdle per copy. Batch n uses slot n % UPLOAD_MAX_BATCHES, and its staging space returns to
+// the ring when its fence signals. Not thread safe: every loader thread owns a context. Contexts can share a queue,
+// queueMutex is only held around vkQueueSubmit.
+struct it_UploadContext
+{
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkQueue queue = VK_NULL_HANDLE;
+	std::mutex* queueMutex = nullptr;
+
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	it_UploadBatch batches[UPLOAD_MAX_BATCHES];
+	uint64_t nextTicket = 1;       // ticket of the batch being recorded
+	uint64_t completedTicket = 0;  // every batch up to this one has been retired
+	bool recording = false;
+
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	it_Allocation stagingMemory;
+	it_StagingRing ring;
+
+	it_UploadStats stats;
+};
+
+// queueFamily must support graphics, uploaded images are transitioned for the fragment shader
+void create_upload_context(VkDevice* device, VkPhysicalDevice* physicalDevice, uint32_t queueFamily, VkQueue queue, std::mutex* queueMutex, it_UploadContext* context);
+
+// Flushes whatever is still recorded
+void destroy_upload_context(it_UploadContext* context);
+
+// The command buffer of the current batch, begun on first use
+VkCommandBuffer upload_context_commands(it_UploadContext* context);
+
+// Host pointer to size bytes of staging memory for the current batch. May submit the batch or wait for an older one
+// when the ring is full, so call it before recording the copy that reads from it.
+void* upload_context_stage(it_UploadContext* context, VkDeviceSize size, VkBuffer* buffer, VkDeviceSize* offset);
+
+// Runs once the current batch has finished on the GPU
+void upload_context_on_complete(it_UploadContext* context, std::function<void()> completion);
+
+// Submits the current batch without waiting for it
+void upload_context_submit(it_UploadContext* context);
+
+// Retires the batches that have finished, running their completions, without waiting for the others
+void upload_context_poll(it_UploadContext* context);
+
+// Submits the batch and waits for every batch in flight. Everything uploaded through the context is usable afterwards.
+void upload_context_flush(it_UploadContext* context);
+
+#endif
@@ -8,6 +8,8 @@
 */
 #include "glmIncludes.h"
 #include <array>
+#include <cstdint>
+#include <cstddef>
 
 struct Vertex {
     glm::vec3 pos;
@@ -68,6 +70,51 @@ struct Vertex {
     }
 };
 
+// 20 byte vertex used with ENGINE_PACKED_VERTICES. position is snorm16 inside the mesh bounds with the tangent
+// handedness in w, normalTangent holds the octahedral snorm16 normal (xy) and tangent (zw), texCoord is unorm16
+// inside the mesh UV range. The dequantization is applied through Model::dequantize and Model::uvScaleBias.
+struct PackedVertex {
+    int16_t position[4];
+    uint16_t texCoord[2];
+    int16_t normalTangent[4];
+
+    static VkVertexInputBindingDescription getBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription = {};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(PackedVertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDescription;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = {};
+
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_SNORM;
+        attributeDescriptions[0].offset = offsetof(PackedVertex, position);
+
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 2;
+        attributeDescriptions[1].format = VK_FORMAT_R16G16_UNORM;
+        attributeDescriptions[1].offset = offsetof(PackedVertex, texCoord);
+
+        attributeDescriptions[2].binding = 0;
+        attributeDescriptions[2].location = 3;
+        attributeDescriptions[2].format = VK_FORMAT_R16G16B16A16_SNORM;
+        attributeDescriptions[2].offset = offsetof(PackedVertex, normalTangent);
+
+        return attributeDescriptions;
+    }
+};
+
+// Layout that ends up in the vertex buffers and pipelines
+#ifdef ENGINE_PACKED_VERTICES
+typedef PackedVertex GpuVertex;
+#else
+typedef Vertex GpuVertex;
+#endif
+
 struct Material
 {
     alignas(16) glm::vec3 ambient;
@@ -75,8 +122,18 @@ struct Material
     alignas(16) glm::vec3 specular;
     alignas(16) glm::vec3 shininess;
     alignas(16) glm::vec3 overrideColor;
+
+    // memberwise, the padding after each vec3 is never initialized
+    bool operator==(const Material& other) const {
+        return ambient == other.ambient && diffuse == other.diffuse && specular == other.specular && shininess == other.shininess
+            && overrideColor == other.overrideColor;
+    }
 };
 
+// std430 element of the material buffer: every vec3 starts on 16 bytes, the stride rounds up to 16
+static_assert(offsetof(Material, diffuse) == 16 && offsetof(Material, specular) == 32 && offsetof(Material, shininess) == 48, "material layout");
+static_assert(offsetof(Material, overrideColor) == 64 && sizeof(Material) == 80, "material stride of the std430 array");
+
 
 namespace std {
     template<> struct hash<Vertex> {
@@ -0,0 +1,41 @@
+#ifndef __VERTEX_PACKING_H__
+#define __VERTEX_PACKING_H__
+
+#include <vector>
+
+#include "Vertex.h"
+
+// Per mesh dequantization: pos = center + extent * snorm, uv = uvMin + uvRange * unorm.
+// A single extent for all axes keeps the decode matrix a uniform scale, so normals can go through the same transform.
+struct it_PackingParams
+{
+	glm::vec3 center = glm::vec3(0.0f);
+	float extent = 1.0f;
+	glm::vec2 uvMin = glm::vec2(0.0f);
+	glm::vec2 uvRange = glm::vec2(1.0f);
+};
+
+// Largest round trip error over a mesh, positions in mesh units, directions in degrees
+struct it_PackingError
+{
+	float position = 0.0f;
+	float texCoord = 0.0f;
+	float normalDegrees = 0.0f;
+	float tangentDegrees = 0.0f;
+	size_t handednessFlips = 0;
+};
+
+glm::vec2 oct_encode(glm::vec3 n);
+
+glm::vec3 oct_decode(glm::vec2 e);
+
+it_PackingParams compute_packing_params(const std::vector<Vertex>& vertices);
+
+PackedVertex pack_vertex(const Vertex& vertex, const it_PackingParams& params);
+
+Vertex unpack_vertex(const PackedVertex& packed, const it_PackingParams& params);
+
+// Decodes every packed vertex and compares it with its source, used by the packing test
+it_PackingError measure_packing_error(const std::vector<Vertex>& vertices, const std::vector<PackedVertex>& packed, const it_PackingParams& params);
+
+#endif
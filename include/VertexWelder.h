@@ -0,0 +1,36 @@
+#ifndef __VERTEX_WELDER_H__
+#define __VERTEX_WELDER_H__
+
+#include <vector>
+#include <cstdint>
+
+#include "Vertex.h"
+#include "ObjParser.h"
+
+// Open addressing table from an OBJ (v, vt, vn) index triple to the welded vertex it produced
+struct it_CornerTable
+{
+	struct Slot
+	{
+		int v;
+		int vt;
+		int vn;
+		uint32_t vertex;
+	};
+	std::vector<Slot> slots;
+	size_t count = 0;
+};
+
+// Open addressing table of welded vertex indices, hashed and compared by vertex value
+struct it_VertexTable
+{
+	std::vector<uint32_t> slots;
+	size_t count = 0;
+};
+
+// Builds the deduplicated vertex and index buffers for an OBJ corner stream. Repeated triples are found through the
+// corner table; a new triple is also looked up by value, so duplicate v/vt/vn lines weld exactly like a value keyed
+// map would and the index buffer does not depend on how the file was written.
+void weld_obj_vertices(const it_ObjMesh& mesh, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices);
+
+#endif
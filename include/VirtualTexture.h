@@ -0,0 +1,175 @@
+#ifndef __VIRTUAL_TEXTURE_H__
+#define __VIRTUAL_TEXTURE_H__
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+#include "Texture.h"
+#include "MappedFile.h"
+#include "JobSystem.h"
+
+// Virtual texturing: a texture too big to keep resident is cut into pages, and only the pages the frame samples live
+// in a fixed atlas of tiles, the physical cache. A feedback buffer holds the page each sample wanted, the CPU turns
+// that into tile loads and evictions and keeps a page table pointing every page at its tile, or at the tile of the
+// nearest coarser page that is resident. This is the CPU side and touches no Vulkan object, VirtualTextureSet.h puts
+// it on the GPU. test_virtual_texture and benchmark_virtual_texture drive it with synthetic feedback.
+#define VT_PAGE_SIZE 128    // texels per page side
+#define VT_PAGE_BORDER 4    // texels of the neighbouring pages around each tile, enough for anisotropic filtering
+#define VT_TILE_SIZE (VT_PAGE_SIZE + 2 * VT_PAGE_BORDER)
+#define VT_TILE_BYTES (VT_TILE_SIZE * VT_TILE_SIZE * 4)
+
+#define VT_FILE_MAGIC 0x58545656 // "VVTX"
+#define VT_FILE_VERSION 1
+#define VT_FILE_ALIGNMENT 4096   // tiles start on page boundaries of the mapping
+
+// Loads started and not yet uploaded. Misses beyond it wait for the next feedback.
+#define VT_MAX_PENDING_LOADS 64
+
+#define VT_INVALID UINT32_MAX
+// Feedback entry for a sample that did not touch the virtual texture
+#define VT_FEEDBACK_NONE UINT32_MAX
+
+// On-disk layout: header, then VT_TILE_BYTES of RGBA8 per page at tileOffset, level 0 first, each level row major.
+struct it_VtFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t format;      // VkFormat of the texels, RGBA8 sRGB or UNORM
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	uint32_t pageCount;   // over all levels
+	uint32_t tagSize;     // bytes of the writer's tag right after the header, 0 in files without one
+	uint64_t tileOffset;
+};
+
+struct it_VtLevel
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t pagesX = 0;
+	uint32_t pagesY = 0;
+	uint32_t firstPage = 0;  // index of page (0, 0), pages of a level are row major
+};
+
+#define VT_PAGE_ABSENT 0
+#define VT_PAGE_LOADING 1
+#define VT_PAGE_RESIDENT 2
+
+// One tile of the physical cache. Unpinned occupied tiles form an LRU list, most recently used first.
+struct it_VtSlot
+{
+	uint32_t page = VT_INVALID;
+	uint64_t lastUsed = 0;  // frame of the last feedback that touched the page
+	uint32_t prev = VT_INVALID;
+	uint32_t next = VT_INVALID;
+	bool pinned = false;    // a page of a level that fits one page, the fallback of last resort is never evicted
+};
+
+struct it_VtLoad
+{
+	uint32_t page = VT_INVALID;
+	uint64_t sequence = 0;      // order the loads were requested in, uploads follow it
+	std::vector<uint8_t> texels;
+};
+
+// A tile to copy into the cache image at vt_slot_origin(slot)
+struct it_VtUpload
+{
+	uint32_t slot = VT_INVALID;
+	uint32_t page = VT_INVALID;
+	std::vector<uint8_t> texels;  // VT_TILE_SIZE squared RGBA8
+};
+
+struct it_VtStats
+{
+	uint64_t feedbackEntries = 0;
+	uint64_t pagesTouched = 0;  // distinct pages per frame, summed
+	uint64_t hits = 0;          // touched pages that were resident
+	uint64_t misses = 0;
+	uint64_t loads = 0;         // tiles uploaded
+	uint64_t evictions = 0;
+	uint64_t dropped = 0;       // misses not requested because VT_MAX_PENDING_LOADS were pending
+};
+
+struct it_VirtualTexture
+{
+	it_MappedFile file;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint64_t tileOffset = 0;
+	std::vector<it_VtLevel> levels;
+
+	// per page
+	std::vector<uint8_t> pageState;
+	std::vector<uint32_t> pageSlot;
+	std::vector<uint64_t> pageFrame;  // last frame the page was touched or requested, dedups feedback
+	std::vector<uint32_t> pageHits;   // samples of it in that frame
+	std::vector<uint32_t> pageTable;  // per page, see vt_page_entry, in page order so level L starts at firstPage
+
+	// physical cache
+	uint32_t cacheColumns = 0;
+	std::vector<it_VtSlot> slots;
+	std::vector<uint32_t> freeSlots;
+	uint32_t lruHead = VT_INVALID;
+	uint32_t lruTail = VT_INVALID;
+
+	uint64_t frame = 0;
+	uint64_t sequence = 0;
+	bool asyncLoads = false;      // loads run on the job system, else in vt_update
+	bool pageTableDirty = true;
+	std::vector<it_VtLoad> queued;  // synchronous loads waiting for vt_update
+	uint32_t pending = 0;           // loads requested and not uploaded
+
+	it_JobCounter loads;            // asynchronous loads running
+	std::mutex loadMutex;           // guards loaded
+	std::vector<it_VtLoad> loaded;  // finished on a job thread
+
+	it_VtStats stats;
+};
+
+// Cuts every level of chain into bordered tiles and writes them to path, to a temporary file that is renamed. tag is
+// stored with them for read_virtual_texture_tag, at most VT_FILE_ALIGNMENT minus the header. False on any I/O error.
+bool write_virtual_texture(const std::string& path, const it_MipChain* chain, VkFormat format, const void* tag = nullptr, uint32_t tagSize = 0);
+// The tag path was written with, without mapping the tiles. False if it is not a virtual texture.
+bool read_virtual_texture_tag(const std::string& path, std::string* tag);
+
+// Maps path and sets up a cache of slotCount tiles. The pages of the levels that fit one page are pinned and requested
+// right away, so there is always a fallback once the first vt_update ran. Tiles load on the job system when it is
+// running, else synchronously in vt_update, which makes a run deterministic. Throws if the file is invalid or the
+// pinned pages do not fit.
+void open_virtual_texture(const std::string& path, uint32_t slotCount, it_VirtualTexture* vt);
+// Waits for loads still running
+void close_virtual_texture(it_VirtualTexture* vt);
+
+// Page index of (level, x, y) packed as the feedback stores it: level in the top 4 bits, then 14 bits each of y and x
+inline uint32_t vt_pack_page(uint32_t level, uint32_t x, uint32_t y)
+{
+	return level << 28 | y << 14 | x;
+}
+
+// What a fragment shader writes for a sample at (u, v) in [0, 1) with mip level lod, computed the same way
+uint32_t vt_feedback_entry(const it_VirtualTexture* vt, float u, float v, float lod);
+
+// Feeds one frame's feedback (packed pages or VT_FEEDBACK_NONE). Touches resident pages in the LRU and requests
+// missing ones along with their missing ancestors, coarsest level first, then by how many samples wanted them.
+void vt_feedback(it_VirtualTexture* vt, const uint32_t* entries, size_t count, uint64_t frame);
+
+// Places up to maxUploads finished loads in the cache, evicting the least recently used tiles not touched this frame,
+// and returns their texels for upload in request order. Rebuilds the page table if residency changed.
+void vt_update(it_VirtualTexture* vt, uint32_t maxUploads, std::vector<it_VtUpload>* uploads);
+
+// Texel position of a slot in the cache image, which is cacheColumns tiles wide
+void vt_slot_origin(const it_VirtualTexture* vt, uint32_t slot, uint32_t* x, uint32_t* y);
+
+// Page table entry: the tile's column in the red byte, row in green, the level it holds in blue
+inline uint32_t vt_page_entry(uint32_t column, uint32_t row, uint32_t level)
+{
+	return column | row << 8 | level << 16 | 0xFFu << 24;
+}
+
+#endif
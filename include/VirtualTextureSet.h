@@ -0,0 +1,73 @@
+#ifndef __VIRTUAL_TEXTURE_SET_H__
+#define __VIRTUAL_TEXTURE_SET_H__
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <cstdint>
+
+#include "VirtualTexture.h"
+
+struct it_BindlessSet;
+
+// The virtual textures the renderer samples, VirtualTexture.h is the CPU side of each. A model whose colour texture
+// has a current cooked virtual texture (TextureCook.h) samples it through a cache image and the page table instead of
+// a resident mip chain. The fragment shaders write the page they wanted for one pixel of every VT_FEEDBACK_STEP square
+// into the frame's feedback buffer. Once the frame's fence signalled that feedback requests the tiles, which load on
+// the job system, finished tiles are copied into the cache images at the start of a later frame and that frame's page
+// tables point at them. Process wide like the texture cache; shaderSrc/virtual_texture.glsl is the GPU side.
+#define VT_MAX_TEXTURES 16        // at once, must match the shader
+#define VT_MAX_LEVELS 16          // 32768 texels per side, the feedback keeps the level in 4 bits. Must match the shader.
+#define VT_CACHE_TILES 256        // per virtual texture, a 16 x 16 tile cache image of 2176 texels square
+#define VT_PAGE_TABLE_CAPACITY (1 << 18)  // entries over all virtual textures, a 16k texture takes 21846
+#define VT_MAX_UPLOADS 16         // tiles copied into the cache images per frame, over all virtual textures
+#define VT_FEEDBACK_STEP 16       // the feedback defines must match the shader
+#define VT_FEEDBACK_WIDTH 256     // cells, 4096 x 4096 pixels at VT_FEEDBACK_STEP. Larger targets share the edge cells.
+#define VT_FEEDBACK_HEIGHT 256
+
+// std430 element of virtualTextures[] in the shader, followed there by the page tables
+struct it_VtShaderInfo
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	uint32_t cacheTexture;     // element of the bindless texture array holding the cache image
+	uint32_t cacheColumns;
+	uint32_t pageTableOffset;  // entry of level 0 page 0 in the page tables, entries are vt_page_entry
+	uint32_t reserved[2];
+	uint32_t levels[VT_MAX_LEVELS][4];  // pagesX, pagesY, firstPage, unused
+};
+
+struct it_VtSetStats
+{
+	uint32_t textures = 0;
+	uint32_t references = 0;
+	uint64_t cacheBytes = 0;  // cache images
+	it_VtStats pages;         // summed over the virtual textures alive
+};
+
+// Creates the page table, feedback and staging buffers and points every bindless set at them. The tiles load on the
+// job system if it is running.
+void init_virtual_textures(VkDevice device, VkPhysicalDevice physicalDevice, it_BindlessSet* bindless);
+// Every virtual texture should have been released by now, leftovers are reported and destroyed
+void destroy_virtual_textures();
+
+// Whether path has a current virtual texture, its mip chain does not have to be decoded then
+bool virtual_texture_available(const std::string& path);
+// The element of the virtual textures sampling path with one more reference. VT_INVALID when path has no current
+// virtual texture or all VT_MAX_TEXTURES or the page table entries are taken, the caller uses the texture cache then.
+// Thread safe.
+uint32_t virtual_texture_acquire(const std::string& path);
+// Drops a reference, the last one destroys it. Only once no frame in flight samples it. VT_INVALID is ignored.
+void virtual_texture_release(uint32_t index);
+
+// Right after frame's fence: feeds the feedback that frame left to the virtual textures, takes the tiles that finished
+// loading for this frame's copies and brings frame's page tables up to date
+void virtual_textures_begin_frame(uint32_t frame, uint64_t frameNumber);
+// Before the first pass: copies the tiles begin_frame took into the cache images through frame's staging region
+void record_virtual_texture_uploads(VkCommandBuffer commandBuffer, uint32_t frame);
+// After the last pass: the feedback writes become visible to the host when the frame's fence signals
+void record_virtual_texture_feedback(VkCommandBuffer commandBuffer);
+
+it_VtSetStats virtual_texture_stats();
+
+#endif
@@ -1,5 +1,9 @@
 #version 460 core
 #extension GL_EXT_ray_tracing : disable
+#extension GL_GOOGLE_include_directive : require
+
+// the virtual texture feedback is written only for fragments that pass the depth test
+layout(early_fragment_tests) in;
 
 
 struct Material 
@@ -13,8 +17,21 @@ struct Material
 
 
 
-layout(binding = 1) uniform sampler2D texSampler;
-layout(binding = 2) uniform sampler2D normalMap;
+// Every texture of the scene, BINDLESS_MAX_TEXTURES. Only the elements in use are written.
+layout(binding = 1) uniform sampler2D textures[4096];
+
+layout(std430, binding = 2) readonly buffer MaterialBuffer {
+    Material materials[];
+};
+
+// it_DrawIndices
+layout(push_constant) uniform DrawIndices {
+    uint textureIndex;
+    uint normalIndex;
+    uint virtualTexture;  // VT_NONE unless the colour texture is virtual
+} draw;
+
+#include "virtual_texture.glsl"
 
 
 
@@ -48,7 +65,7 @@ layout(location = 4) in vec3 aTangent;
 layout(location = 5) in vec3 aBitangent;
 layout(location = 6) in vec3 aCameraPos;
 layout(location = 7) in vec4 fragLightSpacePos;
-layout(location = 8) in Material mMaterial;
+layout(location = 8) flat in uint materialIndex;
 
 
 layout(location = 0) out vec4 outColor;
@@ -62,15 +79,18 @@ float LinearizeDepth(float depth)
 
 
 void main() {
+    Material mMaterial = materials[materialIndex];
     
     
-    // Fetch the normal from the normal map and transform it to [-1, 1] range
+    // Fetch the normal from the normal map and transform it to [-1, 1] range. z is rebuilt from x and y, cooked (BC5)
+    // normal maps only store those two
     vec3 normal = normalize(aNormal);
     vec3 tangent = normalize(aTangent);
     vec3 bitangent = normalize(aBitangent);
 
     mat3 TBN = mat3(tangent, bitangent, normal);
-    vec3 worldNormal = (texture(normalMap, fragTexCoord).xyz );
+    vec2 normalXY = texture(textures[draw.normalIndex], fragTexCoord).xy * 2.0 - 1.0;
+    vec3 worldNormal = vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0)));
     vec3 perturbedNormal = normalize(TBN * worldNormal);
 
 
@@ -102,7 +122,12 @@ void main() {
     
     vec3 projCoords = fragLightSpacePos.xyz / fragLightSpacePos.w;
     
-    outColor =  texture(texSampler, fragTexCoord) * vec4(result, 1.0f);
+    vec4 albedo;
+    if (draw.virtualTexture != VT_NONE)
+        albedo = sample_virtual_texture(draw.virtualTexture, fragTexCoord);
+    else
+        albedo = texture(textures[draw.textureIndex], fragTexCoord);
+    outColor = albedo * vec4(result, 1.0f);
     //outColor = vec4(worldNormal * 0.5 + 0.5, 1.0);
     //outColor = depth * vec4(result , 1.0f);
     //outColor = texture(shadowMap, projCoords.xyz) * vec4(1.0f);
@@ -2,24 +2,25 @@
 #extension GL_EXT_ray_tracing : disable
 
 
-struct Material 
+struct ObjectData
 {
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    vec3 shininess;
-    vec3 overrideColor;
+    mat3x4 transform; // the first three rows of the model matrix, multiplied as a row vector
+    vec4 uvScaleBias;
+    uint material;
 };
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 transform;
+// Every object of the scene, a draw's first instance is its index
+layout(std430, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+};
+
+// Written once per frame
+layout(binding = 5) uniform FrameUniformBufferObject {
     mat4 view;
     mat4 proj;
     mat4 lightSpaceMat;
-    vec3 cameraPos;
-    Material material;
-    float time;
-} ubo;
+    vec4 cameraPos; // w is the time
+} frame;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
@@ -37,35 +38,35 @@ layout(location = 4) out vec3 aTangent;
 layout(location = 5) out vec3 aBitangent;
 layout(location = 6) out vec3 aCameraPos;
 layout(location = 7) out vec4 fragLightSpacePos;
-layout(location = 8) out Material mMaterial;
+layout(location = 8) flat out uint materialIndex;
 
 void main() {
+    ObjectData object = objects[gl_InstanceIndex];
 
     // Calculate the vertex position in world space
-    vec4 worldPosition = ubo.transform * vec4(inPosition, 1.0);
+    vec4 worldPosition = vec4(vec4(inPosition, 1.0) * object.transform, 1.0);
     fragPos = worldPosition.xyz;
 
     // Pass texture coordinates to the fragment shader
     fragTexCoord = inTexCoord;
 
     // Transform the normal, tangent, and bitangent to world space
-    mat3 normalMatrix = transpose(inverse(mat3(ubo.transform)));
-    aNormal = normalize(vec3(ubo.transform * vec4(inNormal, 0.0)));
-    aTangent = normalize(vec3(ubo.transform * vec4(inTangent, 0.0)));
+    aNormal = normalize(vec4(inNormal, 0.0) * object.transform);
+    aTangent = normalize(vec4(inTangent, 0.0) * object.transform);
 
     aTangent = normalize(aTangent - dot(aTangent, aNormal) * aNormal);
 
     aBitangent = cross(aNormal, aTangent);
     
     // Pass lighting information to the fragment shader
-    aCameraPos = ubo.cameraPos;
+    aCameraPos = frame.cameraPos.xyz;
 
-    mMaterial = ubo.material;
+    materialIndex = object.material;
 
-    fragLightSpacePos = ubo.lightSpaceMat * vec4(fragPos, 1.0);    
+    fragLightSpacePos = frame.lightSpaceMat * vec4(fragPos, 1.0);    
 
     // Calculate the final vertex position in clip space
-    gl_Position = ubo.proj * ubo.view * worldPosition;
+    gl_Position = frame.proj * frame.view * worldPosition;
     
     fragColor = inColor;
 }
\ No newline at end of file
@@ -0,0 +1,82 @@
+#version 460 core
+#extension GL_EXT_ray_tracing : disable
+
+
+struct ObjectData
+{
+    mat3x4 transform; // the first three rows of the model matrix, multiplied as a row vector
+    vec4 uvScaleBias;
+    uint material;
+};
+
+// Every object of the scene, a draw's first instance is its index
+layout(std430, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+};
+
+// Written once per frame
+layout(binding = 5) uniform FrameUniformBufferObject {
+    mat4 view;
+    mat4 proj;
+    mat4 lightSpaceMat;
+    vec4 cameraPos; // w is the time
+} frame;
+
+// PackedVertex: snorm16 position (w = tangent handedness), unorm16 uv, octahedral normal (xy) and tangent (zw).
+// The object's transform already contains the per mesh dequantization.
+layout(location = 0) in vec4 inPosition;
+layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in vec4 inNormalTangent;
+
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec3 fragPos;
+layout(location = 3) out vec3 aNormal;
+layout(location = 4) out vec3 aTangent;
+layout(location = 5) out vec3 aBitangent;
+layout(location = 6) out vec3 aCameraPos;
+layout(location = 7) out vec4 fragLightSpacePos;
+layout(location = 8) flat out uint materialIndex;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main() {
+    ObjectData object = objects[gl_InstanceIndex];
+    vec3 inNormal = octDecode(inNormalTangent.xy);
+    vec3 inTangent = octDecode(inNormalTangent.zw);
+
+    // Calculate the vertex position in world space
+    vec4 worldPosition = vec4(vec4(inPosition.xyz, 1.0) * object.transform, 1.0);
+    fragPos = worldPosition.xyz;
+
+    // Pass texture coordinates to the fragment shader
+    fragTexCoord = inTexCoord * object.uvScaleBias.xy + object.uvScaleBias.zw;
+
+    // Transform the normal, tangent, and bitangent to world space
+    aNormal = normalize(vec4(inNormal, 0.0) * object.transform);
+    aTangent = normalize(vec4(inTangent, 0.0) * object.transform);
+
+    aTangent = normalize(aTangent - dot(aTangent, aNormal) * aNormal);
+
+    aBitangent = cross(aNormal, aTangent) * inPosition.w;
+    
+    // Pass lighting information to the fragment shader
+    aCameraPos = frame.cameraPos.xyz;
+
+    materialIndex = object.material;
+
+    fragLightSpacePos = frame.lightSpaceMat * vec4(fragPos, 1.0);    
+
+    // Calculate the final vertex position in clip space
+    gl_Position = frame.proj * frame.view * worldPosition;
+    
+    fragColor = vec3(1.0);
+}
\ No newline at end of file
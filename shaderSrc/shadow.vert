@@ -2,29 +2,31 @@
 #extension GL_EXT_ray_tracing : disable
 
 
-struct Material 
+struct ObjectData
 {
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-    vec3 shininess;
-    vec3 overrideColor;
+    mat3x4 transform; // the first three rows of the model matrix, multiplied as a row vector
+    vec4 uvScaleBias;
+    uint material;
 };
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 transform;
+// Every object of the scene, a draw's first instance is its index
+layout(std430, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+};
+
+// Written once per frame
+layout(binding = 5) uniform FrameUniformBufferObject {
     mat4 view;
     mat4 proj;
     mat4 lightSpaceMat;
-    vec3 cameraPos;
-    Material material;
-    float time;
-} ubo;
+    vec4 cameraPos; // w is the time
+} frame;
 
 layout(location = 0) in vec3 inPosition;
 
 
 void main() {
+    ObjectData object = objects[gl_InstanceIndex];
 
-    gl_Position = ubo.lightSpaceMat * ubo.transform * vec4(inPosition, 1.0);
+    gl_Position = frame.lightSpaceMat * vec4(vec4(inPosition, 1.0) * object.transform, 1.0);
 }
\ No newline at end of file
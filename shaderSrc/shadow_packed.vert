@@ -0,0 +1,33 @@
+#version 460 core
+#extension GL_EXT_ray_tracing : disable
+
+
+struct ObjectData
+{
+    mat3x4 transform; // the first three rows of the model matrix, multiplied as a row vector
+    vec4 uvScaleBias;
+    uint material;
+};
+
+// Every object of the scene, a draw's first instance is its index
+layout(std430, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+};
+
+// Written once per frame
+layout(binding = 5) uniform FrameUniformBufferObject {
+    mat4 view;
+    mat4 proj;
+    mat4 lightSpaceMat;
+    vec4 cameraPos; // w is the time
+} frame;
+
+// snorm16 PackedVertex position, the object's transform already contains the per mesh dequantization
+layout(location = 0) in vec4 inPosition;
+
+
+void main() {
+    ObjectData object = objects[gl_InstanceIndex];
+
+    gl_Position = frame.lightSpaceMat * vec4(vec4(inPosition.xyz, 1.0) * object.transform, 1.0);
+}
\ No newline at end of file
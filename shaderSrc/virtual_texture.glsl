@@ -0,0 +1,70 @@
+// Virtual textures, included by the fragment shaders after textures[]. VirtualTextureSet.h is the CPU side, the
+// defines and layouts must match it and VirtualTexture.h.
+#define VT_NONE 0xFFFFFFFFu
+#define VT_MAX_TEXTURES 16
+#define VT_MAX_LEVELS 16
+#define VT_PAGE_SIZE 128u
+#define VT_PAGE_BORDER 4u
+#define VT_TILE_SIZE 136u
+#define VT_FEEDBACK_STEP 16u
+#define VT_FEEDBACK_WIDTH 256u
+#define VT_FEEDBACK_HEIGHT 256u
+
+// it_VtShaderInfo
+struct VirtualTexture
+{
+    uvec4 size;     // width, height, level count, cache texture
+    uvec4 cache;    // cache columns, page table offset
+    uvec4 levels[VT_MAX_LEVELS];  // pages x, pages y, first page
+};
+
+layout(std430, binding = 6) readonly buffer VirtualTextureBuffer {
+    VirtualTexture virtualTextures[VT_MAX_TEXTURES];
+    uint pageTables[];  // vt_page_entry per page
+};
+
+// One cell per VT_FEEDBACK_STEP square of pixels: the virtual texture and the page it wanted, all ones where none was
+// sampled. Read back once the frame's fence signalled.
+layout(std430, binding = 7) writeonly buffer FeedbackBuffer {
+    uvec2 feedback[];
+};
+
+// Samples the page the footprint asks for, or the nearest coarser one that is resident, and records the wanted page.
+// Called in uniform control flow, the level comes from derivatives.
+vec4 sample_virtual_texture(uint index, vec2 uv)
+{
+    uvec4 size = virtualTextures[index].size;
+    uvec4 cache = virtualTextures[index].cache;
+
+    // the mip the hardware would pick for the whole texture
+    vec2 texels = uv * vec2(size.xy);
+    vec2 dx = dFdx(texels);
+    vec2 dy = dFdy(texels);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1.0));
+    uint level = min(uint(lod), size.z - 1u);
+
+    vec2 wrapped = fract(uv);
+    uvec4 wanted = virtualTextures[index].levels[level];
+    uvec2 levelSize = max(size.xy >> level, uvec2(1u));
+    uvec2 page = min(uvec2(wrapped * vec2(levelSize)) / VT_PAGE_SIZE, wanted.xy - 1u);
+
+    uvec2 pixel = uvec2(gl_FragCoord.xy);
+    if (all(equal(pixel % VT_FEEDBACK_STEP, uvec2(0u))))
+    {
+        uvec2 cell = min(pixel / VT_FEEDBACK_STEP, uvec2(VT_FEEDBACK_WIDTH, VT_FEEDBACK_HEIGHT) - 1u);
+        feedback[cell.y * VT_FEEDBACK_WIDTH + cell.x] = uvec2(index, level << 28 | page.y << 14 | page.x);
+    }
+
+    // tile column, row and the level it holds, no alpha before the first page table arrived
+    uint entry = pageTables[cache.y + wanted.z + page.y * wanted.x + page.x];
+    if ((entry >> 24) == 0u)
+        return vec4(1.0);
+
+    uint held = (entry >> 16) & 0xFFu;
+    uvec4 heldLevel = virtualTextures[index].levels[held];
+    vec2 heldTexel = wrapped * vec2(max(size.xy >> held, uvec2(1u)));
+    uvec2 heldPage = min(uvec2(heldTexel) / VT_PAGE_SIZE, heldLevel.xy - 1u);
+    vec2 tile = vec2(entry & 0xFFu, (entry >> 8) & 0xFFu);
+    vec2 cacheTexel = tile * float(VT_TILE_SIZE) + float(VT_PAGE_BORDER) + heldTexel - vec2(heldPage * VT_PAGE_SIZE);
+    return textureLod(textures[size.w], cacheTexel / float(cache.x * VT_TILE_SIZE), 0.0);
+}
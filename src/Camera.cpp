@@ -1,5 +1,6 @@
 #include <Camera.h>
 #include "util.h"
+#include "DescriptorSet.h"
 
 Camera::Camera(float Winwidth, float Winheight)
 {
@@ -7,29 +8,9 @@ Camera::Camera(float Winwidth, float Winheight)
 	height = Winheight;
 }
 
-void Camera::UpdateMatrices(Model* Model) 
+// Everything here is the same for every model, computed once per frame
+void Camera::UpdateMatrices()
 {
-	//Model->Update();
-	model = glm::mat4(1.0f);
-	glm::mat4 scaleMat = glm::scale(Model->scaleVec);
-	/*
-	if (Model->UUID == "Laocoon" && Model->translationVec.z >= 0.0f)
-	{
-		//Model->translationVec.z -= 0.001;
-		
-		glm::quat quaternion = glm::quatLookAt(Model->rotationVec/glm::length(Model->rotationVec), Up);
-		printf("\r X: %.1f, Y: %.1f, Z: %.1f, W: %.1f", quaternion.x, quaternion.y, quaternion.z, quaternion.w);
-	}
-	*/
-
-	glm::mat4 translateMat = glm::translate(glm::mat4(1.0f), Model->translationVec);
-	glm::mat4 rotMat = glm::mat4(1.0f);
-
-	rotMat *= glm::rotate(glm::mat4(1.0f), Model->rotationVec.z, glm::vec3(0.0f, 0.0f, 1.0f));
-	rotMat *= glm::rotate(glm::mat4(1.0f), Model->rotationVec.y, glm::vec3(0.0f, 1.0f, 0.0f));
-	rotMat *= glm::rotate(glm::mat4(1.0f), Model->rotationVec.x, glm::vec3(1.0f, 0.0f, 0.0f));
-	model *= translateMat * rotMat * scaleMat;
-	Model->transform = model;
 	glm::mat4 lightRotMat = glm::mat4(1.0f);
 
 	lightRotMat *= glm::rotate(glm::mat4(1.0f), lightRot.z, glm::vec3(0.0f, 0.0f, 1.0f));
@@ -40,6 +21,22 @@ void Camera::UpdateMatrices(Model* Model)
 	view = glm::lookAt(Position, Position + Orientation, Up); 
 	proj = glm::perspective(glm::radians(FOV), width / (float)height, 0.1f, 10000.0f);
 
+	glm::vec3 lightTarget = glm::vec3(0.05f, 22.5f, -0.432f);
+
+	// Calculate the light's view matrix
+	glm::mat4 lightView = glm::lookAt(glm::vec3(20.3f, 27.4f, 23.2f), lightTarget, Up);
+
+	// Calculate the light's orthographic projection matrix
+	glm::mat4 lightProjection = glm::ortho<float>(-50, 50, -50, 50, 0, 100);
+	lightProjection[1][1] *= -1;
+	glm::mat4 biasMatrix(
+		0.5, 0.0, 0.0, 0.0,
+		0.0, 0.5, 0.0, 0.0,
+		0.0, 0.0, 0.5, 0.0,
+		0.5, 0.5, 0.5, 1.0
+	);
+	// Calculate the light space matrix
+	lightSpaceMat = lightProjection * lightView * biasMatrix;
 }
 
 
@@ -72,7 +69,7 @@ int Camera::pickModel(std::vector<Model*> scene, GLFWwindow* window)
 			// Calculate world position of the vertex
 			glm::vec3 scaledPos = vertex.pos * cModel->scaleVec;
 			glm::vec3 rotatedPos = glm::mat3(cModel->transform) * vertex.pos;
-			glm::vec3 worldPos = rotatedPos + cModel->translationVec;
+			glm::vec3 worldPos = rotatedPos + glm::vec3(cModel->transform[3]);
 
 			// Convert world position to screen space
 			glm::vec2 screenPos = util::worldToScreen(worldPos, proj, view);
@@ -118,10 +115,10 @@ int Camera::pickModel(std::vector<Model*> scene, GLFWwindow* window)
 		bool inside = util::isInsideQuadrilateral(click, UpScreen, RightScreen, DownScreen, LeftScreen);
 		if (inside) {
 			// Calculate distance from camera to the model's origin (you may adjust this distance calculation as needed)
-			glm::vec3 modelOrigin = cModel->translationVec; // Assuming origin is at the model's translation vector
+			glm::vec3 modelOrigin = glm::vec3(cModel->transform[3]); // world space translation, translationVec is relative to the parent
 
 			// Calculate distance from camera (you need to implement or use your existing depth calculation logic here)
-			float distanceToClick = glm::distance(util::worldToScreen(cModel->translationVec, proj, view), click);
+			float distanceToClick = glm::distance(util::worldToScreen(modelOrigin, proj, view), click);
 			//printf("Kite points in screen space:\n");
 			//printf("Up    (%.2f, %.2f)\n", UpScreen.x, UpScreen.y);
 			//printf("Right (%.2f, %.2f)\n", RightScreen.x, RightScreen.y);
@@ -254,45 +251,45 @@ glm::mat4 calculate_light_space_matrix_dLight(glm::vec3 lightPosition, glm::vec3
 }
 
 
-void update_model_uniform_buffers(Model* cModel, Camera* camera, uint32_t currentImage)
+void pack_object_data(const Model* cModel, ObjectData* object)
 {
-	static auto startTime = std::chrono::high_resolution_clock::now();
-
-	auto currentTime = std::chrono::high_resolution_clock::now();
-	float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+#ifdef ENGINE_PACKED_VERTICES
+	const glm::mat4 transform = cModel->transform * cModel->dequantize;
+#else
+	const glm::mat4 transform = cModel->transform;
+#endif
+	const glm::mat4 rows = glm::transpose(transform);
+	object->transformRows[0] = rows[0];
+	object->transformRows[1] = rows[1];
+	object->transformRows[2] = rows[2];
+	object->uvScaleBias = cModel->uvScaleBias;
+	object->material = cModel->objectIndex;
+}
 
-	camera->UpdateMatrices(cModel);
+size_t update_model_uniform_buffers(Model* cModel, it_BindlessSet* bindless, uint32_t currentImage)
+{
+	// built on the stack and copied whole, the mapping may be write combined
+	ObjectData object{};
+	pack_object_data(cModel, &object);
+	memcpy(bindless_object(bindless, currentImage, cModel->objectIndex), &object, sizeof(object));
 
-	UniformBufferObject ubo{};
-	ubo.transform = cModel->transform;
-	ubo.view = camera->view;
-	ubo.proj = camera->proj;
-	glm::vec3 lightPos = glm::vec3(10.3f, 27.4f, 3.2f);
+	return sizeof(object) + bindless_write_material(bindless, currentImage, cModel->objectIndex, cModel->material);
+}
 
-	glm::vec3 lightTarget = glm::vec3(0.05f, 22.5f, -0.432f);
-	glm::vec3 lightUp = glm::vec3(0.0f, 1.0f, 0.0f);
+size_t update_frame_uniform_buffer(Camera* camera, it_BindlessSet* bindless, uint32_t currentImage)
+{
+	static auto startTime = std::chrono::high_resolution_clock::now();
 
-	// Calculate the light's view matrix
-	glm::mat4 lightView = glm::lookAt(glm::vec3(20.3f, 27.4f, 23.2f), lightTarget, camera->Up);
+	auto currentTime = std::chrono::high_resolution_clock::now();
+	float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
-	// Calculate the light's orthographic projection matrix
-	glm::mat4 lightProjection = glm::ortho<float>(-50, 50, -50, 50, 0, 100);;
-	lightProjection[1][1] *= -1;
-	// Calculate the light space matrix
-	glm::mat4 lightSpaceMatrix = lightProjection * lightView;
-	glm::mat4 biasMatrix(
-		0.5, 0.0, 0.0, 0.0,
-		0.0, 0.5, 0.0, 0.0,
-		0.0, 0.0, 0.5, 0.0,
-		0.5, 0.5, 0.5, 1.0
-	);
-	ubo.lightSpaceMat = lightSpaceMatrix * biasMatrix;
-	ubo.cameraPos = camera->Position;
-	ubo.material = cModel->material;
-	ubo.time = time;
-	ubo.proj[1][1] *= -1;
+	FrameUniformBufferObject frame{};
+	frame.view = camera->view;
+	frame.proj = camera->proj;
+	frame.proj[1][1] *= -1;
+	frame.lightSpaceMat = camera->lightSpaceMat;
+	frame.cameraPos = glm::vec4(camera->Position, time);
 
-	memcpy(cModel->uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+	memcpy(bindless_frame(bindless, currentImage), &frame, sizeof(frame));
+	return sizeof(frame);
 }
-
-
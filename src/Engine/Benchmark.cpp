@@ -0,0 +1,1060 @@
+#include "Benchmark.h"
+#include "JobSystem.h"
+#include "Parallel.h"
+#include "ObjParser.h"
+#include "VertexWelder.h"
+#include "MeshProcessing.h"
+#include "SceneLoader.h"
+#include "TextureCompression.h"
+#include "MipGenerator.h"
+#include "VirtualTexture.h"
+#include "Camera.h"
+#include "MeshCache.h"
+#include "TransformStore.h"
+#include "TransformHierarchy.h"
+
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <cmath>
+#include <cstdlib>
+#include <cctype>
+#include <random>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <fstream>
+#include <cstdio>
+
+#include <tinylogger.h>
+
+
+#define BENCHMARK_MESH_COUNT 16
+#define BENCHMARK_GRID_SIZE 256  // quads per side, two triangles each
+#define BENCHMARK_RUNS 3
+#define BENCHMARK_TEXTURE_SIZE 1024
+#define BENCHMARK_TEXTURE_DIR "res/textures/"
+#define BENCHMARK_MODEL_DIR "res/models/"
+#define BENCHMARK_WELD_GRID_SIZE 512
+#define BENCHMARK_OBJ_GRID_SIZE 1024  // two million triangles, close to 200 MB of OBJ text
+#define BENCHMARK_VT_SIZE 2048
+#define BENCHMARK_VT_SLOTS 64
+#define BENCHMARK_VT_UPLOADS 8      // tiles uploaded per frame at most
+#define BENCHMARK_VT_FRAMES 600
+#define BENCHMARK_VT_FEEDBACK_WIDTH 160  // feedback is written at a fraction of the screen resolution
+#define BENCHMARK_VT_FEEDBACK_HEIGHT 90
+#define BENCHMARK_UPDATE_FRAMES 100
+#define BENCHMARK_HIERARCHY_CHAINS 10    // roots of the deep hierarchy
+#define BENCHMARK_HIERARCHY_FANOUT 316   // children per node of the wide one, three levels hold 100k nodes
+
+// Grid with every corner written as its own v/vt/vn triple, like exporters that do not share attributes
+static void generate_grid_mesh(uint32_t gridSize, float height, it_ObjMesh* mesh)
+{
+    const uint32_t side = gridSize + 1;
+    for (uint32_t y = 0; y < side; ++y)
+    {
+        for (uint32_t x = 0; x < side; ++x)
+        {
+            float u = static_cast<float>(x) / gridSize, v = static_cast<float>(y) / gridSize;
+            mesh->positions.insert(mesh->positions.end(), { u, height * u * v, v });
+            mesh->normals.insert(mesh->normals.end(), { 0.0f, 1.0f, 0.0f });
+            mesh->texcoords.insert(mesh->texcoords.end(), { u, v });
+        }
+    }
+
+    for (uint32_t y = 0; y < gridSize; ++y)
+    {
+        for (uint32_t x = 0; x < gridSize; ++x)
+        {
+            const int corners[6] = {
+                static_cast<int>(y * side + x), static_cast<int>((y + 1) * side + x), static_cast<int>(y * side + x + 1),
+                static_cast<int>(y * side + x + 1), static_cast<int>((y + 1) * side + x), static_cast<int>((y + 1) * side + x + 1) };
+            for (int corner : corners)
+            {
+                tinyobj::index_t index;
+                index.vertex_index = index.normal_index = index.texcoord_index = corner;
+                mesh->indices.push_back(index);
+            }
+        }
+    }
+}
+
+static double seconds_since(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+
+void benchmark_job_scaling(uint32_t maxThreads)
+{
+    if (!maxThreads)
+        maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<it_ObjMesh> meshes(BENCHMARK_MESH_COUNT);
+    for (size_t i = 0; i < meshes.size(); ++i)
+        generate_grid_mesh(BENCHMARK_GRID_SIZE, 0.1f * i, &meshes[i]);
+
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+
+    double weldBase = 0.0, tangentBase = 0.0;
+    for (uint32_t threads : threadCounts)
+    {
+        job_system_init(threads - 1);
+
+        std::vector<std::vector<Vertex>> vertices(meshes.size());
+        std::vector<std::vector<uint32_t>> indices(meshes.size());
+        double weldTime = 1e30, tangentTime = 1e30;
+        for (int run = 0; run < BENCHMARK_RUNS; ++run)
+        {
+            // one mesh per job, the welder itself is serial
+            auto start = std::chrono::high_resolution_clock::now();
+            parallel_for(meshes.size(), [&](size_t i) { weld_obj_vertices(meshes[i], &vertices[i], &indices[i]); });
+            weldTime = std::min(weldTime, seconds_since(start));
+
+            std::vector<it_TangentStreams> streams(meshes.size());
+            for (size_t i = 0; i < meshes.size(); ++i)
+            {
+                const size_t count = vertices[i].size();
+                it_TangentStreams& s = streams[i];
+                s.px.resize(count); s.py.resize(count); s.pz.resize(count);
+                s.nx.resize(count); s.ny.resize(count); s.nz.resize(count);
+                s.u.resize(count); s.v.resize(count);
+                for (size_t k = 0; k < count; ++k)
+                {
+                    const Vertex& vertex = vertices[i][k];
+                    s.px[k] = vertex.pos.x; s.py[k] = vertex.pos.y; s.pz[k] = vertex.pos.z;
+                    s.nx[k] = vertex.normal.x; s.ny[k] = vertex.normal.y; s.nz[k] = vertex.normal.z;
+                    s.u[k] = vertex.texCoord.x; s.v[k] = vertex.texCoord.y;
+                }
+            }
+
+            // meshes in parallel, each one splits its triangles again: nested parallel_for inside jobs
+            start = std::chrono::high_resolution_clock::now();
+            parallel_for(meshes.size(), [&](size_t i) {
+                compute_tangents(&streams[i], indices[i].data(), indices[i].size(), TANGENT_MODE_ANGLE_WEIGHTED);
+            });
+            tangentTime = std::min(tangentTime, seconds_since(start));
+        }
+
+        it_JobStats stats = job_system_stats();
+        job_system_shutdown();
+
+        if (threads == 1)
+        {
+            weldBase = weldTime;
+            tangentBase = tangentTime;
+        }
+        tlog::info(std::to_string(threads) + " threads: weld " + std::to_string(weldTime * 1000.0) + " ms (x" + std::to_string(weldBase / weldTime)
+            + "), tangents " + std::to_string(tangentTime * 1000.0) + " ms (x" + std::to_string(tangentBase / tangentTime) + "), "
+            + std::to_string(stats.stolen) + " of " + std::to_string(stats.executed) + " jobs stolen");
+    }
+}
+
+void benchmark_scene_loading(const std::string& scenePath)
+{
+    if (!std::filesystem::exists("res/data/user/" + scenePath))
+    {
+        tlog::warning("Scene benchmark skipped, res/data/user/" + scenePath + " not found");
+        return;
+    }
+
+    const uint32_t threadCounts[2] = { 1, std::max(1u, std::thread::hardware_concurrency()) };
+    for (uint32_t threads : threadCounts)
+    {
+        job_system_init(threads - 1);
+        std::vector<Model*> scene;
+        it_SceneLoadStats stats;
+        load_scene_pipelined(scenePath, null_scene_uploader(), &scene, &stats);
+        job_system_shutdown();
+        for (Model* model : scene)
+            delete model;
+
+        tlog::info(std::to_string(threads) + " threads: " + std::to_string(stats.models) + " models in " + std::to_string(stats.totalSeconds * 1000.0) + " ms (json "
+            + std::to_string(stats.parseSeconds * 1000.0) + ", mesh " + std::to_string(stats.meshSeconds * 1000.0) + ", decode " + std::to_string(stats.decodeSeconds * 1000.0)
+            + ", wait " + std::to_string(stats.waitSeconds * 1000.0) + " ms), peak decoded " + std::to_string(stats.peakDecodedBytes >> 20) + " of " + std::to_string(stats.decodedBytes >> 20) + " MB");
+        if (threads == threadCounts[1])
+            break;
+    }
+}
+
+// Smooth colour ramps with hard edges and a little noise, and the normal map of a bumpy height field
+static void generate_test_images(uint32_t size, std::vector<uint8_t>* albedo, std::vector<uint8_t>* normal)
+{
+    albedo->resize(static_cast<size_t>(size) * size * 4);
+    normal->resize(static_cast<size_t>(size) * size * 4);
+    srand(1);
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            uint8_t* a = albedo->data() + (static_cast<size_t>(y) * size + x) * 4;
+            const bool tile = ((x / 64) + (y / 64)) & 1;
+            a[0] = static_cast<uint8_t>(tile ? x * 255 / size : 40 + rand() % 8);
+            a[1] = static_cast<uint8_t>(tile ? y * 255 / size : 160 + rand() % 8);
+            a[2] = static_cast<uint8_t>(128 + 100 * std::sin(x * 0.05f) * std::cos(y * 0.03f));
+            a[3] = 255;
+
+            const float dx = 0.6f * std::cos(x * 0.1f) * std::cos(y * 0.07f), dy = -0.4f * std::sin(x * 0.1f) * std::sin(y * 0.07f);
+            const float length = std::sqrt(dx * dx + dy * dy + 1.0f);
+            uint8_t* n = normal->data() + (static_cast<size_t>(y) * size + x) * 4;
+            n[0] = static_cast<uint8_t>((dx / length * 0.5f + 0.5f) * 255.0f + 0.5f);
+            n[1] = static_cast<uint8_t>((dy / length * 0.5f + 0.5f) * 255.0f + 0.5f);
+            n[2] = static_cast<uint8_t>((1.0f / length * 0.5f + 0.5f) * 255.0f + 0.5f);
+            n[3] = 255;
+        }
+    }
+}
+
+void benchmark_texture_compression()
+{
+    std::vector<uint8_t> albedo, normal;
+    generate_test_images(BENCHMARK_TEXTURE_SIZE, &albedo, &normal);
+
+    const std::pair<std::vector<uint8_t>*, VkFormat> images[2] = { { &albedo, VK_FORMAT_BC7_SRGB_BLOCK }, { &normal, VK_FORMAT_BC5_UNORM_BLOCK } };
+    for (const auto& entry : images)
+    {
+        it_ImageData image;
+        image.pixels = entry.first->data();
+        image.width = image.height = BENCHMARK_TEXTURE_SIZE;
+
+        it_MipChain chain;
+        generate_mip_chain(&image, entry.second == VK_FORMAT_BC5_UNORM_BLOCK ? TEXTURE_FORMAT_NORMAL : TEXTURE_FORMAT_COLOR, MIP_FILTER_DEFAULT, &chain);
+        std::vector<it_CompressedLevel> levels;
+        double best = 1e30;
+        for (int run = 0; run < BENCHMARK_RUNS; ++run)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            compress_mip_chain(&chain, entry.second, &levels);
+            best = std::min(best, seconds_since(start));
+        }
+
+        uint64_t rgbaBytes = 0, blockBytes = 0;
+        for (const it_CompressedLevel& level : levels)
+        {
+            rgbaBytes += static_cast<uint64_t>(level.width) * level.height * 4;
+            blockBytes += level.blocks.size();
+        }
+        const double megapixels = rgbaBytes / 4 / 1e6;
+        tlog::info(std::string(entry.second == VK_FORMAT_BC5_UNORM_BLOCK ? "BC5" : "BC7") + " " + std::to_string(BENCHMARK_TEXTURE_SIZE) + "^2 with "
+            + std::to_string(levels.size()) + " levels: " + std::to_string(best * 1000.0) + " ms (" + std::to_string(megapixels / best) + " MPix/s), "
+            + std::to_string(rgbaBytes >> 10) + " -> " + std::to_string(blockBytes >> 10) + " KB, PSNR " + std::to_string(compressed_psnr(&image, &levels[0], entry.second)) + " dB");
+    }
+}
+
+// Normal maps are told apart by name, the way the scenes name them
+static bool is_normal_map(const std::string& name)
+{
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return lower.find("normal") != std::string::npos || lower.find("_n.") != std::string::npos || lower.find("_nrm") != std::string::npos;
+}
+
+void benchmark_mip_generation()
+{
+    struct it_BenchmarkImage
+    {
+        std::string name;
+        std::vector<uint8_t> pixels;
+        int width = 0;
+        int height = 0;
+        double decodeSeconds = 0.0;
+    };
+    std::vector<it_BenchmarkImage> images;
+
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(BENCHMARK_TEXTURE_DIR, ec))
+    {
+        if (!entry.is_regular_file())
+            continue;
+        it_BenchmarkImage image;
+        image.name = entry.path().filename().string();
+        it_ImageData decoded;
+        auto start = std::chrono::high_resolution_clock::now();
+        try
+        {
+            decode_image(entry.path().string(), &decoded);
+        }
+        catch (const std::exception&)
+        {
+            continue;  // not an image stb reads
+        }
+        image.decodeSeconds = seconds_since(start);
+        image.pixels.assign(decoded.pixels, decoded.pixels + image_bytes(&decoded));
+        image.width = decoded.width;
+        image.height = decoded.height;
+        free_image(&decoded);
+        images.push_back(std::move(image));
+    }
+    if (images.empty())
+    {
+        tlog::warning(std::string("No images in ") + BENCHMARK_TEXTURE_DIR + ", using generated ones");
+        images.resize(2);
+        generate_test_images(BENCHMARK_TEXTURE_SIZE, &images[0].pixels, &images[1].pixels);
+        images[0].name = "generated albedo";
+        images[1].name = "generated normal";
+        for (it_BenchmarkImage& image : images)
+            image.width = image.height = BENCHMARK_TEXTURE_SIZE;
+    }
+
+    const it_MipFilter filters[2] = { MIP_FILTER_BOX, MIP_FILTER_KAISER };
+    double totalSeconds[2] = {}, totalDecode = 0.0;
+    uint64_t totalPixels = 0;
+    for (it_BenchmarkImage& image : images)
+    {
+        it_ImageData data;
+        data.pixels = image.pixels.data();
+        data.width = image.width;
+        data.height = image.height;
+        const VkFormat format = is_normal_map(image.name) ? TEXTURE_FORMAT_NORMAL : TEXTURE_FORMAT_COLOR;
+
+        double best[2];
+        it_MipChain chain;
+        for (int f = 0; f < 2; ++f)
+        {
+            best[f] = 1e30;
+            for (int run = 0; run < BENCHMARK_RUNS; ++run)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                generate_mip_chain(&data, format, filters[f], &chain);
+                best[f] = std::min(best[f], seconds_since(start));
+            }
+            totalSeconds[f] += best[f];
+        }
+        const double megapixels = static_cast<double>(image.width) * image.height / 1e6;
+        totalPixels += static_cast<uint64_t>(image.width) * image.height;
+        totalDecode += image.decodeSeconds;
+        tlog::info(image.name + (format == TEXTURE_FORMAT_NORMAL ? " (normal) " : " (sRGB) ") + std::to_string(image.width) + "x" + std::to_string(image.height)
+            + ", " + std::to_string(chain.levels.size()) + " levels: box " + std::to_string(best[0] * 1000.0) + " ms (" + std::to_string(megapixels / best[0])
+            + " MPix/s), Kaiser " + std::to_string(best[1] * 1000.0) + " ms (" + std::to_string(megapixels / best[1]) + " MPix/s), stb decode "
+            + std::to_string(image.decodeSeconds * 1000.0) + " ms");
+    }
+
+    const double megapixels = totalPixels / 1e6;
+    tlog::info(std::to_string(images.size()) + " images, " + std::to_string(megapixels) + " MPix: box " + std::to_string(megapixels / totalSeconds[0]) + " MPix/s, Kaiser "
+        + std::to_string(megapixels / totalSeconds[1]) + " MPix/s, decoding took " + std::to_string(totalDecode * 1000.0) + " ms");
+}
+
+void benchmark_image_decoding(uint32_t maxThreads)
+{
+    if (!maxThreads)
+        maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<std::string> paths;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(BENCHMARK_TEXTURE_DIR, ec))
+    {
+        if (entry.is_regular_file())
+            paths.push_back(entry.path().string());
+    }
+    if (paths.empty())
+    {
+        tlog::warning(std::string("Decode benchmark skipped, no images in ") + BENCHMARK_TEXTURE_DIR);
+        return;
+    }
+
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t threads = 1; threads < maxThreads; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(maxThreads);
+
+    double base = 0.0;
+    for (uint32_t threads : threadCounts)
+    {
+        job_system_init(threads - 1);
+        double best = 1e30;
+        std::atomic<uint64_t> pixels{ 0 };
+        uint32_t decoded = 0;
+        for (int run = 0; run < BENCHMARK_RUNS; ++run)
+        {
+            pixels = 0;
+            std::atomic<uint32_t> count{ 0 };
+            auto start = std::chrono::high_resolution_clock::now();
+            parallel_for(paths.size(), [&](size_t i) {
+                it_ImageData image;
+                try
+                {
+                    decode_image(paths[i], &image);
+                }
+                catch (const std::exception&)
+                {
+                    return;  // not an image stb reads
+                }
+                pixels += static_cast<uint64_t>(image.width) * image.height;
+                count++;
+                free_image(&image);
+            });
+            best = std::min(best, seconds_since(start));
+            decoded = count;
+        }
+        job_system_shutdown();
+
+        if (threads == 1)
+            base = best;
+        const double megapixels = pixels / 1e6;
+        tlog::info(std::to_string(threads) + " threads: " + std::to_string(decoded) + " images, " + std::to_string(megapixels) + " MPix in "
+            + std::to_string(best * 1000.0) + " ms, " + std::to_string(megapixels / best) + " MPix/s (x" + std::to_string(base / best) + ")");
+    }
+}
+
+void benchmark_virtual_texture()
+{
+    std::vector<uint8_t> albedo, normal;
+    generate_test_images(BENCHMARK_VT_SIZE, &albedo, &normal);
+    it_ImageData image;
+    image.pixels = albedo.data();
+    image.width = image.height = BENCHMARK_VT_SIZE;
+    it_MipChain chain;
+    generate_mip_chain(&image, TEXTURE_FORMAT_COLOR, MIP_FILTER_DEFAULT, &chain);
+
+    std::error_code ec;
+    const std::string path = (std::filesystem::temp_directory_path(ec) / "benchmark.vtex").string();
+    auto start = std::chrono::high_resolution_clock::now();
+    if (!write_virtual_texture(path, &chain, TEXTURE_FORMAT_COLOR))
+    {
+        tlog::warning("Virtual texture benchmark skipped, could not write " + path);
+        return;
+    }
+    const double writeSeconds = seconds_since(start);
+
+    it_VirtualTexture vt;
+    open_virtual_texture(path, BENCHMARK_VT_SLOTS, &vt);
+    const size_t pageCount = vt.pageState.size();
+
+    // a camera looking down at a plane and panning across it, the top of the screen is further away and coarser
+    std::vector<uint32_t> feedback(BENCHMARK_VT_FEEDBACK_WIDTH * BENCHMARK_VT_FEEDBACK_HEIGHT);
+    std::vector<it_VtUpload> uploads;
+    double feedbackSeconds = 0.0, updateSeconds = 0.0;
+    uint64_t uploaded = 0;
+    for (uint64_t frame = 0; frame < BENCHMARK_VT_FRAMES; ++frame)
+    {
+        const float panU = frame * 0.002f, panV = 0.3f + 0.1f * std::sin(frame * 0.01f);
+        for (uint32_t y = 0; y < BENCHMARK_VT_FEEDBACK_HEIGHT; ++y)
+        {
+            const float depth = 1.0f - static_cast<float>(y) / BENCHMARK_VT_FEEDBACK_HEIGHT;
+            for (uint32_t x = 0; x < BENCHMARK_VT_FEEDBACK_WIDTH; ++x)
+            {
+                const float u = panU + (static_cast<float>(x) / BENCHMARK_VT_FEEDBACK_WIDTH - 0.5f) * (0.2f + 0.3f * depth);
+                const float v = panV + depth * 0.25f;
+                feedback[y * BENCHMARK_VT_FEEDBACK_WIDTH + x] = vt_feedback_entry(&vt, u, v, 0.5f + 3.0f * depth);
+            }
+        }
+        start = std::chrono::high_resolution_clock::now();
+        vt_feedback(&vt, feedback.data(), feedback.size(), frame);
+        feedbackSeconds += seconds_since(start);
+
+        start = std::chrono::high_resolution_clock::now();
+        vt_update(&vt, BENCHMARK_VT_UPLOADS, &uploads);
+        updateSeconds += seconds_since(start);
+        uploaded += uploads.size();
+    }
+    const it_VtStats stats = vt.stats;
+    close_virtual_texture(&vt);
+    std::filesystem::remove(path, ec);
+
+    tlog::info(std::to_string(BENCHMARK_VT_SIZE) + "^2, " + std::to_string(pageCount) + " pages written in " + std::to_string(writeSeconds * 1000.0) + " ms, "
+        + std::to_string(BENCHMARK_VT_SLOTS) + " tiles cached, " + std::to_string(BENCHMARK_VT_FRAMES) + " frames: hit rate "
+        + std::to_string(100.0 * stats.hits / std::max<uint64_t>(stats.pagesTouched, 1)) + "%, " + std::to_string(stats.loads) + " loads ("
+        + std::to_string(static_cast<double>(uploaded) / BENCHMARK_VT_FRAMES) + " per frame), " + std::to_string(stats.evictions) + " evictions, "
+        + std::to_string(stats.dropped) + " requests deferred, feedback " + std::to_string(feedbackSeconds * 1e6 / BENCHMARK_VT_FRAMES) + " us/frame, update "
+        + std::to_string(updateSeconds * 1e6 / BENCHMARK_VT_FRAMES) + " us/frame");
+}
+
+// dirtyEvery: every nth model's TRS changes each frame, 0 for none
+// The welder load_model used before weld_obj_vertices: a full vertex per corner, looked up in a std::unordered_map
+static void weld_obj_vertices_reference(const it_ObjMesh& mesh, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices)
+{
+    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+    for (const auto& index : mesh.indices)
+    {
+        Vertex vertex{};
+        vertex.pos = { mesh.positions[3 * index.vertex_index + 0], mesh.positions[3 * index.vertex_index + 1], mesh.positions[3 * index.vertex_index + 2] };
+        if (index.normal_index >= 0)
+            vertex.normal = { mesh.normals[3 * index.normal_index + 0], mesh.normals[3 * index.normal_index + 1], mesh.normals[3 * index.normal_index + 2] };
+        if (index.texcoord_index >= 0)
+            vertex.texCoord = { mesh.texcoords[2 * index.texcoord_index + 0], 1.0f - mesh.texcoords[2 * index.texcoord_index + 1] };
+        vertex.color = { 1.0f, 1.0f, 1.0f };
+
+        if (uniqueVertices.count(vertex) == 0) {
+            uniqueVertices[vertex] = static_cast<uint32_t>(vertices->size());
+            vertices->push_back(vertex);
+        }
+        indices->push_back(uniqueVertices[vertex]);
+    }
+}
+
+// Same triangles with every corner written as its own v/vt/vn lines, so nothing welds by index and every corner goes
+// through the value lookup
+static void generate_soup_mesh(const it_ObjMesh& grid, it_ObjMesh* mesh)
+{
+    for (const tinyobj::index_t& corner : grid.indices)
+    {
+        const int i = static_cast<int>(mesh->indices.size());
+        mesh->positions.insert(mesh->positions.end(), grid.positions.begin() + 3 * corner.vertex_index, grid.positions.begin() + 3 * corner.vertex_index + 3);
+        mesh->normals.insert(mesh->normals.end(), grid.normals.begin() + 3 * corner.normal_index, grid.normals.begin() + 3 * corner.normal_index + 3);
+        mesh->texcoords.insert(mesh->texcoords.end(), grid.texcoords.begin() + 2 * corner.texcoord_index, grid.texcoords.begin() + 2 * corner.texcoord_index + 2);
+        tinyobj::index_t index;
+        index.vertex_index = index.normal_index = index.texcoord_index = i;
+        mesh->indices.push_back(index);
+    }
+}
+
+void benchmark_vertex_welding()
+{
+    std::vector<std::pair<std::string, it_ObjMesh>> meshes(2);
+    meshes[0].first = "grid";
+    generate_grid_mesh(BENCHMARK_WELD_GRID_SIZE, 0.5f, &meshes[0].second);
+    meshes[1].first = "soup";
+    generate_soup_mesh(meshes[0].second, &meshes[1].second);
+
+    std::error_code ec;
+    std::vector<std::string> names;
+    for (const auto& entry : std::filesystem::directory_iterator(BENCHMARK_MODEL_DIR, ec))
+        if (entry.path().extension() == ".obj")
+            names.push_back(entry.path().filename().string());
+    std::sort(names.begin(), names.end());
+    for (const std::string& name : names)
+    {
+        it_ObjMesh mesh;
+        std::string err;
+        if (parse_obj(BENCHMARK_MODEL_DIR + name, BENCHMARK_MODEL_DIR, &mesh, &err))
+            meshes.emplace_back(name, std::move(mesh));
+        else
+            tlog::warning("Welding benchmark skipped " + name + ": " + err);
+    }
+
+    for (const auto& [name, mesh] : meshes)
+    {
+        std::vector<Vertex> vertices, referenceVertices;
+        std::vector<uint32_t> indices, referenceIndices;
+        double weldTime = 1e30, referenceTime = 1e30;
+        for (int run = 0; run < BENCHMARK_RUNS; ++run)
+        {
+            vertices.clear();
+            indices.clear();
+            auto start = std::chrono::high_resolution_clock::now();
+            weld_obj_vertices(mesh, &vertices, &indices);
+            weldTime = std::min(weldTime, seconds_since(start));
+
+            referenceVertices.clear();
+            referenceIndices.clear();
+            start = std::chrono::high_resolution_clock::now();
+            weld_obj_vertices_reference(mesh, &referenceVertices, &referenceIndices);
+            referenceTime = std::min(referenceTime, seconds_since(start));
+        }
+
+        const bool same = vertices == referenceVertices && indices == referenceIndices;
+        tlog::info(name + ": " + std::to_string(mesh.indices.size()) + " corners into " + std::to_string(vertices.size()) + " vertices, weld "
+            + std::to_string(weldTime * 1000.0) + " ms, unordered_map " + std::to_string(referenceTime * 1000.0) + " ms (x" + std::to_string(referenceTime / weldTime)
+            + "), output " + (same ? "identical" : "DIFFERENT"));
+    }
+}
+
+void benchmark_vertex_cache()
+{
+    // welded grid with its triangles shuffled, then every model in res/models as the welder leaves it
+    std::vector<std::pair<std::string, std::vector<uint32_t>>> meshes(1);
+    std::vector<size_t> vertexCounts(1);
+    {
+        it_ObjMesh grid;
+        generate_grid_mesh(BENCHMARK_GRID_SIZE, 0.5f, &grid);
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        weld_obj_vertices(grid, &vertices, &indices);
+        std::vector<uint32_t> order(indices.size() / 3);
+        for (size_t t = 0; t < order.size(); ++t)
+            order[t] = static_cast<uint32_t>(t);
+        std::shuffle(order.begin(), order.end(), std::mt19937(7));
+        meshes[0].first = "shuffled grid";
+        for (uint32_t t : order)
+            meshes[0].second.insert(meshes[0].second.end(), indices.begin() + t * 3, indices.begin() + t * 3 + 3);
+        vertexCounts[0] = vertices.size();
+    }
+
+    std::error_code ec;
+    std::vector<std::string> names;
+    for (const auto& entry : std::filesystem::directory_iterator(BENCHMARK_MODEL_DIR, ec))
+        if (entry.path().extension() == ".obj")
+            names.push_back(entry.path().filename().string());
+    std::sort(names.begin(), names.end());
+    for (const std::string& name : names)
+    {
+        it_ObjMesh mesh;
+        std::string err;
+        if (!parse_obj(BENCHMARK_MODEL_DIR + name, BENCHMARK_MODEL_DIR, &mesh, &err))
+            continue;
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        weld_obj_vertices(mesh, &vertices, &indices);
+        meshes.emplace_back(name, std::move(indices));
+        vertexCounts.push_back(vertices.size());
+    }
+
+    const struct { const char* name; void (*optimize)(uint32_t*, size_t, size_t, uint32_t); } optimizers[] = {
+        { "Tipsify", optimize_vertex_cache },
+        { "Forsyth", optimize_vertex_cache_forsyth },
+    };
+    for (size_t m = 0; m < meshes.size(); ++m)
+    {
+        const std::vector<uint32_t>& indices = meshes[m].second;
+        it_VertexCacheStats input = analyze_vertex_cache(indices.data(), indices.size(), vertexCounts[m], MESH_VERTEX_CACHE_SIZE);
+        std::string line = meshes[m].first + ", " + std::to_string(indices.size() / 3) + " triangles: input ACMR " + std::to_string(input.acmr);
+        for (const auto& optimizer : optimizers)
+        {
+            std::vector<uint32_t> optimized;
+            double best = 1e30;
+            for (int run = 0; run < BENCHMARK_RUNS; ++run)
+            {
+                optimized = indices;
+                auto start = std::chrono::high_resolution_clock::now();
+                optimizer.optimize(optimized.data(), optimized.size(), vertexCounts[m], MESH_VERTEX_CACHE_SIZE);
+                best = std::min(best, seconds_since(start));
+            }
+            it_VertexCacheStats stats = analyze_vertex_cache(optimized.data(), optimized.size(), vertexCounts[m], MESH_VERTEX_CACHE_SIZE);
+            line += ", " + std::string(optimizer.name) + " ACMR " + std::to_string(stats.acmr) + " ATVR " + std::to_string(stats.atvr) + " in " + std::to_string(best * 1000.0) + " ms";
+        }
+        tlog::info(line);
+    }
+}
+
+static double time_frame_updates(std::vector<Model>& models, Camera* camera, std::vector<ObjectData>& objects, bool perModelConstants, uint32_t dirtyEvery,
+    bool parallel, uint64_t* rebuilt)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t frame = 0; frame < BENCHMARK_UPDATE_FRAMES; ++frame)
+    {
+        if (!perModelConstants)
+            camera->UpdateMatrices();
+        for (size_t i = 0; i < models.size(); ++i)
+        {
+            if (perModelConstants)
+                camera->UpdateMatrices();
+            if (dirtyEvery && (i + frame) % dirtyEvery == 0)
+            {
+                models[i].rotationVec.y += 0.01f;
+                models[i].transformDirty = true;
+            }
+            if (update_model_transform(&models[i]))
+                (*rebuilt)++;
+            if (!parallel)
+                pack_object_data(&models[i], &objects[i]);
+        }
+        // batched the way drawFrame packs, byte count included
+        if (parallel)
+        {
+            std::atomic<size_t> bytes{ 0 };
+            const size_t batchCount = (models.size() + OBJECT_UPDATE_BATCH_SIZE - 1) / OBJECT_UPDATE_BATCH_SIZE;
+            parallel_for(batchCount, [&](size_t batch) {
+                size_t batchBytes = 0;
+                for (size_t i = batch * OBJECT_UPDATE_BATCH_SIZE; i < std::min(models.size(), (batch + 1) * OBJECT_UPDATE_BATCH_SIZE); ++i)
+                {
+                    pack_object_data(&models[i], &objects[i]);
+                    batchBytes += sizeof(ObjectData);
+                }
+                bytes += batchBytes;
+            });
+        }
+    }
+    return seconds_since(start) / BENCHMARK_UPDATE_FRAMES;
+}
+
+void benchmark_frame_update(uint32_t objectCount)
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f), angle(0.0f, 6.28f), scale(0.5f, 2.0f);
+    std::vector<Model> models(objectCount);
+    for (uint32_t i = 0; i < objectCount; ++i)
+    {
+        models[i].translationVec = glm::vec3(position(rng), position(rng), position(rng));
+        models[i].rotationVec = glm::vec3(angle(rng), angle(rng), angle(rng));
+        models[i].scaleVec = glm::vec3(scale(rng));
+        models[i].objectIndex = i;
+    }
+    std::vector<ObjectData> objects(objectCount);
+
+    Camera camera(1920.0f, 1080.0f);
+    camera.Position = glm::vec3(0.0f, -150.0f, 20.0f);
+    camera.Orientation = glm::vec3(0.0f, 1.0f, 0.0f);
+
+    struct Case { const char* name; bool perModelConstants; uint32_t dirtyEvery; bool parallel; };
+    const Case cases[] = { { "per model constants", true, 1, false }, { "frame constants, all dirty", false, 1, false }, { "1% dirty", false, 100, false },
+        { "static", false, 0, false }, { "static, packed with parallel_for", false, 0, true } };
+    job_system_init(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    std::string line = std::to_string(objectCount) + " objects:";
+    double baseline = 0.0;
+    for (const Case& c : cases)
+    {
+        double best = 0.0;
+        uint64_t rebuilt = 0;
+        for (int run = 0; run < BENCHMARK_RUNS; ++run)
+        {
+            rebuilt = 0;
+            const double seconds = time_frame_updates(models, &camera, objects, c.perModelConstants, c.dirtyEvery, c.parallel, &rebuilt);
+            best = run == 0 ? seconds : std::min(best, seconds);
+        }
+        if (baseline == 0.0)
+            baseline = best;
+        line += std::string(" ") + c.name + " " + std::to_string(best * 1e6) + " us/frame (" + std::to_string(rebuilt / BENCHMARK_UPDATE_FRAMES)
+            + " rebuilt, x" + std::to_string(baseline / best) + "),";
+    }
+    job_system_shutdown();
+    line.pop_back();
+    tlog::info(line + " on " + std::to_string(std::max(1u, std::thread::hardware_concurrency())) + " threads");
+}
+
+void benchmark_transform_batch(uint32_t objectCount)
+{
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f), angle(0.0f, 6.28f), scale(0.5f, 2.0f);
+    // allocated one by one like the scene's models
+    std::vector<std::unique_ptr<Model>> models(objectCount);
+    it_TransformStore store;
+    transform_store_reserve(&store, objectCount);
+    for (uint32_t i = 0; i < objectCount; ++i)
+    {
+        models[i] = std::make_unique<Model>();
+        models[i]->translationVec = glm::vec3(position(rng), position(rng), position(rng));
+        models[i]->rotationVec = glm::vec3(angle(rng), angle(rng), angle(rng));
+        models[i]->scaleVec = glm::vec3(scale(rng));
+        transform_push(&store, models[i]->translationVec, models[i]->rotationVec, models[i]->scaleVec);
+    }
+
+    auto best_of = [](const std::function<void()>& fn) {
+        double best = 0.0;
+        for (int run = 0; run < BENCHMARK_RUNS; ++run)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            fn();
+            const double seconds = seconds_since(start);
+            best = run == 0 ? seconds : std::min(best, seconds);
+        }
+        return best;
+    };
+
+    const double glmSeconds = best_of([&]() {
+        for (auto& model : models)
+        {
+            model->transformDirty = true;
+            update_model_transform(model.get());
+        }
+    });
+    transform_use_simd(false);
+    const double scalarSeconds = best_of([&]() { transform_update_range(&store, 0, store.count); });
+    transform_use_simd(true);
+    const double simdSeconds = best_of([&]() { transform_update_range(&store, 0, store.count); });
+    const double parallelSeconds = best_of([&]() { transform_update_world(&store); });
+
+    // both paths build the same matrices, up to rounding
+    float maxError = 0.0f;
+    for (uint32_t i = 0; i < objectCount; ++i)
+        for (int c = 0; c < 4; ++c)
+            for (int r = 0; r < 4; ++r)
+                maxError = std::max(maxError, std::abs(models[i]->transform[c][r] - store.world[i][c][r]));
+
+    tlog::info(std::to_string(objectCount) + " transforms: glm " + std::to_string(glmSeconds * 1000.0) + " ms, SoA scalar " + std::to_string(scalarSeconds * 1000.0)
+        + " ms (x" + std::to_string(glmSeconds / scalarSeconds) + "), AVX2 " + (transform_simd_supported() ? "" : "(unsupported, scalar) ") + std::to_string(simdSeconds * 1000.0)
+        + " ms (x" + std::to_string(glmSeconds / simdSeconds) + "), AVX2 parallel_for " + std::to_string(parallelSeconds * 1000.0) + " ms (x"
+        + std::to_string(glmSeconds / parallelSeconds) + "), max difference " + std::to_string(maxError));
+}
+
+// dirtyEvery: every nth node's TRS changes each frame, 0 for only dirtyNode
+static double time_hierarchy_updates(it_TransformHierarchy* hierarchy, uint32_t dirtyEvery, uint32_t dirtyNode, uint64_t* rebuilt)
+{
+    const uint32_t count = static_cast<uint32_t>(hierarchy->parent.size());
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t frame = 0; frame < BENCHMARK_UPDATE_FRAMES; ++frame)
+    {
+        const glm::vec3 rotation(0.0f, frame * 0.01f, 0.0f);
+        if (dirtyEvery)
+        {
+            for (uint32_t i = frame % dirtyEvery; i < count; i += dirtyEvery)
+                hierarchy_set_local(hierarchy, i, glm::vec3(1.0f, 0.0f, 0.0f), rotation, glm::vec3(1.0f));
+        }
+        else
+            hierarchy_set_local(hierarchy, dirtyNode, glm::vec3(1.0f, 0.0f, 0.0f), rotation, glm::vec3(1.0f));
+        *rebuilt += hierarchy_update(hierarchy);
+    }
+    return seconds_since(start) / BENCHMARK_UPDATE_FRAMES;
+}
+
+void benchmark_transform_hierarchy(uint32_t nodeCount)
+{
+    const uint32_t chainLength = std::max(1u, nodeCount / BENCHMARK_HIERARCHY_CHAINS);
+    struct Shape { const char* name; std::function<uint32_t(uint32_t)> parentOf; };
+    const Shape shapes[] = {
+        { "deep", [&](uint32_t i) { return i % chainLength == 0 ? HIERARCHY_ROOT : i - 1; } },
+        { "wide", [](uint32_t i) { return i == 0 ? HIERARCHY_ROOT : (i - 1) / BENCHMARK_HIERARCHY_FANOUT; } },
+    };
+    struct Case { const char* name; uint32_t dirtyEvery; uint32_t dirtyNode; };
+    // node 0 is a root and the last node a leaf in both shapes
+    const Case cases[] = { { "all dirty", 1, 0 }, { "1% dirty", 100, 0 }, { "root", 0, 0 }, { "one leaf", 0, nodeCount - 1 } };
+
+    std::mt19937 rng(13);
+    for (const Shape& shape : shapes)
+    {
+        std::vector<uint32_t> parents(nodeCount);
+        uint32_t depth = 0;
+        std::vector<uint32_t> depths(nodeCount);
+        for (uint32_t i = 0; i < nodeCount; ++i)
+        {
+            parents[i] = shape.parentOf(i);
+            depths[i] = parents[i] == HIERARCHY_ROOT ? 1 : depths[parents[i]] + 1;
+            depth = std::max(depth, depths[i]);
+        }
+
+        // sorting is the cost of a structural change, nodes in random order like a scene file's
+        std::vector<uint32_t> label(nodeCount);
+        for (uint32_t i = 0; i < nodeCount; ++i)
+            label[i] = i;
+        std::shuffle(label.begin(), label.end(), rng);
+        std::vector<uint32_t> shuffled(nodeCount), order;
+        double sortSeconds = 0.0;
+        for (int run = 0; run < BENCHMARK_RUNS; ++run)
+        {
+            for (uint32_t i = 0; i < nodeCount; ++i)
+                shuffled[label[i]] = parents[i] == HIERARCHY_ROOT ? HIERARCHY_ROOT : label[parents[i]];
+            auto start = std::chrono::high_resolution_clock::now();
+            hierarchy_sort(&shuffled, &order);
+            const double seconds = seconds_since(start);
+            sortSeconds = run == 0 ? seconds : std::min(sortSeconds, seconds);
+        }
+
+        it_TransformHierarchy hierarchy;
+        hierarchy_reserve(&hierarchy, nodeCount);
+        for (uint32_t i = 0; i < nodeCount; ++i)
+            hierarchy_add(&hierarchy, parents[i], glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f), glm::vec3(1.0f));
+        hierarchy_update(&hierarchy);
+
+        std::string line = std::to_string(nodeCount) + " nodes " + shape.name + ", depth " + std::to_string(depth) + ": sort " + std::to_string(sortSeconds * 1000.0) + " ms,";
+        double baseline = 0.0;
+        for (const Case& c : cases)
+        {
+            double best = 0.0;
+            uint64_t rebuilt = 0;
+            for (int run = 0; run < BENCHMARK_RUNS; ++run)
+            {
+                rebuilt = 0;
+                const double seconds = time_hierarchy_updates(&hierarchy, c.dirtyEvery, c.dirtyNode, &rebuilt);
+                best = run == 0 ? seconds : std::min(best, seconds);
+            }
+            if (baseline == 0.0)
+                baseline = best;
+            line += std::string(" ") + c.name + " " + std::to_string(best * 1e6) + " us/frame (" + std::to_string(rebuilt / BENCHMARK_UPDATE_FRAMES)
+                + " rebuilt, x" + std::to_string(baseline / best) + "),";
+        }
+        line.pop_back();
+        tlog::info(line);
+    }
+}
+
+// Writes the mesh as OBJ text, corners as v/vt/vn triples with the file's one based indices
+static bool write_obj_file(const std::string& path, const it_ObjMesh& mesh)
+{
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    if (!f.is_open())
+        return false;
+
+    std::string text;
+    char line[128];
+    auto flush = [&](bool force) {
+        if (force || text.size() > (1 << 20))
+        {
+            f.write(text.data(), text.size());
+            text.clear();
+        }
+    };
+    for (size_t i = 0; i < mesh.positions.size(); i += 3)
+    {
+        text.append(line, snprintf(line, sizeof(line), "v %f %f %f\n", mesh.positions[i], mesh.positions[i + 1], mesh.positions[i + 2]));
+        flush(false);
+    }
+    for (size_t i = 0; i < mesh.texcoords.size(); i += 2)
+    {
+        text.append(line, snprintf(line, sizeof(line), "vt %f %f\n", mesh.texcoords[i], mesh.texcoords[i + 1]));
+        flush(false);
+    }
+    for (size_t i = 0; i < mesh.normals.size(); i += 3)
+    {
+        text.append(line, snprintf(line, sizeof(line), "vn %f %f %f\n", mesh.normals[i], mesh.normals[i + 1], mesh.normals[i + 2]));
+        flush(false);
+    }
+    for (size_t i = 0; i < mesh.indices.size(); i += 3)
+    {
+        const tinyobj::index_t* c = &mesh.indices[i];
+        text.append(line, snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\n", c[0].vertex_index + 1, c[0].texcoord_index + 1, c[0].normal_index + 1,
+            c[1].vertex_index + 1, c[1].texcoord_index + 1, c[1].normal_index + 1, c[2].vertex_index + 1, c[2].texcoord_index + 1, c[2].normal_index + 1));
+        flush(false);
+    }
+    flush(true);
+    return f.good();
+}
+
+void benchmark_obj_parse()
+{
+    it_ObjMesh grid;
+    generate_grid_mesh(BENCHMARK_OBJ_GRID_SIZE, 0.5f, &grid);
+    std::error_code ec;
+    const std::string path = (std::filesystem::temp_directory_path(ec) / "benchmark.obj").string();
+    if (!write_obj_file(path, grid))
+    {
+        tlog::warning("OBJ benchmark skipped, could not write " + path);
+        return;
+    }
+    const double megabytes = std::filesystem::file_size(path, ec) / (1024.0 * 1024.0);
+    const double triangles = grid.indices.size() / 3.0;
+    grid = it_ObjMesh();
+
+    // parse_obj directly, load_model would find the mesh cache entry
+    it_ObjMesh mesh;
+    const uint32_t threadCounts[2] = { 1, std::max(1u, std::thread::hardware_concurrency()) };
+    double base = 0.0;
+    for (uint32_t threads : threadCounts)
+    {
+        job_system_init(threads - 1);
+        double best = 1e30;
+        for (int run = 0; run < BENCHMARK_RUNS; ++run)
+        {
+            mesh = it_ObjMesh();
+            std::string err;
+            auto start = std::chrono::high_resolution_clock::now();
+            parse_obj(path, "", &mesh, &err);
+            best = std::min(best, seconds_since(start));
+        }
+        job_system_shutdown();
+
+        if (threads == 1)
+            base = best;
+        tlog::info(std::to_string(threads) + " threads: " + std::to_string(megabytes) + " MB, " + std::to_string(static_cast<size_t>(triangles)) + " triangles in "
+            + std::to_string(best * 1000.0) + " ms, " + std::to_string(megabytes / best) + " MB/s (x" + std::to_string(base / best) + ")");
+        if (threads == threadCounts[1])
+            break;
+    }
+
+    // the parser load_model used before, once since it is slow
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string err;
+    auto start = std::chrono::high_resolution_clock::now();
+    tinyobj::LoadObj(&attrib, &shapes, &materials, &err, path.c_str(), "");
+    const double tinyobjSeconds = seconds_since(start);
+    std::filesystem::remove(path, ec);
+
+    std::vector<tinyobj::index_t> corners;
+    for (const tinyobj::shape_t& shape : shapes)
+        corners.insert(corners.end(), shape.mesh.indices.begin(), shape.mesh.indices.end());
+    bool same = attrib.vertices == mesh.positions && attrib.normals == mesh.normals && attrib.texcoords == mesh.texcoords && corners.size() == mesh.indices.size();
+    for (size_t i = 0; same && i < corners.size(); ++i)
+        same = corners[i].vertex_index == mesh.indices[i].vertex_index && corners[i].texcoord_index == mesh.indices[i].texcoord_index
+            && corners[i].normal_index == mesh.indices[i].normal_index;
+    tlog::info("tinyobj: " + std::to_string(tinyobjSeconds * 1000.0) + " ms, " + std::to_string(megabytes / tinyobjSeconds) + " MB/s, output "
+        + (same ? "identical" : "DIFFERENT"));
+}
+
+void benchmark_mesh_cache()
+{
+#ifdef ENGINE_DISABLE_MESH_CACHE
+    tlog::warning("Mesh cache benchmark skipped, built with ENGINE_DISABLE_MESH_CACHE");
+#else
+    std::vector<std::string> names;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(BENCHMARK_MODEL_DIR, ec))
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".obj")
+            names.push_back(entry.path().filename().string());
+    }
+    if (names.empty())
+    {
+        tlog::warning(std::string("Mesh cache benchmark skipped, no .obj files in ") + BENCHMARK_MODEL_DIR);
+        return;
+    }
+    std::sort(names.begin(), names.end());
+
+    double coldTotal = 0.0, warmTotal = 0.0;
+    for (const std::string& name : names)
+    {
+        double cold = 1e30, warm = 1e30;
+        size_t vertexCount = 0, triangleCount = 0;
+        try
+        {
+            for (int run = 0; run < BENCHMARK_RUNS; ++run)
+            {
+                // cold: the entry is removed so the model is parsed, processed and written back
+                Model source;
+                init_model(&source, "models/" + name, "");
+                std::filesystem::remove(mesh_cache_path(source.baseDir + source.MODEL_PATH), ec);
+                auto start = std::chrono::high_resolution_clock::now();
+                load_model(&source);
+                cold = std::min(cold, seconds_since(start));
+
+                Model cached;
+                init_model(&cached, "models/" + name, "");
+                start = std::chrono::high_resolution_clock::now();
+                load_model(&cached);
+                warm = std::min(warm, seconds_since(start));
+                vertexCount = cached.vertices.size();
+                triangleCount = cached.statsFaces;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            tlog::warning(name + " skipped: " + e.what());
+            continue;
+        }
+        coldTotal += cold;
+        warmTotal += warm;
+        tlog::info(name + ": " + std::to_string(vertexCount) + " vertices, " + std::to_string(triangleCount) + " triangles, cold " + std::to_string(cold * 1000.0)
+            + " ms, warm " + std::to_string(warm * 1000.0) + " ms (x" + std::to_string(cold / warm) + ")");
+    }
+    if (warmTotal > 0.0)
+        tlog::info(std::to_string(names.size()) + " models: cold " + std::to_string(coldTotal * 1000.0) + " ms, warm " + std::to_string(warmTotal * 1000.0)
+            + " ms (x" + std::to_string(coldTotal / warmTotal) + ")");
+#endif
+}
+
+void run_benchmarks()
+{
+    tlog::info("Job system scaling, " + std::to_string(BENCHMARK_MESH_COUNT) + " meshes of " + std::to_string(BENCHMARK_GRID_SIZE * BENCHMARK_GRID_SIZE * 2) + " triangles");
+    benchmark_job_scaling();
+
+    tlog::info("Vertex welding against the unordered_map welder, single thread");
+    benchmark_vertex_welding();
+
+    tlog::info("Vertex cache optimization, FIFO of " + std::to_string(MESH_VERTEX_CACHE_SIZE));
+    benchmark_vertex_cache();
+
+    tlog::info("Scene loading pipeline, null uploader");
+    benchmark_scene_loading("main.json");
+
+    tlog::info("Image decoding from mapped files");
+    benchmark_image_decoding();
+
+    tlog::info("Mip generation on " + std::to_string(std::max(1u, std::thread::hardware_concurrency())) + " threads");
+    benchmark_mip_generation();
+
+    tlog::info("Texture compression on " + std::to_string(std::max(1u, std::thread::hardware_concurrency())) + " threads");
+    benchmark_texture_compression();
+
+    tlog::info("Virtual texture residency, synchronous loads");
+    benchmark_virtual_texture();
+
+    tlog::info("Frame constants and transform updates, " + std::to_string(BENCHMARK_UPDATE_FRAMES) + " frames");
+    benchmark_frame_update();
+
+    tlog::info("Transform batches on " + std::to_string(std::max(1u, std::thread::hardware_concurrency())) + " threads");
+    benchmark_transform_batch();
+
+    tlog::info("Transform hierarchy propagation, " + std::to_string(BENCHMARK_UPDATE_FRAMES) + " frames");
+    benchmark_transform_hierarchy();
+
+    tlog::info("OBJ parsing, " + std::to_string(BENCHMARK_OBJ_GRID_SIZE * BENCHMARK_OBJ_GRID_SIZE * 2) + " triangles generated");
+    benchmark_obj_parse();
+
+    tlog::info("Mesh cache, cold and warm loads of " + std::string(BENCHMARK_MODEL_DIR));
+    benchmark_mesh_cache();
+}
@@ -2,10 +2,17 @@
 
 
 void copy_buffer(VkDevice* device, VkCommandPool commandPool, VkQueue graphicsQueue, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+{
+    copy_buffer_region(device, commandPool, graphicsQueue, srcBuffer, dstBuffer, 0, 0, size);
+}
+
+void copy_buffer_region(VkDevice* device, VkCommandPool commandPool, VkQueue graphicsQueue, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize srcOffset, VkDeviceSize dstOffset, VkDeviceSize size)
 {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
 
     VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = srcOffset;
+    copyRegion.dstOffset = dstOffset;
     copyRegion.size = size;
     vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
@@ -15,9 +22,14 @@ void copy_buffer(VkDevice* device, VkCommandPool commandPool, VkQueue graphicsQu
 void copy_buffer_to_image(VkDevice* device, VkCommandPool commandPool, VkQueue graphicsQueue, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
 {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
+    record_copy_buffer_to_image(commandBuffer, buffer, 0, image, width, height);
+    endSingleTimeCommands(device, commandBuffer, commandPool, graphicsQueue);
+}
 
+void record_copy_buffer_to_image(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset, VkImage image, uint32_t width, uint32_t height)
+{
     VkBufferImageCopy region{};
-    region.bufferOffset = 0;
+    region.bufferOffset = bufferOffset;
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -32,12 +44,10 @@ void copy_buffer_to_image(VkDevice* device, VkCommandPool commandPool, VkQueue g
     };
 
     vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-    endSingleTimeCommands(device, commandBuffer, commandPool, graphicsQueue);
 }
 
 
-void create_buffer(VkDevice* device, VkPhysicalDevice* physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+void create_buffer(VkDevice* device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, it_Allocation& bufferMemory)
 {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -49,17 +59,5 @@ void create_buffer(VkDevice* device, VkPhysicalDevice* physicalDevice, VkDeviceS
         throw std::runtime_error("ERROR:failed to create buffer!");
     }
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(*device, buffer, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(*physicalDevice, memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(*device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("ERROR: failed to allocate buffer memory!");
-    }
-
-    vkBindBufferMemory(*device, buffer, bufferMemory, 0);
+    allocate_buffer_memory(buffer, properties, &bufferMemory);
 }
\ No newline at end of file
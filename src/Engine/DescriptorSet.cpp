@@ -1,158 +1,194 @@
 #include "DescriptorSet.h"
+#include "TextureCache.h"
+#include <algorithm>
+#include <cstring>
 #define MAX_FRAMES_IN_FLIGHT 2
 
-void create_descriptor_set_layout(VkDevice* device, VkDescriptorSetLayout* descriptorSetLayout)
+static VkDeviceSize align_up(VkDeviceSize offset, VkDeviceSize alignment)
 {
-    // Used to create a global descriptorSetLayout. I think this is more elegant that grabbing the layout from the first model or sth
-    // could 100% be better though
-    // maybe i should vector or sth that holds all the layouts, each one unique for the matching pipeline, if they ever don't have the same descriptor set.
-    VkDescriptorSetLayoutBinding uboLayoutBinding{};
-    uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorCount = 1;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    uboLayoutBinding.pImmutableSamplers = nullptr;
-    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-    VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-    samplerLayoutBinding.binding = 1;
-    samplerLayoutBinding.descriptorCount = 1;
-    samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    samplerLayoutBinding.pImmutableSamplers = nullptr;
-    samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-    VkDescriptorSetLayoutBinding normalSamplerLayoutBinding{};
-    normalSamplerLayoutBinding.binding = 2;
-    normalSamplerLayoutBinding.descriptorCount = 1;
-    normalSamplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    normalSamplerLayoutBinding.pImmutableSamplers = nullptr;
-    normalSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-    VkDescriptorSetLayoutBinding lightLayoutBinding{};
-    lightLayoutBinding.binding = 3;
-    lightLayoutBinding.descriptorCount = 1;
-    lightLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    lightLayoutBinding.pImmutableSamplers = nullptr;
-    lightLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-    VkDescriptorSetLayoutBinding shadowSamplerLayoutBinding{};
-    shadowSamplerLayoutBinding.binding = 4;
-    shadowSamplerLayoutBinding.descriptorCount = 1;
-    shadowSamplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    shadowSamplerLayoutBinding.pImmutableSamplers = nullptr;
-    shadowSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-    std::array<VkDescriptorSetLayoutBinding, 5> bindings = { uboLayoutBinding, samplerLayoutBinding, normalSamplerLayoutBinding, lightLayoutBinding, shadowSamplerLayoutBinding };
-    VkDescriptorSetLayoutCreateInfo layoutInfo{};
-    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-    layoutInfo.pBindings = bindings.data();
+    return (offset + alignment - 1) / alignment * alignment;
+}
 
-    if (vkCreateDescriptorSetLayout(*device, &layoutInfo, nullptr, descriptorSetLayout) != VK_SUCCESS)
-        throw std::runtime_error("ERROR: failed to create descriptor set layout!");
+bool bindless_supported(VkPhysicalDevice physicalDevice)
+{
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &features12;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+    VkPhysicalDeviceVulkan12Properties properties12{};
+    properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &properties12;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+    return features.features.shaderSampledImageArrayDynamicIndexing && features12.descriptorBindingPartiallyBound
+        && features12.descriptorBindingSampledImageUpdateAfterBind && features12.descriptorBindingUpdateUnusedWhilePending
+        && properties12.maxPerStageDescriptorUpdateAfterBindSampledImages >= BINDLESS_MAX_TEXTURES
+        && properties12.maxPerStageDescriptorUpdateAfterBindSamplers >= BINDLESS_MAX_TEXTURES
+        && properties12.maxDescriptorSetUpdateAfterBindSampledImages >= BINDLESS_MAX_TEXTURES;
 }
 
-void create_descriptor_set_layout(VkDevice* device, Model* cModel)
+void create_descriptor_set_layout(VkDevice* device, VkDescriptorSetLayout* descriptorSetLayout)
 {
-    
-    VkDescriptorSetLayoutBinding uboLayoutBinding{};
-    uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorCount = 1;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    uboLayoutBinding.pImmutableSamplers = nullptr;
-    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-    VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-    samplerLayoutBinding.binding = 1;
-    samplerLayoutBinding.descriptorCount = 1;
-    samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    samplerLayoutBinding.pImmutableSamplers = nullptr;
-    samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-    VkDescriptorSetLayoutBinding normalSamplerLayoutBinding{};
-    normalSamplerLayoutBinding.binding = 2;
-    normalSamplerLayoutBinding.descriptorCount = 1;
-    normalSamplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    normalSamplerLayoutBinding.pImmutableSamplers = nullptr;
-    normalSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    // One layout for every pipeline, so the set stays bound across pipeline changes
+    VkDescriptorSetLayoutBinding objectLayoutBinding{};
+    objectLayoutBinding.binding = BINDING_OBJECTS;
+    objectLayoutBinding.descriptorCount = 1;
+    objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    objectLayoutBinding.pImmutableSamplers = nullptr;
+    objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutBinding textureLayoutBinding{};
+    textureLayoutBinding.binding = BINDING_TEXTURES;
+    textureLayoutBinding.descriptorCount = BINDLESS_MAX_TEXTURES;
+    textureLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    textureLayoutBinding.pImmutableSamplers = nullptr;
+    textureLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutBinding materialLayoutBinding{};
+    materialLayoutBinding.binding = BINDING_MATERIALS;
+    materialLayoutBinding.descriptorCount = 1;
+    materialLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    materialLayoutBinding.pImmutableSamplers = nullptr;
+    materialLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
     VkDescriptorSetLayoutBinding lightLayoutBinding{};
-    lightLayoutBinding.binding = 3;
+    lightLayoutBinding.binding = BINDING_LIGHTS;
     lightLayoutBinding.descriptorCount = 1;
     lightLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     lightLayoutBinding.pImmutableSamplers = nullptr;
     lightLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
     VkDescriptorSetLayoutBinding shadowSamplerLayoutBinding{};
-    shadowSamplerLayoutBinding.binding = 4;
+    shadowSamplerLayoutBinding.binding = BINDING_SHADOW_MAP;
     shadowSamplerLayoutBinding.descriptorCount = 1;
     shadowSamplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     shadowSamplerLayoutBinding.pImmutableSamplers = nullptr;
     shadowSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-    std::array<VkDescriptorSetLayoutBinding, 5> bindings = { uboLayoutBinding, samplerLayoutBinding, normalSamplerLayoutBinding, lightLayoutBinding, shadowSamplerLayoutBinding };
+    VkDescriptorSetLayoutBinding frameLayoutBinding{};
+    frameLayoutBinding.binding = BINDING_FRAME;
+    frameLayoutBinding.descriptorCount = 1;
+    frameLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    frameLayoutBinding.pImmutableSamplers = nullptr;
+    frameLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutBinding virtualTextureLayoutBinding{};
+    virtualTextureLayoutBinding.binding = BINDING_VIRTUAL_TEXTURES;
+    virtualTextureLayoutBinding.descriptorCount = 1;
+    virtualTextureLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    virtualTextureLayoutBinding.pImmutableSamplers = nullptr;
+    virtualTextureLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutBinding feedbackLayoutBinding{};
+    feedbackLayoutBinding.binding = BINDING_VT_FEEDBACK;
+    feedbackLayoutBinding.descriptorCount = 1;
+    feedbackLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    feedbackLayoutBinding.pImmutableSamplers = nullptr;
+    feedbackLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    std::array<VkDescriptorSetLayoutBinding, 8> bindings = { objectLayoutBinding, textureLayoutBinding, materialLayoutBinding, lightLayoutBinding, shadowSamplerLayoutBinding, frameLayoutBinding,
+        virtualTextureLayoutBinding, feedbackLayoutBinding };
+
+    // textures come and go while frames that do not sample them are pending
+    std::array<VkDescriptorBindingFlags, 8> bindingFlags{};
+    bindingFlags[BINDING_TEXTURES] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+    bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
     layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
     layoutInfo.pBindings = bindings.data();
 
-    if (vkCreateDescriptorSetLayout(*device, &layoutInfo, nullptr, &cModel->descriptorSetLayout) != VK_SUCCESS)
+    if (vkCreateDescriptorSetLayout(*device, &layoutInfo, nullptr, descriptorSetLayout) != VK_SUCCESS)
         throw std::runtime_error("ERROR: failed to create descriptor set layout!");
 }
 
 
-void create_descriptor_pool(VkDevice* device, Model* cModel)
+void create_bindless_set(VkDevice* device, VkPhysicalDevice* physicalDevice, VkDescriptorSetLayout descriptorSetLayout, it_ImageResource* shadowRes,
+    const std::vector<VkBuffer>& lightBuffers, it_BindlessSet* bindless)
 {
-    std::array<VkDescriptorPoolSize, 2> poolSizes{};
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+    bindless->device = *device;
+
+    std::array<VkDescriptorPoolSize, 3> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 4;
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 2;
+    poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * (BINDLESS_MAX_TEXTURES + 1);
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 2;
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
     poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
     poolInfo.pPoolSizes = poolSizes.data();
-    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 2;
+    poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
 
-    if (vkCreateDescriptorPool(*device, &poolInfo, nullptr, &cModel->descriptorPool) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create descriptor pool!");
+    if (vkCreateDescriptorPool(*device, &poolInfo, nullptr, &bindless->pool) != VK_SUCCESS) {
+        throw std::runtime_error("ERROR: failed to create descriptor pool!");
     }
-}
-
 
-void create_descriptor_sets(VkDevice* device, Model* cModel,it_ImageResource* shadowRes, std::vector<VkBuffer> lightBuffers)
-{
-    std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, cModel->descriptorSetLayout);
+    std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = cModel->descriptorPool;
+    allocInfo.descriptorPool = bindless->pool;
     allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
     allocInfo.pSetLayouts = layouts.data();
 
-    cModel->descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-    if (vkAllocateDescriptorSets(*device, &allocInfo, cModel->descriptorSets.data()) != VK_SUCCESS) {
+    bindless->sets.resize(MAX_FRAMES_IN_FLIGHT);
+    if (vkAllocateDescriptorSets(*device, &allocInfo, bindless->sets.data()) != VK_SUCCESS) {
         throw std::runtime_error("ERROR: failed to allocate descriptor sets!");
     }
 
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(*physicalDevice, &properties);
+    const VkDeviceSize uniformAlignment = properties.limits.minUniformBufferOffsetAlignment;
+    const VkDeviceSize storageAlignment = properties.limits.minStorageBufferOffsetAlignment;
+    const VkDeviceSize regionAlignment = std::max(uniformAlignment, storageAlignment);
+
+    const VkDeviceSize frameBytes = sizeof(FrameUniformBufferObject);
+    const VkDeviceSize objectBytes = sizeof(ObjectData) * BINDLESS_MAX_OBJECTS;
+    const VkDeviceSize materialBytes = sizeof(Material) * BINDLESS_MAX_OBJECTS;
+    bindless->objectOffset = align_up(frameBytes, storageAlignment);
+    bindless->materialOffset = align_up(bindless->objectOffset + objectBytes, storageAlignment);
+    bindless->frameStride = align_up(bindless->materialOffset + materialBytes, regionAlignment);
+
+    create_buffer(device, bindless->frameStride * MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, bindless->ring, bindless->ringMemory);
+
+    bindless->materials.assign(BINDLESS_MAX_OBJECTS, Material{});
+    bindless->staleMaterials.assign(BINDLESS_MAX_OBJECTS, 0);
+
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = cModel->uniformBuffers[i];
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(UniformBufferObject);
+        const VkDeviceSize region = bindless->frameStride * i;
 
-        VkDescriptorImageInfo imageInfo{};
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = cModel->textureImageView;
-        imageInfo.sampler = cModel->textureSampler;
+        VkDescriptorBufferInfo frameInfo{};
+        frameInfo.buffer = bindless->ring;
+        frameInfo.offset = region;
+        frameInfo.range = frameBytes;
 
-        VkDescriptorImageInfo normalInfo{};
-        normalInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        normalInfo.imageView = cModel->normalImageView;
-        normalInfo.sampler = cModel->normalSampler;
+        VkDescriptorBufferInfo objectInfo{};
+        objectInfo.buffer = bindless->ring;
+        objectInfo.offset = region + bindless->objectOffset;
+        objectInfo.range = objectBytes;
+
+        VkDescriptorBufferInfo materialInfo{};
+        materialInfo.buffer = bindless->ring;
+        materialInfo.offset = region + bindless->materialOffset;
+        materialInfo.range = materialBytes;
 
         VkDescriptorBufferInfo lightBufferInfo{};
-        lightBufferInfo.buffer = (lightBuffers)[i];
+        lightBufferInfo.buffer = lightBuffers[i];
         lightBufferInfo.offset = 0;
         lightBufferInfo.range = sizeof(LightsUniformBufferObject);
 
@@ -164,62 +200,191 @@ void create_descriptor_sets(VkDevice* device, Model* cModel,it_ImageResource* sh
         std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
 
         descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = cModel->descriptorSets[i];
-        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].dstSet = bindless->sets[i];
+        descriptorWrites[0].dstBinding = BINDING_OBJECTS;
         descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
         descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pBufferInfo = &bufferInfo;
+        descriptorWrites[0].pBufferInfo = &objectInfo;
 
         descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[1].dstSet = cModel->descriptorSets[i];
-        descriptorWrites[1].dstBinding = 1;
+        descriptorWrites[1].dstSet = bindless->sets[i];
+        descriptorWrites[1].dstBinding = BINDING_MATERIALS;
         descriptorWrites[1].dstArrayElement = 0;
-        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
         descriptorWrites[1].descriptorCount = 1;
-        descriptorWrites[1].pImageInfo = &imageInfo;
+        descriptorWrites[1].pBufferInfo = &materialInfo;
 
         descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[2].dstSet = cModel->descriptorSets[i];
-        descriptorWrites[2].dstBinding = 2;
+        descriptorWrites[2].dstSet = bindless->sets[i];
+        descriptorWrites[2].dstBinding = BINDING_LIGHTS;
         descriptorWrites[2].dstArrayElement = 0;
-        descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
         descriptorWrites[2].descriptorCount = 1;
-        descriptorWrites[2].pImageInfo = &normalInfo;
+        descriptorWrites[2].pBufferInfo = &lightBufferInfo;
 
         descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[3].dstSet = cModel->descriptorSets[i];
-        descriptorWrites[3].dstBinding = 3;
+        descriptorWrites[3].dstSet = bindless->sets[i];
+        descriptorWrites[3].dstBinding = BINDING_SHADOW_MAP;
         descriptorWrites[3].dstArrayElement = 0;
-        descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
         descriptorWrites[3].descriptorCount = 1;
-        descriptorWrites[3].pBufferInfo = &lightBufferInfo;
+        descriptorWrites[3].pImageInfo = &shadowInfo;
 
         descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[4].dstSet = cModel->descriptorSets[i];
-        descriptorWrites[4].dstBinding = 4;
+        descriptorWrites[4].dstSet = bindless->sets[i];
+        descriptorWrites[4].dstBinding = BINDING_FRAME;
         descriptorWrites[4].dstArrayElement = 0;
-        descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
         descriptorWrites[4].descriptorCount = 1;
-        descriptorWrites[4].pImageInfo = &shadowInfo;
+        descriptorWrites[4].pBufferInfo = &frameInfo;
         vkUpdateDescriptorSets(*device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
     }
+
+    // handed out from 0 up
+    bindless->freeObjects.clear();
+    for (uint32_t i = BINDLESS_MAX_OBJECTS; i-- > 0;)
+        bindless->freeObjects.push_back(i);
+    bindless->freeTextures.clear();
+    for (uint32_t i = BINDLESS_MAX_TEXTURES; i-- > 0;)
+        bindless->freeTextures.push_back(i);
 }
 
-void update_descriptor_set(VkDevice device, VkDescriptorSet descriptorSet, VkImageView imageView, VkSampler sampler, VkImageLayout layout, uint32_t binding) {
-    VkDescriptorImageInfo imageInfo = {};
-    imageInfo.imageLayout = layout;
-    imageInfo.imageView = imageView;
+void destroy_bindless_set(it_BindlessSet* bindless)
+{
+    vkDestroyBuffer(bindless->device, bindless->ring, nullptr);
+    free_device_memory(&bindless->ringMemory);
+    bindless->ring = VK_NULL_HANDLE;
+    bindless->materials.clear();
+    bindless->staleMaterials.clear();
+    // frees the sets
+    vkDestroyDescriptorPool(bindless->device, bindless->pool, nullptr);
+    bindless->pool = VK_NULL_HANDLE;
+    bindless->sets.clear();
+}
+
+
+uint32_t bindless_add_object(it_BindlessSet* bindless)
+{
+    std::lock_guard<std::mutex> lock(bindless->mutex);
+    if (bindless->freeObjects.empty())
+        throw std::runtime_error("ERROR: more than " + std::to_string(BINDLESS_MAX_OBJECTS) + " objects!");
+    uint32_t index = bindless->freeObjects.back();
+    bindless->freeObjects.pop_back();
+    // whatever an earlier object left in the slot is written over on the first update
+    bindless->staleMaterials[index] = (1u << MAX_FRAMES_IN_FLIGHT) - 1;
+    return index;
+}
+
+void bindless_remove_object(it_BindlessSet* bindless, uint32_t index)
+{
+    if (index == BINDLESS_INVALID)
+        return;
+    std::lock_guard<std::mutex> lock(bindless->mutex);
+    bindless->freeObjects.push_back(index);
+}
+
+uint32_t bindless_add_texture(it_BindlessSet* bindless, VkImageView view, VkSampler sampler)
+{
+    std::lock_guard<std::mutex> lock(bindless->mutex);
+    if (bindless->freeTextures.empty())
+        throw std::runtime_error("ERROR: more than " + std::to_string(BINDLESS_MAX_TEXTURES) + " textures!");
+    uint32_t index = bindless->freeTextures.back();
+    bindless->freeTextures.pop_back();
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = view;
     imageInfo.sampler = sampler;
 
-    VkWriteDescriptorSet descriptorWrite = {};
-    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrite.dstSet = descriptorSet;
-    descriptorWrite.dstBinding = binding;
-    descriptorWrite.dstArrayElement = 0;
-    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    descriptorWrite.descriptorCount = 1;
-    descriptorWrite.pImageInfo = &imageInfo;
+    std::vector<VkWriteDescriptorSet> descriptorWrites(bindless->sets.size());
+    for (size_t i = 0; i < bindless->sets.size(); i++) {
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].dstSet = bindless->sets[i];
+        descriptorWrites[i].dstBinding = BINDING_TEXTURES;
+        descriptorWrites[i].dstArrayElement = index;
+        descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].pImageInfo = &imageInfo;
+    }
+    vkUpdateDescriptorSets(bindless->device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    return index;
+}
+
+void bindless_remove_texture(it_BindlessSet* bindless, uint32_t index)
+{
+    if (index == BINDLESS_INVALID)
+        return;
+    // the element keeps pointing at the destroyed view until it is reused, partially bound allows that as long as
+    // nothing samples it
+    std::lock_guard<std::mutex> lock(bindless->mutex);
+    bindless->freeTextures.push_back(index);
+}
+
+FrameUniformBufferObject* bindless_frame(it_BindlessSet* bindless, uint32_t frame)
+{
+    uint8_t* region = static_cast<uint8_t*>(bindless->ringMemory.mapped) + bindless->frameStride * frame;
+    return reinterpret_cast<FrameUniformBufferObject*>(region);
+}
+
+ObjectData* bindless_object(it_BindlessSet* bindless, uint32_t frame, uint32_t index)
+{
+    uint8_t* region = static_cast<uint8_t*>(bindless->ringMemory.mapped) + bindless->frameStride * frame;
+    return reinterpret_cast<ObjectData*>(region + bindless->objectOffset) + index;
+}
+
+size_t bindless_write_material(it_BindlessSet* bindless, uint32_t frame, uint32_t index, const Material& material)
+{
+    // compared with the CPU copy, never read back from the mapping
+    if (!(bindless->materials[index] == material)) {
+        bindless->materials[index] = material;
+        bindless->staleMaterials[index] = (1u << MAX_FRAMES_IN_FLIGHT) - 1;
+    }
+    if (!(bindless->staleMaterials[index] & (1u << frame)))
+        return 0;
+    bindless->staleMaterials[index] &= ~(1u << frame);
+
+    uint8_t* region = static_cast<uint8_t*>(bindless->ringMemory.mapped) + bindless->frameStride * frame;
+    memcpy(reinterpret_cast<Material*>(region + bindless->materialOffset) + index, &material, sizeof(Material));
+    return sizeof(Material);
+}
+
+void bindless_set_virtual_textures(it_BindlessSet* bindless, VkBuffer tables, VkDeviceSize tableStride, VkDeviceSize tableBytes, VkBuffer feedback,
+    VkDeviceSize feedbackStride, VkDeviceSize feedbackBytes)
+{
+    for (size_t i = 0; i < bindless->sets.size(); i++) {
+        VkDescriptorBufferInfo tableInfo{};
+        tableInfo.buffer = tables;
+        tableInfo.offset = tableStride * i;
+        tableInfo.range = tableBytes;
+
+        VkDescriptorBufferInfo feedbackInfo{};
+        feedbackInfo.buffer = feedback;
+        feedbackInfo.offset = feedbackStride * i;
+        feedbackInfo.range = feedbackBytes;
+
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
 
-    vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = bindless->sets[i];
+        descriptorWrites[0].dstBinding = BINDING_VIRTUAL_TEXTURES;
+        descriptorWrites[0].dstArrayElement = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pBufferInfo = &tableInfo;
+
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = bindless->sets[i];
+        descriptorWrites[1].dstBinding = BINDING_VT_FEEDBACK;
+        descriptorWrites[1].dstArrayElement = 0;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pBufferInfo = &feedbackInfo;
+        vkUpdateDescriptorSets(bindless->device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+}
+
+void bind_bindless_set(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const it_BindlessSet* bindless, uint32_t frame)
+{
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &bindless->sets[frame], 0, nullptr);
 }
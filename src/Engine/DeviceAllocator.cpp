@@ -0,0 +1,407 @@
+#include "DeviceAllocator.h"
+#include "RangeAllocator.h"
+#include "Image.h"
+
+#include <vector>
+#include <mutex>
+#include <stdexcept>
+#include <algorithm>
+#include <string>
+
+#include <tinylogger.h>
+
+
+struct it_MemoryBlock
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;   // VK_NULL_HANDLE once released, the slot is reused by the next block
+    uint8_t* mapped = nullptr;
+    it_RangeAllocator ranges;
+};
+
+// One pool per memory type and resource kind. Buffers and images never share a block, so linear and optimally tiled
+// resources cannot end up on the same bufferImageGranularity page.
+struct it_MemoryPool
+{
+    uint32_t memoryTypeIndex = 0;
+    bool images = false;
+    std::vector<it_MemoryBlock> blocks;
+};
+
+struct it_DeviceAllocator
+{
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memoryProperties{};
+    VkDeviceSize bufferImageGranularity = 1;
+
+    std::vector<it_MemoryPool> pools;         // indexed by memoryTypeIndex * 2 + images
+    uint32_t dedicatedCount = 0;
+    VkDeviceSize dedicatedBytes = 0;
+    std::mutex mutex;
+};
+
+static it_DeviceAllocator s_allocator;
+
+
+static uint32_t pool_index(uint32_t memoryTypeIndex, bool images)
+{
+    return memoryTypeIndex * 2 + (images ? 1 : 0);
+}
+
+static bool host_visible(uint32_t memoryTypeIndex)
+{
+    return (s_allocator.memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
+static VkDeviceSize block_size(uint32_t memoryTypeIndex)
+{
+    uint32_t heap = s_allocator.memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    return std::min<VkDeviceSize>(DEVICE_MEMORY_BLOCK_SIZE, s_allocator.memoryProperties.memoryHeaps[heap].size / 8);
+}
+
+static VkDeviceMemory allocate_vk_memory(VkDeviceSize size, uint32_t memoryTypeIndex, const void* next, void** mapped)
+{
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.pNext = next;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(s_allocator.device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+        return VK_NULL_HANDLE;
+
+    *mapped = nullptr;
+    if (host_visible(memoryTypeIndex))
+        vkMapMemory(s_allocator.device, memory, 0, VK_WHOLE_SIZE, 0, mapped);
+    return memory;
+}
+
+static void release_block(it_MemoryBlock* block)
+{
+    // vkFreeMemory implicitly unmaps
+    vkFreeMemory(s_allocator.device, block->memory, nullptr);
+    block->memory = VK_NULL_HANDLE;
+    block->mapped = nullptr;
+    range_allocator_init(&block->ranges, 0);
+}
+
+static uint32_t live_blocks(const it_MemoryPool& pool)
+{
+    uint32_t count = 0;
+    for (const auto& block : pool.blocks)
+        count += block.memory != VK_NULL_HANDLE;
+    return count;
+}
+
+// Tries the existing blocks best fit first, then creates a block. Called with the mutex held.
+static bool suballocate(uint32_t poolIndex, VkDeviceSize size, VkDeviceSize alignment, it_Allocation* allocation)
+{
+    it_MemoryPool& pool = s_allocator.pools[poolIndex];
+
+    uint32_t best = UINT32_MAX;
+    uint64_t bestFree = UINT64_MAX;
+    for (uint32_t i = 0; i < pool.blocks.size(); ++i)
+    {
+        const it_MemoryBlock& block = pool.blocks[i];
+        uint64_t largest = range_largest_free(&block.ranges);
+        if (block.memory != VK_NULL_HANDLE && largest >= size && largest < bestFree)
+        {
+            best = i;
+            bestFree = largest;
+        }
+    }
+
+    uint64_t offset;
+    if (best == UINT32_MAX || !range_alloc_aligned(&pool.blocks[best].ranges, size, alignment, &offset))
+    {
+        // the alignment padding can make the tightest block miss, any other block with room is fine
+        best = UINT32_MAX;
+        for (uint32_t i = 0; i < pool.blocks.size() && best == UINT32_MAX; ++i)
+        {
+            if (pool.blocks[i].memory != VK_NULL_HANDLE && range_alloc_aligned(&pool.blocks[i].ranges, size, alignment, &offset))
+                best = i;
+        }
+    }
+
+    if (best == UINT32_MAX)
+    {
+        // halve the block on failure, down to what this allocation needs
+        VkDeviceSize newSize = std::max(block_size(pool.memoryTypeIndex), size);
+        void* mapped = nullptr;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        while (memory == VK_NULL_HANDLE)
+        {
+            memory = allocate_vk_memory(newSize, pool.memoryTypeIndex, nullptr, &mapped);
+            if (memory == VK_NULL_HANDLE)
+            {
+                if (newSize == size)
+                    return false;
+                newSize = std::max(newSize / 2, size);
+            }
+        }
+
+        auto slot = std::find_if(pool.blocks.begin(), pool.blocks.end(), [](const it_MemoryBlock& block) { return block.memory == VK_NULL_HANDLE; });
+        if (slot == pool.blocks.end())
+            slot = pool.blocks.insert(pool.blocks.end(), it_MemoryBlock{});
+        slot->memory = memory;
+        slot->mapped = static_cast<uint8_t*>(mapped);
+        range_allocator_init(&slot->ranges, newSize);
+        best = static_cast<uint32_t>(slot - pool.blocks.begin());
+        range_alloc_aligned(&slot->ranges, size, alignment, &offset);
+    }
+
+    const it_MemoryBlock& block = pool.blocks[best];
+    allocation->memory = block.memory;
+    allocation->offset = offset;
+    allocation->size = size;
+    allocation->alignment = alignment;
+    allocation->mapped = block.mapped ? block.mapped + offset : nullptr;
+    allocation->pool = poolIndex;
+    allocation->block = best;
+    return true;
+}
+
+static void free_range(const it_Allocation* allocation)
+{
+    it_MemoryPool& pool = s_allocator.pools[allocation->pool];
+    it_MemoryBlock& block = pool.blocks[allocation->block];
+    range_free(&block.ranges, allocation->offset, allocation->size);
+
+    // keep one empty block per pool around so alternating load and free does not hit vkAllocateMemory every time
+    if (block.ranges.allocationCount == 0 && live_blocks(pool) > 1)
+        release_block(&block);
+}
+
+static void allocate(VkMemoryRequirements requirements, bool dedicated, const VkMemoryDedicatedAllocateInfo* dedicatedInfo, bool images,
+    VkMemoryPropertyFlags properties, it_Allocation* allocation)
+{
+    uint32_t memoryTypeIndex = findMemoryType(s_allocator.physicalDevice, requirements.memoryTypeBits, properties);
+    *allocation = it_Allocation{};
+
+    if (dedicated || requirements.size >= DEVICE_MEMORY_DEDICATED_THRESHOLD)
+    {
+        void* mapped = nullptr;
+        VkDeviceMemory memory = allocate_vk_memory(requirements.size, memoryTypeIndex, dedicatedInfo, &mapped);
+        if (memory == VK_NULL_HANDLE)
+            throw std::runtime_error("ERROR: failed to allocate device memory!");
+
+        std::lock_guard<std::mutex> lock(s_allocator.mutex);
+        s_allocator.dedicatedCount++;
+        s_allocator.dedicatedBytes += requirements.size;
+        allocation->memory = memory;
+        allocation->size = requirements.size;
+        allocation->mapped = mapped;
+        allocation->pool = DEVICE_MEMORY_DEDICATED;
+        return;
+    }
+
+    VkDeviceSize alignment = requirements.alignment;
+    if (images)
+        alignment = std::max(alignment, s_allocator.bufferImageGranularity);
+
+    std::lock_guard<std::mutex> lock(s_allocator.mutex);
+    if (!suballocate(pool_index(memoryTypeIndex, images), requirements.size, alignment, allocation))
+        throw std::runtime_error("ERROR: failed to allocate device memory!");
+}
+
+
+void init_device_allocator(VkDevice device, VkPhysicalDevice physicalDevice)
+{
+    s_allocator.device = device;
+    s_allocator.physicalDevice = physicalDevice;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &s_allocator.memoryProperties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    s_allocator.bufferImageGranularity = properties.limits.bufferImageGranularity;
+
+    s_allocator.pools.assign(s_allocator.memoryProperties.memoryTypeCount * 2, it_MemoryPool{});
+    for (uint32_t i = 0; i < s_allocator.pools.size(); ++i)
+    {
+        s_allocator.pools[i].memoryTypeIndex = i / 2;
+        s_allocator.pools[i].images = (i & 1) != 0;
+    }
+    s_allocator.dedicatedCount = 0;
+    s_allocator.dedicatedBytes = 0;
+}
+
+void destroy_device_allocator()
+{
+    std::lock_guard<std::mutex> lock(s_allocator.mutex);
+    for (auto& pool : s_allocator.pools)
+    {
+        for (auto& block : pool.blocks)
+        {
+            if (block.memory == VK_NULL_HANDLE)
+                continue;
+#ifndef ENGINE_DISABLE_LOGGING
+            if (block.ranges.allocationCount)
+                tlog::warning("Device memory: " + std::to_string(block.ranges.allocationCount) + " allocation(s) still live in a block of memory type "
+                    + std::to_string(pool.memoryTypeIndex));
+#endif
+            release_block(&block);
+        }
+    }
+    s_allocator.pools.clear();
+#ifndef ENGINE_DISABLE_LOGGING
+    if (s_allocator.dedicatedCount)
+        tlog::warning("Device memory: " + std::to_string(s_allocator.dedicatedCount) + " dedicated allocation(s) leaked");
+#endif
+}
+
+void allocate_buffer_memory(VkBuffer buffer, VkMemoryPropertyFlags properties, it_Allocation* allocation)
+{
+    VkBufferMemoryRequirementsInfo2 info{};
+    info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+    info.buffer = buffer;
+
+    VkMemoryDedicatedRequirements dedicated{};
+    dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+    VkMemoryRequirements2 requirements{};
+    requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    requirements.pNext = &dedicated;
+    vkGetBufferMemoryRequirements2(s_allocator.device, &info, &requirements);
+
+    VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+    dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicatedInfo.buffer = buffer;
+
+    allocate(requirements.memoryRequirements, dedicated.prefersDedicatedAllocation || dedicated.requiresDedicatedAllocation, &dedicatedInfo, false, properties, allocation);
+    vkBindBufferMemory(s_allocator.device, buffer, allocation->memory, allocation->offset);
+}
+
+void allocate_image_memory(VkImage image, VkMemoryPropertyFlags properties, it_Allocation* allocation)
+{
+    VkImageMemoryRequirementsInfo2 info{};
+    info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+    info.image = image;
+
+    VkMemoryDedicatedRequirements dedicated{};
+    dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+    VkMemoryRequirements2 requirements{};
+    requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    requirements.pNext = &dedicated;
+    vkGetImageMemoryRequirements2(s_allocator.device, &info, &requirements);
+
+    // render targets usually come back with prefersDedicatedAllocation, sampled textures end up in the image blocks
+    VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+    dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicatedInfo.image = image;
+
+    allocate(requirements.memoryRequirements, dedicated.prefersDedicatedAllocation || dedicated.requiresDedicatedAllocation, &dedicatedInfo, true, properties, allocation);
+    vkBindImageMemory(s_allocator.device, image, allocation->memory, allocation->offset);
+}
+
+void free_device_memory(it_Allocation* allocation)
+{
+    if (allocation->memory == VK_NULL_HANDLE)
+        return;
+
+    if (allocation->pool == DEVICE_MEMORY_DEDICATED)
+    {
+        vkFreeMemory(s_allocator.device, allocation->memory, nullptr);
+        std::lock_guard<std::mutex> lock(s_allocator.mutex);
+        s_allocator.dedicatedCount--;
+        s_allocator.dedicatedBytes -= allocation->size;
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(s_allocator.mutex);
+        free_range(allocation);
+    }
+    *allocation = it_Allocation{};
+}
+
+uint32_t defragment_device_memory(it_Allocation** allocations, uint32_t count, uint32_t maxMoves, it_DefragmentMove move, void* userData)
+{
+    std::lock_guard<std::mutex> lock(s_allocator.mutex);
+
+    uint32_t moves = 0;
+    for (uint32_t p = 0; p < s_allocator.pools.size() && moves < maxMoves; ++p)
+    {
+        it_MemoryPool& pool = s_allocator.pools[p];
+        if (live_blocks(pool) < 2)
+            continue;
+
+        // the emptiest block is the cheapest to drain
+        uint32_t source = UINT32_MAX;
+        for (uint32_t b = 0; b < pool.blocks.size(); ++b)
+        {
+            const it_MemoryBlock& block = pool.blocks[b];
+            if (block.memory != VK_NULL_HANDLE && block.ranges.allocationCount
+                && (source == UINT32_MAX || block.ranges.used < pool.blocks[source].ranges.used))
+                source = b;
+        }
+        if (source == UINT32_MAX)
+            continue;
+
+        for (uint32_t i = 0; i < count && moves < maxMoves; ++i)
+        {
+            it_Allocation* allocation = allocations[i];
+            if (allocation->pool != p || allocation->block != source)
+                continue;
+
+            // only into blocks that already exist, fullest first, never grow the pool to defragment it
+            std::vector<uint32_t> targets;
+            for (uint32_t b = 0; b < pool.blocks.size(); ++b)
+            {
+                if (b != source && pool.blocks[b].memory != VK_NULL_HANDLE)
+                    targets.push_back(b);
+            }
+            std::sort(targets.begin(), targets.end(), [&](uint32_t a, uint32_t b) { return pool.blocks[a].ranges.used > pool.blocks[b].ranges.used; });
+
+            for (uint32_t b : targets)
+            {
+                it_MemoryBlock& block = pool.blocks[b];
+                uint64_t offset;
+                if (!range_alloc_aligned(&block.ranges, allocation->size, allocation->alignment, &offset))
+                    continue;
+
+                it_Allocation target = *allocation;
+                target.memory = block.memory;
+                target.offset = offset;
+                target.mapped = block.mapped ? block.mapped + offset : nullptr;
+                target.block = b;
+                if (move(userData, i, allocation, &target))
+                {
+                    free_range(allocation);
+                    *allocation = target;
+                    moves++;
+                }
+                else
+                {
+                    range_free(&block.ranges, offset, allocation->size);
+                }
+                break;
+            }
+        }
+    }
+    return moves;
+}
+
+it_MemoryStats device_memory_stats()
+{
+    std::lock_guard<std::mutex> lock(s_allocator.mutex);
+
+    it_MemoryStats stats;
+    for (const auto& pool : s_allocator.pools)
+    {
+        for (const auto& block : pool.blocks)
+        {
+            if (block.memory == VK_NULL_HANDLE)
+                continue;
+            stats.blockCount++;
+            stats.allocationCount += block.ranges.allocationCount;
+            stats.blockBytes += block.ranges.capacity;
+            stats.usedBytes += block.ranges.used;
+            stats.largestFree = std::max<VkDeviceSize>(stats.largestFree, range_largest_free(&block.ranges));
+            stats.fragmentation = std::max(stats.fragmentation, range_fragmentation(&block.ranges));
+        }
+    }
+    stats.dedicatedCount = s_allocator.dedicatedCount;
+    stats.dedicatedBytes = s_allocator.dedicatedBytes;
+    stats.allocationCount += s_allocator.dedicatedCount;
+    stats.vkAllocationCount = stats.blockCount + stats.dedicatedCount;
+    return stats;
+}
@@ -98,30 +98,16 @@ void Engine::initWindow()
 
 }
 
-void thread_function(VkDevice* device, VkPhysicalDevice* physicalDevice, VkSurfaceKHR* surface, VkQueue graphicsQueue, std::vector<Model*>* models, it_ImageResource* depthRes ,std::vector<VkBuffer>& lightBuffers, std::mutex& queueMutex) {
-
-
-    // Create a command pool for this thread
-    VkCommandPool commandPool;
-    
-    create_command_pool(device, physicalDevice, &commandPool, surface);
-
-    for (Model* model : *models) {
-
-        mt_init_model_resources(device, physicalDevice, commandPool, graphicsQueue, model, depthRes, &lightBuffers, queueMutex);
-    }
-
-    vkDestroyCommandPool(*device, commandPool, nullptr);
-}
-
-
-
 void Engine::initVulkan()
 {
+    // scene loads, uploads and per frame culling all run on it
+    job_system_init();
+
     create_instance(&instance);
     create_surface(&surface, &instance, window);
     pick_physical_device(&physicalDevice, &instance, &surface, &msaaSamples, &RendererName);
-    create_logical_device(&device, &physicalDevice, &surface, &graphicsQueue, &presentQueue);
+    create_logical_device(&device, &physicalDevice, &surface, &graphicsQueue, &presentQueue, &uploadQueue);
+    init_device_allocator(device, physicalDevice);
     create_swapchain(&device, &physicalDevice, &swapChainHandle, &surface, window, VSync);
     create_imageviews(&device, &swapChainHandle.imageViews, &swapChainHandle.images, swapChainHandle.imageFormat);
     create_render_pass(&device, &physicalDevice, &renderPass, swapChainHandle.imageFormat, msaaSamples);
@@ -130,21 +116,27 @@ void Engine::initVulkan()
     
 
     create_command_pool(&device, &physicalDevice, &commandPool, &surface);
+    uploadQueueFamily = findQueueFamilies(physicalDevice, surface).graphicsFamily.value();
+    create_upload_context(&device, &physicalDevice, uploadQueueFamily, uploadQueue, &uploadQueueMutex, &uploadContext);
+    create_upload_context(&device, &physicalDevice, uploadQueueFamily, uploadQueue, &uploadQueueMutex, &streamUploadContext);
+    create_geometry_heap(&device, &geometryHeap);
     
-    create_color_resources(&device, &physicalDevice, &colorImageRes, swapChainHandle.imageFormat, swapChainHandle.extent, msaaSamples);
+    create_color_resources(&device, &colorImageRes, swapChainHandle.imageFormat, swapChainHandle.extent, msaaSamples);
     create_depth_resources(&device, &physicalDevice, &depthImageRes, swapChainHandle.imageFormat, swapChainHandle.extent, msaaSamples);
-    create_shadow_resources(&device, &physicalDevice, &shadowImageRes, swapChainHandle.imageFormat, swapChainHandle.extent, msaaSamples);
+    create_shadow_resources(&device, &shadowImageRes, swapChainHandle.imageFormat, swapChainHandle.extent, msaaSamples);
     create_framebuffers(&device, &swapChainHandle.framebuffers, swapChainHandle.imageViews, swapChainHandle.extent, renderPass, colorImageRes.imageView, depthImageRes.imageView);
     create_shadow_framebuffer(&device, &shadowFramebuffer, &shadowImageRes.imageView, &shadowRenderPass, swapChainHandle.extent);
     
-    create_light_uniform_buffer(&device, &physicalDevice, &lightRes);
+    create_light_uniform_buffer(&device, &lightRes);
+    create_bindless_set(&device, &physicalDevice, descriptorSetLayout, &shadowImageRes, lightRes.lightBuffers, &bindless);
+    init_texture_cache(device, physicalDevice, &bindless);
+    init_virtual_textures(device, physicalDevice, &bindless);
 
     if (firstScene)
         scene_path = "main.json";
     camera = new Camera(swapChainHandle.extent.width, swapChainHandle.extent.height);
-    //loadScene();
     //clock_t t = clock();
-    load_scene(scene_path, &scene, &sceneSize);
+    loadScene();
     
 
     load_file(scene_path, &shader_paths, &shader_indices, &scene, sceneSize, camera);
@@ -155,57 +147,189 @@ void Engine::initVulkan()
 
  
 
-    std::vector<std::thread> threads;
-    std::mutex queueMutex;
+#ifndef ENGINE_DISABLE_LOGGING
+    it_MemoryStats memoryStats = device_memory_stats();
+    tlog::info("Device memory: " + std::to_string(memoryStats.allocationCount) + " allocations in " + std::to_string(memoryStats.vkAllocationCount)
+        + " vkAllocateMemory objects (" + std::to_string(memoryStats.blockCount) + " blocks, " + std::to_string(memoryStats.dedicatedCount) + " dedicated)");
+#endif
 
-    auto start = std::chrono::high_resolution_clock::now();
+
+
+    createImGuiDP();
     
-    // Number of threads to use
-    unsigned int num_threads = std::thread::hardware_concurrency();
-    printf("\n%d\n", num_threads);
-    if (num_threads == 0) num_threads = 1; // Fallback in case hardware_concurrency() returns 0
+    mCurrentSelectedModel = nullptr;
 
-    // Split work among threads
-    std::vector<std::vector<Model*>> model_batches(num_threads);
-    for (size_t i = 0; i < sceneSize; ++i) {
-        model_batches[i % num_threads].push_back(scene[i]);
-    }
+    create_commandbuffer(&device, &commandBuffers, commandPool);
+    create_sync_objects(&device, &imageAvailableSemaphores, &renderFinishedSemaphores, &inFlightFences);
+    slotFrames.assign(MAX_FRAMES_IN_FLIGHT, 0);
+    lastFrameStart = std::chrono::high_resolution_clock::now();
 
-    for (unsigned int i = 0; i < num_threads; ++i) {
-        if (!model_batches[i].empty()) {
-            threads.emplace_back(thread_function, &device, &physicalDevice, &surface, graphicsQueue, &model_batches[i], &shadowImageRes, std::ref(lightRes.lightBuffers), std::ref(queueMutex));
-            //void thread_function(VkDevice * device, VkPhysicalDevice * physicalDevice, 
-            // VkSurfaceKHR * surface, VkQueue graphicsQueue, std::vector<Model*>*models, std::vector<VkBuffer>&lightBuffers)
-        }
-    }
+    audioMgr = new Audio();
+
+    //physicsEngine = new PhysicsEngine(); // Project on hold
+}
+
+// Loads scene_path through the scene loader pipeline and waits for it, for the first scene. Later loads stream in
+// with startSceneStream.
+void Engine::loadScene()
+{
+    it_SceneUploadTarget target;
+    target.uploadContext = &uploadContext;
+    target.geometryHeap = &geometryHeap;
+    target.bindless = &bindless;
+
+    it_UploadStats uploadsBefore = uploadContext.stats;
+    it_SceneLoadStats stats;
+    load_scene_pipelined(scene_path, vulkan_scene_uploader(&target), &scene, &stats);
+    sceneSize = scene.size();
+
+#ifndef ENGINE_DISABLE_LOGGING
+    tlog::info("Scene " + scene_path + ": " + std::to_string(stats.models) + " models in " + std::to_string(stats.totalSeconds * 1000.0) + " ms. json "
+        + std::to_string(stats.parseSeconds * 1000.0) + " ms, mesh " + std::to_string(stats.meshSeconds * 1000.0) + " ms and decode " + std::to_string(stats.decodeSeconds * 1000.0)
+        + " ms across " + std::to_string(job_thread_count()) + " job threads, upload " + std::to_string(stats.uploadSeconds * 1000.0) + " ms, waiting " + std::to_string(stats.waitSeconds * 1000.0)
+        + " ms. Peak decoded " + std::to_string(stats.peakDecodedBytes >> 20) + " of " + std::to_string(stats.decodedBytes >> 20) + " MB, "
+        + std::to_string(stats.skippedDecodes) + " decodes skipped");
+    const it_UploadStats& uploads = uploadContext.stats;
+    tlog::info("Uploads: " + std::to_string(uploads.uploads - uploadsBefore.uploads) + " (" + std::to_string((uploads.bytes - uploadsBefore.bytes) >> 20) + " MB) in "
+        + std::to_string(uploads.submits - uploadsBefore.submits) + " submits, " + std::to_string(uploads.overflows - uploadsBefore.overflows) + " over the staging ring, stall "
+        + std::to_string((uploads.stallSeconds - uploadsBefore.stallSeconds) * 1000.0) + " ms");
+    logTextureCache();
+#endif
+}
+
+void Engine::logTextureCache()
+{
+    it_TextureCacheStats textures = texture_cache_stats();
+    tlog::info("Textures: " + std::to_string(textures.textures) + " resident for " + std::to_string(textures.references) + " references, "
+        + std::to_string(textures.residentBytes >> 20) + " MB instead of " + std::to_string(textures.unsharedBytes >> 20) + " MB unshared ("
+        + std::to_string(textures.hits) + " hits, " + std::to_string(textures.misses) + " misses)");
+    it_VtSetStats virtualTextures = virtual_texture_stats();
+    if (virtualTextures.textures > 0)
+        tlog::info("Virtual textures: " + std::to_string(virtualTextures.textures) + " for " + std::to_string(virtualTextures.references) + " references, "
+            + std::to_string(virtualTextures.cacheBytes >> 20) + " MB of tile caches (" + std::to_string(virtualTextures.pages.loads) + " tiles loaded, "
+            + std::to_string(virtualTextures.pages.evictions) + " evicted)");
+}
 
-    // Join remaining threads
-    for (auto& th : threads) {
-        if (th.joinable()) {
-            th.join();
+void Engine::startSceneStream()
+{
+    it_SceneUploadTarget target;
+    target.uploadContext = &streamUploadContext;
+    target.geometryHeap = &geometryHeap;
+    target.bindless = &bindless;
+
+    sceneSwapped = false;
+    swapStats = it_SceneSwapStats();
+    swapStart = std::chrono::high_resolution_clock::now();
+    measuringSwap = true;
+
+    // the pipelines are ready before the first model, the swap only has to exchange handles
+    const std::string path = scene_path;
+    scene_stream_start(&sceneStream, path, target, [this, path]() {
+        load_file(path, &streamShaderPaths, &streamShaderIndices, nullptr, 0, nullptr);
+        createPipelines(streamShaderPaths, streamShaderIndices, &streamPipelineLayouts, &streamPipelines);
+    });
+}
+
+// Once per frame before anything is recorded
+void Engine::updateSceneStream()
+{
+    if (!sceneStream.running)
+        return;
+    // without workers the loader's jobs only run when this thread helps, one per frame
+    if (job_thread_count() == 1)
+        job_try_run();
+
+    std::vector<Model*> arrived;
+    bool finished = false;
+    try
+    {
+        finished = scene_stream_take(&sceneStream, &arrived);
+    }
+    catch (const std::exception& e)
+    {
+        tlog::error(std::string("Scene ") + scene_path + " failed to load: " + e.what());
+        finished = true;
+        if (!sceneSwapped)
+        {
+            // nothing of it was drawn, keep the old scene
+            for (Model* cModel : arrived)
+                cleanup_model(&geometryHeap, &bindless, cModel);
+            arrived.clear();
+            destroyPipelines(&streamPipelineLayouts, &streamPipelines);
+            measuringSwap = false;
+            return;
         }
     }
-    //for (size_t i = 0; i < sceneSize; ++i)
-    //{
-    //    init_model_resources(&device, &physicalDevice, commandPool, graphicsQueue, scene[i], &lightRes.lightBuffers);
-    //}
-    
-    auto end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double> duration = end - start;
-    std::cout << "Time taken for multithread: " << duration.count() << " seconds" << std::endl;
 
+    if (!sceneSwapped && (!arrived.empty() || finished))
+        swapScene(&arrived);
+    else
+        scene.insert(scene.end(), arrived.begin(), arrived.end());
 
+    if (!finished)
+        return;
+    sceneSize = scene.size();
+    swapStats.loadSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - swapStart).count();
+#ifndef ENGINE_DISABLE_LOGGING
+    const it_SceneLoadStats& stats = sceneStream.stats;
+    tlog::info("Scene " + scene_path + " streamed: " + std::to_string(stats.models) + " models in " + std::to_string(swapStats.loadSeconds * 1000.0) + " ms, mesh "
+        + std::to_string(stats.meshSeconds * 1000.0) + " ms and decode " + std::to_string(stats.decodeSeconds * 1000.0) + " ms, upload " + std::to_string(stats.uploadSeconds * 1000.0)
+        + " ms. Peak decoded " + std::to_string(stats.peakDecodedBytes >> 20) + " of " + std::to_string(stats.decodedBytes >> 20) + " MB, "
+        + std::to_string(stats.skippedDecodes) + " decodes skipped");
+    logTextureCache();
+#endif
+}
 
-    createImGuiDP();
-    
+void Engine::swapScene(std::vector<Model*>* arrived)
+{
+    // every frame so far drew the old scene, the one being recorded draws the new one
+    retiredScene.insert(retiredScene.end(), scene.begin(), scene.end());
+    retiredPipelines.insert(retiredPipelines.end(), graphicsPipelines.begin(), graphicsPipelines.end());
+    retiredPipelineLayouts.insert(retiredPipelineLayouts.end(), pipelineLayouts.begin(), pipelineLayouts.end());
+    retireFrame = frameNumber - 1;
+
+    scene.swap(*arrived);
+    arrived->clear();
+    graphicsPipelines.swap(streamPipelines);
+    pipelineLayouts.swap(streamPipelineLayouts);
+    streamPipelines.clear();
+    streamPipelineLayouts.clear();
+    load_file(scene_path, &shader_paths, &shader_indices, &scene, 0, camera);
     mCurrentSelectedModel = nullptr;
+    sceneSwapped = true;
+    swapStats.swapSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - swapStart).count();
+}
 
-    create_commandbuffer(&device, &commandBuffers, commandPool);
-    create_sync_objects(&device, &imageAvailableSemaphores, &renderFinishedSemaphores, &inFlightFences);
+void Engine::cancelSceneStream()
+{
+    if (!sceneStream.running)
+        return;
+    scene_stream_cancel(&sceneStream);
 
-    audioMgr = new Audio();
+    std::vector<Model*> arrived;
+    scene_stream_take(&sceneStream, &arrived);
+    if (sceneSwapped)
+    {
+        scene.insert(scene.end(), arrived.begin(), arrived.end());
+    }
+    else
+    {
+        for (Model* cModel : arrived)
+            cleanup_model(&geometryHeap, &bindless, cModel);
+        destroyPipelines(&streamPipelineLayouts, &streamPipelines);
+    }
+    sceneSize = scene.size();
+    measuringSwap = false;
+}
 
-    //physicsEngine = new PhysicsEngine(); // Project on hold
+void Engine::destroyRetiredScene(uint64_t completedFrame)
+{
+    if ((retiredScene.empty() && retiredPipelines.empty()) || completedFrame < retireFrame)
+        return;
+    for (Model* cModel : retiredScene)
+        cleanup_model(&geometryHeap, &bindless, cModel);
+    retiredScene.clear();
+    destroyPipelines(&retiredPipelineLayouts, &retiredPipelines);
 }
 
 
@@ -247,6 +371,7 @@ void Engine::mainLoop()
         drawFrame();
     }
     fmodThread.join();
+    cancelSceneStream();
     vkDeviceWaitIdle(device);
 }
 
@@ -261,6 +386,9 @@ void Engine::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIn
         throw std::runtime_error("failed to begin recording command buffer!");
     }
 
+    // outside any render pass, the tiles the page tables of this frame point at
+    record_virtual_texture_uploads(commandBuffer, currentFrame);
+
     VkClearValue clearValue = {};
     clearValue.depthStencil = { 1.0f, 0 };
     
@@ -275,11 +403,20 @@ void Engine::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIn
     shadowRenderPassInfo.clearValueCount = 1;
     shadowRenderPassInfo.pClearValues = &clearValue;
 
-    transition_image_layout(&device, commandPool, graphicsQueue, shadowImageRes.image, VK_FORMAT_D32_SFLOAT,
-        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
+    {
+        std::lock_guard<std::mutex> queueLock(uploadQueueMutex);
+        transition_image_layout(&device, commandPool, graphicsQueue, shadowImageRes.image, VK_FORMAT_D32_SFLOAT,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
+    }
+
+    frameStats = it_FrameStats();
 
     vkCmdBeginRenderPass(commandBuffer, &shadowRenderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
     vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowPipeline);
+    frameStats.binds++;
+    // every pipeline layout shares the set layout and push constant range, so this stays bound for both passes
+    bind_bindless_set(commandBuffer, shadowPipelineLayout, &bindless, currentFrame);
+    frameStats.binds++;
 
     // Bind vertex buffer, set viewport, scissor, etc.
     // Render scene from the light's perspective to create shadow map
@@ -297,25 +434,37 @@ void Engine::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIn
     scissor.extent = swapChainHandle.extent;
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    VkDeviceSize offsets[] = { 0 };
+    // pixels covered by one world unit at distance 1, used to turn LOD errors into screen space
+    const float pixelsPerUnit = std::abs(camera->proj[1][1]) * 0.5f * static_cast<float>(swapChainHandle.extent.height);
+    const glm::mat4 viewProj = camera->proj * camera->view;
+    // only touches the model itself, so models are spread over the job threads
+    parallel_for(scene.size(), [&](size_t i) {
+        if (scene[i]->UUID == "skybox") return;
+        select_model_lod(scene[i], camera->Position, pixelsPerUnit);
+#ifdef ENGINE_BUILD_MESHLETS
+        cull_model_meshlets(scene[i], viewProj, camera->Position);
+#endif
+    });
+
+    bindGeometryHeap(commandBuffer);
     for (size_t i = 0; i < scene.size(); ++i)
     {
         if (scene[i]->UUID == "skybox") continue;
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &scene[i]->vertexBuffer, offsets);
-
-        vkCmdBindIndexBuffer(commandBuffer, scene[i]->indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowPipelineLayout, 0, 1, &scene[i]->descriptorSets[currentFrame], 0, nullptr);
-
-        vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(scene[i]->indices.size()), 1, 0, 0, 0);
+        // the first instance picks the object's data
+        const it_MeshLod& lod = scene[i]->lods[scene[i]->currentLod];
+        vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, scene[i]->baseIndex + lod.firstIndex, static_cast<int32_t>(scene[i]->baseVertex), scene[i]->objectIndex);
+        frameStats.triangles += lod.indexCount / 3;
     }
     
 
     vkCmdEndRenderPass(commandBuffer);
 
 
-    transition_image_layout(&device, commandPool, graphicsQueue, shadowImageRes.image, VK_FORMAT_D32_SFLOAT,
-        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, 1);
+    {
+        std::lock_guard<std::mutex> queueLock(uploadQueueMutex);
+        transition_image_layout(&device, commandPool, graphicsQueue, shadowImageRes.image, VK_FORMAT_D32_SFLOAT,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, 1);
+    }
 
     
 
@@ -335,9 +484,7 @@ void Engine::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIn
     renderPassInfo.pClearValues = clearValues.data();
 
     vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelines[currentPipeline]);
+    bindGeometryHeap(commandBuffer);
     
 
     
@@ -352,12 +499,19 @@ void Engine::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIn
     
     for (size_t currentGPipeline = 0; currentGPipeline < graphicsPipelines.size(); currentGPipeline++)
     {
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelines[currentGPipeline]);
+        // buckets without models are skipped, the geometry stays bound across pipeline changes
+        bool bound = false;
         for (size_t current_model = 0; current_model < scene.size(); current_model++)
         {
             if (scene[current_model]->pipelineIndex == currentGPipeline)
             {
-                draw_model(scene[current_model], commandBuffer, pipelineLayouts[scene[current_model]->pipelineIndex], currentFrame);
+                if (!bound)
+                {
+                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelines[currentGPipeline]);
+                    frameStats.binds++;
+                    bound = true;
+                }
+                draw_model(scene[current_model], commandBuffer, pipelineLayouts[scene[current_model]->pipelineIndex], &frameStats);
             }
         }
     }
@@ -394,6 +548,7 @@ void Engine::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIn
     }
     
     vkCmdEndRenderPass(commandBuffer);
+    record_virtual_texture_feedback(commandBuffer);
     
     // End recording the command buffer
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
@@ -403,6 +558,15 @@ void Engine::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIn
 }
 
 
+void Engine::bindGeometryHeap(VkCommandBuffer commandBuffer)
+{
+    VkDeviceSize offsets[] = { 0 };
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &frameVertexBuffer, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, frameIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    frameStats.binds += 2;
+}
+
+
 void Engine::mouse_callback(GLFWwindow* window, int button, int action, int mods)
 {
     Engine* engine = retrieveEnginePtr(window); //This is so fucking retarded
@@ -572,14 +736,42 @@ void Engine::custom_mouse_button_callback_wrapper(GLFWwindow* window, int button
 void Engine::drawFrame()
 {
     vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    // the queue runs frames in order, so the one that last used this fence and everything before it is done
+    const uint64_t completedFrame = slotFrames[currentFrame];
+    frameNumber++;
+    // the feedback the fence just released, before anything this frame records
+    virtual_textures_begin_frame(currentFrame, frameNumber);
+
+    auto frameStart = std::chrono::high_resolution_clock::now();
+    if (measuringSwap)
+    {
+        double frameSeconds = std::chrono::duration<double>(frameStart - lastFrameStart).count();
+        swapStats.frames++;
+        swapStats.totalFrameSeconds += frameSeconds;
+        swapStats.worstFrameSeconds = std::max(swapStats.worstFrameSeconds, frameSeconds);
+    }
+    lastFrameStart = frameStart;
 
+    destroyRetiredScene(completedFrame);
     processState();
+    updateSceneStream();
+    if (measuringSwap && !sceneStream.running && retiredScene.empty() && retiredPipelines.empty())
+    {
+        measuringSwap = false;
+#ifndef ENGINE_DISABLE_LOGGING
+        tlog::info("Scene swap: new scene drawn after " + std::to_string(swapStats.swapSeconds * 1000.0) + " ms, " + std::to_string(swapStats.frames) + " frames meanwhile, worst "
+            + std::to_string(swapStats.worstFrameSeconds * 1000.0) + " ms, average " + std::to_string(swapStats.totalFrameSeconds * 1000.0 / std::max(1u, swapStats.frames)) + " ms");
+#endif
+    }
+    // after the stream handed over its models, so the buffers hold everything this frame draws
+    geometry_heap_begin_frame(device, &geometryHeap, frameNumber, completedFrame, &frameVertexBuffer, &frameIndexBuffer);
 
     uint32_t imageIndex;
     VkResult result = vkAcquireNextImageKHR(device, swapChainHandle.swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR)
     {
+        std::lock_guard<std::mutex> queueLock(uploadQueueMutex);
         recreate_swapchain(&device, &physicalDevice, &swapChainHandle, &colorImageRes, &depthImageRes, &surface, &renderPass,
             msaaSamples, window, camera, VSync);
         return;
@@ -593,16 +785,21 @@ void Engine::drawFrame()
     update_light_uniform_buffers(&lightRes, camera, currentFrame);
 
     
-    if (scene.size())
-    {
-        for (size_t i = 0; i < scene.size(); i++)
-        {
-            update_model_uniform_buffers(scene[i], camera, currentFrame);
-        }
-        
-    }
+    // frame constants once, then only the models whose TRS changed and their children rebuild their matrix
+    camera->UpdateMatrices();
+    update_model_hierarchy(scene, &modelHierarchy);
+    std::atomic<size_t> uniformBytes{ update_frame_uniform_buffer(camera, &bindless, currentFrame) };
+    // a model only reads itself and writes its own object and material slot, so batches of models go to the job threads
+    const size_t batchCount = (scene.size() + OBJECT_UPDATE_BATCH_SIZE - 1) / OBJECT_UPDATE_BATCH_SIZE;
+    parallel_for(batchCount, [&](size_t batch) {
+        size_t bytes = 0;
+        for (size_t i = batch * OBJECT_UPDATE_BATCH_SIZE; i < std::min(scene.size(), (batch + 1) * OBJECT_UPDATE_BATCH_SIZE); i++)
+            bytes += update_model_uniform_buffers(scene[i], &bindless, currentFrame);
+        uniformBytes += bytes;
+    });
     
     recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+    frameStats.uniformBytes = uniformBytes;
     
 
     vkResetFences(device, 1, &inFlightFences[currentFrame]);
@@ -622,9 +819,13 @@ void Engine::drawFrame()
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-        throw std::runtime_error("ERROR: failed to submit draw command buffer!");
+    {
+        std::lock_guard<std::mutex> queueLock(uploadQueueMutex);
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+            throw std::runtime_error("ERROR: failed to submit draw command buffer!");
+        }
     }
+    slotFrames[currentFrame] = frameNumber;
 
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -638,12 +839,16 @@ void Engine::drawFrame()
 
     presentInfo.pImageIndices = &imageIndex;
 
-    result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    {
+        std::lock_guard<std::mutex> queueLock(uploadQueueMutex);
+        result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    }
     
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized || swapChainConfigChanged)
     {
         framebufferResized = false;
         swapChainConfigChanged = false;
+        std::lock_guard<std::mutex> queueLock(uploadQueueMutex);
         recreate_swapchain(&device, &physicalDevice, &swapChainHandle, &colorImageRes, &depthImageRes, &surface, &renderPass,
             msaaSamples, window, camera, VSync);
     } 
@@ -668,20 +873,21 @@ void Engine::processState()
             break;
         }
         
-        vkQueueWaitIdle(graphicsQueue);
-        cleanup_model(&device, mCurrentSelectedModel);
+        waitForGraphicsQueue();
+        cleanup_model(&geometryHeap, &bindless, mCurrentSelectedModel);
         mCurrentSelectedModel = scene.back();
         state = STATE_NOP;
     }break;
     case STATE_RESET_SCENE:
     {
+        cancelSceneStream();
         if (scene.size())
         {
 
-            vkQueueWaitIdle(graphicsQueue);
+            waitForGraphicsQueue();
             for (auto& cModel : scene)
             {
-                cleanup_model(&device, cModel);
+                cleanup_model(&geometryHeap, &bindless, cModel);
 
             }
             mCurrentSelectedModel = nullptr;
@@ -698,39 +904,15 @@ void Engine::processState()
     }break;
     case STATE_RESET_AND_UPDATE_SCENE:
     {
-        vkQueueWaitIdle(graphicsQueue);
-        for (auto& cModel : scene)
-        {
-            cleanup_model(&device, cModel);
-
-        }
-        mCurrentSelectedModel = nullptr;
-        scene.resize(0);
-        shader_indices.resize(0);
-        shader_paths.resize(0);
-
-        load_scene(scene_path, &scene, &sceneSize);
-        load_file(scene_path, &shader_paths, &shader_indices, &scene, sceneSize, camera);
-
-        for (size_t i = 0; i < sceneSize; ++i)
-        {
-            init_model_resources(&device, &physicalDevice, commandPool, graphicsQueue, scene[i], &shadowImageRes, &lightRes.lightBuffers);
-        }
-        state = STATE_UPDATE_PIPELINE;
+        // the current scene keeps rendering while the new one loads, see updateSceneStream
+        cancelSceneStream();
+        startSceneStream();
+        state = STATE_NOP;
     }break;
     case STATE_UPDATE_PIPELINE:
     {
-        vkQueueWaitIdle(graphicsQueue);
-        for (auto& pipeline : graphicsPipelines)
-        {
-            vkDestroyPipeline(device, pipeline, nullptr);
-        }
-        for (auto& pipelineLayout : pipelineLayouts)
-        {
-            vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-        }
-        graphicsPipelines.resize(0); // reset sizes
-        pipelineLayouts.resize(0);
+        waitForGraphicsQueue();
+        destroyPipelines(&pipelineLayouts, &graphicsPipelines);
         loadShaders();
         state = STATE_NOP;
     }break;
@@ -742,12 +924,38 @@ void Engine::processState()
 
 void Engine::loadShaders()
 {
-    for (int i = 0; i < shader_indices.size(); i++){
-        create_graphics_pipeline(&device, static_cast<int>(graphicsPipelines.size()), shader_paths[shader_indices[i][0]], shader_paths[shader_indices[i][1]],
-            &pipelineLayouts, &graphicsPipelines, msaaSamples, descriptorSetLayout, renderPass);
+    createPipelines(shader_paths, shader_indices, &pipelineLayouts, &graphicsPipelines);
+}
+
+// Also runs on the scene stream's thread, for the pipelines of the incoming scene
+void Engine::createPipelines(const std::vector<std::string>& paths, const std::vector<std::vector<int>>& indices, std::vector<VkPipelineLayout>* layouts, std::vector<VkPipeline>* pipelines)
+{
+    for (int i = 0; i < indices.size(); i++){
+        create_graphics_pipeline(&device, static_cast<int>(pipelines->size()), paths[indices[i][0]], paths[indices[i][1]],
+            layouts, pipelines, msaaSamples, descriptorSetLayout, renderPass);
     }
 }
 
+void Engine::destroyPipelines(std::vector<VkPipelineLayout>* layouts, std::vector<VkPipeline>* pipelines)
+{
+    for (auto& pipeline : *pipelines)
+    {
+        vkDestroyPipeline(device, pipeline, nullptr);
+    }
+    for (auto& pipelineLayout : *layouts)
+    {
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    }
+    pipelines->resize(0); // reset sizes
+    layouts->resize(0);
+}
+
+void Engine::waitForGraphicsQueue()
+{
+    std::lock_guard<std::mutex> queueLock(uploadQueueMutex);
+    vkQueueWaitIdle(graphicsQueue);
+}
+
 void Engine::traceDir(std::string modelDirectory, std::string textureDirectory)
 {
     model_paths.resize(0);
@@ -867,7 +1075,7 @@ void Engine::cleanup()
 
     vkDestroyImageView(device, shadowImageRes.imageView, nullptr);
     vkDestroyImage(device, shadowImageRes.image, nullptr);
-    vkFreeMemory(device, shadowImageRes.memory, nullptr);
+    free_device_memory(&shadowImageRes.memory);
     vkDestroySampler(device, shadowImageRes.sampler, nullptr);
 
     vkDestroyFramebuffer(device, shadowFramebuffer, nullptr);
@@ -881,8 +1089,17 @@ void Engine::cleanup()
     for (size_t i = 0; i < scene.size(); ++i)
     {
         
-        cleanup_model(&device, scene[i]);
+        cleanup_model(&geometryHeap, &bindless, scene[i]);
     }
+    // the device is idle, whatever was retired can go
+    destroyRetiredScene(UINT64_MAX);
+    destroy_geometry_heap(device, &geometryHeap);
+    destroy_upload_context(&uploadContext);
+    destroy_upload_context(&streamUploadContext);
+    // after the contexts, their last completions may still point at textures
+    destroy_virtual_textures();
+    destroy_texture_cache();
+    destroy_bindless_set(&bindless);
 
     for (auto& pipeline : graphicsPipelines)
     {
@@ -905,6 +1122,7 @@ void Engine::cleanup()
 
     vkDestroyCommandPool(device, commandPool, nullptr);
 
+    destroy_device_allocator();
     vkDestroyDevice(device, nullptr);
 
     
@@ -916,4 +1134,6 @@ void Engine::cleanup()
     glfwDestroyWindow(window);
 
     glfwTerminate();   
+
+    job_system_shutdown();
 }
\ No newline at end of file
@@ -16,12 +16,17 @@ void load_file(std::string filename, std::vector<std::string>* shader_paths, std
         (*scene)[i]->translationVec = glm::vec3(j["SceneInfo"]["Objects"][(*scene)[i]->UUID.c_str()]["TRANSLATION"][0], j["SceneInfo"]["Objects"][(*scene)[i]->UUID.c_str()]["TRANSLATION"][1], j["SceneInfo"]["Objects"][(*scene)[i]->UUID.c_str()]["TRANSLATION"][2]);
         (*scene)[i]->rotationVec = glm::vec3(j["SceneInfo"]["Objects"][(*scene)[i]->UUID.c_str()]["ROTATION"][0], j["SceneInfo"]["Objects"][(*scene)[i]->UUID.c_str()]["ROTATION"][1], j["SceneInfo"]["Objects"][(*scene)[i]->UUID.c_str()]["ROTATION"][2]);
         (*scene)[i]->scaleVec = glm::vec3(j["SceneInfo"]["Objects"][(*scene)[i]->UUID.c_str()]["SCALE"][0], j["SceneInfo"]["Objects"][(*scene)[i]->UUID.c_str()]["SCALE"][1], j["SceneInfo"]["Objects"][(*scene)[i]->UUID.c_str()]["SCALE"][2]);
+        (*scene)[i]->parentUUID = j["SceneInfo"]["Objects"][(*scene)[i]->UUID.c_str()].value("PARENT", std::string());
+        (*scene)[i]->transformDirty = true;
     }
 
-    camera->Position = glm::vec3(j["SceneInfo"]["CameraInfo"]["CameraPos"][0], j["SceneInfo"]["CameraInfo"]["CameraPos"][1], j["SceneInfo"]["CameraInfo"]["CameraPos"][2]);
-    camera->Orientation = glm::vec3(j["SceneInfo"]["CameraInfo"]["CameraOrientation"][0], j["SceneInfo"]["CameraInfo"]["CameraOrientation"][1], j["SceneInfo"]["CameraInfo"]["CameraOrientation"][2]);
-    camera->lightPos = glm::vec3(j["SceneInfo"]["LightInfo"]["LightPos"][0], j["SceneInfo"]["LightInfo"]["LightPos"][1], j["SceneInfo"]["LightInfo"]["LightPos"][2]);
-    camera->lightColor = glm::vec3(j["SceneInfo"]["LightInfo"]["LightColor"][0], j["SceneInfo"]["LightInfo"]["LightColor"][1], j["SceneInfo"]["LightInfo"]["LightColor"][2]);
+    if (camera)
+    {
+        camera->Position = glm::vec3(j["SceneInfo"]["CameraInfo"]["CameraPos"][0], j["SceneInfo"]["CameraInfo"]["CameraPos"][1], j["SceneInfo"]["CameraInfo"]["CameraPos"][2]);
+        camera->Orientation = glm::vec3(j["SceneInfo"]["CameraInfo"]["CameraOrientation"][0], j["SceneInfo"]["CameraInfo"]["CameraOrientation"][1], j["SceneInfo"]["CameraInfo"]["CameraOrientation"][2]);
+        camera->lightPos = glm::vec3(j["SceneInfo"]["LightInfo"]["LightPos"][0], j["SceneInfo"]["LightInfo"]["LightPos"][1], j["SceneInfo"]["LightInfo"]["LightPos"][2]);
+        camera->lightColor = glm::vec3(j["SceneInfo"]["LightInfo"]["LightColor"][0], j["SceneInfo"]["LightInfo"]["LightColor"][1], j["SceneInfo"]["LightInfo"]["LightColor"][2]);
+    }
 
     (*shader_paths) = j["SceneInfo"]["GraphicsPipelines"]["ShaderPaths"];
     (*shader_indices) = j["SceneInfo"]["GraphicsPipelines"]["ShaderIndices"];
@@ -97,6 +102,8 @@ void write_file(std::vector<Model*> scene, std::string scene_path, std::vector<s
         j["SceneInfo"]["Objects"][scene[i]->UUID.c_str()]["TRANSLATION"] = { json::number_float_t(scene[i]->translationVec.x), json::number_float_t(scene[i]->translationVec.y), json::number_float_t(scene[i]->translationVec.z) };
         j["SceneInfo"]["Objects"][scene[i]->UUID.c_str()]["ROTATION"] = { json::number_float_t(scene[i]->rotationVec.x), json::number_float_t(scene[i]->rotationVec.y), json::number_float_t(scene[i]->rotationVec.z) };
         j["SceneInfo"]["Objects"][scene[i]->UUID.c_str()]["SCALE"] = { json::number_float_t(scene[i]->scaleVec.x), json::number_float_t(scene[i]->scaleVec.y), json::number_float_t(scene[i]->scaleVec.z) };
+        // empty for roots, the TRS above are relative to the parent
+        j["SceneInfo"]["Objects"][scene[i]->UUID.c_str()]["PARENT"] = json::string_t(scene[i]->parentUUID);
     }
 
     f << std::setw(4) << j << std::endl;
@@ -141,7 +148,13 @@ void load_scene(std::string scene_path, std::vector<Model*>* scene, size_t* scen
         cModel->NORMAL_PATH = j["SceneInfo"]["Objects"][UUIDs[i]]["NormalPath"];
         cModel->UUID = UUIDs[i];
         cModel->pipelineIndex = j["SceneInfo"]["Objects"][UUIDs[i]]["GraphicsPipeline"];
-        load_model(cModel);
+        // placed right away, streamed models are drawn as soon as they arrive
+        const json& object = j["SceneInfo"]["Objects"][UUIDs[i]];
+        cModel->translationVec = glm::vec3(object["TRANSLATION"][0], object["TRANSLATION"][1], object["TRANSLATION"][2]);
+        cModel->rotationVec = glm::vec3(object["ROTATION"][0], object["ROTATION"][1], object["ROTATION"][2]);
+        cModel->scaleVec = glm::vec3(object["SCALE"][0], object["SCALE"][1], object["SCALE"][2]);
+        // scenes saved before parent links have none
+        cModel->parentUUID = object.value("PARENT", std::string());
         scene->push_back(cModel);
     }
 }
@@ -141,10 +141,15 @@ void Engine::renderImGui()
             {
                 util::GenerateUUID(mCurrentSelectedModel, 8, true);
             }
+            // UUID of the parent, the TRS below are relative to it
+            ImGui::InputText("Parent", &mCurrentSelectedModel->parentUUID);
             ImGui::SliderFloat("FOV", &camera->FOV, 10.0f, 120.0f, NULL);
-            ImGui::SliderFloat3("ModelPos", glm::value_ptr(mCurrentSelectedModel->translationVec), -15.0f, 15.0f, NULL);
-            ImGui::SliderFloat3("ModelRot", glm::value_ptr(mCurrentSelectedModel->rotationVec), 0.0f, 6.28f, NULL);
-            ImGui::SliderFloat3("ModelScale", glm::value_ptr(mCurrentSelectedModel->scaleVec), 0.001f, 10.0f, NULL);
+            if (ImGui::SliderFloat3("ModelPos", glm::value_ptr(mCurrentSelectedModel->translationVec), -15.0f, 15.0f, NULL))
+                mCurrentSelectedModel->transformDirty = true;
+            if (ImGui::SliderFloat3("ModelRot", glm::value_ptr(mCurrentSelectedModel->rotationVec), 0.0f, 6.28f, NULL))
+                mCurrentSelectedModel->transformDirty = true;
+            if (ImGui::SliderFloat3("ModelScale", glm::value_ptr(mCurrentSelectedModel->scaleVec), 0.001f, 10.0f, NULL))
+                mCurrentSelectedModel->transformDirty = true;
             
             ImGui::Text("GraphicsPipeline");
             uint8_t count1 = 0;
@@ -281,7 +286,8 @@ void Engine::renderImGui()
                     cModel->NORMAL_PATH = "textures/" + normal_path;
                 }
                 load_model(cModel);
-                init_model_resources(&device, &physicalDevice, commandPool, graphicsQueue, cModel, &depthImageRes,&lightRes.lightBuffers);
+                init_model_resources(&uploadContext, &geometryHeap, &bindless, cModel);
+                upload_context_flush(&uploadContext);
                 scene.push_back(cModel);
             }
             catch (const std::exception& e) {
@@ -347,11 +353,24 @@ void Engine::renderImGui()
         }
 
 
-        if (ImGui::BeginTable("Scene Details", 3))
+        ImGui::Text("Triangles drawn: %u", frameStats.triangles);
+        ImGui::Text("Binds per frame: %u", frameStats.binds);
+        ImGui::Text("Uniform bytes per frame: %zu", frameStats.uniformBytes);
+        ImGui::Text("Last scene swap: worst frame %.2f ms over %u frames", swapStats.worstFrameSeconds * 1000.0, swapStats.frames);
+
+        it_TextureCacheStats textureStats = texture_cache_stats();
+        ImGui::Text("Textures: %u for %u references, %.1f MB (%.1f MB unshared)", textureStats.textures, textureStats.references, textureStats.residentBytes / 1048576.0, textureStats.unsharedBytes / 1048576.0);
+
+        it_MemoryStats memoryStats = device_memory_stats();
+        ImGui::Text("Device memory: %u allocations, %u blocks, %u dedicated", memoryStats.allocationCount, memoryStats.blockCount, memoryStats.dedicatedCount);
+        ImGui::Text("Block usage: %.1f / %.1f MB, fragmentation %.2f", memoryStats.usedBytes / 1048576.0, memoryStats.blockBytes / 1048576.0, memoryStats.fragmentation);
+
+        if (ImGui::BeginTable("Scene Details", 4))
         {
             ImGui::TableSetupColumn("MODEL");
             ImGui::TableSetupColumn("ID");
             ImGui::TableSetupColumn("TRIANGLES");
+            ImGui::TableSetupColumn("LOD");
 
             ImGui::TableHeadersRow();
 
@@ -364,6 +383,8 @@ void Engine::renderImGui()
                 ImGui::Text(scene[i]->UUID.c_str());
                 ImGui::TableNextColumn();
                 ImGui::Text("%d", scene[i]->statsFaces);
+                ImGui::TableNextColumn();
+                ImGui::Text("%d / %d", scene[i]->currentLod, static_cast<int>(scene[i]->lods.size()) - 1);
 
             }
             ImGui::EndTable();
@@ -413,11 +434,16 @@ void Engine::renderImGui()
 
             if (ImGuizmo::IsUsing())
             {
+                // the gizmo moves the world transform, the TRS are relative to the parent
+                glm::mat4 local = mCurrentSelectedModel->transform;
+                if (mCurrentSelectedModel->parent)
+                    local = glm::inverse(mCurrentSelectedModel->parent->transform) * local;
                 glm::vec3 translation, rotation, scale;
-                util::DecomposeTransform(mCurrentSelectedModel->transform, translation, rotation, scale);
+                util::DecomposeTransform(local, translation, rotation, scale);
                 mCurrentSelectedModel->translationVec = translation;
                 mCurrentSelectedModel->rotationVec = rotation;
                 mCurrentSelectedModel->scaleVec = scale;
+                mCurrentSelectedModel->transformDirty = true;
             }
         }
         else if(lightTranslateEnable) {
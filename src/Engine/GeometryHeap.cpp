@@ -0,0 +1,164 @@
+#include "GeometryHeap.h"
+#include "Buffer.h"
+#include "Vertex.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+static void create_heap_buffer(VkDevice* device, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer* buffer, it_Allocation* memory)
+{
+    // transfer source so the contents can be moved when the heap grows
+    create_buffer(device, size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, *buffer, *memory);
+}
+
+// Called with the heap locked and no uploads pending, so no recorded batch still targets the old buffer. The copy
+// goes through the caller's upload context, which is flushed before the buffers are swapped. make_room retired
+// every batch of that context already, so the flush runs no completion that would take the heap lock again. Frames in
+// flight may still read the old buffer, it is retired with the frame being recorded.
+static void grow_heap_buffer(it_UploadContext* uploadContext, it_GeometryHeap* heap, it_RangeAllocator* allocator, VkDeviceSize elementSize, VkBufferUsageFlags usage,
+    uint64_t required, VkBuffer* buffer, it_Allocation* memory)
+{
+    uint64_t capacity = std::max(allocator->capacity * 2, allocator->capacity + required);
+
+    VkBuffer newBuffer;
+    it_Allocation newMemory;
+    create_heap_buffer(&uploadContext->device, capacity * elementSize, usage, &newBuffer, &newMemory);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.size = allocator->capacity * elementSize;
+    vkCmdCopyBuffer(upload_context_commands(uploadContext), *buffer, newBuffer, 1, &copyRegion);
+    upload_context_flush(uploadContext);
+
+    heap->retired.push_back(it_RetiredHeapBuffer{ *buffer, *memory, heap->frame });
+    *buffer = newBuffer;
+    *memory = newMemory;
+    range_allocator_grow(allocator, capacity);
+}
+
+// Takes the heap lock and returns with it held and room for count more elements in allocator
+static std::unique_lock<std::mutex> make_room(it_UploadContext* uploadContext, it_GeometryHeap* heap, it_RangeAllocator* allocator, VkDeviceSize elementSize,
+    VkBufferUsageFlags usage, VkBuffer* buffer, it_Allocation* memory, uint64_t count)
+{
+    std::unique_lock<std::mutex> lock(heap->mutex);
+    while (range_largest_free(allocator) < count)
+    {
+        if (heap->pendingUploads)
+        {
+            // our own recorded copies count as pending too, submit them before waiting on everyone else's
+            lock.unlock();
+            upload_context_flush(uploadContext);
+            lock.lock();
+            heap->idle.wait(lock, [heap]() { return heap->pendingUploads == 0; });
+            continue;
+        }
+        grow_heap_buffer(uploadContext, heap, allocator, elementSize, usage, count, buffer, memory);
+    }
+    return lock;
+}
+
+// The range is reserved before anything is staged: making room can flush the context, which hands its staging space
+// back to the ring, so nothing may be staged and not yet recorded at that point.
+static uint32_t upload_range(it_UploadContext* uploadContext, it_GeometryHeap* heap, it_RangeAllocator* allocator, VkDeviceSize elementSize, VkBufferUsageFlags usage,
+    VkBuffer* buffer, it_Allocation* memory, const void* data, uint32_t count)
+{
+    uint64_t offset;
+    {
+        std::unique_lock<std::mutex> lock = make_room(uploadContext, heap, allocator, elementSize, usage, buffer, memory, count);
+        if (!range_alloc(allocator, count, &offset))
+            throw std::runtime_error("ERROR: geometry heap could not fit " + std::to_string(count) + " elements");
+        if (!count)
+            return static_cast<uint32_t>(offset);
+
+        // the heap must not grow (and destroy *buffer) until the copy below has executed
+        heap->pendingUploads++;
+    }
+
+    VkBuffer stagingBuffer;
+    VkDeviceSize stagingOffset;
+    void* staging = upload_context_stage(uploadContext, count * elementSize, &stagingBuffer, &stagingOffset);
+    memcpy(staging, data, count * elementSize);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = stagingOffset;
+    copyRegion.dstOffset = offset * elementSize;
+    copyRegion.size = count * elementSize;
+    vkCmdCopyBuffer(upload_context_commands(uploadContext), stagingBuffer, *buffer, 1, &copyRegion);
+
+    upload_context_on_complete(uploadContext, [heap]() {
+        std::lock_guard<std::mutex> lock(heap->mutex);
+        if (--heap->pendingUploads == 0)
+            heap->idle.notify_all();
+    });
+    return static_cast<uint32_t>(offset);
+}
+
+
+void create_geometry_heap(VkDevice* device, it_GeometryHeap* heap)
+{
+    create_heap_buffer(device, GEOMETRY_HEAP_INITIAL_VERTICES * sizeof(GpuVertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &heap->vertexBuffer, &heap->vertexMemory);
+    create_heap_buffer(device, GEOMETRY_HEAP_INITIAL_INDICES * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &heap->indexBuffer, &heap->indexMemory);
+    range_allocator_init(&heap->vertices, GEOMETRY_HEAP_INITIAL_VERTICES);
+    range_allocator_init(&heap->indices, GEOMETRY_HEAP_INITIAL_INDICES);
+}
+
+void destroy_geometry_heap(VkDevice device, it_GeometryHeap* heap)
+{
+    for (auto& retired : heap->retired)
+    {
+        vkDestroyBuffer(device, retired.buffer, nullptr);
+        free_device_memory(&retired.memory);
+    }
+    heap->retired.clear();
+    vkDestroyBuffer(device, heap->vertexBuffer, nullptr);
+    free_device_memory(&heap->vertexMemory);
+    vkDestroyBuffer(device, heap->indexBuffer, nullptr);
+    free_device_memory(&heap->indexMemory);
+    range_allocator_init(&heap->vertices, 0);
+    range_allocator_init(&heap->indices, 0);
+}
+
+uint32_t geometry_heap_upload_vertices(it_UploadContext* uploadContext, it_GeometryHeap* heap, const void* vertices, uint32_t count)
+{
+    return upload_range(uploadContext, heap, &heap->vertices, sizeof(GpuVertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        &heap->vertexBuffer, &heap->vertexMemory, vertices, count);
+}
+
+uint32_t geometry_heap_upload_indices(it_UploadContext* uploadContext, it_GeometryHeap* heap, const uint32_t* indices, uint32_t count)
+{
+    return upload_range(uploadContext, heap, &heap->indices, sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        &heap->indexBuffer, &heap->indexMemory, indices, count);
+}
+
+void geometry_heap_reserve(it_UploadContext* uploadContext, it_GeometryHeap* heap, uint64_t vertexCount, uint64_t indexCount)
+{
+    make_room(uploadContext, heap, &heap->vertices, sizeof(GpuVertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &heap->vertexBuffer, &heap->vertexMemory, vertexCount);
+    make_room(uploadContext, heap, &heap->indices, sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &heap->indexBuffer, &heap->indexMemory, indexCount);
+}
+
+void geometry_heap_begin_frame(VkDevice device, it_GeometryHeap* heap, uint64_t frame, uint64_t completedFrame, VkBuffer* vertexBuffer, VkBuffer* indexBuffer)
+{
+    std::lock_guard<std::mutex> lock(heap->mutex);
+    heap->frame = frame;
+    size_t kept = 0;
+    for (auto& retired : heap->retired)
+    {
+        if (retired.frame <= completedFrame)
+        {
+            vkDestroyBuffer(device, retired.buffer, nullptr);
+            free_device_memory(&retired.memory);
+        }
+        else
+            heap->retired[kept++] = retired;
+    }
+    heap->retired.resize(kept);
+    *vertexBuffer = heap->vertexBuffer;
+    *indexBuffer = heap->indexBuffer;
+}
+
+void geometry_heap_release(it_GeometryHeap* heap, uint32_t baseVertex, uint32_t vertexCount, uint32_t baseIndex, uint32_t indexCount)
+{
+    std::lock_guard<std::mutex> lock(heap->mutex);
+    range_free(&heap->vertices, baseVertex, vertexCount);
+    range_free(&heap->indices, baseIndex, indexCount);
+}
@@ -1,4 +1,19 @@
 #include "GraphicsPipeline.h"
+#include "DescriptorSet.h"
+
+std::string vertex_shader_variant(const std::string& vertShaderPath)
+{
+#ifdef ENGINE_PACKED_VERTICES
+    // scene files keep naming the float shaders, packed builds load the matching "_packed_vert.spv" next to them
+    const std::string suffix = "_vert.spv";
+    if (vertShaderPath.size() > suffix.size() && vertShaderPath.compare(vertShaderPath.size() - suffix.size(), suffix.size(), suffix) == 0
+        && vertShaderPath.find("_packed_vert.spv") == std::string::npos)
+    {
+        return vertShaderPath.substr(0, vertShaderPath.size() - suffix.size()) + "_packed" + suffix;
+    }
+#endif
+    return vertShaderPath;
+}
 
 VkShaderModule create_shader_module(VkDevice* device, const std::vector<char>& code)
 {
@@ -19,7 +34,7 @@ void create_graphics_pipeline(VkDevice* device, int index, std::string vertShade
     std::vector<VkPipelineLayout>* pipelineLayouts, std::vector<VkPipeline>* graphicsPipelines,  VkSampleCountFlagBits msaaSamples, 
     VkDescriptorSetLayout descriptorSetLayout, VkRenderPass renderPass)
 {
-    auto vertShaderCode = util::readFile(vertShaderPath);
+    auto vertShaderCode = util::readFile(vertex_shader_variant(vertShaderPath));
     auto fragShaderCode = util::readFile(fragShaderPath);
 
     //auto tesselationControlShaderCode = util::readFile("res/shaders/tesselation_control.spv");
@@ -64,8 +79,8 @@ void create_graphics_pipeline(VkDevice* device, int index, std::string vertShade
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    auto bindingDescription = GpuVertex::getBindingDescription();
+    auto attributeDescriptions = GpuVertex::getAttributeDescriptions();
 
     vertexInputInfo.vertexBindingDescriptionCount = 1;
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
@@ -130,10 +145,18 @@ void create_graphics_pipeline(VkDevice* device, int index, std::string vertShade
     dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
     dynamicState.pDynamicStates = dynamicStates.data();
 
+    // the same range in every layout keeps them compatible, the bindless set stays bound across pipelines
+    VkPushConstantRange drawIndicesRange{};
+    drawIndicesRange.stageFlags = DRAW_INDICES_STAGES;
+    drawIndicesRange.offset = 0;
+    drawIndicesRange.size = sizeof(it_DrawIndices);
+
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = 1;
     pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &drawIndicesRange;
 
     pipelineLayouts->resize(pipelineLayouts->size() + 1);
     (*pipelineLayouts)[index] = VkPipelineLayout();
@@ -174,7 +197,7 @@ void create_graphics_pipeline(VkDevice* device, int index, std::string vertShade
 void create_shadow_pipeline(VkDevice* device, std::string vertShaderPath, std::string fragShaderPath, VkPipelineLayout* shadowPipelineLayout,
     VkPipeline* shadowPipeline, VkDescriptorSetLayout descriptorSetLayout, VkRenderPass shadowRenderPass, VkExtent2D shadowMapExtent, VkSampleCountFlagBits msaaSamples)
 {
-    auto vertShaderCode = util::readFile(vertShaderPath);
+    auto vertShaderCode = util::readFile(vertex_shader_variant(vertShaderPath));
     auto fragShaderCode = util::readFile(fragShaderPath);
 
     //auto tesselationControlShaderCode = util::readFile("res/shaders/tesselation_control.spv");
@@ -219,8 +242,8 @@ void create_shadow_pipeline(VkDevice* device, std::string vertShaderPath, std::s
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    auto bindingDescription = GpuVertex::getBindingDescription();
+    auto attributeDescriptions = GpuVertex::getAttributeDescriptions();
 
     vertexInputInfo.vertexBindingDescriptionCount = 1;
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
@@ -285,10 +308,18 @@ void create_shadow_pipeline(VkDevice* device, std::string vertShaderPath, std::s
     dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
     dynamicState.pDynamicStates = dynamicStates.data();
 
+    // the same range in every layout keeps them compatible, the bindless set stays bound across pipelines
+    VkPushConstantRange drawIndicesRange{};
+    drawIndicesRange.stageFlags = DRAW_INDICES_STAGES;
+    drawIndicesRange.offset = 0;
+    drawIndicesRange.size = sizeof(it_DrawIndices);
+
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = 1;
     pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &drawIndicesRange;
 
     
     if (vkCreatePipelineLayout(*device, &pipelineLayoutInfo, nullptr, shadowPipelineLayout) != VK_SUCCESS) {
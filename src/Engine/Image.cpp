@@ -9,6 +9,12 @@ bool hasStencilComponent(VkFormat format)
 void transition_image_layout(VkDevice* device, VkCommandPool commandPool, VkQueue graphicsQueue, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
 {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
+    record_image_layout_transition(commandBuffer, image, format, oldLayout, newLayout, mipLevels);
+    endSingleTimeCommands(device, commandBuffer, commandPool, graphicsQueue);
+}
+
+void record_image_layout_transition(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
+{
 
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -78,8 +84,6 @@ void transition_image_layout(VkDevice* device, VkCommandPool commandPool, VkQueu
         0, nullptr,
         1, &barrier
     );
-
-    endSingleTimeCommands(device, commandBuffer, commandPool, graphicsQueue);
 }
 
 
@@ -128,7 +132,7 @@ VkFormat findDepthFormat(VkPhysicalDevice physicalDevice)
 
 
 
-void createImage(VkDevice* device, VkPhysicalDevice* physicalDevice, uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
+void createImage(VkDevice* device, uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, it_Allocation& imageMemory)
 {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -149,17 +153,7 @@ void createImage(VkDevice* device, VkPhysicalDevice* physicalDevice, uint32_t wi
     if (vkCreateImage(*device, &imageInfo, nullptr, &image) != VK_SUCCESS)
         throw std::runtime_error("ERROR: failed to create image!");
 
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(*device, image, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(*physicalDevice,memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    if (vkAllocateMemory(*device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
-        throw std::runtime_error("ERROR: failed to allocate iamge memory!");
-
-    vkBindImageMemory(*device, image, imageMemory, 0);
+    allocate_image_memory(image, properties, &imageMemory);
 }
 
 
@@ -0,0 +1,437 @@
+#include "JobSystem.h"
+
+#include <thread>
+#include <deque>
+#include <memory>
+#include <condition_variable>
+#include <algorithm>
+#include <string>
+
+#include <tinylogger.h>
+
+
+// Failed searches before an idle worker goes to sleep
+#define JOB_SPIN_COUNT 64
+
+struct it_Job
+{
+    std::function<void()> fn;
+    it_JobCounter* counter = nullptr;
+};
+
+// Chase-Lev work stealing deque with the C11 orderings of Le et al. 2013. The owner pushes and pops at bottom,
+// thieves take from top. Fixed capacity, a full deque makes job_run execute the job in place.
+struct it_JobDeque
+{
+    std::atomic<int64_t> top{ 0 };
+    std::atomic<int64_t> bottom{ 0 };
+    std::atomic<it_Job*> jobs[JOB_QUEUE_CAPACITY];
+};
+
+struct it_JobSystem
+{
+    std::vector<std::unique_ptr<it_JobDeque>> deques;  // one per job thread, 0 belongs to the thread that called init
+    std::vector<std::thread> workers;
+
+    // jobs queued from threads that are not job threads (audio, GUI callbacks)
+    std::mutex injectedMutex;
+    std::deque<it_Job*> injected;
+
+    std::atomic<int64_t> queued{ 0 };  // jobs sitting in any deque or in injected
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<uint32_t> sleeping{ 0 };
+    std::atomic<bool> quit{ false };
+    std::atomic<bool> running{ false };
+
+    std::atomic<uint64_t> executed{ 0 };
+    std::atomic<uint64_t> stolen{ 0 };
+    std::atomic<uint64_t> inlined{ 0 };
+    std::atomic<uint64_t> sleeps{ 0 };
+    std::atomic<uint64_t> failed{ 0 };
+};
+
+static it_JobSystem s_jobs;
+static thread_local int t_threadIndex = -1;
+static thread_local uint32_t t_random = 0;
+
+
+static bool deque_push(it_JobDeque* deque, it_Job* job)
+{
+    int64_t b = deque->bottom.load(std::memory_order_relaxed);
+    int64_t t = deque->top.load(std::memory_order_acquire);
+    if (b - t >= JOB_QUEUE_CAPACITY)
+        return false;
+    deque->jobs[b & (JOB_QUEUE_CAPACITY - 1)].store(job, std::memory_order_relaxed);
+    deque->bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+
+static it_Job* deque_pop(it_JobDeque* deque)
+{
+    int64_t b = deque->bottom.load(std::memory_order_relaxed) - 1;
+    deque->bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = deque->top.load(std::memory_order_relaxed);
+    if (t > b)
+    {
+        deque->bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    it_Job* job = deque->jobs[b & (JOB_QUEUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (t == b)
+    {
+        // last job, race the thieves for it
+        if (!deque->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = nullptr;
+        deque->bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+static it_Job* deque_steal(it_JobDeque* deque)
+{
+    int64_t t = deque->top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = deque->bottom.load(std::memory_order_acquire);
+    if (t >= b)
+        return nullptr;
+
+    it_Job* job = deque->jobs[t & (JOB_QUEUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (!deque->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr;
+    return job;
+}
+
+static uint32_t next_random()
+{
+    // xorshift, only used to spread thieves over the victims
+    if (!t_random)
+        t_random = static_cast<uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id())) | 1u;
+    t_random ^= t_random << 13;
+    t_random ^= t_random >> 17;
+    t_random ^= t_random << 5;
+    return t_random;
+}
+
+static it_Job* find_job(int index)
+{
+    it_Job* job = deque_pop(s_jobs.deques[index].get());
+
+    // thread 0 renders. With workers around it only runs what it queued itself, a background scene load's jobs and
+    // the jobs they spawn on the workers' deques would hitch the frame it is waiting for.
+    const bool takeForeign = index != 0 || s_jobs.deques.size() == 1;
+    if (!job && takeForeign && s_jobs.queued.load(std::memory_order_relaxed) > 0)
+    {
+        std::lock_guard<std::mutex> lock(s_jobs.injectedMutex);
+        if (!s_jobs.injected.empty())
+        {
+            job = s_jobs.injected.front();
+            s_jobs.injected.pop_front();
+        }
+    }
+
+    if (!job && takeForeign)
+    {
+        const size_t count = s_jobs.deques.size();
+        const size_t first = next_random() % count;
+        for (size_t i = 0; i < count && !job; ++i)
+        {
+            size_t victim = (first + i) % count;
+            if (victim != static_cast<size_t>(index))
+                job = deque_steal(s_jobs.deques[victim].get());
+        }
+        if (job)
+            s_jobs.stolen.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (job)
+        s_jobs.queued.fetch_sub(1, std::memory_order_relaxed);
+    return job;
+}
+
+static void push_job(it_Job* job);
+
+static void finish_job(it_JobCounter* counter, std::exception_ptr error)
+{
+    std::vector<it_Job*> ready;
+    {
+        // waiters take the mutex once they see zero, so the counter outlives this block
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        if (error && !counter->error)
+            counter->error = error;
+        if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            ready.swap(counter->continuations);
+    }
+    for (it_Job* job : ready)
+        push_job(job);
+}
+
+static void execute_job(it_Job* job)
+{
+    std::exception_ptr error;
+    try
+    {
+        job->fn();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    it_JobCounter* counter = job->counter;
+    delete job;
+    s_jobs.executed.fetch_add(1, std::memory_order_relaxed);
+    if (counter)
+    {
+        finish_job(counter, error);
+        return;
+    }
+    // nobody waits for it, rethrowing on a worker would terminate the process
+    if (error)
+    {
+        s_jobs.failed.fetch_add(1, std::memory_order_relaxed);
+#ifndef ENGINE_DISABLE_LOGGING
+        try
+        {
+            std::rethrow_exception(error);
+        }
+        catch (const std::exception& e)
+        {
+            tlog::error(std::string("Job without a counter failed: ") + e.what());
+        }
+        catch (...)
+        {
+            tlog::error("Job without a counter failed");
+        }
+#endif
+    }
+}
+
+static void push_job(it_Job* job)
+{
+    if (!s_jobs.running)
+    {
+        execute_job(job);
+        return;
+    }
+
+    if (t_threadIndex >= 0)
+    {
+        if (!deque_push(s_jobs.deques[t_threadIndex].get(), job))
+        {
+            s_jobs.inlined.fetch_add(1, std::memory_order_relaxed);
+            execute_job(job);
+            return;
+        }
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(s_jobs.injectedMutex);
+        s_jobs.injected.push_back(job);
+    }
+
+    s_jobs.queued.fetch_add(1, std::memory_order_seq_cst);
+    if (s_jobs.sleeping.load(std::memory_order_seq_cst) > 0)
+    {
+        std::lock_guard<std::mutex> lock(s_jobs.sleepMutex);
+        s_jobs.wake.notify_one();
+    }
+}
+
+static void worker_main(int index)
+{
+    t_threadIndex = index;
+    uint32_t spins = 0;
+    for (;;)
+    {
+        if (it_Job* job = find_job(index))
+        {
+            execute_job(job);
+            spins = 0;
+            continue;
+        }
+        if (++spins < JOB_SPIN_COUNT)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(s_jobs.sleepMutex);
+        s_jobs.sleeping.fetch_add(1, std::memory_order_seq_cst);
+        if (s_jobs.queued.load(std::memory_order_seq_cst) == 0 && !s_jobs.quit)
+        {
+            s_jobs.sleeps.fetch_add(1, std::memory_order_relaxed);
+            s_jobs.wake.wait(lock, []() { return s_jobs.queued.load() > 0 || s_jobs.quit; });
+        }
+        s_jobs.sleeping.fetch_sub(1, std::memory_order_seq_cst);
+        if (s_jobs.quit && s_jobs.queued.load() == 0)
+            return;
+        spins = 0;
+    }
+}
+
+
+void job_system_init(uint32_t workerCount)
+{
+    if (s_jobs.running)
+        return;
+    if (workerCount == JOB_WORKERS_AUTO)
+        workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+    s_jobs.deques.clear();
+    for (uint32_t i = 0; i <= workerCount; ++i)
+        s_jobs.deques.push_back(std::make_unique<it_JobDeque>());
+    s_jobs.quit = false;
+    s_jobs.running = true;
+    s_jobs.executed = 0;
+    s_jobs.stolen = 0;
+    s_jobs.inlined = 0;
+    s_jobs.sleeps = 0;
+    s_jobs.failed = 0;
+    t_threadIndex = 0;
+
+    for (uint32_t i = 1; i <= workerCount; ++i)
+        s_jobs.workers.emplace_back(worker_main, static_cast<int>(i));
+}
+
+void job_system_shutdown()
+{
+    if (!s_jobs.running)
+        return;
+
+    // the caller's own deque is only drained by stealing, help so workers are not left with all of it
+    while (it_Job* job = find_job(0))
+        execute_job(job);
+    {
+        std::lock_guard<std::mutex> lock(s_jobs.sleepMutex);
+        s_jobs.quit = true;
+    }
+    s_jobs.wake.notify_all();
+    for (auto& worker : s_jobs.workers)
+        worker.join();
+
+    s_jobs.workers.clear();
+    s_jobs.deques.clear();
+    s_jobs.running = false;
+    t_threadIndex = -1;
+}
+
+bool job_system_running()
+{
+    return s_jobs.running;
+}
+
+uint32_t job_thread_count()
+{
+    return s_jobs.running ? static_cast<uint32_t>(s_jobs.deques.size()) : 1;
+}
+
+int job_thread_index()
+{
+    return t_threadIndex;
+}
+
+void job_run(std::function<void()> fn, it_JobCounter* counter)
+{
+    if (counter)
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    push_job(new it_Job{ std::move(fn), counter });
+}
+
+void job_run_after(it_JobCounter* dependency, std::function<void()> fn, it_JobCounter* counter)
+{
+    if (counter)
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    it_Job* job = new it_Job{ std::move(fn), counter };
+    {
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (dependency->pending.load(std::memory_order_acquire) != 0)
+        {
+            dependency->continuations.push_back(job);
+            return;
+        }
+    }
+    push_job(job);
+}
+
+void job_wait(it_JobCounter* counter)
+{
+    const int index = s_jobs.running ? t_threadIndex : -1;
+    while (counter->pending.load(std::memory_order_acquire) != 0)
+    {
+        it_Job* job = index >= 0 ? find_job(index) : nullptr;
+        if (job)
+            execute_job(job);
+        else
+            std::this_thread::yield();
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        error = counter->error;
+        counter->error = nullptr;
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+bool job_try_run()
+{
+    if (!s_jobs.running || t_threadIndex < 0)
+        return false;
+    it_Job* job = find_job(t_threadIndex);
+    if (!job)
+        return false;
+    execute_job(job);
+    return true;
+}
+
+void job_parallel_for(size_t count, const std::function<void(size_t)>& fn)
+{
+    const size_t jobCount = std::min<size_t>(count, static_cast<size_t>(job_thread_count()) * JOB_PARALLEL_SPLIT);
+    if (jobCount <= 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+            fn(i);
+        return;
+    }
+
+    // items are handed out one at a time like parallel_for always did, the jobs only decide who takes part
+    std::atomic<size_t> next{ 0 };
+    auto take = [&]() {
+        for (size_t i = next++; i < count; i = next++)
+            fn(i);
+    };
+
+    it_JobCounter counter;
+    for (size_t j = 1; j < jobCount; ++j)
+        job_run(take, &counter);
+    std::exception_ptr error;
+    try
+    {
+        take();
+    }
+    catch (...)
+    {
+        // the queued jobs still reference next and fn, let them drain before unwinding
+        error = std::current_exception();
+        next = count;
+    }
+    job_wait(&counter);
+    if (error)
+        std::rethrow_exception(error);
+}
+
+it_JobStats job_system_stats()
+{
+    it_JobStats stats;
+    stats.executed = s_jobs.executed.load();
+    stats.stolen = s_jobs.stolen.load();
+    stats.inlined = s_jobs.inlined.load();
+    stats.sleeps = s_jobs.sleeps.load();
+    stats.failed = s_jobs.failed.load();
+    return stats;
+}
@@ -0,0 +1,277 @@
+#include "Ktx2.h"
+
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+
+static const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+// Khronos data format descriptor values for the formats the cooker writes
+#define KHR_DF_MODEL_RGBSDA 1
+#define KHR_DF_MODEL_BC5 132
+#define KHR_DF_MODEL_BC7 134
+#define KHR_DF_PRIMARIES_BT709 1
+#define KHR_DF_TRANSFER_LINEAR 1
+#define KHR_DF_TRANSFER_SRGB 2
+#define KHR_DF_VERSION 2
+#define KHR_DF_CHANNEL_ALPHA 15
+#define KHR_DF_SAMPLE_LINEAR 0x10
+
+struct it_Ktx2Header
+{
+    uint8_t identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+
+struct it_Ktx2LevelIndex
+{
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+static_assert(sizeof(it_Ktx2Header) == 80, "KTX2 header layout");
+static_assert(sizeof(it_Ktx2LevelIndex) == 24, "KTX2 level index layout");
+
+
+static bool block_format(uint32_t format)
+{
+    return format == VK_FORMAT_BC7_SRGB_BLOCK || format == VK_FORMAT_BC7_UNORM_BLOCK || format == VK_FORMAT_BC5_UNORM_BLOCK;
+}
+
+static bool supported_format(uint32_t format)
+{
+    return block_format(format) || format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_R8G8B8A8_UNORM;
+}
+
+static uint64_t level_size(uint32_t format, uint32_t width, uint32_t height)
+{
+    if (block_format(format))
+        return static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * 16;
+    return static_cast<uint64_t>(width) * height * 4;
+}
+
+static uint64_t align_up(uint64_t offset, uint64_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+static void put_u32(std::vector<uint8_t>* out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        out->push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+// Basic descriptor block: one sample per stored channel of the 128 bit block, or one per byte of an RGBA8 texel
+static std::vector<uint8_t> data_format_descriptor(VkFormat format)
+{
+    const bool bc5 = format == VK_FORMAT_BC5_UNORM_BLOCK, rgba = !block_format(format);
+    const bool srgb = format == VK_FORMAT_BC7_SRGB_BLOCK || format == VK_FORMAT_R8G8B8A8_SRGB;
+    const uint32_t samples = rgba ? 4 : bc5 ? 2 : 1;
+    const uint32_t blockSize = 24 + 16 * samples;
+
+    std::vector<uint8_t> dfd;
+    put_u32(&dfd, 4 + blockSize);
+    put_u32(&dfd, 0);  // Khronos vendor, basic descriptor type
+    put_u32(&dfd, KHR_DF_VERSION | blockSize << 16);
+    dfd.push_back(rgba ? KHR_DF_MODEL_RGBSDA : bc5 ? KHR_DF_MODEL_BC5 : KHR_DF_MODEL_BC7);
+    dfd.push_back(KHR_DF_PRIMARIES_BT709);
+    dfd.push_back(srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR);
+    dfd.push_back(0);  // straight alpha
+    const uint8_t side = rgba ? 0 : 3;  // texels per block side minus one, 4x4 for BC
+    const uint8_t dimensions[4] = { side, side, 0, 0 };
+    dfd.insert(dfd.end(), dimensions, dimensions + 4);
+    const uint8_t bytesPlane[8] = { static_cast<uint8_t>(rgba ? 4 : 16), 0, 0, 0, 0, 0, 0, 0 };
+    dfd.insert(dfd.end(), bytesPlane, bytesPlane + 8);
+    for (uint32_t i = 0; i < samples; i++)
+    {
+        uint32_t bitOffset = bc5 ? 64 * i : 0, bitLength = bc5 ? 63 : 127, channel = i, upper = UINT32_MAX;
+        if (rgba)
+        {
+            bitOffset = 8 * i;
+            bitLength = 7;
+            // alpha is never sRGB encoded
+            channel = i == 3 ? KHR_DF_CHANNEL_ALPHA | (srgb ? KHR_DF_SAMPLE_LINEAR : 0) : i;
+            upper = 255;
+        }
+        put_u32(&dfd, bitOffset | bitLength << 16 | channel << 24);  // channel id: RGBA, red and green for BC5, colour for BC7
+        put_u32(&dfd, 0);  // sample position
+        put_u32(&dfd, 0);
+        put_u32(&dfd, upper);
+    }
+    return dfd;
+}
+
+
+bool open_ktx2(const std::string& path, it_Ktx2File* ktx)
+{
+    *ktx = it_Ktx2File{};
+    if (!map_file(path, &ktx->file))
+        return false;
+
+    it_Ktx2Header header;
+    bool valid = ktx->file.size >= sizeof(header);
+    if (valid)
+    {
+        memcpy(&header, ktx->file.data, sizeof(header));
+        valid = memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0 && supported_format(header.vkFormat)
+            && header.typeSize == 1 && header.pixelWidth > 0 && header.pixelHeight > 0 && header.pixelDepth == 0
+            && header.layerCount == 0 && header.faceCount == 1 && header.supercompressionScheme == 0
+            && header.levelCount > 0 && sizeof(header) + header.levelCount * sizeof(it_Ktx2LevelIndex) <= ktx->file.size
+            && static_cast<uint64_t>(header.kvdByteOffset) + header.kvdByteLength <= ktx->file.size;
+    }
+
+    if (valid)
+    {
+        ktx->format = static_cast<VkFormat>(header.vkFormat);
+        ktx->width = header.pixelWidth;
+        ktx->height = header.pixelHeight;
+        ktx->kvdOffset = header.kvdByteOffset;
+        ktx->kvdLength = header.kvdByteLength;
+        ktx->levels.resize(header.levelCount);
+        for (uint32_t i = 0; i < header.levelCount && valid; i++)
+        {
+            it_Ktx2LevelIndex index;
+            memcpy(&index, ktx->file.data + sizeof(header) + i * sizeof(index), sizeof(index));
+            valid = index.byteLength == level_size(header.vkFormat, std::max(header.pixelWidth >> i, 1u), std::max(header.pixelHeight >> i, 1u))
+                && index.byteOffset % KTX2_LEVEL_ALIGNMENT == 0
+                && index.byteOffset + index.byteLength <= ktx->file.size;
+            ktx->levels[i].offset = index.byteOffset;
+            ktx->levels[i].size = index.byteLength;
+        }
+    }
+
+    if (!valid)
+        close_ktx2(ktx);
+    return valid;
+}
+
+void close_ktx2(it_Ktx2File* ktx)
+{
+    unmap_file(&ktx->file);
+    *ktx = it_Ktx2File{};
+}
+
+const uint8_t* ktx2_value(const it_Ktx2File* ktx, const std::string& key, uint32_t* size)
+{
+    const uint8_t* kvd = ktx->file.data + ktx->kvdOffset;
+    uint32_t offset = 0;
+    while (offset + 4 <= ktx->kvdLength)
+    {
+        uint32_t length;
+        memcpy(&length, kvd + offset, sizeof(length));
+        if (length == 0 || offset + 4 + length > ktx->kvdLength)
+            break;
+        const char* entry = reinterpret_cast<const char*>(kvd + offset + 4);
+        // the key is null terminated, the value takes the rest of the entry
+        if (length > key.size() && memcmp(entry, key.c_str(), key.size() + 1) == 0)
+        {
+            *size = length - static_cast<uint32_t>(key.size()) - 1;
+            return kvd + offset + 4 + key.size() + 1;
+        }
+        offset += 4 + static_cast<uint32_t>(align_up(length, 4));
+    }
+    return nullptr;
+}
+
+bool write_ktx2(const std::string& path, VkFormat format, uint32_t width, uint32_t height, const std::vector<it_Ktx2Level>& levels, const uint8_t* data,
+    std::vector<std::pair<std::string, std::string>> keyValues)
+{
+    if (!supported_format(format) || levels.empty())
+        return false;
+
+    const uint32_t levelCount = static_cast<uint32_t>(levels.size());
+    const std::vector<uint8_t> dfd = data_format_descriptor(format);
+
+    // entries sorted by key, each padded to 4 bytes
+    std::sort(keyValues.begin(), keyValues.end());
+    std::vector<uint8_t> kvd;
+    for (const auto& keyValue : keyValues)
+    {
+        const uint32_t length = static_cast<uint32_t>(keyValue.first.size() + 1 + keyValue.second.size());
+        put_u32(&kvd, length);
+        kvd.insert(kvd.end(), keyValue.first.begin(), keyValue.first.end());
+        kvd.push_back(0);
+        kvd.insert(kvd.end(), keyValue.second.begin(), keyValue.second.end());
+        kvd.resize(align_up(kvd.size(), 4), 0);
+    }
+
+    it_Ktx2Header header{};
+    memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    header.vkFormat = format;
+    header.typeSize = 1;
+    header.pixelWidth = width;
+    header.pixelHeight = height;
+    header.faceCount = 1;
+    header.levelCount = levelCount;
+    header.dfdByteOffset = static_cast<uint32_t>(sizeof(header) + levelCount * sizeof(it_Ktx2LevelIndex));
+    header.dfdByteLength = static_cast<uint32_t>(dfd.size());
+    header.kvdByteOffset = kvd.empty() ? 0 : header.dfdByteOffset + header.dfdByteLength;
+    header.kvdByteLength = static_cast<uint32_t>(kvd.size());
+
+    std::vector<it_Ktx2LevelIndex> index(levelCount);
+    uint64_t offset = align_up(static_cast<uint64_t>(header.dfdByteOffset) + dfd.size() + kvd.size(), KTX2_LEVEL_ALIGNMENT);
+    const uint64_t dataOffset = offset;
+    for (uint32_t i = levelCount; i-- > 0;)
+    {
+        index[i].byteOffset = offset;
+        index[i].byteLength = levels[i].size;
+        index[i].uncompressedByteLength = levels[i].size;
+        offset = align_up(offset + levels[i].size, KTX2_LEVEL_ALIGNMENT);
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    // cooking runs in parallel and may meet one file twice, so the temporary name is per thread
+    const std::string tmpPath = path + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream f(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!f.is_open())
+            return false;
+
+        static const char padding[KTX2_LEVEL_ALIGNMENT] = {};
+        f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        f.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(it_Ktx2LevelIndex));
+        f.write(reinterpret_cast<const char*>(dfd.data()), dfd.size());
+        f.write(reinterpret_cast<const char*>(kvd.data()), kvd.size());
+        uint64_t written = header.dfdByteOffset + dfd.size() + kvd.size();
+        f.write(padding, dataOffset - written);
+        written = dataOffset;
+        for (uint32_t i = levelCount; i-- > 0;)
+        {
+            f.write(padding, index[i].byteOffset - written);
+            f.write(reinterpret_cast<const char*>(data + levels[i].offset), levels[i].size);
+            written = index[i].byteOffset + levels[i].size;
+        }
+        if (!f.good())
+        {
+            f.close();
+            std::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+    }
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec)
+    {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
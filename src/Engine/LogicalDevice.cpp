@@ -1,29 +1,52 @@
 #include "LogicalDevice.h"
 
 
-void create_logical_device(VkDevice* device, VkPhysicalDevice* physicalDevice, VkSurfaceKHR* surface, VkQueue* graphicsQueue, VkQueue* presentQueue)
+void create_logical_device(VkDevice* device, VkPhysicalDevice* physicalDevice, VkSurfaceKHR* surface, VkQueue* graphicsQueue, VkQueue* presentQueue, VkQueue* uploadQueue)
 {
     QueueFamilyIndices indices = findQueueFamilies(*physicalDevice, *surface);
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
-    float queuePriority = 1.0f;
+    // A second queue of the graphics family takes the uploads, so loader threads never contend with frame submits.
+    // A transfer only family would need ownership transfers and cannot wait on the fragment stage.
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(*physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(*physicalDevice, &familyCount, families.data());
+    bool separateUploadQueue = families[indices.graphicsFamily.value()].queueCount > 1;
+
+    float queuePriorities[2] = { 1.0f, 0.5f };
     for (uint32_t queueFamily : uniqueQueueFamilies)
     {
         VkDeviceQueueCreateInfo queueCreateInfo{};
         queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queueCreateInfo.queueFamilyIndex = queueFamily;
-        queueCreateInfo.queueCount = 1;
-        queueCreateInfo.pQueuePriorities = &queuePriority;
+        queueCreateInfo.queueCount = (separateUploadQueue && queueFamily == indices.graphicsFamily.value()) ? 2 : 1;
+        queueCreateInfo.pQueuePriorities = queuePriorities;
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(*physicalDevice, &supportedFeatures);
+
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
     deviceFeatures.depthClamp = VK_TRUE;
+    // cooked textures are BC7 and BC5, without it the texture cache uploads the source images
+    deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+    // the bindless texture array, indexed with push constants. pick_physical_device checked for all of it.
+    deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+    // the fragment shaders write the virtual texture feedback
+    deviceFeatures.fragmentStoresAndAtomics = VK_TRUE;
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features12.descriptorBindingPartiallyBound = VK_TRUE;
+    features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
 
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &features12;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
@@ -45,4 +68,5 @@ void create_logical_device(VkDevice* device, VkPhysicalDevice* physicalDevice, V
     }
     vkGetDeviceQueue(*device, indices.graphicsFamily.value(), 0, graphicsQueue);
     vkGetDeviceQueue(*device, indices.presentFamily.value(), 0, presentQueue);
+    vkGetDeviceQueue(*device, indices.graphicsFamily.value(), separateUploadQueue ? 1 : 0, uploadQueue);
 }
\ No newline at end of file
@@ -0,0 +1,281 @@
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "MeshProcessing.h"
+
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <thread>
+
+
+static int64_t source_mtime(const std::string& path, uint64_t* size)
+{
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec)
+        return 0;
+    *size = static_cast<uint64_t>(std::filesystem::file_size(path, ec));
+    if (ec)
+        return 0;
+    return static_cast<int64_t>(mtime.time_since_epoch().count());
+}
+
+static uint64_t align_offset(uint64_t offset)
+{
+    return (offset + 15) & ~uint64_t(15);
+}
+
+// count elements of stride bytes at offset fit in size bytes, without overflowing on garbage counts
+static bool range_inside(uint64_t offset, uint64_t count, uint64_t stride, uint64_t size)
+{
+    return offset <= size && count <= (size - offset) / stride;
+}
+
+// first + count <= limit without overflowing
+static bool span_inside(uint64_t first, uint64_t count, uint64_t limit)
+{
+    return first <= limit && count <= limit - first;
+}
+
+// A corrupt or stale entry must not reach the geometry heap, out of range values would draw other models' ranges
+static bool mesh_cache_ranges_valid(const Model* cModel)
+{
+    const uint64_t vertexCount = cModel->vertices.size();
+    const uint64_t indexCount = cModel->indices.size();
+    for (uint32_t index : cModel->indices)
+    {
+        if (index >= vertexCount)
+            return false;
+    }
+    for (const it_MeshLod& lod : cModel->lods)
+    {
+        if (!span_inside(lod.firstIndex, lod.indexCount, indexCount))
+            return false;
+    }
+
+    const it_MeshletData& meshlets = cModel->meshlets;
+    for (uint32_t v : meshlets.vertices)
+    {
+        if (v >= vertexCount)
+            return false;
+    }
+    for (const it_Meshlet& meshlet : meshlets.meshlets)
+    {
+        const uint64_t cornerCount = uint64_t(meshlet.triangleCount) * 3;
+        if (meshlet.vertexCount > MESHLET_MAX_VERTICES || meshlet.triangleCount > MESHLET_MAX_TRIANGLES
+            || !span_inside(meshlet.vertexOffset, meshlet.vertexCount, meshlets.vertices.size())
+            || !span_inside(meshlet.triangleOffset, cornerCount, meshlets.triangles.size())
+            || !span_inside(meshlet.firstIndex, cornerCount, indexCount))
+            return false;
+        for (uint64_t c = 0; c < cornerCount; ++c)
+        {
+            if (meshlets.triangles[meshlet.triangleOffset + c] >= meshlet.vertexCount)
+                return false;
+        }
+    }
+    return true;
+}
+
+
+uint64_t hash_bytes(const void* data, size_t size)
+{
+    // FNV-1a over 64 bit words with a murmur finalizer. Only used to detect edits, not for security.
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t h = 14695981039346656037ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        h = (h ^ word) * 1099511628211ull;
+        h ^= h >> 29;
+    }
+    for (; i < size; ++i)
+        h = (h ^ bytes[i]) * 1099511628211ull;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+std::string mesh_cache_path(const std::string& sourcePath)
+{
+    std::string name = sourcePath;
+    for (auto& c : name)
+    {
+        if (c == '/' || c == '\\' || c == ':')
+            c = '_';
+    }
+    return std::string(MESH_CACHE_DIR) + name + ".mesh";
+}
+
+
+bool load_mesh_cache(Model* cModel)
+{
+    const std::string sourcePath = cModel->baseDir + cModel->MODEL_PATH;
+    const std::string cachePath = mesh_cache_path(sourcePath);
+
+    uint64_t sourceSize = 0;
+    int64_t sourceMTime = source_mtime(sourcePath, &sourceSize);
+    if (!sourceMTime)
+        return false;
+
+    it_MappedFile cache;
+    if (!map_file(cachePath, &cache))
+        return false;
+
+    it_MeshCacheHeader header;
+    bool valid = cache.size >= sizeof(header);
+    if (valid)
+    {
+        memcpy(&header, cache.data, sizeof(header));
+        valid = header.magic == MESH_CACHE_MAGIC && header.version == MESH_CACHE_VERSION
+            && header.vertexStride == sizeof(Vertex) && header.indexStride == sizeof(uint32_t)
+            && header.buildFlags == MESH_CACHE_BUILD_FLAGS
+            && header.pathHash == hash_bytes(sourcePath.data(), sourcePath.size())
+            && header.sourceSize == sourceSize
+            && header.vertexCount <= UINT32_MAX
+            && range_inside(header.vertexOffset, header.vertexCount, sizeof(Vertex), cache.size)
+            && range_inside(header.indexOffset, header.indexCount, sizeof(uint32_t), cache.size)
+            && header.lodCount > 0 && header.lodCount <= MESH_MAX_LODS
+            && range_inside(header.lodOffset, header.lodCount, sizeof(it_MeshLod), cache.size)
+            && range_inside(header.meshletOffset, header.meshletCount, sizeof(it_Meshlet), cache.size)
+            && range_inside(header.meshletVertexOffset, header.meshletVertexCount, sizeof(uint32_t), cache.size)
+            && range_inside(header.meshletTriangleOffset, header.meshletTriangleBytes, 1, cache.size);
+    }
+
+    // Touched but unchanged files (checkouts, copies) only cost a hash of the source instead of a full parse
+    bool touched = valid && header.sourceMTime != sourceMTime;
+    if (touched)
+    {
+        it_MappedFile source;
+        if (!map_file(sourcePath, &source))
+        {
+            unmap_file(&cache);
+            return false;
+        }
+        valid = hash_bytes(source.data, source.size) == header.sourceHash;
+        unmap_file(&source);
+    }
+
+    if (!valid)
+    {
+        unmap_file(&cache);
+        return false;
+    }
+
+    cModel->vertices.resize(header.vertexCount);
+    cModel->indices.resize(header.indexCount);
+    memcpy(cModel->vertices.data(), cache.data + header.vertexOffset, header.vertexCount * sizeof(Vertex));
+    memcpy(cModel->indices.data(), cache.data + header.indexOffset, header.indexCount * sizeof(uint32_t));
+    cModel->lods.resize(header.lodCount);
+    memcpy(cModel->lods.data(), cache.data + header.lodOffset, header.lodCount * sizeof(it_MeshLod));
+    cModel->meshlets.meshlets.resize(header.meshletCount);
+    cModel->meshlets.vertices.resize(header.meshletVertexCount);
+    cModel->meshlets.triangles.resize(header.meshletTriangleBytes);
+    memcpy(cModel->meshlets.meshlets.data(), cache.data + header.meshletOffset, header.meshletCount * sizeof(it_Meshlet));
+    memcpy(cModel->meshlets.vertices.data(), cache.data + header.meshletVertexOffset, header.meshletVertexCount * sizeof(uint32_t));
+    memcpy(cModel->meshlets.triangles.data(), cache.data + header.meshletTriangleOffset, header.meshletTriangleBytes);
+    unmap_file(&cache);
+    if (!mesh_cache_ranges_valid(cModel))
+    {
+        cModel->vertices.clear();
+        cModel->indices.clear();
+        cModel->lods.clear();
+        cModel->meshlets = it_MeshletData();
+        return false;
+    }
+
+    cModel->material = header.material;
+    cModel->boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    cModel->boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    cModel->statsFaces = cModel->lods[0].indexCount / 3;
+
+    if (touched)
+    {
+        // refresh the stored mtime so the next load takes the fast path again
+        std::fstream f(cachePath, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(offsetof(it_MeshCacheHeader, sourceMTime));
+        f.write(reinterpret_cast<const char*>(&sourceMTime), sizeof(sourceMTime));
+    }
+    return true;
+}
+
+void write_mesh_cache(Model* cModel)
+{
+    const std::string sourcePath = cModel->baseDir + cModel->MODEL_PATH;
+    const std::string cachePath = mesh_cache_path(sourcePath);
+
+    it_MeshCacheHeader header{};
+    header.sourceMTime = source_mtime(sourcePath, &header.sourceSize);
+    if (!header.sourceMTime)
+        return;
+
+    it_MappedFile source;
+    if (!map_file(sourcePath, &source))
+        return;
+    header.sourceHash = hash_bytes(source.data, source.size);
+    unmap_file(&source);
+
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.vertexStride = sizeof(Vertex);
+    header.indexStride = sizeof(uint32_t);
+    header.buildFlags = MESH_CACHE_BUILD_FLAGS;
+    header.pathHash = hash_bytes(sourcePath.data(), sourcePath.size());
+    header.vertexCount = cModel->vertices.size();
+    header.indexCount = cModel->indices.size();
+    header.vertexOffset = align_offset(sizeof(header));
+    header.indexOffset = align_offset(header.vertexOffset + header.vertexCount * sizeof(Vertex));
+    header.lodCount = cModel->lods.size();
+    header.lodOffset = align_offset(header.indexOffset + header.indexCount * sizeof(uint32_t));
+    header.meshletCount = cModel->meshlets.meshlets.size();
+    header.meshletOffset = align_offset(header.lodOffset + header.lodCount * sizeof(it_MeshLod));
+    header.meshletVertexCount = cModel->meshlets.vertices.size();
+    header.meshletVertexOffset = align_offset(header.meshletOffset + header.meshletCount * sizeof(it_Meshlet));
+    header.meshletTriangleBytes = cModel->meshlets.triangles.size();
+    header.meshletTriangleOffset = align_offset(header.meshletVertexOffset + header.meshletVertexCount * sizeof(uint32_t));
+    for (int i = 0; i < 3; ++i)
+    {
+        header.boundsMin[i] = cModel->boundsMin[i];
+        header.boundsMax[i] = cModel->boundsMax[i];
+    }
+    header.material = cModel->material;
+
+    std::error_code ec;
+    std::filesystem::create_directories(MESH_CACHE_DIR, ec);
+
+    // write next to the target and rename so a crash never leaves a truncated entry behind. Scenes load models in
+    // parallel and may reference one file twice, so the temporary name is per thread.
+    const std::string tmpPath = cachePath + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream f(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!f.is_open())
+            return;
+
+        static const char padding[16] = {};
+        f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        f.write(padding, header.vertexOffset - sizeof(header));
+        f.write(reinterpret_cast<const char*>(cModel->vertices.data()), header.vertexCount * sizeof(Vertex));
+        f.write(padding, header.indexOffset - (header.vertexOffset + header.vertexCount * sizeof(Vertex)));
+        f.write(reinterpret_cast<const char*>(cModel->indices.data()), header.indexCount * sizeof(uint32_t));
+        f.write(padding, header.lodOffset - (header.indexOffset + header.indexCount * sizeof(uint32_t)));
+        f.write(reinterpret_cast<const char*>(cModel->lods.data()), header.lodCount * sizeof(it_MeshLod));
+        f.write(padding, header.meshletOffset - (header.lodOffset + header.lodCount * sizeof(it_MeshLod)));
+        f.write(reinterpret_cast<const char*>(cModel->meshlets.meshlets.data()), header.meshletCount * sizeof(it_Meshlet));
+        f.write(padding, header.meshletVertexOffset - (header.meshletOffset + header.meshletCount * sizeof(it_Meshlet)));
+        f.write(reinterpret_cast<const char*>(cModel->meshlets.vertices.data()), header.meshletVertexCount * sizeof(uint32_t));
+        f.write(padding, header.meshletTriangleOffset - (header.meshletVertexOffset + header.meshletVertexCount * sizeof(uint32_t)));
+        f.write(reinterpret_cast<const char*>(cModel->meshlets.triangles.data()), header.meshletTriangleBytes);
+        if (!f.good())
+        {
+            f.close();
+            std::filesystem::remove(tmpPath, ec);
+            return;
+        }
+    }
+    std::filesystem::rename(tmpPath, cachePath, ec);
+    if (ec)
+        std::filesystem::remove(tmpPath, ec);
+}
@@ -0,0 +1,945 @@
+#include "MeshProcessing.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TANGENT_AVX_TARGET
+#else
+#define TANGENT_AVX_TARGET __attribute__((target("avx")))
+#endif
+
+
+// Triangles per parallel work item
+#define TANGENT_BATCH_SIZE 16384
+
+
+static bool s_useAvx = true;
+
+struct it_CornerFrames
+{
+	std::vector<float> tx, ty, tz;
+	std::vector<float> bx, by, bz;
+};
+
+
+static inline __m128 gather4(const float* stream, const uint32_t* indices, size_t tri, size_t corner)
+{
+    return _mm_setr_ps(stream[indices[(tri + 0) * 3 + corner]], stream[indices[(tri + 1) * 3 + corner]],
+        stream[indices[(tri + 2) * 3 + corner]], stream[indices[(tri + 3) * 3 + corner]]);
+}
+
+// 1 / sqrt(x) with a real division, matching glm::normalize exactly
+static inline __m128 inverse_length(__m128 x, __m128 y, __m128 z)
+{
+    __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+    return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(dot));
+}
+
+// Four triangles per iteration, one per lane. Same operation order as the scalar glm code it replaced.
+static void legacy_triangle_frames(const it_TangentStreams* s, const uint32_t* indices, size_t first, size_t last, it_CornerFrames* out)
+{
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 infinity = _mm_set1_ps(INFINITY);
+    const __m128 zero = _mm_setzero_ps();
+
+    size_t tri = first;
+    for (; tri + 4 <= last; tri += 4)
+    {
+        __m128 p0x = gather4(s->px.data(), indices, tri, 0), p0y = gather4(s->py.data(), indices, tri, 0), p0z = gather4(s->pz.data(), indices, tri, 0);
+        __m128 e1x = _mm_sub_ps(gather4(s->px.data(), indices, tri, 1), p0x);
+        __m128 e1y = _mm_sub_ps(gather4(s->py.data(), indices, tri, 1), p0y);
+        __m128 e1z = _mm_sub_ps(gather4(s->pz.data(), indices, tri, 1), p0z);
+        __m128 e2x = _mm_sub_ps(gather4(s->px.data(), indices, tri, 2), p0x);
+        __m128 e2y = _mm_sub_ps(gather4(s->py.data(), indices, tri, 2), p0y);
+        __m128 e2z = _mm_sub_ps(gather4(s->pz.data(), indices, tri, 2), p0z);
+
+        __m128 uv0u = gather4(s->u.data(), indices, tri, 0), uv0v = gather4(s->v.data(), indices, tri, 0);
+        __m128 d1u = _mm_sub_ps(gather4(s->u.data(), indices, tri, 1), uv0u);
+        __m128 d1v = _mm_sub_ps(gather4(s->v.data(), indices, tri, 1), uv0v);
+        __m128 d2u = _mm_sub_ps(gather4(s->u.data(), indices, tri, 2), uv0u);
+        __m128 d2v = _mm_sub_ps(gather4(s->v.data(), indices, tri, 2), uv0v);
+
+        __m128 f = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sub_ps(_mm_mul_ps(d1u, d2v), _mm_mul_ps(d2u, d1v)));
+        // degenerate uv mapping: f is inf or nan and gets replaced by 0
+        f = _mm_and_ps(f, _mm_cmplt_ps(_mm_and_ps(f, absMask), infinity));
+
+        __m128 tx = _mm_mul_ps(f, _mm_sub_ps(_mm_mul_ps(d2v, e1x), _mm_mul_ps(d1v, e2x)));
+        __m128 ty = _mm_mul_ps(f, _mm_sub_ps(_mm_mul_ps(d2v, e1y), _mm_mul_ps(d1v, e2y)));
+        __m128 tz = _mm_mul_ps(f, _mm_sub_ps(_mm_mul_ps(d2v, e1z), _mm_mul_ps(d1v, e2z)));
+        __m128 inv = inverse_length(tx, ty, tz);
+        tx = _mm_mul_ps(tx, inv);
+        ty = _mm_mul_ps(ty, inv);
+        tz = _mm_mul_ps(tz, inv);
+
+        __m128 nd2u = _mm_xor_ps(d2u, _mm_set1_ps(-0.0f));
+        __m128 bx = _mm_mul_ps(f, _mm_add_ps(_mm_mul_ps(nd2u, e1x), _mm_mul_ps(d1u, e2x)));
+        __m128 by = _mm_mul_ps(f, _mm_add_ps(_mm_mul_ps(nd2u, e1y), _mm_mul_ps(d1u, e2y)));
+        __m128 bz = _mm_mul_ps(f, _mm_add_ps(_mm_mul_ps(nd2u, e1z), _mm_mul_ps(d1u, e2z)));
+        inv = inverse_length(bx, by, bz);
+        bx = _mm_mul_ps(bx, inv);
+        by = _mm_mul_ps(by, inv);
+        bz = _mm_mul_ps(bz, inv);
+
+        // flip the tangent when (n0 x t) points away from the bitangent
+        __m128 n0x = gather4(s->nx.data(), indices, tri, 0), n0y = gather4(s->ny.data(), indices, tri, 0), n0z = gather4(s->nz.data(), indices, tri, 0);
+        __m128 cx = _mm_sub_ps(_mm_mul_ps(n0y, tz), _mm_mul_ps(ty, n0z));
+        __m128 cy = _mm_sub_ps(_mm_mul_ps(n0z, tx), _mm_mul_ps(tz, n0x));
+        __m128 cz = _mm_sub_ps(_mm_mul_ps(n0x, ty), _mm_mul_ps(tx, n0y));
+        __m128 handedness = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, bx), _mm_mul_ps(cy, by)), _mm_mul_ps(cz, bz));
+        __m128 flip = _mm_and_ps(_mm_cmplt_ps(handedness, zero), _mm_set1_ps(-0.0f));
+        tx = _mm_xor_ps(tx, flip);
+        ty = _mm_xor_ps(ty, flip);
+        tz = _mm_xor_ps(tz, flip);
+
+        _mm_storeu_ps(&out->tx[tri], tx);
+        _mm_storeu_ps(&out->ty[tri], ty);
+        _mm_storeu_ps(&out->tz[tri], tz);
+        _mm_storeu_ps(&out->bx[tri], bx);
+        _mm_storeu_ps(&out->by[tri], by);
+        _mm_storeu_ps(&out->bz[tri], bz);
+    }
+
+    for (; tri < last; ++tri)
+    {
+        const uint32_t i0 = indices[tri * 3 + 0], i1 = indices[tri * 3 + 1], i2 = indices[tri * 3 + 2];
+        float e1x = s->px[i1] - s->px[i0], e1y = s->py[i1] - s->py[i0], e1z = s->pz[i1] - s->pz[i0];
+        float e2x = s->px[i2] - s->px[i0], e2y = s->py[i2] - s->py[i0], e2z = s->pz[i2] - s->pz[i0];
+        float d1u = s->u[i1] - s->u[i0], d1v = s->v[i1] - s->v[i0];
+        float d2u = s->u[i2] - s->u[i0], d2v = s->v[i2] - s->v[i0];
+
+        float f = 1.0f / (d1u * d2v - d2u * d1v);
+        if (!std::isfinite(f))
+            f = 0.0f;
+
+        float tx = f * (d2v * e1x - d1v * e2x), ty = f * (d2v * e1y - d1v * e2y), tz = f * (d2v * e1z - d1v * e2z);
+        float inv = 1.0f / std::sqrt((tx * tx + ty * ty) + tz * tz);
+        tx *= inv; ty *= inv; tz *= inv;
+
+        float bx = f * (-d2u * e1x + d1u * e2x), by = f * (-d2u * e1y + d1u * e2y), bz = f * (-d2u * e1z + d1u * e2z);
+        inv = 1.0f / std::sqrt((bx * bx + by * by) + bz * bz);
+        bx *= inv; by *= inv; bz *= inv;
+
+        float nx = s->nx[i0], ny = s->ny[i0], nz = s->nz[i0];
+        float handedness = ((ny * tz - ty * nz) * bx + (nz * tx - tz * nx) * by) + (nx * ty - tx * ny) * bz;
+        if (handedness < 0.0f)
+        {
+            tx = -tx; ty = -ty; tz = -tz;
+        }
+
+        out->tx[tri] = tx; out->ty[tri] = ty; out->tz[tri] = tz;
+        out->bx[tri] = bx; out->by[tri] = by; out->bz[tri] = bz;
+    }
+}
+
+TANGENT_AVX_TARGET static inline __m256 gather8(const float* stream, const uint32_t* indices, size_t tri, size_t corner)
+{
+    return _mm256_setr_ps(stream[indices[(tri + 0) * 3 + corner]], stream[indices[(tri + 1) * 3 + corner]],
+        stream[indices[(tri + 2) * 3 + corner]], stream[indices[(tri + 3) * 3 + corner]],
+        stream[indices[(tri + 4) * 3 + corner]], stream[indices[(tri + 5) * 3 + corner]],
+        stream[indices[(tri + 6) * 3 + corner]], stream[indices[(tri + 7) * 3 + corner]]);
+}
+
+TANGENT_AVX_TARGET static inline __m256 inverse_length8(__m256 x, __m256 y, __m256 z)
+{
+    __m256 dot = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+    return _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(dot));
+}
+
+// Eight triangles per iteration with the SSE kernel's operations lane for lane, so both give identical frames. The
+// remainder goes through the SSE kernel.
+TANGENT_AVX_TARGET static void legacy_triangle_frames_avx(const it_TangentStreams* s, const uint32_t* indices, size_t first, size_t last, it_CornerFrames* out)
+{
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    const __m256 infinity = _mm256_set1_ps(INFINITY);
+    const __m256 zero = _mm256_setzero_ps();
+
+    size_t tri = first;
+    for (; tri + 8 <= last; tri += 8)
+    {
+        __m256 p0x = gather8(s->px.data(), indices, tri, 0), p0y = gather8(s->py.data(), indices, tri, 0), p0z = gather8(s->pz.data(), indices, tri, 0);
+        __m256 e1x = _mm256_sub_ps(gather8(s->px.data(), indices, tri, 1), p0x);
+        __m256 e1y = _mm256_sub_ps(gather8(s->py.data(), indices, tri, 1), p0y);
+        __m256 e1z = _mm256_sub_ps(gather8(s->pz.data(), indices, tri, 1), p0z);
+        __m256 e2x = _mm256_sub_ps(gather8(s->px.data(), indices, tri, 2), p0x);
+        __m256 e2y = _mm256_sub_ps(gather8(s->py.data(), indices, tri, 2), p0y);
+        __m256 e2z = _mm256_sub_ps(gather8(s->pz.data(), indices, tri, 2), p0z);
+
+        __m256 uv0u = gather8(s->u.data(), indices, tri, 0), uv0v = gather8(s->v.data(), indices, tri, 0);
+        __m256 d1u = _mm256_sub_ps(gather8(s->u.data(), indices, tri, 1), uv0u);
+        __m256 d1v = _mm256_sub_ps(gather8(s->v.data(), indices, tri, 1), uv0v);
+        __m256 d2u = _mm256_sub_ps(gather8(s->u.data(), indices, tri, 2), uv0u);
+        __m256 d2v = _mm256_sub_ps(gather8(s->v.data(), indices, tri, 2), uv0v);
+
+        __m256 f = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sub_ps(_mm256_mul_ps(d1u, d2v), _mm256_mul_ps(d2u, d1v)));
+        f = _mm256_and_ps(f, _mm256_cmp_ps(_mm256_and_ps(f, absMask), infinity, _CMP_LT_OQ));
+
+        __m256 tx = _mm256_mul_ps(f, _mm256_sub_ps(_mm256_mul_ps(d2v, e1x), _mm256_mul_ps(d1v, e2x)));
+        __m256 ty = _mm256_mul_ps(f, _mm256_sub_ps(_mm256_mul_ps(d2v, e1y), _mm256_mul_ps(d1v, e2y)));
+        __m256 tz = _mm256_mul_ps(f, _mm256_sub_ps(_mm256_mul_ps(d2v, e1z), _mm256_mul_ps(d1v, e2z)));
+        __m256 inv = inverse_length8(tx, ty, tz);
+        tx = _mm256_mul_ps(tx, inv);
+        ty = _mm256_mul_ps(ty, inv);
+        tz = _mm256_mul_ps(tz, inv);
+
+        __m256 nd2u = _mm256_xor_ps(d2u, _mm256_set1_ps(-0.0f));
+        __m256 bx = _mm256_mul_ps(f, _mm256_add_ps(_mm256_mul_ps(nd2u, e1x), _mm256_mul_ps(d1u, e2x)));
+        __m256 by = _mm256_mul_ps(f, _mm256_add_ps(_mm256_mul_ps(nd2u, e1y), _mm256_mul_ps(d1u, e2y)));
+        __m256 bz = _mm256_mul_ps(f, _mm256_add_ps(_mm256_mul_ps(nd2u, e1z), _mm256_mul_ps(d1u, e2z)));
+        inv = inverse_length8(bx, by, bz);
+        bx = _mm256_mul_ps(bx, inv);
+        by = _mm256_mul_ps(by, inv);
+        bz = _mm256_mul_ps(bz, inv);
+
+        __m256 n0x = gather8(s->nx.data(), indices, tri, 0), n0y = gather8(s->ny.data(), indices, tri, 0), n0z = gather8(s->nz.data(), indices, tri, 0);
+        __m256 cx = _mm256_sub_ps(_mm256_mul_ps(n0y, tz), _mm256_mul_ps(ty, n0z));
+        __m256 cy = _mm256_sub_ps(_mm256_mul_ps(n0z, tx), _mm256_mul_ps(tz, n0x));
+        __m256 cz = _mm256_sub_ps(_mm256_mul_ps(n0x, ty), _mm256_mul_ps(tx, n0y));
+        __m256 handedness = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, bx), _mm256_mul_ps(cy, by)), _mm256_mul_ps(cz, bz));
+        __m256 flip = _mm256_and_ps(_mm256_cmp_ps(handedness, zero, _CMP_LT_OQ), _mm256_set1_ps(-0.0f));
+        tx = _mm256_xor_ps(tx, flip);
+        ty = _mm256_xor_ps(ty, flip);
+        tz = _mm256_xor_ps(tz, flip);
+
+        _mm256_storeu_ps(&out->tx[tri], tx);
+        _mm256_storeu_ps(&out->ty[tri], ty);
+        _mm256_storeu_ps(&out->tz[tri], tz);
+        _mm256_storeu_ps(&out->bx[tri], bx);
+        _mm256_storeu_ps(&out->by[tri], by);
+        _mm256_storeu_ps(&out->bz[tri], bz);
+    }
+    legacy_triangle_frames(s, indices, tri, last, out);
+}
+
+// Angle weighted corner frames: the unnormalized triangle tangent and bitangent are projected into each corner's
+// tangent plane and weighted by the corner angle, so the result does not depend on how a surface was triangulated.
+static void angle_weighted_corner_frames(const it_TangentStreams* s, const uint32_t* indices, size_t first, size_t last, it_CornerFrames* out)
+{
+    for (size_t tri = first; tri < last; ++tri)
+    {
+        const uint32_t idx[3] = { indices[tri * 3 + 0], indices[tri * 3 + 1], indices[tri * 3 + 2] };
+        float e1x = s->px[idx[1]] - s->px[idx[0]], e1y = s->py[idx[1]] - s->py[idx[0]], e1z = s->pz[idx[1]] - s->pz[idx[0]];
+        float e2x = s->px[idx[2]] - s->px[idx[0]], e2y = s->py[idx[2]] - s->py[idx[0]], e2z = s->pz[idx[2]] - s->pz[idx[0]];
+        float d1u = s->u[idx[1]] - s->u[idx[0]], d1v = s->v[idx[1]] - s->v[idx[0]];
+        float d2u = s->u[idx[2]] - s->u[idx[0]], d2v = s->v[idx[2]] - s->v[idx[0]];
+
+        float det = d1u * d2v - d2u * d1v;
+        float f = std::fabs(det) > 1e-20f ? 1.0f / det : 0.0f;
+        float sx = f * (d2v * e1x - d1v * e2x), sy = f * (d2v * e1y - d1v * e2y), sz = f * (d2v * e1z - d1v * e2z);
+        float rx = f * (d1u * e2x - d2u * e1x), ry = f * (d1u * e2y - d2u * e1y), rz = f * (d1u * e2z - d2u * e1z);
+
+        for (int c = 0; c < 3; ++c)
+        {
+            const uint32_t i = idx[c], a = idx[(c + 1) % 3], b = idx[(c + 2) % 3];
+            float ax = s->px[a] - s->px[i], ay = s->py[a] - s->py[i], az = s->pz[a] - s->pz[i];
+            float bx = s->px[b] - s->px[i], by = s->py[b] - s->py[i], bz = s->pz[b] - s->pz[i];
+            float la = std::sqrt(ax * ax + ay * ay + az * az), lb = std::sqrt(bx * bx + by * by + bz * bz);
+            float angle = 0.0f;
+            if (la > 0.0f && lb > 0.0f)
+                angle = std::acos(std::fmax(-1.0f, std::fmin(1.0f, (ax * bx + ay * by + az * bz) / (la * lb))));
+
+            // Gram-Schmidt against the vertex normal
+            float nx = s->nx[i], ny = s->ny[i], nz = s->nz[i];
+            float dt = nx * sx + ny * sy + nz * sz;
+            float tx = sx - nx * dt, ty = sy - ny * dt, tz = sz - nz * dt;
+            float lt = std::sqrt(tx * tx + ty * ty + tz * tz);
+            float wt = lt > 0.0f ? angle / lt : 0.0f;
+
+            float db = nx * rx + ny * ry + nz * rz;
+            float qx = rx - nx * db, qy = ry - ny * db, qz = rz - nz * db;
+            float lq = std::sqrt(qx * qx + qy * qy + qz * qz);
+            float wb = lq > 0.0f ? angle / lq : 0.0f;
+
+            const size_t corner = tri * 3 + c;
+            out->tx[corner] = tx * wt; out->ty[corner] = ty * wt; out->tz[corner] = tz * wt;
+            out->bx[corner] = qx * wb; out->by[corner] = qy * wb; out->bz[corner] = qz * wb;
+        }
+    }
+}
+
+
+bool tangent_avx_supported()
+{
+    static const bool supported = []() {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+        // the OS must save the upper halves of the ymm registers
+        return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+        return __builtin_cpu_supports("avx") != 0;
+#endif
+    }();
+    return supported;
+}
+
+void tangent_use_avx(bool enabled)
+{
+    s_useAvx = enabled;
+}
+
+void compute_tangents(it_TangentStreams* streams, const uint32_t* indices, size_t indexCount, int mode)
+{
+    const size_t vertexCount = streams->px.size();
+    const size_t triangleCount = indexCount / 3;
+    const bool angleWeighted = mode == TANGENT_MODE_ANGLE_WEIGHTED;
+
+    // legacy frames are per triangle, angle weighted frames per corner
+    it_CornerFrames frames;
+    const size_t frameCount = angleWeighted ? triangleCount * 3 : triangleCount;
+    frames.tx.resize(frameCount); frames.ty.resize(frameCount); frames.tz.resize(frameCount);
+    frames.bx.resize(frameCount); frames.by.resize(frameCount); frames.bz.resize(frameCount);
+
+    const size_t batchCount = (triangleCount + TANGENT_BATCH_SIZE - 1) / TANGENT_BATCH_SIZE;
+    parallel_for(batchCount, [&](size_t batch) {
+        size_t first = batch * TANGENT_BATCH_SIZE;
+        size_t last = std::min(first + TANGENT_BATCH_SIZE, triangleCount);
+        if (angleWeighted)
+            angle_weighted_corner_frames(streams, indices, first, last, &frames);
+        else if (s_useAvx && tangent_avx_supported())
+            legacy_triangle_frames_avx(streams, indices, first, last, &frames);
+        else
+            legacy_triangle_frames(streams, indices, first, last, &frames);
+    });
+
+    // Vertex to corner adjacency (CSR). Corners are listed in ascending order, so every vertex sums its contributions
+    // in the same order the old serial loop did and no two threads ever write the same vertex.
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+        offsets[indices[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; ++v)
+        offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> corners(triangleCount * 3);
+    {
+        std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i)
+            corners[cursor[indices[i]]++] = static_cast<uint32_t>(i);
+    }
+
+    streams->tx.assign(vertexCount, 0.0f); streams->ty.assign(vertexCount, 0.0f); streams->tz.assign(vertexCount, 0.0f);
+    streams->bx.assign(vertexCount, 0.0f); streams->by.assign(vertexCount, 0.0f); streams->bz.assign(vertexCount, 0.0f);
+    streams->tangentSign.assign(vertexCount, 1.0f);
+
+    const size_t vertexBatchCount = (vertexCount + TANGENT_BATCH_SIZE - 1) / TANGENT_BATCH_SIZE;
+    parallel_for(vertexBatchCount, [&](size_t batch) {
+        size_t first = batch * TANGENT_BATCH_SIZE;
+        size_t last = std::min(first + TANGENT_BATCH_SIZE, vertexCount);
+        for (size_t v = first; v < last; ++v)
+        {
+            float tx = 0.0f, ty = 0.0f, tz = 0.0f, bx = 0.0f, by = 0.0f, bz = 0.0f;
+            for (uint32_t c = offsets[v]; c < offsets[v + 1]; ++c)
+            {
+                const size_t frame = angleWeighted ? corners[c] : corners[c] / 3;
+                tx += frames.tx[frame]; ty += frames.ty[frame]; tz += frames.tz[frame];
+                bx += frames.bx[frame]; by += frames.by[frame]; bz += frames.bz[frame];
+            }
+
+            if (angleWeighted && !((tx * tx + ty * ty) + tz * tz > 0.0f))
+            {
+                // no usable uv gradient around this vertex, any direction in the tangent plane will do
+                float nx = streams->nx[v], ny = streams->ny[v], nz = streams->nz[v];
+                bool useX = std::fabs(nx) < 0.9f;
+                tx = useX ? 1.0f - nx * nx : -ny * nx;
+                ty = useX ? -nx * ny : 1.0f - ny * ny;
+                tz = useX ? -nx * nz : -ny * nz;
+            }
+
+            float inv = 1.0f / std::sqrt((tx * tx + ty * ty) + tz * tz);
+            tx *= inv; ty *= inv; tz *= inv;
+
+            if (angleWeighted)
+            {
+                // the bitangent is rebuilt from the normal and tangent, only its orientation is kept
+                float nx = streams->nx[v], ny = streams->ny[v], nz = streams->nz[v];
+                float cx = ny * tz - nz * ty, cy = nz * tx - nx * tz, cz = nx * ty - ny * tx;
+                float sign = (cx * bx + cy * by + cz * bz) < 0.0f ? -1.0f : 1.0f;
+                streams->tangentSign[v] = sign;
+                bx = cx * sign; by = cy * sign; bz = cz * sign;
+            }
+            else
+            {
+                inv = 1.0f / std::sqrt((bx * bx + by * by) + bz * bz);
+                bx *= inv; by *= inv; bz *= inv;
+            }
+
+            streams->tx[v] = tx; streams->ty[v] = ty; streams->tz[v] = tz;
+            streams->bx[v] = bx; streams->by[v] = by; streams->bz[v] = bz;
+        }
+    });
+}
+
+
+it_VertexCacheStats analyze_vertex_cache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+    it_VertexCacheStats stats;
+    if (indexCount < 3)
+        return stats;
+
+    // cacheTime[v] is the miss counter value when v entered the FIFO, it is still cached while it is among the last cacheSize entries
+    std::vector<size_t> cacheTime(vertexCount, 0);
+    std::vector<uint8_t> referenced(vertexCount, 0);
+    size_t misses = 0;
+    size_t uniqueCount = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        uint32_t v = indices[i];
+        if (!referenced[v])
+        {
+            referenced[v] = 1;
+            uniqueCount++;
+        }
+        if (cacheTime[v] == 0 || misses + 1 - cacheTime[v] > cacheSize)
+        {
+            misses++;
+            cacheTime[v] = misses;
+        }
+    }
+
+    stats.acmr = static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+    stats.atvr = static_cast<float>(misses) / static_cast<float>(uniqueCount);
+    return stats;
+}
+
+void optimize_vertex_cache(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0 || vertexCount == 0)
+        return;
+
+    // vertex -> triangle adjacency
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+        offsets[indices[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; ++v)
+        offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+        std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i)
+            adjacency[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<uint32_t> liveTriangles(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        liveTriangles[v] = offsets[v + 1] - offsets[v];
+
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+
+    uint32_t timestamp = cacheSize + 1;
+    size_t cursor = 0;
+    int64_t fanning = 0;
+    while (fanning >= 0)
+    {
+        candidates.clear();
+        for (uint32_t a = offsets[fanning]; a < offsets[fanning + 1]; ++a)
+        {
+            uint32_t tri = adjacency[a];
+            if (emitted[tri])
+                continue;
+            for (int c = 0; c < 3; ++c)
+            {
+                uint32_t v = indices[tri * 3 + c];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (timestamp - cacheTime[v] > cacheSize)
+                    cacheTime[v] = timestamp++;
+            }
+            emitted[tri] = 1;
+        }
+
+        // prefer a candidate that will still be in the cache after its remaining triangles are emitted
+        int64_t next = -1;
+        int64_t bestPriority = -1;
+        for (uint32_t v : candidates)
+        {
+            if (liveTriangles[v] == 0)
+                continue;
+            int64_t priority = 0;
+            if (timestamp - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+                priority = timestamp - cacheTime[v];
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+
+        if (next == -1)
+        {
+            // dead end: go back through recently used vertices, then scan forward for any vertex with work left
+            while (!deadEnd.empty() && next == -1)
+            {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveTriangles[v] > 0)
+                    next = v;
+            }
+            while (next == -1 && cursor < vertexCount)
+            {
+                if (liveTriangles[cursor] > 0)
+                    next = static_cast<int64_t>(cursor);
+                cursor++;
+            }
+        }
+        fanning = next;
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+// Forsyth scoring constants from the original article
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+static float forsyth_vertex_score(int32_t cachePosition, uint32_t liveTriangles, uint32_t cacheSize)
+{
+    if (liveTriangles == 0)
+        return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        // the last triangle's vertices get a fixed score so the next triangle does not just reuse its edge
+        if (cachePosition < 3)
+            score = FORSYTH_LAST_TRIANGLE_SCORE;
+        else
+            score = std::pow(1.0f - static_cast<float>(cachePosition - 3) / static_cast<float>(cacheSize - 3), FORSYTH_CACHE_DECAY_POWER);
+    }
+    // vertices with few triangles left are finished first so they do not come back later as isolated misses
+    return score + FORSYTH_VALENCE_BOOST_SCALE * std::pow(static_cast<float>(liveTriangles), -FORSYTH_VALENCE_BOOST_POWER);
+}
+
+void optimize_vertex_cache_forsyth(uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0 || vertexCount == 0 || cacheSize <= 3)
+        return;
+
+    // vertex -> triangle adjacency, the live triangles of v are the first liveTriangles[v] entries of its range
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+        offsets[indices[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; ++v)
+        offsets[v + 1] += offsets[v];
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+        std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i)
+            adjacency[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<uint32_t> liveTriangles(vertexCount);
+    std::vector<int32_t> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        liveTriangles[v] = offsets[v + 1] - offsets[v];
+        vertexScore[v] = forsyth_vertex_score(-1, liveTriangles[v], cacheSize);
+    }
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    uint32_t best = 0;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        triangleScore[t] = vertexScore[indices[t * 3 + 0]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+        if (triangleScore[t] > triangleScore[best])
+            best = static_cast<uint32_t>(t);
+    }
+
+    // LRU cache, most recent first, with room for the three vertices pushed in front before the tail is dropped
+    std::vector<uint32_t> cache, nextCache;
+    cache.reserve(cacheSize + 3);
+    nextCache.reserve(cacheSize + 3);
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+
+    const uint32_t none = 0xFFFFFFFFu;
+    size_t cursor = 0;
+    for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+    {
+        if (best == none)
+        {
+            // nothing in the cache has work left, continue with the next triangle in input order
+            while (emitted[cursor])
+                cursor++;
+            best = static_cast<uint32_t>(cursor);
+        }
+
+        const uint32_t* corners = &indices[best * 3];
+        emitted[best] = 1;
+        nextCache.clear();
+        for (int c = 0; c < 3; ++c)
+        {
+            const uint32_t v = corners[c];
+            output.push_back(v);
+            // drop one occurrence of the triangle, a degenerate triangle is listed once per corner
+            uint32_t* live = &adjacency[offsets[v]];
+            for (uint32_t a = 0; a < liveTriangles[v]; ++a)
+            {
+                if (live[a] == best)
+                {
+                    live[a] = live[liveTriangles[v] - 1];
+                    live[liveTriangles[v] - 1] = best;
+                    break;
+                }
+            }
+            liveTriangles[v]--;
+            if (std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+                nextCache.push_back(v);
+        }
+        const size_t fresh = nextCache.size();
+        for (uint32_t v : cache)
+            if (std::find(nextCache.begin(), nextCache.begin() + fresh, v) == nextCache.begin() + fresh)
+                nextCache.push_back(v);
+
+        // rescore everything that was or is cached, then pick the best live triangle among the cached vertices
+        for (size_t i = 0; i < nextCache.size(); ++i)
+        {
+            const uint32_t v = nextCache[i];
+            cachePosition[v] = i < cacheSize ? static_cast<int32_t>(i) : -1;
+            vertexScore[v] = forsyth_vertex_score(cachePosition[v], liveTriangles[v], cacheSize);
+        }
+        best = none;
+        float bestScore = -1.0f;
+        for (uint32_t v : nextCache)
+        {
+            for (uint32_t a = offsets[v]; a < offsets[v] + liveTriangles[v]; ++a)
+            {
+                const uint32_t t = adjacency[a];
+                triangleScore[t] = vertexScore[indices[t * 3 + 0]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                if (cachePosition[v] >= 0 && triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+        if (nextCache.size() > cacheSize)
+            nextCache.resize(cacheSize);
+        cache.swap(nextCache);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+std::vector<uint32_t> optimize_vertex_fetch(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    const uint32_t unassigned = 0xFFFFFFFFu;
+    std::vector<uint32_t> remap(vertexCount, unassigned);
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        uint32_t& target = remap[indices[i]];
+        if (target == unassigned)
+            target = next++;
+        indices[i] = target;
+    }
+    for (auto& target : remap)
+    {
+        if (target == unassigned)
+            target = next++;
+    }
+    return remap;
+}
+
+struct it_Quadric
+{
+	double a2, b2, c2, ab, ac, bc, ad, bd, cd, d2;
+};
+
+static inline const float* vertex_position(const float* positions, size_t positionStride, uint32_t v)
+{
+    return reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + v * positionStride);
+}
+
+// Unit plane normal and offset, false for zero area triangles
+static bool triangle_plane(const float* p0, const float* p1, const float* p2, double plane[4])
+{
+    double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+    double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length == 0.0)
+        return false;
+    plane[0] = n[0] / length;
+    plane[1] = n[1] / length;
+    plane[2] = n[2] / length;
+    plane[3] = -(plane[0] * p0[0] + plane[1] * p0[1] + plane[2] * p0[2]);
+    return true;
+}
+
+static inline void quadric_add(it_Quadric* q, const it_Quadric& other)
+{
+    q->a2 += other.a2; q->b2 += other.b2; q->c2 += other.c2;
+    q->ab += other.ab; q->ac += other.ac; q->bc += other.bc;
+    q->ad += other.ad; q->bd += other.bd; q->cd += other.cd;
+    q->d2 += other.d2;
+}
+
+// Sum of squared distances from p to the planes accumulated in q. Planes are not area weighted, so the result is
+// never smaller than the squared distance to any single one of them.
+static inline double quadric_error(const it_Quadric& q, const float* p)
+{
+    double x = p[0], y = p[1], z = p[2];
+    double error = q.a2 * x * x + q.b2 * y * y + q.c2 * z * z
+        + 2.0 * (q.ab * x * y + q.ac * x * z + q.bc * y * z)
+        + 2.0 * (q.ad * x + q.bd * y + q.cd * z) + q.d2;
+    return error > 0.0 ? error : 0.0;
+}
+
+// Rejects the collapse if a surviving triangle around from would turn by more than ~75 degrees
+static bool collapse_flips(const float* positions, size_t positionStride, const std::vector<uint32_t>& indices,
+    const uint32_t* triangles, uint32_t triangleCount, uint32_t from, uint32_t to)
+{
+    for (uint32_t t = 0; t < triangleCount; ++t)
+    {
+        const uint32_t* tri = &indices[triangles[t] * 3];
+        if (tri[0] == to || tri[1] == to || tri[2] == to)
+            continue;
+
+        const float* p[3];
+        const float* q[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            p[c] = vertex_position(positions, positionStride, tri[c]);
+            q[c] = vertex_position(positions, positionStride, tri[c] == from ? to : tri[c]);
+        }
+        double before[4];
+        if (!triangle_plane(p[0], p[1], p[2], before))
+            continue;
+        double after[4];
+        if (!triangle_plane(q[0], q[1], q[2], after))
+            return true;
+        if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] < 0.25)
+            return true;
+    }
+    return false;
+}
+
+it_SimplifyResult simplify_mesh(const float* positions, size_t positionStride, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+    size_t targetIndexCount, float maxError)
+{
+    it_SimplifyResult result;
+    result.indices.assign(indices, indices + indexCount);
+    result.collapse.resize(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        result.collapse[v] = static_cast<uint32_t>(v);
+    if (indexCount <= targetIndexCount || vertexCount == 0)
+        return result;
+
+    // vertices split by the welder (uv or normal seams) share a position id
+    std::vector<uint32_t> order(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        order[v] = static_cast<uint32_t>(v);
+    auto position_less = [&](uint32_t a, uint32_t b) {
+        const float* pa = vertex_position(positions, positionStride, a);
+        const float* pb = vertex_position(positions, positionStride, b);
+        return std::lexicographical_compare(pa, pa + 3, pb, pb + 3);
+    };
+    std::sort(order.begin(), order.end(), position_less);
+    std::vector<uint32_t> positionId(vertexCount);
+    std::vector<uint8_t> locked(vertexCount, 0);
+    uint32_t positionCount = 0;
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        if (i > 0 && position_less(order[i - 1], order[i]))
+            positionCount++;
+        positionId[order[i]] = positionCount;
+    }
+    positionCount++;
+    std::vector<uint32_t> positionUses(positionCount, 0);
+    for (size_t v = 0; v < vertexCount; ++v)
+        positionUses[positionId[v]]++;
+
+    // an edge not shared by exactly two triangles is a border (or non manifold), its vertices stay where they are
+    std::vector<uint64_t> edges;
+    edges.reserve(indexCount);
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        for (int e = 0; e < 3; ++e)
+        {
+            uint64_t a = positionId[indices[i + e]], b = positionId[indices[i + (e + 1) % 3]];
+            edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    std::vector<uint8_t> borderPosition(positionCount, 0);
+    for (size_t i = 0; i < edges.size();)
+    {
+        size_t j = i;
+        while (j < edges.size() && edges[j] == edges[i])
+            ++j;
+        if (j - i != 2)
+        {
+            borderPosition[edges[i] >> 32] = 1;
+            borderPosition[edges[i] & 0xFFFFFFFFu] = 1;
+        }
+        i = j;
+    }
+    for (size_t v = 0; v < vertexCount; ++v)
+        locked[v] = positionUses[positionId[v]] > 1 || borderPosition[positionId[v]];
+
+    std::vector<it_Quadric> quadrics(vertexCount, it_Quadric{});
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        double plane[4];
+        if (!triangle_plane(vertex_position(positions, positionStride, indices[i]), vertex_position(positions, positionStride, indices[i + 1]),
+            vertex_position(positions, positionStride, indices[i + 2]), plane))
+            continue;
+        it_Quadric q = { plane[0] * plane[0], plane[1] * plane[1], plane[2] * plane[2],
+            plane[0] * plane[1], plane[0] * plane[2], plane[1] * plane[2],
+            plane[0] * plane[3], plane[1] * plane[3], plane[2] * plane[3], plane[3] * plane[3] };
+        for (int c = 0; c < 3; ++c)
+            quadric_add(&quadrics[indices[i + c]], q);
+    }
+
+    struct Candidate
+    {
+        uint32_t from, to;
+        double cost;
+    };
+
+    const double maxCost = static_cast<double>(maxError) * maxError;
+    const size_t targetTriangles = targetIndexCount / 3;
+    double worstCost = 0.0;
+    std::vector<uint32_t> offsets, adjacency;
+    std::vector<Candidate> candidates;
+    std::vector<uint8_t> touched;
+    for (;;)
+    {
+        size_t triangleCount = result.indices.size() / 3;
+        if (triangleCount <= targetTriangles)
+            break;
+
+        offsets.assign(vertexCount + 1, 0);
+        for (uint32_t v : result.indices)
+            offsets[v + 1]++;
+        for (size_t v = 0; v < vertexCount; ++v)
+            offsets[v + 1] += offsets[v];
+        adjacency.resize(result.indices.size());
+        {
+            std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < result.indices.size(); ++i)
+                adjacency[cursor[result.indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        // cheapest edge out of every vertex that is allowed to move
+        candidates.clear();
+        for (uint32_t u = 0; u < vertexCount; ++u)
+        {
+            if (locked[u] || offsets[u] == offsets[u + 1])
+                continue;
+            Candidate best = { u, u, 0.0 };
+            for (uint32_t a = offsets[u]; a < offsets[u + 1]; ++a)
+            {
+                const uint32_t* tri = &result.indices[adjacency[a] * 3];
+                for (int c = 0; c < 3; ++c)
+                {
+                    uint32_t w = tri[c];
+                    if (w == u)
+                        continue;
+                    it_Quadric q = quadrics[u];
+                    quadric_add(&q, quadrics[w]);
+                    double cost = quadric_error(q, vertex_position(positions, positionStride, w));
+                    if (best.to == u || cost < best.cost)
+                        best = { u, w, cost };
+                }
+            }
+            if (best.to != u && best.cost <= maxCost)
+                candidates.push_back(best);
+        }
+        if (candidates.empty())
+            break;
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.cost < b.cost; });
+
+        // remove at most half of what is left to remove per pass so later collapses see updated costs
+        size_t passTarget = std::max(targetTriangles, (triangleCount + targetTriangles) / 2);
+        touched.assign(vertexCount, 0);
+        size_t collapsed = 0;
+        for (const Candidate& candidate : candidates)
+        {
+            if (triangleCount <= passTarget)
+                break;
+            if (touched[candidate.from] || touched[candidate.to])
+                continue;
+            const uint32_t* triangles = &adjacency[offsets[candidate.from]];
+            const uint32_t around = offsets[candidate.from + 1] - offsets[candidate.from];
+            if (collapse_flips(positions, positionStride, result.indices, triangles, around, candidate.from, candidate.to))
+                continue;
+
+            for (uint32_t t = 0; t < around; ++t)
+            {
+                uint32_t* tri = &result.indices[triangles[t] * 3];
+                bool degenerate = tri[0] == candidate.to || tri[1] == candidate.to || tri[2] == candidate.to;
+                for (int c = 0; c < 3; ++c)
+                {
+                    touched[tri[c]] = 1;
+                    if (tri[c] == candidate.from)
+                        tri[c] = candidate.to;
+                }
+                if (degenerate)
+                    triangleCount--;
+            }
+            quadric_add(&quadrics[candidate.to], quadrics[candidate.from]);
+            result.collapse[candidate.from] = candidate.to;
+            worstCost = std::max(worstCost, candidate.cost);
+            touched[candidate.to] = 1;
+            collapsed++;
+        }
+        if (collapsed == 0)
+            break;
+
+        size_t write = 0;
+        for (size_t i = 0; i + 2 < result.indices.size(); i += 3)
+        {
+            uint32_t a = result.indices[i], b = result.indices[i + 1], c = result.indices[i + 2];
+            if (a == b || b == c || a == c)
+                continue;
+            result.indices[write++] = a;
+            result.indices[write++] = b;
+            result.indices[write++] = c;
+        }
+        result.indices.resize(write);
+    }
+
+    // resolve chains (a vertex collapsed into one that moved later) so collapse[] points at kept vertices
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        uint32_t target = result.collapse[v];
+        while (result.collapse[target] != target)
+            target = result.collapse[target];
+        result.collapse[v] = target;
+    }
+    result.error = static_cast<float>(std::sqrt(worstCost));
+    return result;
+}
+
+float measure_simplification_error(const float* positions, size_t positionStride, const uint32_t* indices, size_t indexCount, const std::vector<uint32_t>& collapse)
+{
+    double worst = 0.0;
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        double plane[4];
+        if (!triangle_plane(vertex_position(positions, positionStride, indices[i]), vertex_position(positions, positionStride, indices[i + 1]),
+            vertex_position(positions, positionStride, indices[i + 2]), plane))
+            continue;
+        for (int c = 0; c < 3; ++c)
+        {
+            const float* p = vertex_position(positions, positionStride, collapse[indices[i + c]]);
+            worst = std::max(worst, std::abs(plane[0] * p[0] + plane[1] * p[1] + plane[2] * p[2] + plane[3]));
+        }
+    }
+    return static_cast<float>(worst);
+}
@@ -0,0 +1,246 @@
+#include "MeshletBuilder.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+// Normal cones wider than this (cosine of the half angle) are not worth testing
+#define MESHLET_CONE_MIN_COS 0.1f
+#define MESHLET_NO_CONE 2.0f
+
+
+static inline const float* vertex_position(const float* positions, size_t positionStride, uint32_t v)
+{
+    return reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + v * positionStride);
+}
+
+static inline float dot3(const float* a, const float* b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Unit normal of a counter clockwise triangle, false for zero area
+static bool triangle_normal(const float* p0, const float* p1, const float* p2, float n[3])
+{
+    float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    float length = std::sqrt(dot3(n, n));
+    if (length == 0.0f)
+        return false;
+    n[0] /= length;
+    n[1] /= length;
+    n[2] /= length;
+    return true;
+}
+
+static void compute_meshlet_bounds(it_Meshlet* meshlet, const float* positions, size_t positionStride, const uint32_t* indices)
+{
+    const uint32_t* tri = indices + meshlet->firstIndex;
+    const size_t cornerCount = meshlet->triangleCount * 3;
+
+    // sphere around the box center, loose but cheap and order independent
+    float boxMin[3], boxMax[3];
+    const float* first = vertex_position(positions, positionStride, tri[0]);
+    for (int k = 0; k < 3; ++k)
+        boxMin[k] = boxMax[k] = first[k];
+    for (size_t i = 1; i < cornerCount; ++i)
+    {
+        const float* p = vertex_position(positions, positionStride, tri[i]);
+        for (int k = 0; k < 3; ++k)
+        {
+            boxMin[k] = std::min(boxMin[k], p[k]);
+            boxMax[k] = std::max(boxMax[k], p[k]);
+        }
+    }
+    for (int k = 0; k < 3; ++k)
+        meshlet->center[k] = (boxMin[k] + boxMax[k]) * 0.5f;
+    float radius2 = 0.0f;
+    for (size_t i = 0; i < cornerCount; ++i)
+    {
+        const float* p = vertex_position(positions, positionStride, tri[i]);
+        float d[3] = { p[0] - meshlet->center[0], p[1] - meshlet->center[1], p[2] - meshlet->center[2] };
+        radius2 = std::max(radius2, dot3(d, d));
+    }
+    meshlet->radius = std::sqrt(radius2);
+
+    // normal cone: axis is the mean normal, the half angle is set by the normal furthest from it
+    float normals[MESHLET_MAX_TRIANGLES][3];
+    bool valid[MESHLET_MAX_TRIANGLES];
+    float axis[3] = { 0.0f, 0.0f, 0.0f };
+    for (uint32_t t = 0; t < meshlet->triangleCount; ++t)
+    {
+        valid[t] = triangle_normal(vertex_position(positions, positionStride, tri[t * 3]), vertex_position(positions, positionStride, tri[t * 3 + 1]),
+            vertex_position(positions, positionStride, tri[t * 3 + 2]), normals[t]);
+        if (!valid[t])
+            continue;
+        axis[0] += normals[t][0];
+        axis[1] += normals[t][1];
+        axis[2] += normals[t][2];
+    }
+
+    float axisLength = std::sqrt(dot3(axis, axis));
+    float minCos = 1.0f;
+    if (axisLength > 0.0f)
+    {
+        for (int k = 0; k < 3; ++k)
+            axis[k] /= axisLength;
+        for (uint32_t t = 0; t < meshlet->triangleCount; ++t)
+        {
+            if (valid[t])
+                minCos = std::min(minCos, dot3(axis, normals[t]));
+        }
+    }
+    for (int k = 0; k < 3; ++k)
+    {
+        meshlet->coneAxis[k] = axis[k];
+        meshlet->coneApex[k] = meshlet->center[k];
+    }
+    if (axisLength == 0.0f || minCos < MESHLET_CONE_MIN_COS)
+    {
+        meshlet->coneCutoff = MESHLET_NO_CONE;
+        return;
+    }
+
+    // move the apex back along the axis until every triangle plane has it on its back side
+    float maxT = 0.0f;
+    for (uint32_t t = 0; t < meshlet->triangleCount; ++t)
+    {
+        if (!valid[t])
+            continue;
+        const float* p0 = vertex_position(positions, positionStride, tri[t * 3]);
+        float toCenter[3] = { meshlet->center[0] - p0[0], meshlet->center[1] - p0[1], meshlet->center[2] - p0[2] };
+        maxT = std::max(maxT, dot3(toCenter, normals[t]) / dot3(axis, normals[t]));
+    }
+    for (int k = 0; k < 3; ++k)
+        meshlet->coneApex[k] = meshlet->center[k] - axis[k] * maxT;
+    meshlet->coneCutoff = std::sqrt(1.0f - minCos * minCos);
+}
+
+
+void build_meshlets(const float* positions, size_t positionStride, size_t vertexCount, const uint32_t* indices, size_t indexCount, it_MeshletData* out)
+{
+    out->meshlets.clear();
+    out->vertices.clear();
+    out->triangles.clear();
+    out->vertices.reserve(indexCount / 3);
+    out->triangles.reserve(indexCount);
+
+    const uint8_t unused = 0xFF;
+    std::vector<uint8_t> localIndex(vertexCount, unused);
+    it_Meshlet current{};
+
+    auto flush = [&]() {
+        for (uint32_t i = 0; i < current.vertexCount; ++i)
+            localIndex[out->vertices[current.vertexOffset + i]] = unused;
+        out->meshlets.push_back(current);
+        current = it_Meshlet{};
+        current.vertexOffset = static_cast<uint32_t>(out->vertices.size());
+        current.triangleOffset = static_cast<uint32_t>(out->triangles.size());
+    };
+
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        const uint32_t* tri = indices + i;
+        uint32_t newVertices = (localIndex[tri[0]] == unused) + (localIndex[tri[1]] == unused && tri[1] != tri[0])
+            + (localIndex[tri[2]] == unused && tri[2] != tri[0] && tri[2] != tri[1]);
+        if (current.vertexCount + newVertices > MESHLET_MAX_VERTICES || current.triangleCount == MESHLET_MAX_TRIANGLES)
+            flush();
+        if (current.triangleCount == 0)
+            current.firstIndex = static_cast<uint32_t>(i);
+
+        for (int c = 0; c < 3; ++c)
+        {
+            uint8_t& local = localIndex[tri[c]];
+            if (local == unused)
+            {
+                local = static_cast<uint8_t>(current.vertexCount++);
+                out->vertices.push_back(tri[c]);
+            }
+            out->triangles.push_back(local);
+        }
+        current.triangleCount++;
+    }
+    if (current.triangleCount > 0)
+        flush();
+
+    parallel_for(out->meshlets.size(), [&](size_t m) {
+        compute_meshlet_bounds(&out->meshlets[m], positions, positionStride, indices);
+    });
+}
+
+bool validate_meshlets(const it_MeshletData& data, const float* positions, size_t positionStride, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+    std::string* err)
+{
+    auto fail = [&](size_t m, const std::string& what) {
+        if (err)
+            *err = "meshlet " + std::to_string(m) + ": " + what;
+        return false;
+    };
+
+    size_t nextIndex = 0;
+    for (size_t m = 0; m < data.meshlets.size(); ++m)
+    {
+        const it_Meshlet& meshlet = data.meshlets[m];
+        if (meshlet.vertexCount > MESHLET_MAX_VERTICES || meshlet.triangleCount > MESHLET_MAX_TRIANGLES || meshlet.triangleCount == 0)
+            return fail(m, "limits exceeded");
+        if (meshlet.firstIndex != nextIndex || meshlet.vertexOffset + meshlet.vertexCount > data.vertices.size()
+            || meshlet.triangleOffset + meshlet.triangleCount * 3u > data.triangles.size())
+            return fail(m, "ranges are not contiguous");
+        nextIndex += meshlet.triangleCount * 3u;
+
+        for (uint32_t c = 0; c < meshlet.triangleCount * 3u; ++c)
+        {
+            uint8_t local = data.triangles[meshlet.triangleOffset + c];
+            if (local >= meshlet.vertexCount)
+                return fail(m, "micro index out of range");
+            uint32_t v = data.vertices[meshlet.vertexOffset + local];
+            if (v >= vertexCount || v != indices[meshlet.firstIndex + c])
+                return fail(m, "triangles differ from the source");
+
+            const float* p = vertex_position(positions, positionStride, v);
+            float d[3] = { p[0] - meshlet.center[0], p[1] - meshlet.center[1], p[2] - meshlet.center[2] };
+            if (std::sqrt(dot3(d, d)) > meshlet.radius * 1.0001f + 1e-6f)
+                return fail(m, "vertex outside the bounding sphere");
+        }
+
+        if (meshlet.coneCutoff > 1.0f)
+            continue;
+        const float minCos = std::sqrt(1.0f - meshlet.coneCutoff * meshlet.coneCutoff);
+        for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+        {
+            const uint32_t* tri = indices + meshlet.firstIndex + t * 3;
+            const float* p0 = vertex_position(positions, positionStride, tri[0]);
+            float n[3];
+            if (!triangle_normal(p0, vertex_position(positions, positionStride, tri[1]), vertex_position(positions, positionStride, tri[2]), n))
+                continue;
+            float toApex[3] = { meshlet.coneApex[0] - p0[0], meshlet.coneApex[1] - p0[1], meshlet.coneApex[2] - p0[2] };
+            float scale = std::max(meshlet.radius, 1e-6f);
+            if (dot3(meshlet.coneAxis, n) < minCos - 1e-4f || dot3(toApex, n) > scale * 1e-4f)
+                return fail(m, "triangle outside the normal cone");
+        }
+    }
+    if (nextIndex != indexCount - indexCount % 3)
+        return fail(data.meshlets.size(), "source triangles missing");
+    return true;
+}
+
+bool meshlet_backfacing(const it_Meshlet& meshlet, const float cameraPos[3])
+{
+    // seen from anywhere inside the cone opposite to the normals, every triangle is back facing
+    float view[3] = { meshlet.coneApex[0] - cameraPos[0], meshlet.coneApex[1] - cameraPos[1], meshlet.coneApex[2] - cameraPos[2] };
+    return dot3(view, meshlet.coneAxis) >= meshlet.coneCutoff * std::sqrt(dot3(view, view));
+}
+
+bool meshlet_outside_frustum(const it_Meshlet& meshlet, const float planes[6][4], float radiusScale)
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        if (dot3(planes[i], meshlet.center) + planes[i][3] < -meshlet.radius * radiusScale)
+            return true;
+    }
+    return false;
+}
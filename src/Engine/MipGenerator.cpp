@@ -0,0 +1,291 @@
+#include "MipGenerator.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+
+// Target rows per parallel work item
+#define MIP_ROWS_PER_JOB 8
+// Kaiser window half width in target texels (twice that in source texels when halving) and its shape
+#define MIP_KAISER_RADIUS 2.0
+#define MIP_KAISER_ALPHA 4.0
+
+
+// How bytes map to the values that are filtered and back. Rounding back goes to the nearest byte in byte space, so
+// an sRGB level is the closest sRGB value to the true linear average.
+struct it_MipCodec
+{
+    float decode[2][256];      // [0] colour channels, [1] alpha
+    float threshold[2][256];   // decoded value halfway between byte i and i + 1, the last one never reached
+    float low = 0.0f;          // colour channels are clamped to [low, 1] after filtering, the sinc overshoots
+    bool normal = false;
+};
+
+struct it_MipTaps
+{
+    uint32_t count = 0;           // per target texel, unused ones weigh 0
+    std::vector<uint32_t> index;  // source texel, clamped to the edge
+    std::vector<float> weight;
+};
+
+struct it_MipPass
+{
+    const uint8_t* sourceBytes = nullptr;  // level 0, decoded row by row through the codec
+    const float* source = nullptr;         // the levels after it
+    uint32_t sourceWidth = 0;
+    uint32_t sourceHeight = 0;
+    float* target = nullptr;
+    uint8_t* targetBytes = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    it_MipTaps columns;
+    it_MipTaps rows;
+};
+
+
+static float srgb_to_linear(float value)
+{
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static void init_codec(VkFormat format, it_MipCodec* codec)
+{
+    const bool srgb = format == TEXTURE_FORMAT_COLOR;
+    codec->normal = format == TEXTURE_FORMAT_NORMAL;
+    codec->low = codec->normal ? -1.0f : 0.0f;
+    for (int channel = 0; channel < 2; channel++)
+    {
+        auto decode = [&](float byte) {
+            const float value = byte / 255.0f;
+            if (channel == 1)
+                return value;
+            return srgb ? srgb_to_linear(value) : codec->normal ? value * 2.0f - 1.0f : value;
+        };
+        for (int i = 0; i < 256; i++)
+        {
+            codec->decode[channel][i] = decode(static_cast<float>(i));
+            codec->threshold[channel][i] = i < 255 ? decode(i + 0.5f) : INFINITY;
+        }
+    }
+}
+
+// Nearest byte, a branchless binary search over the thresholds
+static inline uint8_t encode_channel(const float* threshold, float value)
+{
+    uint32_t byte = 0;
+    for (uint32_t step = 128; step; step >>= 1)
+        byte += value >= threshold[byte + step - 1] ? step : 0;
+    return static_cast<uint8_t>(byte);
+}
+
+static void decode_row(const it_MipCodec* codec, const uint8_t* bytes, uint32_t width, float* row)
+{
+    for (uint32_t x = 0; x < width * 4; x += 4)
+    {
+        row[x + 0] = codec->decode[0][bytes[x + 0]];
+        row[x + 1] = codec->decode[0][bytes[x + 1]];
+        row[x + 2] = codec->decode[0][bytes[x + 2]];
+        row[x + 3] = codec->decode[1][bytes[x + 3]];
+    }
+}
+
+
+// Each target texel averages the source interval it covers, texels cut by its edges count in part
+static void box_taps(uint32_t source, uint32_t target, it_MipTaps* taps)
+{
+    const double scale = static_cast<double>(source) / target;
+    taps->count = static_cast<uint32_t>(std::ceil(scale)) + 1;
+    taps->index.assign(static_cast<size_t>(target) * taps->count, 0);
+    taps->weight.assign(static_cast<size_t>(target) * taps->count, 0.0f);
+    for (uint32_t x = 0; x < target; x++)
+    {
+        const double begin = x * scale, end = (x + 1) * scale;
+        const uint32_t first = static_cast<uint32_t>(begin);
+        for (uint32_t k = 0; k < taps->count; k++)
+        {
+            const uint32_t i = first + k;
+            const double overlap = std::min(end, i + 1.0) - std::max(begin, static_cast<double>(i));
+            taps->index[x * taps->count + k] = std::min(i, source - 1);
+            taps->weight[x * taps->count + k] = overlap > 0.0 ? static_cast<float>(overlap / scale) : 0.0f;
+        }
+    }
+}
+
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; term > sum * 1e-12; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// sinc at the target rate under a Kaiser window, weights normalized so flat areas stay flat
+static void kaiser_taps(uint32_t source, uint32_t target, it_MipTaps* taps)
+{
+    if (source == target)
+    {
+        box_taps(source, target, taps);
+        return;
+    }
+    const double pi = 3.14159265358979323846;
+    const double scale = static_cast<double>(source) / target;
+    const double support = MIP_KAISER_RADIUS * scale;
+    taps->count = static_cast<uint32_t>(std::ceil(2.0 * support)) + 1;
+    taps->index.assign(static_cast<size_t>(target) * taps->count, 0);
+    taps->weight.assign(static_cast<size_t>(target) * taps->count, 0.0f);
+    for (uint32_t x = 0; x < target; x++)
+    {
+        const double center = (x + 0.5) * scale;
+        const int64_t first = static_cast<int64_t>(std::floor(center - support));
+        double sum = 0.0;
+        for (uint32_t k = 0; k < taps->count; k++)
+        {
+            const int64_t i = first + k;
+            const double t = (i + 0.5 - center) / scale;  // in target texels
+            double weight = 0.0;
+            if (std::abs(t) < MIP_KAISER_RADIUS)
+            {
+                const double r = t / MIP_KAISER_RADIUS;
+                const double sinc = t == 0.0 ? 1.0 : std::sin(pi * t) / (pi * t);
+                weight = sinc * bessel_i0(MIP_KAISER_ALPHA * std::sqrt(1.0 - r * r)) / bessel_i0(MIP_KAISER_ALPHA);
+            }
+            taps->index[x * taps->count + k] = static_cast<uint32_t>(std::clamp<int64_t>(i, 0, source - 1));
+            taps->weight[x * taps->count + k] = static_cast<float>(weight);
+            sum += weight;
+        }
+        for (uint32_t k = 0; k < taps->count; k++)
+            taps->weight[x * taps->count + k] = static_cast<float>(taps->weight[x * taps->count + k] / sum);
+    }
+}
+
+
+// Rows first into a line of source width, then columns. A texel is one __m128, RGBA.
+static void filter_rows(const it_MipPass* pass, const it_MipCodec* codec, uint32_t firstRow, uint32_t lastRow)
+{
+    std::vector<float> line(static_cast<size_t>(pass->sourceWidth) * 4), decoded(pass->sourceBytes ? line.size() : 0);
+    const __m128 low = _mm_setr_ps(codec->low, codec->low, codec->low, 0.0f), high = _mm_set1_ps(1.0f);
+
+    for (uint32_t y = firstRow; y < lastRow; y++)
+    {
+        std::fill(line.begin(), line.end(), 0.0f);
+        for (uint32_t k = 0; k < pass->rows.count; k++)
+        {
+            const float weight = pass->rows.weight[y * pass->rows.count + k];
+            if (weight == 0.0f)
+                continue;
+            const uint32_t sourceRow = pass->rows.index[y * pass->rows.count + k];
+            const float* source;
+            if (pass->sourceBytes)
+            {
+                decode_row(codec, pass->sourceBytes + static_cast<size_t>(sourceRow) * pass->sourceWidth * 4, pass->sourceWidth, decoded.data());
+                source = decoded.data();
+            }
+            else
+                source = pass->source + static_cast<size_t>(sourceRow) * pass->sourceWidth * 4;
+
+            const __m128 w = _mm_set1_ps(weight);
+            for (size_t x = 0; x < line.size(); x += 4)
+                _mm_storeu_ps(&line[x], _mm_add_ps(_mm_loadu_ps(&line[x]), _mm_mul_ps(w, _mm_loadu_ps(source + x))));
+        }
+
+        float* target = pass->target + static_cast<size_t>(y) * pass->width * 4;
+        uint8_t* bytes = pass->targetBytes + static_cast<size_t>(y) * pass->width * 4;
+        for (uint32_t x = 0; x < pass->width; x++)
+        {
+            __m128 texel = _mm_setzero_ps();
+            const uint32_t* index = &pass->columns.index[x * pass->columns.count];
+            const float* weight = &pass->columns.weight[x * pass->columns.count];
+            for (uint32_t k = 0; k < pass->columns.count; k++)
+                texel = _mm_add_ps(texel, _mm_mul_ps(_mm_set1_ps(weight[k]), _mm_loadu_ps(&line[index[k] * 4])));
+            texel = _mm_min_ps(_mm_max_ps(texel, low), high);
+
+            float* out = target + x * 4;
+            _mm_storeu_ps(out, texel);
+            if (codec->normal)
+            {
+                // averaged normals get shorter where they disagree, the next level starts from unit vectors again
+                const float length = std::sqrt(out[0] * out[0] + out[1] * out[1] + out[2] * out[2]);
+                if (length > 1e-6f)
+                {
+                    out[0] /= length;
+                    out[1] /= length;
+                    out[2] /= length;
+                }
+                else
+                {
+                    out[0] = out[1] = 0.0f;
+                    out[2] = 1.0f;
+                }
+            }
+            bytes[x * 4 + 0] = encode_channel(codec->threshold[0], out[0]);
+            bytes[x * 4 + 1] = encode_channel(codec->threshold[0], out[1]);
+            bytes[x * 4 + 2] = encode_channel(codec->threshold[0], out[2]);
+            bytes[x * 4 + 3] = encode_channel(codec->threshold[1], out[3]);
+        }
+    }
+}
+
+
+void generate_mip_chain(const it_ImageData* image, VkFormat format, it_MipFilter filter, it_MipChain* chain)
+{
+    const uint32_t levelCount = texture_mip_levels(image->width, image->height);
+    chain->levels.assign(levelCount, it_MipLevel{});
+    size_t bytes = 0;
+    uint32_t width = static_cast<uint32_t>(image->width), height = static_cast<uint32_t>(image->height);
+    for (it_MipLevel& level : chain->levels)
+    {
+        level.width = width;
+        level.height = height;
+        level.offset = bytes;
+        bytes += static_cast<size_t>(width) * height * 4;
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+    chain->pixels.resize(bytes);
+    memcpy(chain->pixels.data(), image->pixels, image_bytes(image));
+
+    it_MipCodec codec;
+    init_codec(format, &codec);
+
+    // only the previous level is kept as floats, so level 1 (a quarter of the source at 16 bytes a texel) is the peak
+    std::vector<float> source, target;
+    for (uint32_t i = 1; i < levelCount; i++)
+    {
+        const it_MipLevel& above = chain->levels[i - 1];
+        const it_MipLevel& level = chain->levels[i];
+        target.resize(static_cast<size_t>(level.width) * level.height * 4);
+
+        it_MipPass pass;
+        pass.sourceBytes = i == 1 ? image->pixels : nullptr;
+        pass.source = source.data();
+        pass.sourceWidth = above.width;
+        pass.sourceHeight = above.height;
+        pass.target = target.data();
+        pass.targetBytes = chain->pixels.data() + level.offset;
+        pass.width = level.width;
+        pass.height = level.height;
+        if (filter == MIP_FILTER_KAISER)
+        {
+            kaiser_taps(above.width, level.width, &pass.columns);
+            kaiser_taps(above.height, level.height, &pass.rows);
+        }
+        else
+        {
+            box_taps(above.width, level.width, &pass.columns);
+            box_taps(above.height, level.height, &pass.rows);
+        }
+
+        const uint32_t bands = (level.height + MIP_ROWS_PER_JOB - 1) / MIP_ROWS_PER_JOB;
+        parallel_for(bands, [&](size_t band) {
+            const uint32_t first = static_cast<uint32_t>(band) * MIP_ROWS_PER_JOB;
+            filter_rows(&pass, &codec, first, std::min(first + MIP_ROWS_PER_JOB, level.height));
+        });
+        source.swap(target);
+    }
+}
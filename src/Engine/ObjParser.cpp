@@ -0,0 +1,324 @@
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+
+#include <cstring>
+#include <cstdint>
+#include <thread>
+
+
+// Chunks smaller than this are not worth a thread
+#define OBJ_MIN_CHUNK_SIZE (1 << 20)
+
+#define OBJ_RELATIVE_V  1
+#define OBJ_RELATIVE_VT 2
+#define OBJ_RELATIVE_VN 4
+
+
+struct it_ObjChunk
+{
+    const char* begin = nullptr;
+    const char* end = nullptr;
+
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> texcoords;
+    std::vector<tinyobj::index_t> indices;
+
+    // Negative (relative) indices depend on how many elements the previous chunks produced, so they are stored
+    // relative to the chunk start and patched while merging. Each entry is (corner << 3) | OBJ_RELATIVE_* mask.
+    std::vector<uint64_t> relative;
+    std::vector<std::string> mtllibs;
+};
+
+
+static const char* skip_space(const char* p, const char* end)
+{
+    while (p < end && IS_SPACE(*p))
+        ++p;
+    return p;
+}
+
+static float parse_float(const char** token, const char* end)
+{
+    const char* p = skip_space(*token, end);
+    const char* e = p;
+    while (e < end && !IS_SPACE(*e) && *e != '\r')
+        ++e;
+
+    // same conversion as tinyobj::parseReal so the results are bit identical
+    double value = 0.0;
+    tinyobj::tryParseDouble(p, e, &value);
+    *token = e;
+    return static_cast<float>(value);
+}
+
+static int parse_int(const char** token, const char* end)
+{
+    const char* p = *token;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        ++p;
+    }
+    int value = 0;
+    while (p < end && IS_DIGIT(*p))
+        value = value * 10 + (*p++ - '0');
+    while (p < end && *p != '/' && !IS_SPACE(*p) && *p != '\r')
+        ++p;
+    *token = p;
+    return negative ? -value : value;
+}
+
+// Same rules as tinyobj::fixIndex, except that negative indices stay relative to the chunk start
+static int resolve_index(int idx, size_t count, uint32_t flag, uint32_t* relativeMask)
+{
+    if (idx > 0)
+        return idx - 1;
+    if (idx == 0)
+        return 0;
+    *relativeMask |= flag;
+    return static_cast<int>(count) + idx;
+}
+
+// i, i/j, i//k, i/j/k
+static tinyobj::index_t parse_corner(const char** token, const char* end, const it_ObjChunk* chunk, uint32_t* relativeMask)
+{
+    tinyobj::index_t index;
+    index.vertex_index = resolve_index(parse_int(token, end), chunk->positions.size() / 3, OBJ_RELATIVE_V, relativeMask);
+    index.texcoord_index = -1;
+    index.normal_index = -1;
+
+    const char* p = *token;
+    if (p >= end || *p != '/')
+        return index;
+    ++p;
+
+    if (p < end && *p == '/')
+    {
+        ++p;
+        index.normal_index = resolve_index(parse_int(&p, end), chunk->normals.size() / 3, OBJ_RELATIVE_VN, relativeMask);
+        *token = p;
+        return index;
+    }
+
+    index.texcoord_index = resolve_index(parse_int(&p, end), chunk->texcoords.size() / 2, OBJ_RELATIVE_VT, relativeMask);
+    if (p < end && *p == '/')
+    {
+        ++p;
+        index.normal_index = resolve_index(parse_int(&p, end), chunk->normals.size() / 3, OBJ_RELATIVE_VN, relativeMask);
+    }
+    *token = p;
+    return index;
+}
+
+static void parse_line(const char* p, const char* end, it_ObjChunk* chunk, std::vector<tinyobj::index_t>& face, std::vector<uint32_t>& faceRelative)
+{
+    if (end > p && end[-1] == '\r')
+        --end;
+    p = skip_space(p, end);
+    if (p >= end || *p == '#')
+        return;
+
+    auto at = [&](size_t i) { return p + i < end ? p[i] : '\0'; };
+
+    if (p[0] == 'v' && IS_SPACE(at(1)))
+    {
+        p += 2;
+        chunk->positions.push_back(parse_float(&p, end));
+        chunk->positions.push_back(parse_float(&p, end));
+        chunk->positions.push_back(parse_float(&p, end));
+        return;
+    }
+
+    if (p[0] == 'v' && at(1) == 'n' && IS_SPACE(at(2)))
+    {
+        p += 3;
+        chunk->normals.push_back(parse_float(&p, end));
+        chunk->normals.push_back(parse_float(&p, end));
+        chunk->normals.push_back(parse_float(&p, end));
+        return;
+    }
+
+    if (p[0] == 'v' && at(1) == 't' && IS_SPACE(at(2)))
+    {
+        p += 3;
+        chunk->texcoords.push_back(parse_float(&p, end));
+        chunk->texcoords.push_back(parse_float(&p, end));
+        return;
+    }
+
+    if (p[0] == 'f' && IS_SPACE(at(1)))
+    {
+        p = skip_space(p + 2, end);
+        face.clear();
+        faceRelative.clear();
+        while (p < end && *p != '\r')
+        {
+            uint32_t relativeMask = 0;
+            face.push_back(parse_corner(&p, end, chunk, &relativeMask));
+            faceRelative.push_back(relativeMask);
+            while (p < end && (IS_SPACE(*p) || *p == '\r'))
+                ++p;
+        }
+
+        // triangle fan, same corner order as tinyobj's triangulation
+        for (size_t k = 2; k < face.size(); ++k)
+        {
+            const size_t corners[3] = { 0, k - 1, k };
+            for (size_t c : corners)
+            {
+                if (faceRelative[c])
+                    chunk->relative.push_back((static_cast<uint64_t>(chunk->indices.size()) << 3) | faceRelative[c]);
+                chunk->indices.push_back(face[c]);
+            }
+        }
+        return;
+    }
+
+    if (end - p > 6 && strncmp(p, "mtllib", 6) == 0 && IS_SPACE(p[6]))
+    {
+        chunk->mtllibs.emplace_back(p + 7, end);
+        return;
+    }
+
+    // groups, objects, usemtl and smoothing groups do not change the flattened mesh
+}
+
+static void parse_chunk(it_ObjChunk* chunk)
+{
+    // rough guess from typical line lengths, avoids most reallocations on big files
+    size_t bytes = static_cast<size_t>(chunk->end - chunk->begin);
+    chunk->positions.reserve(bytes / 64 * 3);
+    chunk->indices.reserve(bytes / 32 * 3);
+
+    std::vector<tinyobj::index_t> face;
+    std::vector<uint32_t> faceRelative;
+    const char* p = chunk->begin;
+    while (p < chunk->end)
+    {
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', chunk->end - p));
+        if (!lineEnd)
+            lineEnd = chunk->end;
+        parse_line(p, lineEnd, chunk, face, faceRelative);
+        p = lineEnd + 1;
+    }
+}
+
+static void load_materials(const std::vector<it_ObjChunk>& chunks, const std::string& mtlBaseDir, it_ObjMesh* mesh, std::string* err)
+{
+    tinyobj::MaterialFileReader reader(mtlBaseDir);
+    std::map<std::string, int> materialMap;
+    for (const auto& chunk : chunks)
+    {
+        for (const auto& line : chunk.mtllibs)
+        {
+            std::vector<std::string> filenames;
+            tinyobj::SplitString(line, ' ', filenames);
+
+            bool found = false;
+            for (const auto& filename : filenames)
+            {
+                std::string mtlErr;
+                found = reader(filename, &mesh->materials, &materialMap, &mtlErr);
+                if (err)
+                    *err += mtlErr;
+                if (found)
+                    break;
+            }
+            if (!found && err)
+                *err += "WARN: Failed to load material file(s). Use default material.\n";
+        }
+    }
+}
+
+
+bool parse_obj(const std::string& path, const std::string& mtlBaseDir, it_ObjMesh* mesh, std::string* err)
+{
+    it_MappedFile file;
+    if (!map_file(path, &file))
+    {
+        if (err)
+            *err = "ERROR: Cannot open file [" + path + "]";
+        return false;
+    }
+
+    const char* data = reinterpret_cast<const char*>(file.data);
+    const size_t size = file.size;
+    mesh->fileSize = size;
+
+    size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    size_t chunkCount = std::min(threadCount * 2, size / OBJ_MIN_CHUNK_SIZE + 1);
+
+    // split at line boundaries so no line is shared by two chunks
+    std::vector<it_ObjChunk> chunks(chunkCount);
+    size_t begin = 0;
+    for (size_t i = 0; i < chunkCount; ++i)
+    {
+        size_t end = size;
+        if (i + 1 < chunkCount)
+        {
+            end = std::max(begin, size * (i + 1) / chunkCount);
+            const void* newline = memchr(data + end, '\n', size - end);
+            end = newline ? static_cast<size_t>(static_cast<const char*>(newline) - data) + 1 : size;
+        }
+        chunks[i].begin = data + begin;
+        chunks[i].end = data + end;
+        begin = end;
+    }
+
+    parallel_for(chunkCount, [&](size_t i) { parse_chunk(&chunks[i]); });
+
+    // exclusive prefix sums give every chunk its place in the merged arrays
+    std::vector<size_t> positionBase(chunkCount), normalBase(chunkCount), texcoordBase(chunkCount), indexBase(chunkCount);
+    size_t positionCount = 0, normalCount = 0, texcoordCount = 0, indexCount = 0;
+    for (size_t i = 0; i < chunkCount; ++i)
+    {
+        positionBase[i] = positionCount;
+        normalBase[i] = normalCount;
+        texcoordBase[i] = texcoordCount;
+        indexBase[i] = indexCount;
+        positionCount += chunks[i].positions.size();
+        normalCount += chunks[i].normals.size();
+        texcoordCount += chunks[i].texcoords.size();
+        indexCount += chunks[i].indices.size();
+    }
+
+    mesh->positions.resize(positionCount);
+    mesh->normals.resize(normalCount);
+    mesh->texcoords.resize(texcoordCount);
+    mesh->indices.resize(indexCount);
+
+    parallel_for(chunkCount, [&](size_t i) {
+        it_ObjChunk& chunk = chunks[i];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), mesh->positions.begin() + positionBase[i]);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), mesh->normals.begin() + normalBase[i]);
+        std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), mesh->texcoords.begin() + texcoordBase[i]);
+
+        tinyobj::index_t* indices = mesh->indices.data() + indexBase[i];
+        std::copy(chunk.indices.begin(), chunk.indices.end(), indices);
+        for (uint64_t entry : chunk.relative)
+        {
+            tinyobj::index_t& index = indices[entry >> 3];
+            if (entry & OBJ_RELATIVE_V)
+                index.vertex_index += static_cast<int>(positionBase[i] / 3);
+            if (entry & OBJ_RELATIVE_VT)
+                index.texcoord_index += static_cast<int>(texcoordBase[i] / 2);
+            if (entry & OBJ_RELATIVE_VN)
+                index.normal_index += static_cast<int>(normalBase[i] / 3);
+        }
+
+        // the chunk buffers can be large, give the memory back as soon as possible
+        chunk.positions = std::vector<float>();
+        chunk.normals = std::vector<float>();
+        chunk.texcoords = std::vector<float>();
+        chunk.indices = std::vector<tinyobj::index_t>();
+    });
+
+    unmap_file(&file);
+
+    load_materials(chunks, mtlBaseDir, mesh, err);
+    return true;
+}
@@ -1,4 +1,5 @@
 #include <PhysicalDevice.h>
+#include "DescriptorSet.h"
 
 bool checkDeviceExtensionSupport(VkPhysicalDevice device)
 {
@@ -28,7 +29,8 @@ bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface)
         swapChainAdequate = !SwapChainSupport.formats.empty() && !SwapChainSupport.presentModes.empty();
     }
 
-    return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+    return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy && supportedFeatures.fragmentStoresAndAtomics
+        && bindless_supported(device);
 }
 
 
@@ -112,6 +114,7 @@ void pick_physical_device(VkPhysicalDevice* physicalDevice, VkInstance* instance
 
 
     std::multimap<int, VkPhysicalDevice> candidates;
+    uint32_t withoutBindless = 0;
 
     for (const auto& device : devices)
     {
@@ -122,6 +125,15 @@ void pick_physical_device(VkPhysicalDevice* physicalDevice, VkInstance* instance
             score = rateDeviceSuitability(device);
             candidates.insert(std::make_pair(score, device));
         }
+        else if (!bindless_supported(device))
+        {
+            // there is no per model descriptor set path to fall back to
+            withoutBindless++;
+#ifndef ENGINE_DISABLE_LOGGING
+            tlog::warning(std::string(deviceProperties.deviceName) + " skipped: no descriptor indexing for " + std::to_string(BINDLESS_MAX_TEXTURES)
+                + " update after bind textures (Vulkan 1.2 partially bound, update after bind and update unused while pending)");
+#endif
+        }
         //printf("%s with score: %d\n", &deviceProperties.deviceName, score);
         std::stringstream ss;
 
@@ -133,10 +145,13 @@ void pick_physical_device(VkPhysicalDevice* physicalDevice, VkInstance* instance
 
 
 
-    if (candidates.rbegin()->first > 0) {
+    if (!candidates.empty() && candidates.rbegin()->first > 0) {
         *physicalDevice = candidates.rbegin()->second;
         *msaaSamples = getMaxUsableSampleCount(*physicalDevice);
     }
+    else if (withoutBindless > 0) {
+        throw std::runtime_error("ERROR: failed to find a suitable GPU, " + std::to_string(withoutBindless) + " lack the descriptor indexing bindless textures need!");
+    }
     else {
         throw std::runtime_error("ERROR: failed to find a suitable GPU!");
     }
@@ -0,0 +1,123 @@
+#include "RangeAllocator.h"
+
+#include <iterator>
+
+
+static void insert_free(it_RangeAllocator* allocator, uint64_t offset, uint64_t size)
+{
+    allocator->freeRanges[offset] = size;
+    allocator->freeSizes.emplace(size, offset);
+}
+
+static void erase_free(it_RangeAllocator* allocator, std::map<uint64_t, uint64_t>::iterator range)
+{
+    auto sizes = allocator->freeSizes.equal_range(range->second);
+    for (auto it = sizes.first; it != sizes.second; ++it)
+    {
+        if (it->second == range->first)
+        {
+            allocator->freeSizes.erase(it);
+            break;
+        }
+    }
+    allocator->freeRanges.erase(range);
+}
+
+
+void range_allocator_init(it_RangeAllocator* allocator, uint64_t capacity)
+{
+    allocator->freeRanges.clear();
+    allocator->freeSizes.clear();
+    allocator->capacity = capacity;
+    allocator->used = 0;
+    allocator->allocationCount = 0;
+    if (capacity)
+        insert_free(allocator, 0, capacity);
+}
+
+bool range_alloc(it_RangeAllocator* allocator, uint64_t size, uint64_t* offset)
+{
+    return range_alloc_aligned(allocator, size, 1, offset);
+}
+
+bool range_alloc_aligned(it_RangeAllocator* allocator, uint64_t size, uint64_t alignment, uint64_t* offset)
+{
+    if (size == 0)
+    {
+        *offset = 0;
+        return true;
+    }
+
+    // smallest free range that still fits once its start is aligned
+    for (auto it = allocator->freeSizes.lower_bound(size); it != allocator->freeSizes.end(); ++it)
+    {
+        const uint64_t rangeOffset = it->second;
+        const uint64_t rangeSize = it->first;
+        const uint64_t aligned = (rangeOffset + alignment - 1) & ~(alignment - 1);
+        if (aligned + size > rangeOffset + rangeSize)
+            continue;
+
+        erase_free(allocator, allocator->freeRanges.find(rangeOffset));
+        if (aligned > rangeOffset)
+            insert_free(allocator, rangeOffset, aligned - rangeOffset);
+        if (aligned + size < rangeOffset + rangeSize)
+            insert_free(allocator, aligned + size, rangeOffset + rangeSize - (aligned + size));
+
+        allocator->used += size;
+        allocator->allocationCount++;
+        *offset = aligned;
+        return true;
+    }
+    return false;
+}
+
+void range_free(it_RangeAllocator* allocator, uint64_t offset, uint64_t size)
+{
+    if (size == 0)
+        return;
+    allocator->used -= size;
+    allocator->allocationCount--;
+
+    auto next = allocator->freeRanges.lower_bound(offset);
+    if (next != allocator->freeRanges.begin())
+    {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset)
+        {
+            offset = previous->first;
+            size += previous->second;
+            erase_free(allocator, previous);
+        }
+    }
+    if (next != allocator->freeRanges.end() && offset + size == next->first)
+    {
+        size += next->second;
+        erase_free(allocator, next);
+    }
+    insert_free(allocator, offset, size);
+}
+
+void range_allocator_grow(it_RangeAllocator* allocator, uint64_t newCapacity)
+{
+    if (newCapacity <= allocator->capacity)
+        return;
+    uint64_t oldCapacity = allocator->capacity;
+    allocator->capacity = newCapacity;
+    // range_free merges with a trailing free range, undo its bookkeeping first
+    allocator->used += newCapacity - oldCapacity;
+    allocator->allocationCount++;
+    range_free(allocator, oldCapacity, newCapacity - oldCapacity);
+}
+
+uint64_t range_largest_free(const it_RangeAllocator* allocator)
+{
+    return allocator->freeSizes.empty() ? 0 : allocator->freeSizes.rbegin()->first;
+}
+
+float range_fragmentation(const it_RangeAllocator* allocator)
+{
+    const uint64_t freeSpace = allocator->capacity - allocator->used;
+    if (freeSpace == 0)
+        return 0.0f;
+    return 1.0f - static_cast<float>(range_largest_free(allocator)) / static_cast<float>(freeSpace);
+}
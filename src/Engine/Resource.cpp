@@ -2,11 +2,11 @@
 
 
 
-void create_color_resources(VkDevice* device, VkPhysicalDevice* physicalDevice, it_ImageResource* colorImageRes,VkFormat swapChainImageFormat, VkExtent2D swapChainExtent, VkSampleCountFlagBits msaaSamples)
+void create_color_resources(VkDevice* device, it_ImageResource* colorImageRes,VkFormat swapChainImageFormat, VkExtent2D swapChainExtent, VkSampleCountFlagBits msaaSamples)
 {
     VkFormat colorFormat = swapChainImageFormat;
 
-    createImage(device, physicalDevice, swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, colorFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImageRes->image, colorImageRes->memory);
+    createImage(device, swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, colorFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImageRes->image, colorImageRes->memory);
     colorImageRes->imageView = createImageView(*device, colorImageRes->image, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 
 }
@@ -15,7 +15,7 @@ void create_depth_resources(VkDevice* device, VkPhysicalDevice* physicalDevice,
 {
     VkFormat depthFormat = findDepthFormat(*physicalDevice);
 
-    createImage(device, physicalDevice, swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImageRes->image, depthImageRes->memory);
+    createImage(device, swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImageRes->image, depthImageRes->memory);
     depthImageRes->imageView = createImageView(*device, depthImageRes->image, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
 
 
@@ -43,7 +43,7 @@ void create_depth_resources(VkDevice* device, VkPhysicalDevice* physicalDevice,
 
 }
 
-void create_shadow_resources(VkDevice* device, VkPhysicalDevice* physicalDevice, it_ImageResource* shadowImageRes, VkFormat swapChainImageFormat, VkExtent2D swapChainExtent, VkSampleCountFlagBits msaaSamples)
+void create_shadow_resources(VkDevice* device, it_ImageResource* shadowImageRes, VkFormat swapChainImageFormat, VkExtent2D swapChainExtent, VkSampleCountFlagBits msaaSamples)
 {
     // Create the depth image for the shadow map
     VkImageCreateInfo imageInfo{};
@@ -65,19 +65,7 @@ void create_shadow_resources(VkDevice* device, VkPhysicalDevice* physicalDevice,
         throw std::runtime_error("failed to create shadow map image!");
     }
 
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(*device, shadowImageRes->image, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(*physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    if (vkAllocateMemory(*device, &allocInfo, nullptr, &shadowImageRes->memory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate shadow map image memory!");
-    }
-
-    vkBindImageMemory(*device, shadowImageRes->image, shadowImageRes->memory, 0);
+    allocate_image_memory(shadowImageRes->image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &shadowImageRes->memory);
 
     // Create the image view for the depth image
     VkImageViewCreateInfo viewInfo{};
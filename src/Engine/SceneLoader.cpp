@@ -0,0 +1,418 @@
+#include "SceneLoader.h"
+#include "JobSystem.h"
+#include "File.h"
+#include "TextureCache.h"
+#include "VirtualTextureSet.h"
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <algorithm>
+#include <unordered_set>
+
+
+struct it_ModelLoad
+{
+    Model* model = nullptr;
+    it_ModelImages images;
+    std::atomic<int> remaining{ 2 };  // mesh and decode job
+};
+
+struct it_LoadPipeline
+{
+    std::mutex mutex;
+    std::condition_variable readyChanged;
+    std::deque<it_ModelLoad*> ready;   // both jobs done, waiting for upload
+    std::exception_ptr error;
+    std::atomic<bool> failed{ false };
+
+    std::atomic<uint64_t> decodedBytes{ 0 };  // mip chains of started models that have not been uploaded
+    std::atomic<uint64_t> peakDecodedBytes{ 0 };
+    std::atomic<uint64_t> totalDecodedBytes{ 0 };
+    std::atomic<uint64_t> meshNanoseconds{ 0 };
+    std::atomic<uint64_t> decodeNanoseconds{ 0 };
+
+    std::mutex claimMutex;
+    std::unordered_set<std::string> claimed;  // images one decode job of this load has taken on
+    std::atomic<uint32_t> skippedDecodes{ 0 };
+};
+
+
+static double seconds_since(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static uint64_t nanoseconds_since(std::chrono::high_resolution_clock::time_point start)
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count());
+}
+
+static void record_error(it_LoadPipeline* pipeline)
+{
+    std::lock_guard<std::mutex> lock(pipeline->mutex);
+    if (!pipeline->error)
+        pipeline->error = std::current_exception();
+    pipeline->failed = true;
+}
+
+// A failed stage still reports in, so the loading thread never waits for a model that will not come
+static void stage_done(it_LoadPipeline* pipeline, it_ModelLoad* load)
+{
+    if (load->remaining.fetch_sub(1) != 1)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(pipeline->mutex);
+        pipeline->ready.push_back(load);
+    }
+    pipeline->readyChanged.notify_one();
+}
+
+// Only the first model to ask decodes an image, the others find it in the texture cache at upload. If that model is
+// uploaded later than they are, the cache decodes it for them there. Cooked images, cached mips and colour textures
+// sampled as virtual textures are never decoded.
+static bool claim_image(it_LoadPipeline* pipeline, const std::string& path, VkFormat format)
+{
+    bool claimed;
+    if (!texture_cache_needs_pixels(path, format) || (format == TEXTURE_FORMAT_COLOR && virtual_texture_available(path)))
+        claimed = false;
+    else
+    {
+        std::lock_guard<std::mutex> lock(pipeline->claimMutex);
+        claimed = pipeline->claimed.insert(path + '|' + std::to_string(static_cast<int>(format))).second;
+    }
+    if (!claimed)
+        pipeline->skippedDecodes++;
+    return claimed;
+}
+
+static void decode_model(it_LoadPipeline* pipeline, it_ModelLoad* load)
+{
+    Model* model = load->model;
+    const std::string texturePath = model->baseDir + model->TEXTURE_PATH;
+    const std::string normalPath = model->baseDir + model->NORMAL_PATH;
+    if (claim_image(pipeline, texturePath, TEXTURE_FORMAT_COLOR))
+        texture_cache_decode(texturePath, TEXTURE_FORMAT_COLOR, &load->images.texture);
+    if (claim_image(pipeline, normalPath, TEXTURE_FORMAT_NORMAL))
+        texture_cache_decode(normalPath, TEXTURE_FORMAT_NORMAL, &load->images.normal);
+}
+
+static void start_model(it_LoadPipeline* pipeline, it_ModelLoad* load, it_JobCounter* counter)
+{
+    job_run([pipeline, load]() {
+        auto start = std::chrono::high_resolution_clock::now();
+        try
+        {
+            load_model(load->model);
+        }
+        catch (...)
+        {
+            record_error(pipeline);
+        }
+        pipeline->meshNanoseconds += nanoseconds_since(start);
+        stage_done(pipeline, load);
+    }, counter);
+
+    job_run([pipeline, load]() {
+        auto start = std::chrono::high_resolution_clock::now();
+        try
+        {
+            decode_model(pipeline, load);
+            uint64_t bytes = model_images_bytes(&load->images);
+            pipeline->totalDecodedBytes += bytes;
+            uint64_t alive = pipeline->decodedBytes += bytes;
+            uint64_t peak = pipeline->peakDecodedBytes.load();
+            while (alive > peak && !pipeline->peakDecodedBytes.compare_exchange_weak(peak, alive))
+                ;
+        }
+        catch (...)
+        {
+            record_error(pipeline);
+        }
+        pipeline->decodeNanoseconds += nanoseconds_since(start);
+        stage_done(pipeline, load);
+    }, counter);
+}
+
+static it_ModelLoad* take_ready(it_LoadPipeline* pipeline, const it_SceneUploader& uploader)
+{
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> lock(pipeline->mutex);
+            if (!pipeline->ready.empty())
+            {
+                it_ModelLoad* load = pipeline->ready.front();
+                pipeline->ready.pop_front();
+                return load;
+            }
+        }
+        // help the stages along instead of idling, the loading thread may be the only job thread
+        if (job_try_run())
+            continue;
+        if (uploader.poll)
+            uploader.poll(uploader.userData);
+        std::unique_lock<std::mutex> lock(pipeline->mutex);
+        pipeline->readyChanged.wait_for(lock, std::chrono::milliseconds(1), [pipeline]() { return !pipeline->ready.empty(); });
+    }
+}
+
+
+static void vulkan_upload(void* userData, Model* model, const it_ModelImages* images)
+{
+    it_SceneUploadTarget* target = static_cast<it_SceneUploadTarget*>(userData);
+    init_model_resources(target->uploadContext, target->geometryHeap, target->bindless, model, images);
+    upload_context_submit(target->uploadContext);
+}
+
+static void vulkan_finish(void* userData)
+{
+    upload_context_flush(static_cast<it_SceneUploadTarget*>(userData)->uploadContext);
+}
+
+static void vulkan_discard(void* userData, Model* model)
+{
+    it_SceneUploadTarget* target = static_cast<it_SceneUploadTarget*>(userData);
+    // init_model_resources either took everything or released it again, the object slot is taken last
+    if (model->objectIndex == UINT32_MAX)
+    {
+        delete model;
+        return;
+    }
+    upload_context_flush(target->uploadContext);
+    cleanup_model(target->geometryHeap, target->bindless, model);
+}
+
+it_SceneUploader vulkan_scene_uploader(it_SceneUploadTarget* target)
+{
+    return it_SceneUploader{ target, vulkan_upload, vulkan_finish, nullptr, vulkan_discard };
+}
+
+static void null_upload(void*, Model*, const it_ModelImages*)
+{
+}
+
+it_SceneUploader null_scene_uploader()
+{
+    return it_SceneUploader{ nullptr, null_upload, nullptr };
+}
+
+
+static void discard_scene(const it_SceneUploader& uploader, std::vector<Model*>* scene)
+{
+    for (Model* model : *scene)
+    {
+        if (uploader.discard)
+            uploader.discard(uploader.userData, model);
+        else
+            delete model;
+    }
+    scene->clear();
+}
+
+void load_scene_pipelined(const std::string& scenePath, it_SceneUploader uploader, std::vector<Model*>* scene, it_SceneLoadStats* stats)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    *stats = it_SceneLoadStats{};
+
+    size_t sceneSize = 0;
+    try
+    {
+        load_scene(scenePath, scene, &sceneSize);
+    }
+    catch (...)
+    {
+        // a malformed object leaves the ones before it behind
+        discard_scene(uploader, scene);
+        throw;
+    }
+    stats->parseSeconds = seconds_since(start);
+    stats->models = static_cast<uint32_t>(sceneSize);
+
+    it_LoadPipeline pipeline;
+    std::vector<it_ModelLoad> loads(sceneSize);
+    it_JobCounter counter;
+    size_t started = 0, inFlight = 0;
+
+    while (inFlight > 0 || (started < sceneSize && !pipeline.failed))
+    {
+        // the first model always starts, otherwise a single texture above the budget would stall the load
+        while (started < sceneSize && !pipeline.failed && inFlight < SCENE_LOAD_WINDOW
+            && (inFlight == 0 || pipeline.decodedBytes.load() < SCENE_LOAD_DECODE_BUDGET))
+        {
+            loads[started].model = (*scene)[started];
+            start_model(&pipeline, &loads[started], &counter);
+            started++;
+            inFlight++;
+        }
+
+        auto waitStart = std::chrono::high_resolution_clock::now();
+        it_ModelLoad* load = take_ready(&pipeline, uploader);
+        stats->waitSeconds += seconds_since(waitStart);
+
+        if (!pipeline.failed)
+        {
+            auto uploadStart = std::chrono::high_resolution_clock::now();
+            try
+            {
+                uploader.upload(uploader.userData, load->model, &load->images);
+            }
+            catch (...)
+            {
+                record_error(&pipeline);
+            }
+            stats->uploadSeconds += seconds_since(uploadStart);
+        }
+
+        pipeline.decodedBytes -= model_images_bytes(&load->images);
+        free_model_images(&load->images);
+        inFlight--;
+    }
+
+    job_wait(&counter);
+    if (pipeline.error)
+    {
+        discard_scene(uploader, scene);
+        std::rethrow_exception(pipeline.error);
+    }
+
+    if (uploader.finish)
+    {
+        auto finishStart = std::chrono::high_resolution_clock::now();
+        uploader.finish(uploader.userData);
+        stats->uploadSeconds += seconds_since(finishStart);
+    }
+
+    stats->meshSeconds = pipeline.meshNanoseconds * 1e-9;
+    stats->decodeSeconds = pipeline.decodeNanoseconds * 1e-9;
+    stats->decodedBytes = pipeline.totalDecodedBytes;
+    stats->peakDecodedBytes = pipeline.peakDecodedBytes;
+    stats->skippedDecodes = pipeline.skippedDecodes;
+    stats->totalSeconds = seconds_since(start);
+}
+
+
+static void stream_upload(void* userData, Model* model, const it_ModelImages* images)
+{
+    it_SceneStream* stream = static_cast<it_SceneStream*>(userData);
+    if (stream->cancel)
+        throw std::runtime_error("ERROR: scene load cancelled");
+
+    it_SceneUploadTarget* target = &stream->target;
+    init_model_resources(target->uploadContext, target->geometryHeap, target->bindless, model, images);
+    upload_context_on_complete(target->uploadContext, [stream, model]() {
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        stream->resident.push_back(model);
+    });
+    stream->uploaded.push_back(model);
+    upload_context_submit(target->uploadContext);
+    upload_context_poll(target->uploadContext);
+}
+
+static void stream_finish(void* userData)
+{
+    upload_context_flush(static_cast<it_SceneStream*>(userData)->target.uploadContext);
+}
+
+// Uploaded models reach the renderer through resident once their batch finishes, stream_main flushes for that
+static void stream_discard(void* userData, Model* model)
+{
+    it_SceneStream* stream = static_cast<it_SceneStream*>(userData);
+    if (std::find(stream->uploaded.begin(), stream->uploaded.end(), model) == stream->uploaded.end())
+        delete model;
+}
+
+static void stream_poll(void* userData)
+{
+    upload_context_poll(static_cast<it_SceneStream*>(userData)->target.uploadContext);
+}
+
+static void stream_main(it_SceneStream* stream, std::string scenePath, std::function<void()> prepare)
+{
+    std::exception_ptr error;
+    it_SceneLoadStats stats;
+    try
+    {
+        if (prepare)
+            prepare();
+        load_scene_pipelined(scenePath, it_SceneUploader{ stream, stream_upload, stream_finish, stream_poll, stream_discard }, &stream->scene, &stats);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+        // batches still in flight hand over their models, stream_discard deleted the rest
+        upload_context_flush(stream->target.uploadContext);
+    }
+    stream->scene.clear();
+    stream->uploaded.clear();
+
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    stream->stats = stats;
+    stream->error = error;
+    stream->finished = true;
+}
+
+void scene_stream_start(it_SceneStream* stream, const std::string& scenePath, it_SceneUploadTarget target, std::function<void()> prepare)
+{
+    if (stream->running)
+        throw std::runtime_error("ERROR: a scene is already streaming!");
+
+    stream->cancel = false;
+    stream->target = target;
+    stream->resident.clear();
+    stream->finished = false;
+    stream->error = nullptr;
+    stream->stats = it_SceneLoadStats{};
+    stream->start = std::chrono::high_resolution_clock::now();
+    stream->thread = std::thread(stream_main, stream, scenePath, std::move(prepare));
+    stream->running = true;
+}
+
+bool scene_stream_take(it_SceneStream* stream, std::vector<Model*>* models)
+{
+    bool finished;
+    {
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        models->insert(models->end(), stream->resident.begin(), stream->resident.end());
+        stream->resident.clear();
+        finished = stream->finished;
+    }
+    if (!finished)
+        return false;
+
+    if (stream->running)
+    {
+        stream->thread.join();
+        stream->running = false;
+    }
+    std::exception_ptr error = stream->error;
+    stream->error = nullptr;
+    if (error)
+        std::rethrow_exception(error);
+    return true;
+}
+
+void scene_stream_cancel(it_SceneStream* stream)
+{
+    if (!stream->running)
+        return;
+    stream->cancel = true;
+    // with no workers the models in flight need this thread to finish
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> lock(stream->mutex);
+            if (stream->finished)
+                break;
+        }
+        if (!job_try_run())
+            std::this_thread::yield();
+    }
+    stream->thread.join();
+    stream->running = false;
+
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    stream->error = nullptr;
+}
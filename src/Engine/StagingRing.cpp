@@ -0,0 +1,73 @@
+#include "StagingRing.h"
+
+
+void staging_ring_init(it_StagingRing* ring, uint64_t capacity, it_FenceSource fences)
+{
+    ring->capacity = capacity;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->submitted = 0;
+    ring->inFlight.clear();
+    ring->fences = fences;
+    ring->waits = 0;
+}
+
+bool staging_ring_alloc(it_StagingRing* ring, uint64_t size, uint64_t alignment, uint64_t* offset)
+{
+    if (size > ring->capacity)
+        return false;
+
+    for (;;)
+    {
+        // an idle ring starts over at the beginning, so anything up to capacity fits
+        if (ring->head == ring->tail && ring->head % ring->capacity)
+        {
+            ring->head += ring->capacity - ring->head % ring->capacity;
+            ring->tail = ring->submitted = ring->head;
+        }
+
+        uint64_t position = ring->head % ring->capacity;
+        uint64_t start = (position + alignment - 1) & ~(alignment - 1);
+        if (start + size > ring->capacity)
+            start = ring->capacity;  // wrap, the skipped tail goes with this allocation
+        uint64_t needed = start - position + size;
+        uint64_t used = ring->head - ring->tail;
+
+        if (used + needed <= ring->capacity)
+        {
+            ring->head += needed;
+            *offset = start % ring->capacity;
+            return true;
+        }
+
+        staging_ring_retire(ring);
+        if (ring->head - ring->tail != used)
+            continue;
+        if (ring->inFlight.empty())
+            return false;
+
+        ring->waits++;
+        ring->fences.wait(ring->fences.userData, ring->inFlight.front().first);
+        staging_ring_retire(ring);
+    }
+}
+
+void staging_ring_submit(it_StagingRing* ring, uint64_t ticket)
+{
+    if (ring->head == ring->submitted)
+        return;
+    ring->inFlight.emplace_back(ticket, ring->head);
+    ring->submitted = ring->head;
+}
+
+void staging_ring_retire(it_StagingRing* ring)
+{
+    if (ring->inFlight.empty())
+        return;
+    uint64_t completed = ring->fences.completed(ring->fences.userData);
+    while (!ring->inFlight.empty() && ring->inFlight.front().first <= completed)
+    {
+        ring->tail = ring->inFlight.front().second;
+        ring->inFlight.pop_front();
+    }
+}
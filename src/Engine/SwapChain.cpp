@@ -137,10 +137,10 @@ void cleanupSwapChain(VkDevice* device, it_SwapChainHandle* swapChainHandle, it_
 {
     vkDestroyImageView(*device, colorImageRes->imageView, nullptr);
     vkDestroyImage(*device, colorImageRes->image, nullptr);
-    vkFreeMemory(*device, colorImageRes->memory, nullptr);
+    free_device_memory(&colorImageRes->memory);
     vkDestroyImageView(*device, depthImageRes->imageView, nullptr);
     vkDestroyImage(*device, depthImageRes->image, nullptr);
-    vkFreeMemory(*device, depthImageRes->memory, nullptr);
+    free_device_memory(&depthImageRes->memory);
     vkDestroySampler(*device, depthImageRes->sampler, nullptr);
     for (size_t i = 0; i < swapChainHandle->framebuffers.size(); i++)
         vkDestroyFramebuffer(*device, swapChainHandle->framebuffers[i], nullptr);
@@ -169,7 +169,7 @@ void recreate_swapchain(VkDevice* device, VkPhysicalDevice* physicalDevice, it_S
     camera->width = (*swapChainHandle).extent.width;
     camera->height = (*swapChainHandle).extent.height;
     create_imageviews(device, &swapChainHandle->imageViews, &swapChainHandle->images, swapChainHandle->imageFormat);
-    create_color_resources(device, physicalDevice, colorImageRes, swapChainHandle->imageFormat, swapChainHandle->extent, msaaSamples);
+    create_color_resources(device, colorImageRes, swapChainHandle->imageFormat, swapChainHandle->extent, msaaSamples);
     create_depth_resources(device, physicalDevice, depthImageRes, swapChainHandle->imageFormat, swapChainHandle->extent, msaaSamples);
     create_framebuffers(device, &swapChainHandle->framebuffers, swapChainHandle->imageViews, swapChainHandle->extent, *renderPass, colorImageRes->imageView, depthImageRes->imageView);
 
@@ -0,0 +1,1991 @@
+#include "Tests.h"
+#include "MeshProcessing.h"
+#include "VertexPacking.h"
+#include "MeshletBuilder.h"
+#include "MeshCache.h"
+#include "RangeAllocator.h"
+#include "StagingRing.h"
+#include "VirtualTexture.h"
+#include "TransformStore.h"
+#include "TextureCompression.h"
+#include "MipGenerator.h"
+#include "JobSystem.h"
+#include "Parallel.h"
+#include "ObjParser.h"
+#include "VertexWelder.h"
+#include "glmIncludes.h"
+
+#include <array>
+#include <map>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+
+#include <tinylogger.h>
+
+
+#define TEST_GRID_SIZE 64
+#define TEST_EPSILON 1e-5f
+#define TEST_PACKING_VERTICES 100000
+#define TEST_RANGE_CAPACITY (1 << 18)
+#define TEST_RANGE_OPS 10000
+#define TEST_RANGE_MAX_GROWS 4
+#define TEST_RING_CAPACITY 1024
+#define TEST_RING_OPS 5000
+#define TEST_VT_SIZE 512
+#define TEST_VT_PINNED 8      // levels 2 to 9 of TEST_VT_SIZE fit one page
+#define TEST_VT_FREE_SLOTS 4
+#define TEST_TRANSFORM_COUNT (2 * TRANSFORM_CHUNK + 13)
+#define TEST_TRANSFORM_EPSILON 1e-4f  // translations reach 100 and a float has 24 bits
+#define TEST_HIERARCHY_NODES 60
+#define TEST_BC_SIZE 62  // edge blocks are partial
+#define TEST_BC7_MIN_PSNR 40.0  // 42.1 dB measured on the test image
+#define TEST_BC5_MIN_PSNR 50.0  // 55.5 dB measured
+#define TEST_JOB_WORKERS 3
+#define TEST_JOB_COUNT 2000
+#define TEST_OBJ_QUADS 40000  // about 4 MB, several parse chunks
+#define TEST_PACKING_MAX_DEGREES 0.005f  // octahedral snorm16 directions, 0.0037 measured over the random mesh
+
+static int s_failed = 0;
+
+static bool check(bool condition, const std::string& what)
+{
+    if (condition)
+        return true;
+    tlog::error("FAILED: " + what);
+    s_failed++;
+    return false;
+}
+
+static std::string vertex_name(size_t v)
+{
+    return " at vertex " + std::to_string(v);
+}
+
+
+// Height field grid with analytic normals. waviness bends the surface and distorts the uv mapping; mirrored flips u
+// on the right half, the way mirrored uv islands share a seam.
+static void generate_tangent_grid(uint32_t size, float waviness, bool mirrored, it_TangentStreams* streams, std::vector<uint32_t>* indices)
+{
+    const uint32_t side = size + 1;
+    for (uint32_t y = 0; y < side; ++y)
+    {
+        for (uint32_t x = 0; x < side; ++x)
+        {
+            const float fx = static_cast<float>(x) / size, fz = static_cast<float>(y) / size;
+            streams->px.push_back(fx);
+            streams->py.push_back(waviness * std::sin(fx * 6.0f) * std::cos(fz * 4.0f));
+            streams->pz.push_back(fz);
+
+            glm::vec3 n = glm::normalize(glm::vec3(-waviness * 6.0f * std::cos(fx * 6.0f) * std::cos(fz * 4.0f), 1.0f,
+                waviness * 4.0f * std::sin(fx * 6.0f) * std::sin(fz * 4.0f)));
+            streams->nx.push_back(n.x);
+            streams->ny.push_back(n.y);
+            streams->nz.push_back(n.z);
+
+            float u = fx + waviness * 0.1f * std::sin(fz * 5.0f);
+            if (mirrored && fx > 0.5f)
+                u = 1.0f - u;
+            streams->u.push_back(u);
+            streams->v.push_back(fz);
+        }
+    }
+
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            const uint32_t i = y * side + x;
+            indices->insert(indices->end(), { i, i + side, i + 1, i + 1, i + side, i + side + 1 });
+        }
+    }
+}
+
+// The tangent loop load_model ran before compute_tangents existed, on glm vectors
+static void reference_legacy_tangents(const it_TangentStreams& s, const std::vector<uint32_t>& indices, std::vector<glm::vec3>* tangents, std::vector<glm::vec3>* bitangents)
+{
+    const size_t count = s.px.size();
+    tangents->assign(count, glm::vec3(0.0f));
+    bitangents->assign(count, glm::vec3(0.0f));
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        const uint32_t i0 = indices[i + 0], i1 = indices[i + 1], i2 = indices[i + 2];
+        glm::vec3 edge1 = glm::vec3(s.px[i1], s.py[i1], s.pz[i1]) - glm::vec3(s.px[i0], s.py[i0], s.pz[i0]);
+        glm::vec3 edge2 = glm::vec3(s.px[i2], s.py[i2], s.pz[i2]) - glm::vec3(s.px[i0], s.py[i0], s.pz[i0]);
+        glm::vec2 deltaUV1 = glm::vec2(s.u[i1], s.v[i1]) - glm::vec2(s.u[i0], s.v[i0]);
+        glm::vec2 deltaUV2 = glm::vec2(s.u[i2], s.v[i2]) - glm::vec2(s.u[i0], s.v[i0]);
+
+        float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
+        if (!std::isfinite(f)) {
+            f = 0.0f;
+        }
+
+        glm::vec3 tangent, bitangent;
+        tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
+        tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
+        tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
+        tangent = glm::normalize(tangent);
+
+        bitangent.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
+        bitangent.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
+        bitangent.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
+        bitangent = glm::normalize(bitangent);
+
+        if (glm::dot(glm::cross(glm::vec3(s.nx[i0], s.ny[i0], s.nz[i0]), tangent), bitangent) < 0.0f) {
+            tangent = tangent * -1.0f;
+        }
+
+        for (uint32_t v : { i0, i1, i2 }) {
+            (*tangents)[v] += tangent;
+            (*bitangents)[v] += bitangent;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        (*tangents)[i] = glm::normalize((*tangents)[i]);
+        (*bitangents)[i] = glm::normalize((*bitangents)[i]);
+    }
+}
+
+static glm::vec3 stream_tangent(const it_TangentStreams& s, size_t v)
+{
+    return glm::vec3(s.tx[v], s.ty[v], s.tz[v]);
+}
+
+static glm::vec3 stream_bitangent(const it_TangentStreams& s, size_t v)
+{
+    return glm::vec3(s.bx[v], s.by[v], s.bz[v]);
+}
+
+static float max_difference(const glm::vec3& a, const glm::vec3& b)
+{
+    const glm::vec3 d = glm::abs(a - b);
+    return std::max(d.x, std::max(d.y, d.z));
+}
+
+int test_tangents()
+{
+    const int failedBefore = s_failed;
+
+    for (bool mirrored : { false, true })
+    {
+        const std::string grid = mirrored ? "mirrored grid" : "grid";
+        it_TangentStreams streams;
+        std::vector<uint32_t> indices;
+        generate_tangent_grid(TEST_GRID_SIZE, 0.2f, mirrored, &streams, &indices);
+        const size_t count = streams.px.size();
+
+        std::vector<glm::vec3> tangents, bitangents;
+        reference_legacy_tangents(streams, indices, &tangents, &bitangents);
+
+        // legacy must reproduce the old loop, with either kernel
+        tangent_use_avx(false);
+        compute_tangents(&streams, indices.data(), indices.size(), TANGENT_MODE_LEGACY);
+        it_TangentStreams sse = streams;
+        tangent_use_avx(true);
+        compute_tangents(&streams, indices.data(), indices.size(), TANGENT_MODE_LEGACY);
+
+        float worst = 0.0f;
+        for (size_t v = 0; v < count; ++v)
+            worst = std::max(worst, std::max(max_difference(stream_tangent(sse, v), tangents[v]), max_difference(stream_bitangent(sse, v), bitangents[v])));
+        check(worst <= TEST_EPSILON, "legacy tangents on the " + grid + " differ from the glm loop by " + std::to_string(worst));
+        if (tangent_avx_supported())
+        {
+            bool same = streams.tx == sse.tx && streams.ty == sse.ty && streams.tz == sse.tz && streams.bx == sse.bx && streams.by == sse.by && streams.bz == sse.bz;
+            check(same, "AVX and SSE legacy tangents differ on the " + grid);
+        }
+        else
+            tlog::warning("No AVX on this CPU, the AVX tangent kernel was not tested");
+
+        // angle weighted: unit tangent in the tangent plane, bitangent rebuilt from the normal with the stored sign
+        compute_tangents(&streams, indices.data(), indices.size(), TANGENT_MODE_ANGLE_WEIGHTED);
+        for (size_t v = 0; v < count; ++v)
+        {
+            const glm::vec3 n(streams.nx[v], streams.ny[v], streams.nz[v]);
+            const glm::vec3 t = stream_tangent(streams, v), b = stream_bitangent(streams, v);
+            const float sign = streams.tangentSign[v];
+            check(std::fabs(glm::length(t) - 1.0f) <= 1e-4f, "angle weighted tangent is not unit length" + vertex_name(v));
+            check(std::fabs(glm::dot(t, n)) <= 1e-4f, "angle weighted tangent is not orthogonal to the normal" + vertex_name(v));
+            check(sign == 1.0f || sign == -1.0f, "tangent sign is " + std::to_string(sign) + vertex_name(v));
+            check(max_difference(b, glm::cross(n, t) * sign) <= 1e-6f, "bitangent is not sign * cross(n, t)" + vertex_name(v));
+        }
+
+        // away from the mirror seam both modes see the same triangles and agree. Legacy negates the tangent of a left
+        // handed frame, angle weighted keeps it and stores the handedness in tangentSign instead.
+        it_TangentStreams flat;
+        std::vector<uint32_t> flatIndices;
+        generate_tangent_grid(TEST_GRID_SIZE, 0.0f, mirrored, &flat, &flatIndices);
+        compute_tangents(&flat, flatIndices.data(), flatIndices.size(), TANGENT_MODE_LEGACY);
+        it_TangentStreams legacy = flat;
+        compute_tangents(&flat, flatIndices.data(), flatIndices.size(), TANGENT_MODE_ANGLE_WEIGHTED);
+        size_t disagreeing = 0;
+        for (size_t v = 0; v < flat.px.size(); ++v)
+        {
+            const bool seam = mirrored && std::fabs(flat.px[v] - 0.5f) <= 1.0f / TEST_GRID_SIZE;
+            if (seam)
+                continue;
+            if (max_difference(stream_tangent(flat, v) * flat.tangentSign[v], stream_tangent(legacy, v)) > 1e-4f || max_difference(stream_bitangent(flat, v), stream_bitangent(legacy, v)) > 1e-4f)
+                disagreeing++;
+        }
+        check(disagreeing == 0, std::to_string(disagreeing) + " vertices of the flat " + grid + " have different legacy and angle weighted frames");
+    }
+    return s_failed - failedBefore;
+}
+
+
+static glm::vec3 any_orthogonal(const glm::vec3& n)
+{
+    const glm::vec3 axis = std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    return glm::normalize(glm::cross(n, axis));
+}
+
+// Random unit normal, a tangent orthogonal to it and a bitangent of either handedness
+static Vertex random_packing_vertex(std::mt19937* rng, const glm::vec3& center, float extent, const glm::vec2& uvMin, const glm::vec2& uvRange)
+{
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f), positive(0.0f, 1.0f);
+    Vertex vertex{};
+    vertex.pos = center + extent * glm::vec3(unit(*rng), unit(*rng), unit(*rng));
+    vertex.texCoord = uvMin + uvRange * glm::vec2(positive(*rng), positive(*rng));
+    vertex.color = glm::vec3(1.0f);
+    glm::vec3 n(unit(*rng), unit(*rng), unit(*rng));
+    vertex.normal = glm::dot(n, n) > 1e-6f ? glm::normalize(n) : glm::vec3(0.0f, 0.0f, 1.0f);
+    const float angle = positive(*rng) * 6.2831853f;
+    const glm::vec3 a = any_orthogonal(vertex.normal), b = glm::cross(vertex.normal, a);
+    vertex.tangent = a * std::cos(angle) + b * std::sin(angle);
+    vertex.bitangent = glm::cross(vertex.normal, vertex.tangent) * (positive(*rng) < 0.5f ? -1.0f : 1.0f);
+    return vertex;
+}
+
+static void check_packing_error(const std::vector<Vertex>& vertices, const std::string& name)
+{
+    const it_PackingParams params = compute_packing_params(vertices);
+    std::vector<PackedVertex> packed(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+        packed[i] = pack_vertex(vertices[i], params);
+    const it_PackingError error = measure_packing_error(vertices, packed, params);
+
+    // rounding to the nearest step is off by half a step at most, plus float error in the decode
+    const float positionLimit = params.extent * (0.5f / 32767.0f) * 1.01f;
+    const float uvLimit = std::max(params.uvRange.x, params.uvRange.y) * (0.5f / 65535.0f) * 1.01f;
+    check(error.position <= positionLimit, name + " position error " + std::to_string(error.position) + " above " + std::to_string(positionLimit));
+    check(error.texCoord <= uvLimit, name + " uv error " + std::to_string(error.texCoord) + " above " + std::to_string(uvLimit));
+    check(error.normalDegrees <= TEST_PACKING_MAX_DEGREES, name + " normal error " + std::to_string(error.normalDegrees) + " degrees");
+    check(error.tangentDegrees <= TEST_PACKING_MAX_DEGREES, name + " tangent error " + std::to_string(error.tangentDegrees) + " degrees");
+    check(error.handednessFlips == 0, name + " flipped the handedness of " + std::to_string(error.handednessFlips) + " vertices");
+}
+
+int test_vertex_packing()
+{
+    const int failedBefore = s_failed;
+    check(sizeof(PackedVertex) == 20, "PackedVertex is " + std::to_string(sizeof(PackedVertex)) + " bytes");
+
+    // an off center mesh with tiling uvs that go negative
+    std::mt19937 rng(1234);
+    std::vector<Vertex> vertices;
+    for (int i = 0; i < TEST_PACKING_VERTICES; ++i)
+        vertices.push_back(random_packing_vertex(&rng, glm::vec3(120.0f, -3.0f, 40.0f), 25.0f, glm::vec2(-2.0f, 0.5f), glm::vec2(6.0f, 3.0f)));
+    check_packing_error(vertices, "random mesh");
+
+    // the axes and the folded edges of the octahedron, where the encoding wraps around
+    const glm::vec3 directions[] = {
+        { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+        { 1, 1, -1e-4f }, { -1, 1, -1e-4f }, { 1, -1, -1e-4f }, { -1, -1, -1e-4f }, { 1, 0, -1 }, { 0, -1, -1 }, { -1, 1, -1 } };
+    for (const glm::vec3& direction : directions)
+    {
+        const glm::vec3 n = glm::normalize(direction);
+        const float difference = max_difference(oct_decode(oct_encode(n)), n);
+        check(difference <= TEST_EPSILON, "oct_encode/oct_decode of (" + std::to_string(n.x) + ", " + std::to_string(n.y) + ", " + std::to_string(n.z)
+            + ") is off by " + std::to_string(difference) + " without quantization");
+    }
+    vertices.clear();
+    for (const glm::vec3& direction : directions)
+    {
+        for (float handedness : { 1.0f, -1.0f })
+        {
+            Vertex vertex = random_packing_vertex(&rng, glm::vec3(0.0f), 1.0f, glm::vec2(0.0f), glm::vec2(1.0f));
+            vertex.normal = glm::normalize(direction);
+            vertex.tangent = any_orthogonal(vertex.normal);
+            vertex.bitangent = glm::cross(vertex.normal, vertex.tangent) * handedness;
+            vertices.push_back(vertex);
+        }
+    }
+    check_packing_error(vertices, "axis and fold directions");
+
+    // a flat quad has no extent on y and no uv range on one axis, the packing must not divide by zero
+    vertices.clear();
+    for (int i = 0; i < 4; ++i)
+    {
+        Vertex vertex = random_packing_vertex(&rng, glm::vec3(0.0f), 1.0f, glm::vec2(0.0f), glm::vec2(1.0f));
+        vertex.pos = glm::vec3(static_cast<float>(i & 1), 2.0f, static_cast<float>(i >> 1));
+        vertex.texCoord = glm::vec2(static_cast<float>(i & 1), 0.25f);
+        vertices.push_back(vertex);
+    }
+    check_packing_error(vertices, "flat quad");
+    return s_failed - failedBefore;
+}
+
+
+// Rotates a triangle to its lexicographically smallest rotation. Rotations keep the winding, and taking the minimum
+// of all three also works when indices repeat: (a, b, b), (b, a, b) and (b, b, a) all become the same triangle.
+static std::array<uint32_t, 3> canonical_triangle(uint32_t a, uint32_t b, uint32_t c)
+{
+    return std::min({ std::array<uint32_t, 3>{ a, b, c }, std::array<uint32_t, 3>{ b, c, a }, std::array<uint32_t, 3>{ c, a, b } });
+}
+
+// True if optimized holds exactly the triangles of original mapped through remap, as a multiset, with the same winding
+static bool same_triangles(const std::vector<uint32_t>& original, const std::vector<uint32_t>& optimized, const std::vector<uint32_t>& remap)
+{
+    if (original.size() != optimized.size())
+        return false;
+    std::vector<std::array<uint32_t, 3>> before, after;
+    for (size_t i = 0; i + 2 < original.size(); i += 3)
+    {
+        before.push_back(canonical_triangle(remap[original[i]], remap[original[i + 1]], remap[original[i + 2]]));
+        after.push_back(canonical_triangle(optimized[i], optimized[i + 1], optimized[i + 2]));
+    }
+    std::sort(before.begin(), before.end());
+    std::sort(after.begin(), after.end());
+    return before == after;
+}
+
+int test_mesh_optimization()
+{
+    const int failedBefore = s_failed;
+
+    // shuffled grid triangles, plus degenerate triangles with repeated indices and a duplicated triangle
+    it_TangentStreams grid;
+    std::vector<uint32_t> indices;
+    generate_tangent_grid(TEST_GRID_SIZE, 0.0f, false, &grid, &indices);
+    const size_t vertexCount = grid.px.size();
+    std::vector<std::array<uint32_t, 3>> triangles;
+    for (size_t i = 0; i < indices.size(); i += 3)
+        triangles.push_back({ indices[i], indices[i + 1], indices[i + 2] });
+    triangles.push_back({ 7, 7, 8 });
+    triangles.push_back({ 9, 8, 9 });
+    triangles.push_back({ 10, 11, 11 });
+    triangles.push_back({ 12, 12, 12 });
+    triangles.push_back(triangles[5]);
+    std::shuffle(triangles.begin(), triangles.end(), std::mt19937(99));
+    indices.clear();
+    for (const auto& triangle : triangles)
+        indices.insert(indices.end(), triangle.begin(), triangle.end());
+
+    // the comparison itself: rotations are equal, a flipped winding or a moved index is not
+    std::vector<uint32_t> identity(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        identity[v] = static_cast<uint32_t>(v);
+    std::vector<uint32_t> changed = indices;
+    std::rotate(changed.begin(), changed.begin() + 1, changed.begin() + 3);
+    check(same_triangles(indices, changed, identity), "a rotated triangle compares as different");
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        if (indices[i] == indices[i + 1] && indices[i + 1] != indices[i + 2])
+        {
+            changed = indices;
+            std::swap(changed[i + 1], changed[i + 2]);
+            check(same_triangles(indices, changed, identity), "a rotated degenerate triangle compares as different");
+            break;
+        }
+    }
+    changed = indices;
+    std::swap(changed[0], changed[1]);
+    check(!same_triangles(indices, changed, identity), "a flipped triangle compares as equal");
+    changed = indices;
+    changed[0] = changed[0] == 0 ? 1 : 0;
+    check(!same_triangles(indices, changed, identity), "a moved corner compares as equal");
+
+    const it_VertexCacheStats input = analyze_vertex_cache(indices.data(), indices.size(), vertexCount, MESH_VERTEX_CACHE_SIZE);
+    const struct { const char* name; void (*optimize)(uint32_t*, size_t, size_t, uint32_t); } optimizers[] = {
+        { "Tipsify", optimize_vertex_cache },
+        { "Forsyth", optimize_vertex_cache_forsyth },
+    };
+    for (const auto& optimizer : optimizers)
+    {
+        const std::string name = optimizer.name;
+        std::vector<uint32_t> optimized = indices;
+        optimizer.optimize(optimized.data(), optimized.size(), vertexCount, MESH_VERTEX_CACHE_SIZE);
+        check(same_triangles(indices, optimized, identity), name + " changed the triangles");
+
+        std::vector<uint32_t> remap = optimize_vertex_fetch(optimized.data(), optimized.size(), vertexCount);
+        check(same_triangles(indices, optimized, remap), name + " followed by the fetch remap changed the triangles");
+        std::vector<uint32_t> sortedRemap = remap;
+        std::sort(sortedRemap.begin(), sortedRemap.end());
+        check(sortedRemap == identity, name + " fetch remap is not a permutation");
+        bool firstUse = true;
+        uint32_t next = 0;
+        for (uint32_t v : optimized)
+        {
+            firstUse = firstUse && v <= next;
+            next = std::max(next, v + 1);
+        }
+        check(firstUse, name + " fetch remap does not number vertices in first use order");
+
+        const it_VertexCacheStats stats = analyze_vertex_cache(optimized.data(), optimized.size(), vertexCount, MESH_VERTEX_CACHE_SIZE);
+        check(stats.acmr < input.acmr * 0.5f, name + " ACMR " + std::to_string(stats.acmr) + " from " + std::to_string(input.acmr) + " on the shuffled grid");
+        check(stats.atvr >= 1.0f, name + " ATVR " + std::to_string(stats.atvr) + " is below one");
+    }
+    return s_failed - failedBefore;
+}
+
+
+struct it_TestMesh
+{
+    std::string name;
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    std::vector<uint8_t> locked;  // border and seam vertices simplify_mesh must never move
+};
+
+// Grid on the unit square, optionally a height field. The border is locked since it is open.
+static it_TestMesh simplification_grid(const std::string& name, float waviness)
+{
+    it_TestMesh mesh;
+    mesh.name = name;
+    it_TangentStreams grid;
+    generate_tangent_grid(TEST_GRID_SIZE, waviness, false, &grid, &mesh.indices);
+    for (size_t v = 0; v < grid.px.size(); ++v)
+    {
+        mesh.positions.push_back(glm::vec3(grid.px[v], grid.py[v], grid.pz[v]));
+        const uint32_t x = static_cast<uint32_t>(v % (TEST_GRID_SIZE + 1)), y = static_cast<uint32_t>(v / (TEST_GRID_SIZE + 1));
+        mesh.locked.push_back(x == 0 || y == 0 || x == TEST_GRID_SIZE || y == TEST_GRID_SIZE);
+    }
+    return mesh;
+}
+
+// Closed latitude/longitude sphere written the way the welder leaves a uv mapped one: the first and last column share
+// positions along the seam and every pole vertex is its own copy. Those shared positions are locked.
+static it_TestMesh simplification_sphere()
+{
+    it_TestMesh mesh;
+    mesh.name = "sphere";
+    const uint32_t rings = TEST_GRID_SIZE / 2, segments = TEST_GRID_SIZE;
+    for (uint32_t r = 0; r <= rings; ++r)
+    {
+        for (uint32_t s = 0; s <= segments; ++s)
+        {
+            const float theta = 3.14159265f * r / rings, phi = 6.2831853f * (s == segments ? 0 : s) / segments;
+            mesh.positions.push_back(glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+            mesh.locked.push_back(r == 0 || r == rings || s == 0 || s == segments);
+        }
+    }
+    for (uint32_t r = 0; r < rings; ++r)
+    {
+        for (uint32_t s = 0; s < segments; ++s)
+        {
+            const uint32_t i = r * (segments + 1) + s, below = i + segments + 1;
+            if (r > 0)
+                mesh.indices.insert(mesh.indices.end(), { i, i + 1, below });
+            if (r + 1 < rings)
+                mesh.indices.insert(mesh.indices.end(), { i + 1, below + 1, below });
+        }
+    }
+    return mesh;
+}
+
+int test_simplification()
+{
+    const int failedBefore = s_failed;
+    const it_TestMesh meshes[] = { simplification_grid("flat grid", 0.0f), simplification_grid("wavy grid", 0.2f), simplification_sphere() };
+    for (const it_TestMesh& mesh : meshes)
+    {
+        const float* positions = &mesh.positions[0].x;
+        const size_t vertexCount = mesh.positions.size(), indexCount = mesh.indices.size();
+        // the same bound load_model uses, 5% of the diagonal
+        const float maxError = 0.05f * std::sqrt(3.0f);
+        for (size_t level = 1; level < MESH_MAX_LODS; ++level)
+        {
+            const std::string name = mesh.name + " level " + std::to_string(level);
+            const size_t target = (indexCount >> level) / 3 * 3;
+            const it_SimplifyResult result = simplify_mesh(positions, sizeof(glm::vec3), vertexCount, mesh.indices.data(), indexCount, target, maxError);
+
+            check(result.indices.size() % 3 == 0 && result.indices.size() <= indexCount, name + " has " + std::to_string(result.indices.size()) + " indices");
+            check(result.indices.size() < indexCount, name + " removed no triangles");
+            check(result.error <= maxError, name + " error bound " + std::to_string(result.error) + " above the limit " + std::to_string(maxError));
+            const float measured = measure_simplification_error(positions, sizeof(glm::vec3), mesh.indices.data(), indexCount, result.collapse);
+            check(measured <= result.error * 1.001f + 1e-6f, name + " measured error " + std::to_string(measured) + " above its bound " + std::to_string(result.error));
+
+            size_t degenerate = 0, collapsedCorners = 0, movedLocked = 0;
+            for (size_t i = 0; i < result.indices.size(); i += 3)
+            {
+                const uint32_t a = result.indices[i], b = result.indices[i + 1], c = result.indices[i + 2];
+                degenerate += a == b || b == c || a == c;
+                for (uint32_t v : { a, b, c })
+                    collapsedCorners += result.collapse[v] != v;
+            }
+            for (size_t v = 0; v < vertexCount; ++v)
+                movedLocked += mesh.locked[v] && result.collapse[v] != v;
+            check(degenerate == 0, name + " kept " + std::to_string(degenerate) + " degenerate triangles");
+            check(collapsedCorners == 0, name + " references " + std::to_string(collapsedCorners) + " collapsed vertices");
+            check(movedLocked == 0, name + " moved " + std::to_string(movedLocked) + " border or seam vertices");
+        }
+    }
+
+    // a flat grid loses nothing, so every level must reach its target with no error at all
+    const it_TestMesh& flat = meshes[0];
+    const size_t target = (flat.indices.size() >> 3) / 3 * 3;
+    const it_SimplifyResult result = simplify_mesh(&flat.positions[0].x, sizeof(glm::vec3), flat.positions.size(), flat.indices.data(), flat.indices.size(), target, 1e-4f);
+    check(result.indices.size() <= target, "flat grid stopped at " + std::to_string(result.indices.size()) + " indices, target " + std::to_string(target));
+    check(result.error <= 1e-5f, "flat grid error bound " + std::to_string(result.error));
+    return s_failed - failedBefore;
+}
+
+
+static std::string temp_path(const std::string& name)
+{
+    std::error_code ec;
+    return (std::filesystem::temp_directory_path(ec) / name).string();
+}
+
+int test_meshlets()
+{
+    const int failedBefore = s_failed;
+    const it_TestMesh meshes[] = { simplification_grid("flat grid", 0.0f), simplification_grid("wavy grid", 0.2f), simplification_sphere() };
+    std::vector<it_MeshletData> built;
+    for (const it_TestMesh& mesh : meshes)
+    {
+        const float* positions = &mesh.positions[0].x;
+        it_MeshletData data;
+        build_meshlets(positions, sizeof(glm::vec3), mesh.positions.size(), mesh.indices.data(), mesh.indices.size(), &data);
+        std::string err;
+        check(validate_meshlets(data, positions, sizeof(glm::vec3), mesh.positions.size(), mesh.indices.data(), mesh.indices.size(), &err), mesh.name + " meshlets: " + err);
+        check(data.meshlets.size() >= mesh.indices.size() / 3 / MESHLET_MAX_TRIANGLES, mesh.name + " has too few meshlets to hold its triangles");
+
+        // the validator has to notice broken data, or the checks above prove nothing
+        it_MeshletData broken = data;
+        broken.meshlets[0].radius = 0.0f;
+        check(!validate_meshlets(broken, positions, sizeof(glm::vec3), mesh.positions.size(), mesh.indices.data(), mesh.indices.size(), &err), mesh.name + " zero radius sphere passed validation");
+        broken = data;
+        std::swap(broken.triangles[broken.meshlets[0].triangleOffset + 1], broken.triangles[broken.meshlets[0].triangleOffset + 2]);
+        check(!validate_meshlets(broken, positions, sizeof(glm::vec3), mesh.positions.size(), mesh.indices.data(), mesh.indices.size(), &err), mesh.name + " flipped triangle passed validation");
+        broken = data;
+        broken.meshlets.pop_back();
+        check(!validate_meshlets(broken, positions, sizeof(glm::vec3), mesh.positions.size(), mesh.indices.data(), mesh.indices.size(), &err), mesh.name + " missing meshlet passed validation");
+        built.push_back(std::move(data));
+    }
+
+    // a flat grid faces one way: every meshlet is culled from exactly one side
+    const float above[3] = { 0.5f, 10.0f, 0.5f }, below[3] = { 0.5f, -10.0f, 0.5f };
+    size_t bothOrNeither = 0;
+    for (const it_Meshlet& meshlet : built[0].meshlets)
+        bothOrNeither += meshlet_backfacing(meshlet, above) == meshlet_backfacing(meshlet, below);
+    check(bothOrNeither == 0, std::to_string(bothOrNeither) + " flat grid meshlets are back facing from both sides or from neither");
+    const float outside[6][4] = { { 1, 0, 0, -10 }, { 0, 1, 0, 10 }, { 0, -1, 0, 10 }, { -1, 0, 0, 10 }, { 0, 0, 1, 10 }, { 0, 0, -1, 10 } };
+    const float inside[6][4] = { { 1, 0, 0, 10 }, { 0, 1, 0, 10 }, { 0, -1, 0, 10 }, { -1, 0, 0, 10 }, { 0, 0, 1, 10 }, { 0, 0, -1, 10 } };
+    check(meshlet_outside_frustum(built[0].meshlets[0], outside, 1.0f), "meshlet behind the x >= 10 plane is not outside the frustum");
+    check(!meshlet_outside_frustum(built[0].meshlets[0], inside, 1.0f), "meshlet inside the frustum is culled");
+
+    // meshlets are stored with the mesh, a warm load must return them unchanged without rebuilding
+    const it_TestMesh& sphere = meshes[2];
+    Model model{};
+    model.baseDir = temp_path("");
+    if (!model.baseDir.empty() && model.baseDir.back() != '/' && model.baseDir.back() != '\\')
+        model.baseDir += '/';
+    model.MODEL_PATH = "test_meshlets.obj";
+    {
+        std::ofstream source(model.baseDir + model.MODEL_PATH, std::ios::binary | std::ios::trunc);
+        source << "# meshlet cache test\n";
+    }
+    for (size_t v = 0; v < sphere.positions.size(); ++v)
+    {
+        Vertex vertex{};
+        vertex.pos = sphere.positions[v];
+        vertex.normal = sphere.positions[v];
+        model.vertices.push_back(vertex);
+    }
+    model.indices = sphere.indices;
+    model.lods.assign(1, it_MeshLod{ 0, static_cast<uint32_t>(sphere.indices.size()), 0.0f });
+    model.meshlets = built[2];
+    write_mesh_cache(&model);
+
+    Model loaded{};
+    loaded.baseDir = model.baseDir;
+    loaded.MODEL_PATH = model.MODEL_PATH;
+    if (check(load_mesh_cache(&loaded), "mesh cache entry written by write_mesh_cache did not load"))
+    {
+        const it_MeshletData& a = model.meshlets, & b = loaded.meshlets;
+        check(a.meshlets.size() == b.meshlets.size() && std::memcmp(a.meshlets.data(), b.meshlets.data(), a.meshlets.size() * sizeof(it_Meshlet)) == 0,
+            "meshlets differ after the mesh cache round trip");
+        check(a.vertices == b.vertices && a.triangles == b.triangles, "meshlet vertex or triangle arrays differ after the mesh cache round trip");
+        check(loaded.indices == model.indices && loaded.vertices.size() == model.vertices.size(), "mesh differs after the mesh cache round trip");
+    }
+
+    // corrupt entries are rejected instead of reaching the geometry heap
+    const std::string cachePath = mesh_cache_path(model.baseDir + model.MODEL_PATH);
+    std::vector<char> entry;
+    {
+        std::ifstream f(cachePath, std::ios::binary);
+        entry.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    }
+    it_MeshCacheHeader header{};
+    if (check(entry.size() >= sizeof(header), "mesh cache entry is shorter than its header"))
+        memcpy(&header, entry.data(), sizeof(header));
+    auto rejects = [&](uint64_t offset, uint64_t value, size_t size, const std::string& what) {
+        std::vector<char> corrupt = entry;
+        if (!check(offset + size <= corrupt.size(), what + " lies outside the entry"))
+            return;
+        memcpy(corrupt.data() + offset, &value, size);
+        {
+            std::ofstream f(cachePath, std::ios::binary | std::ios::trunc);
+            f.write(corrupt.data(), corrupt.size());
+        }
+        Model corrupted{};
+        corrupted.baseDir = model.baseDir;
+        corrupted.MODEL_PATH = model.MODEL_PATH;
+        check(!load_mesh_cache(&corrupted) && corrupted.indices.empty() && corrupted.meshlets.meshlets.empty(), "mesh cache accepted " + what);
+    };
+    rejects(offsetof(it_MeshCacheHeader, lodOffset), UINT64_MAX - 7, sizeof(uint64_t), "a lod offset that wraps around");
+    rejects(offsetof(it_MeshCacheHeader, indexCount), UINT64_MAX / 2, sizeof(uint64_t), "an index count that overflows");
+    rejects(header.lodOffset + offsetof(it_MeshLod, indexCount), header.indexCount + 3, sizeof(uint32_t), "a lod past the index buffer");
+    rejects(header.lodOffset + offsetof(it_MeshLod, firstIndex), UINT32_MAX, sizeof(uint32_t), "a lod whose end overflows");
+    rejects(header.indexOffset + 5 * sizeof(uint32_t), header.vertexCount, sizeof(uint32_t), "an index past the vertices");
+    rejects(header.meshletOffset + offsetof(it_Meshlet, vertexOffset), header.meshletVertexCount, sizeof(uint32_t), "a meshlet past its vertex array");
+    rejects(header.meshletOffset + offsetof(it_Meshlet, triangleOffset), header.meshletTriangleBytes - 2, sizeof(uint32_t), "a meshlet past its triangle array");
+    rejects(header.meshletVertexOffset, header.vertexCount + 1, sizeof(uint32_t), "a meshlet vertex past the vertices");
+    rejects(header.meshletTriangleOffset, 0xFF, 1, "a micro index past its meshlet's vertices");
+
+    std::error_code ec;
+    std::filesystem::remove(cachePath, ec);
+    std::filesystem::remove(model.baseDir + model.MODEL_PATH, ec);
+    return s_failed - failedBefore;
+}
+
+
+// Free list invariants against the live allocations: ranges merged and inside capacity, both indices agree, free and
+// used space add up to the capacity and no free range overlaps an allocation
+static bool range_allocator_consistent(const it_RangeAllocator& allocator, const std::map<uint64_t, uint64_t>& live, std::string* err)
+{
+    uint64_t freeSpace = 0, end = 0;
+    bool first = true;
+    for (const auto& [offset, size] : allocator.freeRanges)
+    {
+        if (size == 0 || offset + size > allocator.capacity)
+            return *err = "free range " + std::to_string(offset) + "+" + std::to_string(size) + " is empty or past the capacity", false;
+        if (!first && offset <= end)
+            return *err = "free range at " + std::to_string(offset) + " touches or overlaps the previous one", false;
+        bool indexed = false;
+        auto sizes = allocator.freeSizes.equal_range(size);
+        for (auto it = sizes.first; it != sizes.second && !indexed; ++it)
+            indexed = it->second == offset;
+        if (!indexed)
+            return *err = "free range at " + std::to_string(offset) + " is missing from the size index", false;
+        auto after = live.lower_bound(offset);
+        if ((after != live.end() && after->first < offset + size) || (after != live.begin() && std::prev(after)->first + std::prev(after)->second > offset))
+            return *err = "free range at " + std::to_string(offset) + " overlaps an allocation", false;
+        freeSpace += size;
+        end = offset + size;
+        first = false;
+    }
+    if (allocator.freeSizes.size() != allocator.freeRanges.size())
+        return *err = "size index holds " + std::to_string(allocator.freeSizes.size()) + " ranges, offset index " + std::to_string(allocator.freeRanges.size()), false;
+    if (freeSpace + allocator.used != allocator.capacity)
+        return *err = "free " + std::to_string(freeSpace) + " plus used " + std::to_string(allocator.used) + " is not the capacity", false;
+    if (allocator.allocationCount != live.size())
+        return *err = "allocation count " + std::to_string(allocator.allocationCount) + ", live " + std::to_string(live.size()), false;
+    return true;
+}
+
+int test_range_allocator()
+{
+    const int failedBefore = s_failed;
+    std::mt19937 rng(2024);
+    it_RangeAllocator allocator;
+    range_allocator_init(&allocator, TEST_RANGE_CAPACITY);
+    std::map<uint64_t, uint64_t> live;  // offset -> size
+    std::vector<uint64_t> liveOffsets;
+
+    uint64_t allocations = 0, failures = 0, grows = 0;
+    double fragmentationSum = 0.0;
+    float fragmentationMax = 0.0f;
+    for (int op = 0; op < TEST_RANGE_OPS; ++op)
+    {
+        if (rng() % 100 < 55 || liveOffsets.empty())
+        {
+            // mostly small sizes with the odd large one, alignments from 1 to 256
+            const uint64_t size = rng() % 8 == 0 ? 1 + rng() % 16384 : 1 + rng() % 512;
+            const uint64_t alignment = uint64_t(1) << (rng() % 9);
+
+            // best fit by brute force over the free list: the smallest range the aligned allocation fits in
+            const std::vector<std::pair<uint64_t, uint64_t>> before(allocator.freeRanges.begin(), allocator.freeRanges.end());
+            uint64_t bestSize = UINT64_MAX;
+            for (const auto& [offset, rangeSize] : before)
+            {
+                const uint64_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+                if (aligned + size <= offset + rangeSize)
+                    bestSize = std::min(bestSize, rangeSize);
+            }
+
+            uint64_t offset = 0;
+            const bool ok = range_alloc_aligned(&allocator, size, alignment, &offset);
+            if (!check(ok == (bestSize != UINT64_MAX), "range_alloc_aligned(" + std::to_string(size) + ", " + std::to_string(alignment) + ") returned "
+                + (ok ? "true" : "false") + " against the free list"))
+                break;
+            if (ok)
+            {
+                allocations++;
+                auto after = live.lower_bound(offset);
+                const bool overlaps = (after != live.end() && after->first < offset + size) || (after != live.begin() && std::prev(after)->first + std::prev(after)->second > offset);
+                if (!check(offset % alignment == 0 && offset + size <= allocator.capacity && !overlaps, "allocation " + std::to_string(offset) + "+" + std::to_string(size)
+                    + " is misaligned, past the capacity or overlaps another"))
+                    break;
+                auto source = std::upper_bound(before.begin(), before.end(), std::make_pair(offset, UINT64_MAX));
+                if (!check(source != before.begin() && std::prev(source)->second == bestSize, "allocation " + std::to_string(offset) + " did not come from the best fitting range"))
+                    break;
+                live[offset] = size;
+                liveOffsets.push_back(offset);
+            }
+            else
+            {
+                // the owner grows the pool when it runs out, a few times, then allocations start failing for good
+                failures++;
+                if (grows < TEST_RANGE_MAX_GROWS)
+                {
+                    range_allocator_grow(&allocator, allocator.capacity + TEST_RANGE_CAPACITY / 2);
+                    grows++;
+                }
+            }
+        }
+        else
+        {
+            const size_t pick = rng() % liveOffsets.size();
+            const uint64_t offset = liveOffsets[pick];
+            range_free(&allocator, offset, live[offset]);
+            live.erase(offset);
+            liveOffsets[pick] = liveOffsets.back();
+            liveOffsets.pop_back();
+        }
+
+        std::string err;
+        if (!check(range_allocator_consistent(allocator, live, &err), "after operation " + std::to_string(op) + ": " + err))
+            break;
+
+        // fragmentation as the allocator reports it and as the free list says it should be
+        uint64_t largest = 0;
+        for (const auto& range : allocator.freeRanges)
+            largest = std::max(largest, range.second);
+        const uint64_t freeSpace = allocator.capacity - allocator.used;
+        const float expected = freeSpace ? 1.0f - static_cast<float>(largest) / static_cast<float>(freeSpace) : 0.0f;
+        const float fragmentation = range_fragmentation(&allocator);
+        if (!check(range_largest_free(&allocator) == largest && std::fabs(fragmentation - expected) <= 1e-6f, "fragmentation " + std::to_string(fragmentation)
+            + " or largest free range " + std::to_string(range_largest_free(&allocator)) + " disagree with the free list"))
+            break;
+        fragmentationSum += fragmentation;
+        fragmentationMax = std::max(fragmentationMax, fragmentation);
+    }
+
+    tlog::info("range allocator: " + std::to_string(allocations) + " allocations, " + std::to_string(failures) + " out of space, " + std::to_string(grows) + " grows, "
+        + std::to_string(allocator.freeRanges.size()) + " free ranges at the end, fragmentation average " + std::to_string(fragmentationSum / TEST_RANGE_OPS)
+        + " max " + std::to_string(fragmentationMax));
+
+    // freeing everything must merge back into one range covering the whole capacity
+    for (const auto& [offset, size] : live)
+        range_free(&allocator, offset, size);
+    live.clear();
+    check(allocator.freeRanges.size() == 1 && allocator.freeRanges.begin()->first == 0 && allocator.freeRanges.begin()->second == allocator.capacity,
+        "freeing every allocation left " + std::to_string(allocator.freeRanges.size()) + " free ranges");
+    check(allocator.used == 0 && allocator.allocationCount == 0 && range_fragmentation(&allocator) == 0.0f, "empty allocator still reports use or fragmentation");
+
+    // zero sized requests never take space
+    uint64_t offset = 1;
+    check(range_alloc(&allocator, 0, &offset) && offset == 0 && allocator.allocationCount == 0, "zero sized allocation changed the allocator");
+    return s_failed - failedBefore;
+}
+
+
+// In order fake GPU: waiting on a ticket finishes it and everything submitted before it
+struct it_FakeFences
+{
+	uint64_t completed = 0;
+	std::vector<uint64_t> waitedOn;
+};
+
+static it_FenceSource fake_fence_source(it_FakeFences* fake)
+{
+    it_FenceSource source;
+    source.userData = fake;
+    source.completed = [](void* userData) { return static_cast<it_FakeFences*>(userData)->completed; };
+    source.wait = [](void* userData, uint64_t ticket) {
+        it_FakeFences* fake = static_cast<it_FakeFences*>(userData);
+        fake->waitedOn.push_back(ticket);
+        fake->completed = std::max(fake->completed, ticket);
+    };
+    return source;
+}
+
+int test_staging_ring()
+{
+    const int failedBefore = s_failed;
+    it_FakeFences fake;
+    it_StagingRing ring;
+    uint64_t offset = 0;
+
+    // alignment, and requests larger than the ring fail without waiting
+    staging_ring_init(&ring, TEST_RING_CAPACITY, fake_fence_source(&fake));
+    check(staging_ring_alloc(&ring, 100, 16, &offset) && offset == 0, "first allocation not at 0");
+    check(staging_ring_alloc(&ring, 50, 64, &offset) && offset == 128, "64 byte aligned allocation after 100 bytes at " + std::to_string(offset));
+    check(!staging_ring_alloc(&ring, TEST_RING_CAPACITY + 1, 1, &offset) && fake.waitedOn.empty(), "allocation larger than the ring succeeded or waited");
+
+    // wraparound: the skipped end of the buffer is charged to the allocation that wrapped and released with its batch
+    staging_ring_init(&ring, TEST_RING_CAPACITY, fake_fence_source(&fake));
+    fake = it_FakeFences();
+    staging_ring_alloc(&ring, 600, 1, &offset);
+    staging_ring_submit(&ring, 1);
+    staging_ring_alloc(&ring, 300, 1, &offset);
+    staging_ring_submit(&ring, 2);
+    fake.completed = 1;
+    check(staging_ring_alloc(&ring, 200, 1, &offset) && offset == 0, "wrapped allocation at " + std::to_string(offset) + " instead of 0");
+    check(ring.head - ring.tail == 300 + 124 + 200, "ring holds " + std::to_string(ring.head - ring.tail) + " bytes after wrapping, expected the skipped 124 as well");
+    check(fake.waitedOn.empty(), "wrapping into retired space waited on a fence");
+    staging_ring_submit(&ring, 3);
+    fake.completed = 2;
+    staging_ring_retire(&ring);
+    check(ring.head - ring.tail == 124 + 200, "skipped tail released before the allocation that wrapped");
+    fake.completed = 3;
+    staging_ring_retire(&ring);
+    check(ring.head == ring.tail && ring.inFlight.empty(), "ring not empty once every batch completed");
+
+    // a full ring waits on the oldest submission only, as long as that frees enough
+    staging_ring_init(&ring, TEST_RING_CAPACITY, fake_fence_source(&fake));
+    fake = it_FakeFences();
+    staging_ring_alloc(&ring, 400, 1, &offset);
+    staging_ring_submit(&ring, 1);
+    staging_ring_alloc(&ring, 400, 1, &offset);
+    staging_ring_submit(&ring, 2);
+    check(staging_ring_alloc(&ring, 400, 1, &offset) && offset == 0, "allocation after waiting at " + std::to_string(offset));
+    check(fake.waitedOn == std::vector<uint64_t>{ 1 } && ring.waits == 1, "waited on " + std::to_string(fake.waitedOn.size()) + " fences instead of the oldest one");
+    check(ring.inFlight.size() == 1 && ring.inFlight.front().first == 2, "the newer batch was retired without completing");
+
+    // only the open batch holds the space: after waiting out everything submitted, the ring gives up instead of
+    // waiting on a ticket that does not exist yet
+    staging_ring_init(&ring, TEST_RING_CAPACITY, fake_fence_source(&fake));
+    fake = it_FakeFences();
+    staging_ring_alloc(&ring, 200, 1, &offset);
+    staging_ring_submit(&ring, 1);
+    staging_ring_alloc(&ring, 800, 1, &offset);
+    const uint64_t head = ring.head;
+    check(!staging_ring_alloc(&ring, 300, 1, &offset), "allocation succeeded although the open batch holds the space");
+    check(fake.waitedOn == std::vector<uint64_t>{ 1 } && ring.head == head && ring.inFlight.empty(), "failed allocation did not wait out exactly the submitted batch or changed the head");
+    staging_ring_submit(&ring, 2);
+    check(staging_ring_alloc(&ring, 300, 1, &offset) && offset == 0, "allocation after submitting the open batch failed or landed at " + std::to_string(offset));
+
+    // random sizes and alignments with a GPU that finishes at its own pace: no byte may be handed out while a batch
+    // that was given it is still running
+    staging_ring_init(&ring, TEST_RING_CAPACITY, fake_fence_source(&fake));
+    fake = it_FakeFences();
+    std::mt19937 rng(5);
+    std::vector<uint64_t> owner(TEST_RING_CAPACITY, 0);  // ticket of the batch using a byte, 0 when free
+    uint64_t ticket = 1, submittedTicket = 0;
+    size_t overlaps = 0, refused = 0;
+    for (int op = 0; op < TEST_RING_OPS; ++op)
+    {
+        const uint64_t size = 1 + rng() % (TEST_RING_CAPACITY / 3);
+        const uint64_t alignment = uint64_t(1) << (rng() % 8);
+        bool ok = staging_ring_alloc(&ring, size, alignment, &offset);
+        if (!ok)
+        {
+            refused++;
+            staging_ring_submit(&ring, ticket);
+            submittedTicket = ticket++;
+            ok = staging_ring_alloc(&ring, size, alignment, &offset);
+        }
+        for (size_t b = 0; b < owner.size(); ++b)
+            if (owner[b] && owner[b] <= fake.completed)
+                owner[b] = 0;
+        if (!check(ok && offset % alignment == 0 && offset + size <= TEST_RING_CAPACITY, "random allocation " + std::to_string(op) + " failed or is out of place"))
+            break;
+        for (uint64_t b = offset; b < offset + size; ++b)
+        {
+            overlaps += owner[b] != 0;
+            owner[b] = ticket;
+        }
+        if (rng() % 3 == 0)
+        {
+            staging_ring_submit(&ring, ticket);
+            submittedTicket = ticket++;
+        }
+        if (rng() % 4 == 0 && fake.completed < submittedTicket)
+            fake.completed += 1 + rng() % (submittedTicket - fake.completed);
+    }
+    check(overlaps == 0, std::to_string(overlaps) + " bytes were handed out while a running batch still used them");
+    tlog::info("staging ring: " + std::to_string(TEST_RING_OPS) + " random allocations, " + std::to_string(ring.waits) + " waits, " + std::to_string(refused)
+        + " refused until the open batch was submitted");
+    return s_failed - failedBefore;
+}
+
+
+// Every texel names its level and page, so a tile shows which page it was cut from
+static void virtual_texture_chain(uint32_t size, it_MipChain* chain)
+{
+    chain->levels.clear();
+    chain->pixels.clear();
+    for (uint32_t level = 0, width = size; level < texture_mip_levels(static_cast<int>(size), static_cast<int>(size)); ++level, width = std::max(width / 2, 1u))
+    {
+        chain->levels.push_back(it_MipLevel{ width, width, chain->pixels.size() });
+        for (uint32_t y = 0; y < width; ++y)
+            for (uint32_t x = 0; x < width; ++x)
+                chain->pixels.insert(chain->pixels.end(), { uint8_t(level), uint8_t(x / VT_PAGE_SIZE), uint8_t(y / VT_PAGE_SIZE), 255 });
+    }
+}
+
+static uint32_t virtual_texture_page(const it_VirtualTexture& vt, uint32_t level, uint32_t x, uint32_t y)
+{
+    return vt.levels[level].firstPage + y * vt.levels[level].pagesX + x;
+}
+
+// One frame of synthetic feedback: samples at (u, v, lod), then the uploads it causes as (page, slot) pairs
+static std::vector<std::pair<uint32_t, uint32_t>> virtual_texture_frame(it_VirtualTexture* vt, const std::vector<glm::vec3>& samples, uint64_t frame)
+{
+    std::vector<uint32_t> entries;
+    for (const glm::vec3& sample : samples)
+        entries.push_back(vt_feedback_entry(vt, sample.x, sample.y, sample.z));
+    entries.push_back(VT_FEEDBACK_NONE);
+    vt_feedback(vt, entries.data(), entries.size(), frame);
+
+    std::vector<it_VtUpload> uploads;
+    vt_update(vt, VT_MAX_PENDING_LOADS, &uploads);
+    std::vector<std::pair<uint32_t, uint32_t>> placed;
+    for (const it_VtUpload& upload : uploads)
+        placed.push_back({ upload.page, upload.slot });
+    return placed;
+}
+
+// Unpinned resident pages, most recently used first
+static std::vector<uint32_t> virtual_texture_lru(const it_VirtualTexture& vt)
+{
+    std::vector<uint32_t> pages;
+    for (uint32_t slot = vt.lruHead; slot != VT_INVALID; slot = vt.slots[slot].next)
+        pages.push_back(vt.slots[slot].page);
+    return pages;
+}
+
+static uint32_t virtual_texture_entry(const it_VirtualTexture& vt, uint32_t slot, uint32_t level)
+{
+    return vt_page_entry(slot % vt.cacheColumns, slot / vt.cacheColumns, level);
+}
+
+int test_virtual_texture()
+{
+    const int failedBefore = s_failed;
+    typedef std::vector<std::pair<uint32_t, uint32_t>> Placed;
+
+    // 512 texels: level 0 has 4x4 pages, level 1 2x2, levels 2 to 9 one pinned page each, and 4 tiles for the rest
+    it_MipChain chain;
+    virtual_texture_chain(TEST_VT_SIZE, &chain);
+    const std::string path = temp_path("test_virtual_texture.vtx");
+    if (!check(write_virtual_texture(path, &chain, VK_FORMAT_R8G8B8A8_UNORM), "could not write " + path))
+        return s_failed - failedBefore;
+    it_VirtualTexture vt;
+    open_virtual_texture(path, TEST_VT_PINNED + TEST_VT_FREE_SLOTS, &vt);
+    check(!vt.asyncLoads, "virtual texture loads on the job system, the test needs them in vt_update");
+    check(vt.levels.size() == 10 && vt.pending == TEST_VT_PINNED, std::to_string(vt.levels.size()) + " levels and " + std::to_string(vt.pending) + " pinned pages requested");
+
+    // the pinned pages come in first, coarser ones at later levels, and become the fallback of every page
+    std::vector<it_VtUpload> uploads;
+    vt_update(&vt, VT_MAX_PENDING_LOADS, &uploads);
+    check(uploads.size() == TEST_VT_PINNED, std::to_string(uploads.size()) + " pinned uploads");
+    for (size_t i = 0; i < uploads.size(); ++i)
+    {
+        const uint32_t level = 2 + static_cast<uint32_t>(i);
+        const uint8_t* center = &uploads[i].texels[(static_cast<size_t>(VT_TILE_SIZE / 2) * VT_TILE_SIZE + VT_TILE_SIZE / 2) * 4];
+        check(uploads[i].page == virtual_texture_page(vt, level, 0, 0) && uploads[i].slot == i && vt.slots[i].pinned && center[0] == level,
+            "pinned upload " + std::to_string(i) + " is page " + std::to_string(uploads[i].page) + " in slot " + std::to_string(uploads[i].slot));
+    }
+    const uint32_t pinnedEntry = virtual_texture_entry(vt, 0, 2);
+    check(vt.pageTable[virtual_texture_page(vt, 0, 3, 3)] == pinnedEntry && vt.pageTable[virtual_texture_page(vt, 1, 1, 0)] == pinnedEntry,
+        "absent pages do not fall back to the first pinned level");
+    check(vt.lruHead == VT_INVALID, "pinned tiles are in the LRU list");
+
+    // a miss requests the page and its missing parent, parent first; the border comes from the neighbouring page
+    const glm::vec3 page11(0.3f, 0.3f, 0.0f), page33(0.9f, 0.9f, 0.0f), page00(0.1f, 0.1f, 0.0f);
+    const glm::vec3 parent10(0.7f, 0.2f, 1.0f), parent01(0.2f, 0.7f, 1.0f);
+    check(vt_feedback_entry(&vt, page11.x, page11.y, page11.z) == vt_pack_page(0, 1, 1) && vt_feedback_entry(&vt, 1.3f, -0.7f, 20.0f) == vt_pack_page(9, 0, 0),
+        "feedback entries do not wrap uv or clamp the level");
+    const uint32_t p11 = virtual_texture_page(vt, 0, 1, 1), p33 = virtual_texture_page(vt, 0, 3, 3), p00 = virtual_texture_page(vt, 0, 0, 0);
+    const uint32_t q00 = virtual_texture_page(vt, 1, 0, 0), q10 = virtual_texture_page(vt, 1, 1, 0), q01 = virtual_texture_page(vt, 1, 0, 1), q11 = virtual_texture_page(vt, 1, 1, 1);
+    uploads.clear();
+    vt_feedback(&vt, std::vector<uint32_t>{ vt_pack_page(0, 1, 1) }.data(), 1, 1);
+    vt_update(&vt, VT_MAX_PENDING_LOADS, &uploads);
+    check(uploads.size() == 2 && uploads[0].page == q00 && uploads[1].page == p11 && uploads[1].slot == TEST_VT_PINNED + 1,
+        "frame 1 did not load the parent and then the page");
+    if (uploads.size() == 2)
+    {
+        const uint8_t* left = &uploads[1].texels[(static_cast<size_t>(VT_TILE_SIZE / 2) * VT_TILE_SIZE) * 4];
+        const uint8_t* center = &uploads[1].texels[(static_cast<size_t>(VT_TILE_SIZE / 2) * VT_TILE_SIZE + VT_TILE_SIZE / 2) * 4];
+        check(center[0] == 0 && center[1] == 1 && center[2] == 1 && left[1] == 0 && left[2] == 1, "tile of page (1, 1) has the wrong texels or border");
+    }
+    check(vt.pageTable[p11] == virtual_texture_entry(vt, TEST_VT_PINNED + 1, 0), "resident page does not point at its tile");
+    check(vt.pageTable[virtual_texture_page(vt, 0, 0, 1)] == virtual_texture_entry(vt, TEST_VT_PINNED, 1), "absent page does not fall back to its resident parent");
+    check(vt.pageTable[p33] == pinnedEntry, "page under an absent parent does not fall back to the pinned level");
+    check(vt.stats.misses == 1 && vt.stats.hits == 0, "frame 1 counted " + std::to_string(vt.stats.misses) + " misses");
+
+    // the remaining tiles fill up, the newest upload heads the LRU list
+    Placed placed = virtual_texture_frame(&vt, { parent10, parent01 }, 2);
+    check(placed == Placed{ { q10, TEST_VT_PINNED + 2 }, { q01, TEST_VT_PINNED + 3 } }, "frame 2 did not load both level 1 pages into the free tiles");
+    check(virtual_texture_lru(vt) == std::vector<uint32_t>{ q01, q10, p11, q00 }, "LRU order after filling the cache");
+
+    // a hit moves to the front, the least recently used tiles are evicted for the new page and its parent
+    placed = virtual_texture_frame(&vt, { page11, page33 }, 3);
+    check(placed == Placed{ { q11, TEST_VT_PINNED }, { p33, TEST_VT_PINNED + 2 } }, "frame 3 did not evict the two least recently used tiles");
+    check(virtual_texture_lru(vt) == std::vector<uint32_t>{ p33, q11, p11, q01 }, "LRU order after evicting");
+    check(vt.pageState[q00] == VT_PAGE_ABSENT && vt.pageState[q10] == VT_PAGE_ABSENT && vt.stats.evictions == 2, "evicted pages still resident");
+    check(vt.pageTable[virtual_texture_page(vt, 0, 0, 1)] == pinnedEntry, "page under an evicted parent does not fall back to the pinned level");
+
+    // nothing the frame touched is evicted, the loads wait without being requested twice
+    placed = virtual_texture_frame(&vt, { page11, page33, parent01, glm::vec3(0.9f, 0.9f, 1.0f), page00 }, 4);
+    check(placed.empty() && vt.pending == 2 && vt.queued.size() == 2, "frame 4 evicted a tile it touched");
+    check(virtual_texture_lru(vt) == std::vector<uint32_t>{ q11, q01, p33, p11 }, "LRU order does not follow the order frame 4 touched the pages in");
+    placed = virtual_texture_frame(&vt, { page00 }, 5);
+    check(placed == Placed{ { q00, TEST_VT_PINNED + 1 }, { p00, TEST_VT_PINNED + 2 } } && vt.pending == 0, "frame 5 did not place the waiting loads in the oldest tiles");
+    check(virtual_texture_lru(vt) == std::vector<uint32_t>{ p00, q00, q11, q01 }, "LRU order after frame 5");
+
+    // pinned tiles never leave, whatever the feedback did
+    for (uint32_t slot = 0; slot < TEST_VT_PINNED; ++slot)
+        check(vt.slots[slot].pinned && vt.slots[slot].page == virtual_texture_page(vt, 2 + slot, 0, 0) && vt.pageState[vt.slots[slot].page] == VT_PAGE_RESIDENT,
+            "pinned slot " + std::to_string(slot) + " lost its page");
+    check(vt.stats.loads == TEST_VT_PINNED + 8 && vt.stats.dropped == 0, std::to_string(vt.stats.loads) + " loads");
+    close_virtual_texture(&vt);
+
+    // the same feedback stream gives the same uploads every run
+    std::vector<Placed> runs[2];
+    for (std::vector<Placed>& run : runs)
+    {
+        it_VirtualTexture replay;
+        open_virtual_texture(path, TEST_VT_PINNED + TEST_VT_FREE_SLOTS, &replay);
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> uv(0.0f, 1.0f), lod(0.0f, 3.0f);
+        for (uint64_t frame = 0; frame < 64; ++frame)
+        {
+            std::vector<glm::vec3> samples;
+            for (int s = 0; s < 16; ++s)
+                samples.push_back(glm::vec3(uv(rng), uv(rng), lod(rng)));
+            run.push_back(virtual_texture_frame(&replay, samples, frame));
+        }
+        close_virtual_texture(&replay);
+    }
+    check(runs[0] == runs[1], "replaying the same feedback gave different uploads");
+
+    // the cook stores its source stamp as the tag, a file without one reads back empty
+    std::string tag = "stale";
+    check(read_virtual_texture_tag(path, &tag) && tag.empty(), "untagged virtual texture read back tag '" + tag + "'");
+    const std::string stamp = "source stamp";
+    check(write_virtual_texture(path, &chain, VK_FORMAT_R8G8B8A8_UNORM, stamp.data(), static_cast<uint32_t>(stamp.size()))
+        && read_virtual_texture_tag(path, &tag) && tag == stamp, "tag read back as '" + tag + "'");
+    check(!write_virtual_texture(path, &chain, VK_FORMAT_R8G8B8A8_UNORM, std::string(VT_FILE_ALIGNMENT, 't').data(), VT_FILE_ALIGNMENT),
+        "a tag beyond the header's page was written");
+    it_VirtualTexture tagged;
+    open_virtual_texture(path, TEST_VT_PINNED + TEST_VT_FREE_SLOTS, &tagged);
+    check(tagged.levels.size() == 10 && tagged.pending == TEST_VT_PINNED, "the tag moved the tiles");
+    close_virtual_texture(&tagged);
+
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+    check(!read_virtual_texture_tag(path, &tag), "a missing file has a tag");
+    return s_failed - failedBefore;
+}
+
+
+// Largest element difference between two matrices
+static float matrix_difference(const glm::mat4& a, const glm::mat4& b)
+{
+    float difference = 0.0f;
+    for (int c = 0; c < 4; ++c)
+        for (int r = 0; r < 4; ++r)
+            difference = std::max(difference, std::abs(a[c][r] - b[c][r]));
+    return difference;
+}
+
+int test_transform_store()
+{
+    const int failedBefore = s_failed;
+
+    // random transforms past a chunk boundary and not a multiple of the AVX2 width, then the angles where Euler
+    // rotations degenerate, and mirroring scales
+    std::mt19937 rng(13);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f), angle(-10.0f, 10.0f), scale(0.05f, 4.0f);
+    std::vector<Model> models(TEST_TRANSFORM_COUNT);
+    for (Model& model : models)
+    {
+        model.translationVec = glm::vec3(position(rng), position(rng), position(rng));
+        model.rotationVec = glm::vec3(angle(rng), angle(rng), angle(rng));
+        model.scaleVec = glm::vec3(scale(rng), scale(rng), scale(rng));
+    }
+    const float pi = 3.14159265f, halfPi = 0.5f * pi;
+    const glm::vec3 specialAngles[] = { glm::vec3(0.0f), glm::vec3(0.0f, halfPi, 0.0f), glm::vec3(0.3f, -halfPi, 1.1f), glm::vec3(pi, pi, pi),
+        glm::vec3(-pi, 0.0f, halfPi), glm::vec3(2.0f * pi, -2.0f * pi, 0.0f) };
+    for (size_t i = 0; i < std::size(specialAngles); ++i)
+    {
+        models[i].rotationVec = specialAngles[i];
+        models[i + std::size(specialAngles)].scaleVec = glm::vec3(-1.0f, 1.0f, 2.0f);
+    }
+
+    it_TransformStore store;
+    transform_store_reserve(&store, models.size());
+    for (Model& model : models)
+    {
+        model.transformDirty = true;
+        update_model_transform(&model);
+        transform_push(&store, model.translationVec, model.rotationVec, model.scaleVec);
+    }
+    auto max_error = [&](size_t first, size_t count) {
+        float error = 0.0f;
+        for (size_t i = first; i < first + count; ++i)
+            error = std::max(error, matrix_difference(models[i].transform, store.world[i]));
+        return error;
+    };
+
+    // every path against the glm matrices update_model_transform builds, translation dominates the tolerance
+    transform_use_simd(false);
+    transform_update_range(&store, 0, store.count);
+    const float scalarError = max_error(0, store.count);
+    check(scalarError <= TEST_TRANSFORM_EPSILON, "scalar transforms differ from glm by " + std::to_string(scalarError));
+    transform_use_simd(true);
+    float simdError = 0.0f, worldError = 0.0f;
+    if (transform_simd_supported())
+    {
+        std::fill(store.world.begin(), store.world.end(), glm::mat4(0.0f));
+        transform_update_range(&store, 0, store.count);
+        simdError = max_error(0, store.count);
+        check(simdError <= TEST_TRANSFORM_EPSILON, "AVX2 transforms differ from glm by " + std::to_string(simdError));
+    }
+    std::fill(store.world.begin(), store.world.end(), glm::mat4(0.0f));
+    transform_update_world(&store);
+    worldError = max_error(0, store.count);
+    check(worldError <= TEST_TRANSFORM_EPSILON, "chunked transforms differ from glm by " + std::to_string(worldError));
+
+    // a range starting and ending off the AVX2 width rebuilds exactly its matrices
+    const size_t first = 5, count = 3 * TRANSFORM_BATCH + 3;
+    for (size_t i = first; i < first + count; ++i)
+    {
+        models[i].translationVec += glm::vec3(1.0f, -2.0f, 3.0f);
+        models[i].rotationVec.y += 0.5f;
+        models[i].transformDirty = true;
+        update_model_transform(&models[i]);
+        transform_set(&store, static_cast<uint32_t>(i), models[i].translationVec, models[i].rotationVec, models[i].scaleVec);
+    }
+    const glm::mat4 before = store.world[first - 1], after = store.world[first + count];
+    transform_update_range(&store, first, count);
+    check(max_error(first, count) <= TEST_TRANSFORM_EPSILON, "transforms set and rebuilt in a range differ from glm");
+    check(store.world[first - 1] == before && store.world[first + count] == after, "rebuilding a range touched matrices outside it");
+
+    tlog::info("transform store: " + std::to_string(store.count) + " transforms, max difference from glm scalar " + std::to_string(scalarError) + ", AVX2 "
+        + (transform_simd_supported() ? std::to_string(simdError) : std::string("unsupported")) + ", chunked " + std::to_string(worldError));
+    return s_failed - failedBefore;
+}
+
+// Random TRS on a model, parentless so update_model_transform gives its local matrix
+static void hierarchy_random_trs(std::mt19937* rng, Model* model)
+{
+    std::uniform_real_distribution<float> position(-5.0f, 5.0f), angle(-3.0f, 3.0f), scale(0.5f, 1.5f);
+    model->translationVec = glm::vec3(position(*rng), position(*rng), position(*rng));
+    model->rotationVec = glm::vec3(angle(*rng), angle(*rng), angle(*rng));
+    model->scaleVec = glm::vec3(scale(*rng), scale(*rng), scale(*rng));
+    model->transformDirty = true;
+}
+
+// World matrices the slow way: glm local matrices multiplied up the parent chain, parents by index
+static std::vector<glm::mat4> hierarchy_reference(std::vector<Model>& locals, const std::vector<uint32_t>& parents)
+{
+    std::vector<glm::mat4> world(locals.size());
+    for (size_t i = 0; i < locals.size(); ++i)
+    {
+        locals[i].transformDirty = true;
+        update_model_transform(&locals[i]);
+        world[i] = locals[i].transform;
+        for (uint32_t p = parents[i]; p != HIERARCHY_ROOT; p = parents[p])
+        {
+            locals[p].transformDirty = true;
+            update_model_transform(&locals[p]);
+            world[i] = locals[p].transform * world[i];
+        }
+    }
+    return world;
+}
+
+// Whether node lies in the subtree below root, root included
+static bool hierarchy_below(const std::vector<uint32_t>& parents, uint32_t node, uint32_t root)
+{
+    for (uint32_t n = node; n != HIERARCHY_ROOT; n = parents[n])
+        if (n == root)
+            return true;
+    return false;
+}
+
+// hierarchy_sort postconditions: order is a permutation with every parent placed before its children
+static bool hierarchy_sorted(const std::vector<uint32_t>& parents, const std::vector<uint32_t>& order)
+{
+    std::vector<uint32_t> position(parents.size(), UINT32_MAX);
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        if (order[i] >= parents.size() || position[order[i]] != UINT32_MAX)
+            return false;
+        position[order[i]] = static_cast<uint32_t>(i);
+    }
+    for (size_t i = 0; i < parents.size(); ++i)
+        if (position[i] == UINT32_MAX || (parents[i] != HIERARCHY_ROOT && position[parents[i]] >= position[i]))
+            return false;
+    return true;
+}
+
+int test_transform_hierarchy()
+{
+    const int failedBefore = s_failed;
+
+    // three roots, every other node below a random earlier one, so chains run several levels deep
+    std::mt19937 rng(21);
+    std::vector<Model> locals(TEST_HIERARCHY_NODES);
+    std::vector<uint32_t> parents(TEST_HIERARCHY_NODES, HIERARCHY_ROOT);
+    it_TransformHierarchy hierarchy;
+    for (uint32_t i = 0; i < TEST_HIERARCHY_NODES; ++i)
+    {
+        if (i >= 3)
+            parents[i] = std::max<uint32_t>(i / 2, rng() % i);
+        hierarchy_random_trs(&rng, &locals[i]);
+        hierarchy_add(&hierarchy, parents[i], locals[i].translationVec, locals[i].rotationVec, locals[i].scaleVec);
+    }
+    uint32_t depth = 0;
+    for (uint32_t i = 0; i < TEST_HIERARCHY_NODES; ++i)
+    {
+        uint32_t d = 0;
+        for (uint32_t p = parents[i]; p != HIERARCHY_ROOT; p = parents[p])
+            ++d;
+        depth = std::max(depth, d);
+    }
+    check(depth >= 3, "test hierarchy is only " + std::to_string(depth) + " levels deep");
+
+    auto world_error = [&]() {
+        const std::vector<glm::mat4> reference = hierarchy_reference(locals, parents);
+        float error = 0.0f;
+        for (size_t i = 0; i < reference.size(); ++i)
+            error = std::max(error, matrix_difference(reference[i], hierarchy.world[i]));
+        return error;
+    };
+    check(hierarchy_update(&hierarchy) == TEST_HIERARCHY_NODES, "first update did not build every node");
+    float error = world_error();
+    check(error <= TEST_TRANSFORM_EPSILON, "world matrices differ from glm by " + std::to_string(error));
+    check(hierarchy_update(&hierarchy) == 0, "update without changes rebuilt nodes");
+
+    // moving an inner node rebuilds exactly its subtree; a second, unrelated leaf adds only itself
+    const uint32_t moved = 4, leaf = TEST_HIERARCHY_NODES - 1;
+    size_t subtree = 0;
+    for (uint32_t i = 0; i < TEST_HIERARCHY_NODES; ++i)
+        subtree += hierarchy_below(parents, i, moved);
+    const bool leafInside = hierarchy_below(parents, leaf, moved);
+    check(subtree > 2, "moved node has no grandchildren in the test hierarchy");
+    hierarchy_random_trs(&rng, &locals[moved]);
+    hierarchy_set_local(&hierarchy, moved, locals[moved].translationVec, locals[moved].rotationVec, locals[moved].scaleVec);
+    hierarchy_random_trs(&rng, &locals[leaf]);
+    hierarchy_set_local(&hierarchy, leaf, locals[leaf].translationVec, locals[leaf].rotationVec, locals[leaf].scaleVec);
+    const size_t rebuilt = hierarchy_update(&hierarchy);
+    check(rebuilt == subtree + (leafInside ? 0 : 1), std::to_string(rebuilt) + " nodes rebuilt for a subtree of " + std::to_string(subtree));
+    size_t wrongFlags = 0;
+    for (uint32_t i = 0; i < TEST_HIERARCHY_NODES; ++i)
+        wrongFlags += (hierarchy.changed[i] != 0) != (hierarchy_below(parents, i, moved) || i == leaf);
+    check(wrongFlags == 0, std::to_string(wrongFlags) + " nodes flagged changed wrongly");
+    error = world_error();
+    check(error <= TEST_TRANSFORM_EPSILON, "world matrices differ from glm by " + std::to_string(error) + " after a partial update");
+
+    // the same tree as scene models keyed by UUID, in shuffled order so the scene is not sorted
+    std::vector<Model> models(TEST_HIERARCHY_NODES);
+    std::vector<Model*> scene;
+    for (uint32_t i = 0; i < TEST_HIERARCHY_NODES; ++i)
+    {
+        models[i].UUID = "node" + std::to_string(i);
+        models[i].parentUUID = parents[i] == HIERARCHY_ROOT ? "" : "node" + std::to_string(parents[i]);
+        models[i].translationVec = locals[i].translationVec;
+        models[i].rotationVec = locals[i].rotationVec;
+        models[i].scaleVec = locals[i].scaleVec;
+        scene.push_back(&models[i]);
+    }
+    std::shuffle(scene.begin(), scene.end(), rng);
+    it_ModelHierarchy modelHierarchy;
+    auto scene_error = [&]() {
+        const std::vector<glm::mat4> reference = hierarchy_reference(locals, parents);
+        float error = 0.0f;
+        for (uint32_t i = 0; i < TEST_HIERARCHY_NODES; ++i)
+            error = std::max(error, matrix_difference(reference[i], models[i].transform));
+        return error;
+    };
+    update_model_hierarchy(scene, &modelHierarchy);
+    error = scene_error();
+    check(error <= TEST_TRANSFORM_EPSILON, "scene transforms differ from glm by " + std::to_string(error));
+
+    // reparenting the moved subtree under another root carries all of it along
+    const uint32_t newParent = parents[moved] == 2 ? 1 : 2;
+    parents[moved] = newParent;
+    models[moved].parentUUID = "node" + std::to_string(newParent);
+    const size_t reparented = update_model_hierarchy(scene, &modelHierarchy);
+    check(reparented == TEST_HIERARCHY_NODES && models[moved].parent == &models[newParent], "reparenting did not rebuild the hierarchy");
+    error = scene_error();
+    check(error <= TEST_TRANSFORM_EPSILON, "scene transforms differ from glm by " + std::to_string(error) + " after reparenting");
+    hierarchy_random_trs(&rng, &models[newParent]);
+    locals[newParent].translationVec = models[newParent].translationVec;
+    locals[newParent].rotationVec = models[newParent].rotationVec;
+    locals[newParent].scaleVec = models[newParent].scaleVec;
+    size_t below = 0;
+    for (uint32_t i = 0; i < TEST_HIERARCHY_NODES; ++i)
+        below += hierarchy_below(parents, i, newParent);
+    check(update_model_hierarchy(scene, &modelHierarchy) == below, "moving the new parent did not rebuild exactly its subtree");
+    error = scene_error();
+    check(error <= TEST_TRANSFORM_EPSILON, "scene transforms differ from glm by " + std::to_string(error) + " after moving the new parent");
+
+    // cycles are cut at one node, the same one every time, and the rest keeps its parents
+    const std::vector<uint32_t> cyclic = { 1, 2, 0, 0, 3, HIERARCHY_ROOT, 5, 8, 7, 9, 42 };
+    std::vector<uint32_t> cut[2], order[2];
+    bool acyclic[2];
+    for (int run = 0; run < 2; ++run)
+    {
+        cut[run] = cyclic;
+        acyclic[run] = hierarchy_sort(&cut[run], &order[run]);
+    }
+    check(!acyclic[0] && cut[0] == cut[1] && order[0] == order[1], "cycle not reported or cut differently between runs");
+    check(hierarchy_sorted(cut[0], order[0]), "sorted order puts a child before its parent");
+    size_t changedParents = 0, cutInCycle = 0, cutInPair = 0;
+    for (size_t i = 0; i < cyclic.size(); ++i)
+    {
+        if (cut[0][i] == cyclic[i])
+            continue;
+        ++changedParents;
+        check(cut[0][i] == HIERARCHY_ROOT, "cycle cut by moving a node instead of making it a root");
+        cutInCycle += i <= 2;
+        cutInPair += i == 7 || i == 8;
+    }
+    // self parent and out of range parents become roots as well
+    check(cut[0][9] == HIERARCHY_ROOT && cut[0][10] == HIERARCHY_ROOT, "self or out of range parent kept");
+    check(changedParents == 4 && cutInCycle == 1 && cutInPair == 1, "cycles cut at " + std::to_string(changedParents) + " nodes instead of one each");
+
+    std::vector<uint32_t> tree = { HIERARCHY_ROOT, 0, 0, 1, HIERARCHY_ROOT, 4, 1 }, treeOrder;
+    const std::vector<uint32_t> treeBefore = tree;
+    check(hierarchy_sort(&tree, &treeOrder) && tree == treeBefore, "acyclic parents reported as a cycle or changed");
+    check(treeOrder == std::vector<uint32_t>({ 0, 1, 3, 6, 2, 4, 5 }), "sort is not depth first in sibling order");
+    return s_failed - failedBefore;
+}
+
+
+// Sleeps so the other threads get the core even when there is only one
+static void job_busy(std::atomic<uint32_t>* ranOn)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(500));
+    ranOn[job_thread_index() + 1].fetch_add(1);
+}
+
+// Sums values over a tree of jobs that each wait for their children inside a job
+static void job_tree(uint32_t depth, std::atomic<uint32_t>* leaves)
+{
+    if (depth == 0)
+    {
+        leaves->fetch_add(1);
+        return;
+    }
+    it_JobCounter children;
+    for (int c = 0; c < 4; ++c)
+        job_run([depth, leaves]() { job_tree(depth - 1, leaves); }, &children);
+    job_wait(&children);
+}
+
+int test_job_system()
+{
+    const int failedBefore = s_failed;
+    job_system_init(TEST_JOB_WORKERS);
+    check(job_thread_count() == TEST_JOB_WORKERS + 1 && job_thread_index() == 0, "job system did not start its workers");
+
+    // every job counted once, the counter back at zero and reusable
+    it_JobCounter counter;
+    std::atomic<uint32_t> sum{ 0 };
+    for (uint32_t round = 0; round < 2; ++round)
+    {
+        for (uint32_t i = 0; i < TEST_JOB_COUNT; ++i)
+            job_run([&sum, i]() { sum.fetch_add(i); }, &counter);
+        job_wait(&counter);
+        check(counter.pending.load() == 0, "counter not back at zero after job_wait");
+    }
+    check(sum.load() == TEST_JOB_COUNT * (TEST_JOB_COUNT - 1), "jobs ran " + std::to_string(sum.load()) + " in sum");
+
+    // continuations start only once their dependency finished, one on a finished counter starts right away
+    it_JobCounter first, second, third;
+    std::atomic<uint32_t> firstDone{ 0 };
+    std::atomic<bool> secondSawAll{ false }, thirdSawSecond{ false };
+    for (int i = 0; i < 64; ++i)
+        job_run([&firstDone]() {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            firstDone.fetch_add(1);
+        }, &first);
+    job_run_after(&first, [&]() { secondSawAll = firstDone.load() == 64; }, &second);
+    job_run_after(&second, [&]() { thirdSawSecond = secondSawAll.load(); }, &third);
+    job_wait(&third);
+    check(secondSawAll && thirdSawSecond, "continuation ran before its dependency finished");
+    check(first.pending.load() == 0 && second.pending.load() == 0, "dependencies not finished once the continuation was");
+    std::atomic<bool> late{ false };
+    job_run_after(&first, [&late]() { late = true; }, &second);
+    job_wait(&second);
+    check(late, "continuation on a finished counter never ran");
+
+    // thread 0's own jobs get stolen by the idle workers
+    std::atomic<uint32_t> ranOn[TEST_JOB_WORKERS + 2] = {};
+    const uint64_t stolenBefore = job_system_stats().stolen;
+    for (int i = 0; i < 64; ++i)
+        job_run([&ranOn]() { job_busy(ranOn); }, &counter);
+    job_wait(&counter);
+    uint32_t threadsUsed = 0, ran = 0;
+    for (const std::atomic<uint32_t>& count : ranOn)
+    {
+        threadsUsed += count.load() > 0;
+        ran += count.load();
+    }
+    check(ran == 64 && ranOn[0].load() == 0, "busy jobs ran " + std::to_string(ran) + " times or off the job threads");
+    check(threadsUsed > 1 && job_system_stats().stolen > stolenBefore, "no worker stole from a loaded thread 0");
+
+    // jobs queued by another thread and the jobs those spawn never run on thread 0 while there are workers
+    for (std::atomic<uint32_t>& count : ranOn)
+        count = 0;
+    it_JobCounter foreign;
+    std::thread loader([&]() {
+        for (int i = 0; i < 16; ++i)
+            job_run([&]() {
+                job_busy(ranOn);
+                it_JobCounter pieces;
+                for (int p = 0; p < 4; ++p)
+                    job_run([&ranOn]() { job_busy(ranOn); }, &pieces);
+                job_wait(&pieces);
+            }, &foreign);
+    });
+    loader.join();
+    bool renderRanForeign = false;
+    while (foreign.pending.load() != 0)
+    {
+        renderRanForeign |= job_try_run();
+        std::this_thread::yield();
+    }
+    job_wait(&foreign);
+    check(!renderRanForeign && ranOn[1].load() == 0, "thread 0 ran jobs queued by another thread");
+    check(ranOn[2].load() + ranOn[3].load() + ranOn[4].load() == 16 * 5, "foreign jobs went missing");
+
+    // waiting inside jobs, three levels deep, with more waiting jobs than threads
+    std::atomic<uint32_t> leaves{ 0 };
+    job_run([&leaves]() { job_tree(3, &leaves); }, &counter);
+    job_run([&leaves]() { job_tree(3, &leaves); }, &counter);
+    job_wait(&counter);
+    check(leaves.load() == 2 * 64, "nested job_wait reached " + std::to_string(leaves.load()) + " leaves");
+
+    // the first exception reaches job_wait once, the others still run, the counter is clean afterwards
+    std::atomic<uint32_t> survivors{ 0 };
+    for (int i = 0; i < 32; ++i)
+        job_run([&survivors, i]() {
+            if (i % 8 == 3)
+                throw std::runtime_error("job " + std::to_string(i));
+            survivors.fetch_add(1);
+        }, &counter);
+    bool thrown = false;
+    try
+    {
+        job_wait(&counter);
+    }
+    catch (const std::runtime_error& e)
+    {
+        thrown = std::string(e.what()).rfind("job ", 0) == 0;
+    }
+    check(thrown && survivors.load() == 28, "job exception not rethrown by job_wait or other jobs dropped");
+    job_run([]() {}, &counter);
+    thrown = false;
+    try
+    {
+        job_wait(&counter);
+    }
+    catch (...)
+    {
+        thrown = true;
+    }
+    check(!thrown, "exception rethrown a second time");
+
+    // without a counter it is counted, not rethrown on a worker
+    const uint64_t failedJobs = job_system_stats().failed;
+    job_run([]() { throw std::runtime_error("nobody waits"); }, nullptr);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (job_system_stats().failed == failedJobs && std::chrono::steady_clock::now() < deadline)
+        if (!job_try_run())
+            std::this_thread::yield();
+    check(job_system_stats().failed == failedJobs + 1, "counterless job failure not counted");
+
+    bool parallelThrown = false;
+    try
+    {
+        parallel_for(100, [](size_t i) { if (i == 57) throw std::runtime_error("item"); });
+    }
+    catch (const std::runtime_error&)
+    {
+        parallelThrown = true;
+    }
+    check(parallelThrown, "parallel_for on the job system did not rethrow");
+    job_system_shutdown();
+
+    // the fallback threads rethrow on the caller too
+    parallelThrown = false;
+    try
+    {
+        parallel_for(100, [](size_t i) { if (i == 57) throw std::runtime_error("item"); });
+    }
+    catch (const std::runtime_error&)
+    {
+        parallelThrown = true;
+    }
+    check(parallelThrown, "parallel_for without the job system did not rethrow");
+    return s_failed - failedBefore;
+}
+
+
+// Smooth gradients with a little noise and a hard edge, RGBA with varying alpha, in the spirit of the benchmark image
+static void compression_test_image(uint32_t size, std::vector<uint8_t>* pixels)
+{
+    std::mt19937 rng(5);
+    pixels->resize(static_cast<size_t>(size) * size * 4);
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            uint8_t* t = pixels->data() + (static_cast<size_t>(y) * size + x) * 4;
+            const int noise = static_cast<int>(rng() % 5) - 2;
+            t[0] = static_cast<uint8_t>(std::clamp(static_cast<int>(x * 255 / size) + noise, 0, 255));
+            t[1] = static_cast<uint8_t>(y < size / 2 ? 40 : 200);
+            t[2] = static_cast<uint8_t>(128 + 100 * std::sin(x * 0.1f) * std::cos(y * 0.08f));
+            t[3] = static_cast<uint8_t>(255 - y * 2);
+        }
+    }
+}
+
+int test_texture_compression()
+{
+    const int failedBefore = s_failed;
+
+    // two colours whose channels share a parity are mode 6 endpoints with their p-bit, they have to come back exactly
+    const uint8_t even[4] = { 10, 20, 30, 40 }, odd[4] = { 201, 99, 51, 255 };
+    uint8_t texels[64], block[BC_BLOCK_BYTES], decoded[64];
+    for (int i = 0; i < 16; ++i)
+        memcpy(texels + i * 4, (i * 7) % 3 ? odd : even, 4);
+    encode_bc7_block(texels, block);
+    check(decode_bc7_block(block, decoded) && memcmp(texels, decoded, sizeof(texels)) == 0, "two colour BC7 block is not exact");
+    for (int i = 0; i < 16; ++i)
+        memcpy(texels + i * 4, odd, 4);
+    encode_bc7_block(texels, block);
+    check(decode_bc7_block(block, decoded) && memcmp(texels, decoded, sizeof(texels)) == 0, "solid BC7 block is not exact");
+    const uint8_t notMode6[BC_BLOCK_BYTES] = { 0x01 };
+    check(!decode_bc7_block(notMode6, decoded), "mode 0 block decoded as mode 6");
+
+    // BC5 stores 8 bit endpoints, two values per channel are exact; blue and alpha are dropped
+    for (int i = 0; i < 16; ++i)
+    {
+        texels[i * 4 + 0] = i & 1 ? 17 : 230;
+        texels[i * 4 + 1] = i & 4 ? 3 : 128;
+        texels[i * 4 + 2] = 77;
+        texels[i * 4 + 3] = 12;
+    }
+    encode_bc5_block(texels, block);
+    decode_bc5_block(block, decoded);
+    size_t bc5Wrong = 0;
+    for (int i = 0; i < 16; ++i)
+        bc5Wrong += decoded[i * 4] != texels[i * 4] || decoded[i * 4 + 1] != texels[i * 4 + 1] || decoded[i * 4 + 2] != 0 || decoded[i * 4 + 3] != 255;
+    check(bc5Wrong == 0, std::to_string(bc5Wrong) + " texels of a two value BC5 block are not exact");
+
+    // whole images, not a multiple of the block size, against a PSNR floor, and the same bytes every run
+    std::vector<uint8_t> pixels;
+    compression_test_image(TEST_BC_SIZE, &pixels);
+    it_ImageData image;
+    image.pixels = pixels.data();
+    image.width = image.height = TEST_BC_SIZE;
+    const std::pair<VkFormat, double> formats[] = { { VK_FORMAT_BC7_SRGB_BLOCK, TEST_BC7_MIN_PSNR }, { VK_FORMAT_BC5_UNORM_BLOCK, TEST_BC5_MIN_PSNR } };
+    for (const auto& [blockFormat, minPsnr] : formats)
+    {
+        const std::string name = blockFormat == VK_FORMAT_BC5_UNORM_BLOCK ? "BC5" : "BC7";
+        it_MipChain chain;
+        generate_mip_chain(&image, blockFormat == VK_FORMAT_BC5_UNORM_BLOCK ? TEXTURE_FORMAT_NORMAL : TEXTURE_FORMAT_COLOR, MIP_FILTER_BOX, &chain);
+        std::vector<it_CompressedLevel> levels, again;
+        compress_mip_chain(&chain, blockFormat, &levels);
+        compress_mip_chain(&chain, blockFormat, &again);
+        check(levels.size() == chain.levels.size(), name + " chain has " + std::to_string(levels.size()) + " levels");
+        bool sameBlocks = levels.size() == again.size();
+        for (size_t l = 0; sameBlocks && l < levels.size(); ++l)
+            sameBlocks = levels[l].blocks == again[l].blocks;
+        check(sameBlocks, name + " encodes differently between runs");
+
+        const double psnr = compressed_psnr(&image, &levels[0], blockFormat);
+        tlog::info("texture compression: " + name + " " + std::to_string(TEST_BC_SIZE) + "^2 PSNR " + std::to_string(psnr) + " dB");
+        check(psnr >= minPsnr, name + " PSNR " + std::to_string(psnr) + " dB is below " + std::to_string(minPsnr));
+
+        // the 3x3 level is a single partial block, encoded as if its last row and column were repeated
+        const it_CompressedLevel* small = nullptr;
+        for (size_t l = 0; l < levels.size(); ++l)
+            if (levels[l].width == 3)
+                small = &levels[l];
+        if (check(small && small->height == 3 && small->blocks.size() == BC_BLOCK_BYTES, name + " has no single block 3x3 level"))
+        {
+            const uint8_t* source = chain.pixels.data() + chain.levels[small - levels.data()].offset;
+            uint8_t padded[64], expected[BC_BLOCK_BYTES];
+            for (int y = 0; y < 4; ++y)
+                for (int x = 0; x < 4; ++x)
+                    memcpy(padded + (y * 4 + x) * 4, source + (std::min(y, 2) * 3 + std::min(x, 2)) * 4, 4);
+            if (blockFormat == VK_FORMAT_BC5_UNORM_BLOCK)
+                encode_bc5_block(padded, expected);
+            else
+                encode_bc7_block(padded, expected);
+            check(memcmp(small->blocks.data(), expected, BC_BLOCK_BYTES) == 0, name + " partial block does not repeat the edge texels");
+            it_ImageData smallImage;
+            decompress_level(small, blockFormat, &smallImage);
+            check(smallImage.width == 3 && smallImage.height == 3, name + " 3x3 level decodes to " + std::to_string(smallImage.width) + "x" + std::to_string(smallImage.height));
+            free(smallImage.pixels);
+        }
+    }
+    return s_failed - failedBefore;
+}
+
+
+// Level l of chain, texel (x, y), channel c
+static uint8_t mip_texel(const it_MipChain& chain, size_t l, uint32_t x, uint32_t y, uint32_t c)
+{
+    const it_MipLevel& level = chain.levels[l];
+    return chain.pixels[level.offset + (static_cast<size_t>(y) * level.width + x) * 4 + c];
+}
+
+static glm::vec3 mip_normal(const it_MipChain& chain, size_t l, uint32_t x, uint32_t y)
+{
+    return glm::vec3(mip_texel(chain, l, x, y, 0), mip_texel(chain, l, x, y, 1), mip_texel(chain, l, x, y, 2)) / 255.0f * 2.0f - glm::vec3(1.0f);
+}
+
+int test_mip_generator()
+{
+    const int failedBefore = s_failed;
+    const it_MipFilter filters[] = { MIP_FILTER_BOX, MIP_FILTER_KAISER };
+
+    // black and white average to half the light, sRGB 188, not to byte 128. Alpha and linear formats average the bytes.
+    uint8_t checker[2 * 2 * 4];
+    for (int i = 0; i < 4; ++i)
+    {
+        const uint8_t value = (i == 0 || i == 3) ? 255 : 0;
+        checker[i * 4 + 0] = checker[i * 4 + 1] = checker[i * 4 + 2] = checker[i * 4 + 3] = value;
+    }
+    it_ImageData image;
+    image.pixels = checker;
+    image.width = image.height = 2;
+    for (it_MipFilter filter : filters)
+    {
+        const std::string name = filter == MIP_FILTER_BOX ? "box" : "Kaiser";
+        it_MipChain chain;
+        generate_mip_chain(&image, TEXTURE_FORMAT_COLOR, filter, &chain);
+        check(chain.levels.size() == 2 && chain.pixels.size() == 20, name + " 2x2 chain has " + std::to_string(chain.levels.size()) + " levels");
+        const int color = mip_texel(chain, 1, 0, 0, 0), alpha = mip_texel(chain, 1, 0, 0, 3);
+        check(color >= 187 && color <= 188 && mip_texel(chain, 1, 0, 0, 2) == color, name + " sRGB average of black and white is " + std::to_string(color));
+        check(alpha >= 127 && alpha <= 128, name + " alpha average is " + std::to_string(alpha));
+        generate_mip_chain(&image, VK_FORMAT_B8G8R8A8_UNORM, filter, &chain);
+        const int linear = mip_texel(chain, 1, 0, 0, 0);
+        check(linear >= 127 && linear <= 128, name + " linear average is " + std::to_string(linear));
+    }
+
+    // two tilted normals average to a short vector along z, stored unit length again
+    uint8_t tilted[2 * 2 * 4];
+    for (int i = 0; i < 4; ++i)
+    {
+        const float nx = i & 1 ? 0.6f : -0.6f;
+        tilted[i * 4 + 0] = static_cast<uint8_t>((nx * 0.5f + 0.5f) * 255.0f + 0.5f);
+        tilted[i * 4 + 1] = 128;
+        tilted[i * 4 + 2] = static_cast<uint8_t>((0.8f * 0.5f + 0.5f) * 255.0f + 0.5f);
+        tilted[i * 4 + 3] = 255;
+    }
+    image.pixels = tilted;
+    it_MipChain normals;
+    generate_mip_chain(&image, TEXTURE_FORMAT_NORMAL, MIP_FILTER_BOX, &normals);
+    const glm::vec3 averaged = mip_normal(normals, 1, 0, 0);
+    check(std::abs(averaged.x) < 0.01f && std::abs(averaged.y) < 0.01f && averaged.z > 0.99f,
+        "averaged normal is (" + std::to_string(averaged.x) + ", " + std::to_string(averaged.y) + ", " + std::to_string(averaged.z) + ")");
+
+    // a bumpy normal map keeps unit normals in every level with either filter
+    const uint32_t bumpySize = 37;
+    std::vector<uint8_t> bumpy(bumpySize * bumpySize * 4);
+    for (uint32_t y = 0; y < bumpySize; ++y)
+    {
+        for (uint32_t x = 0; x < bumpySize; ++x)
+        {
+            const glm::vec3 n = glm::normalize(glm::vec3(std::sin(x * 1.3f), std::cos(y * 0.9f), 0.6f));
+            uint8_t* t = bumpy.data() + (static_cast<size_t>(y) * bumpySize + x) * 4;
+            for (int c = 0; c < 3; ++c)
+                t[c] = static_cast<uint8_t>((n[c] * 0.5f + 0.5f) * 255.0f + 0.5f);
+            t[3] = 255;
+        }
+    }
+    image.pixels = bumpy.data();
+    image.width = image.height = bumpySize;
+    for (it_MipFilter filter : filters)
+    {
+        generate_mip_chain(&image, TEXTURE_FORMAT_NORMAL, filter, &normals);
+        float worst = 0.0f;
+        for (size_t l = 1; l < normals.levels.size(); ++l)
+            for (uint32_t y = 0; y < normals.levels[l].height; ++y)
+                for (uint32_t x = 0; x < normals.levels[l].width; ++x)
+                    worst = std::max(worst, std::abs(glm::length(mip_normal(normals, l, x, y)) - 1.0f));
+        // a byte per component is off by up to 1/255, the length by about the sum of the three
+        check(worst < 0.015f, std::string(filter == MIP_FILTER_BOX ? "box" : "Kaiser") + " normals are off unit length by " + std::to_string(worst));
+    }
+
+    // 5x3 halves to 2x1 and 1x1 rounding down. A box texel covers 2.5 columns, the middle one counts half to each side.
+    uint8_t ramp[5 * 3 * 4];
+    for (int y = 0; y < 3; ++y)
+        for (int x = 0; x < 5; ++x)
+            for (int c = 0; c < 4; ++c)
+                ramp[(y * 5 + x) * 4 + c] = c == 3 ? 255 : static_cast<uint8_t>(x * 50);
+    image.pixels = ramp;
+    image.width = 5;
+    image.height = 3;
+    it_MipChain npot;
+    generate_mip_chain(&image, VK_FORMAT_B8G8R8A8_UNORM, MIP_FILTER_BOX, &npot);
+    const bool shape = npot.levels.size() == 3 && npot.levels[1].width == 2 && npot.levels[1].height == 1 && npot.levels[2].width == 1
+        && npot.levels[2].height == 1 && npot.levels[2].offset + 4 == npot.pixels.size();
+    if (check(shape, "5x3 chain does not halve to 2x1 and 1x1"))
+    {
+        check(mip_texel(npot, 1, 0, 0, 0) == 40 && mip_texel(npot, 1, 1, 0, 0) == 160 && mip_texel(npot, 2, 0, 0, 0) == 100,
+            "5x3 box levels are " + std::to_string(mip_texel(npot, 1, 0, 0, 0)) + ", " + std::to_string(mip_texel(npot, 1, 1, 0, 0)) + " and "
+            + std::to_string(mip_texel(npot, 2, 0, 0, 0)) + " instead of 40, 160 and 100");
+    }
+
+    // flat stays flat up to the edges of an odd sized image, the Kaiser taps past the border clamp and renormalize
+    std::vector<uint8_t> flat(static_cast<size_t>(bumpySize) * 21 * 4);
+    for (size_t i = 0; i < flat.size(); ++i)
+        flat[i] = static_cast<uint8_t>(i % 4 == 3 ? 200 : 90);
+    image.pixels = flat.data();
+    image.width = bumpySize;
+    image.height = 21;
+    for (it_MipFilter filter : filters)
+    {
+        it_MipChain chain;
+        generate_mip_chain(&image, TEXTURE_FORMAT_COLOR, filter, &chain);
+        size_t wrong = 0;
+        for (size_t i = chain.levels[1].offset; i < chain.pixels.size(); ++i)
+            wrong += chain.pixels[i] != flat[i % 4];
+        check(wrong == 0, std::string(filter == MIP_FILTER_BOX ? "box" : "Kaiser") + " changed " + std::to_string(wrong) + " bytes of a flat odd sized image");
+    }
+    return s_failed - failedBefore;
+}
+
+
+// Corner c of the parsed mesh as (v, vt, vn)
+static bool obj_corner(const it_ObjMesh& mesh, size_t c, int v, int vt, int vn)
+{
+    const tinyobj::index_t& index = mesh.indices[c];
+    return index.vertex_index == v && index.texcoord_index == vt && index.normal_index == vn;
+}
+
+int test_obj_parser()
+{
+    const int failedBefore = s_failed;
+    const std::string path = temp_path("test_obj_parser.obj");
+    it_ObjMesh mesh;
+    std::string err;
+
+    // every face form once, followed by lines that must not add anything
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << "# small obj\n"
+            "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 2 0.5 -1\n"
+            "vt 0 0\nvt 1 0\nvt 1 1\n"
+            "vn 0 0 1\n"
+            "o object\ng group\nusemtl none\ns 1\n"
+            "f 1 2 3\n"
+            "f 1//1 2//1 3//1\n"
+            "f 1/1 2/2 3/3\n"
+            "f 1/1/1 2/2/1 3/3/1 4/1/1\n"
+            "f -5 -4 -3\n"
+            "f 1 2 3 4 5\n"
+            "v 5 5 5\n"
+            "f -1/-1/-1 -2/-2/-1 -3/-3/-1\r\n"
+            "vx 1 2 3\n"
+            "v\n"
+            "f\n"
+            "f 1 2\n"
+            "not an obj line\n"
+            "   # indented comment\n"
+            "\n"
+            "f 2 3 4";
+    }
+    if (check(parse_obj(path, temp_path(""), &mesh, &err), "small obj did not parse: " + err))
+    {
+        check(mesh.positions.size() == 18 && mesh.texcoords.size() == 6 && mesh.normals.size() == 3,
+            "small obj has " + std::to_string(mesh.positions.size() / 3) + " positions, " + std::to_string(mesh.texcoords.size() / 2)
+            + " texcoords and " + std::to_string(mesh.normals.size() / 3) + " normals instead of 6, 3 and 1");
+        check(mesh.positions[12] == 2.0f && mesh.positions[13] == 0.5f && mesh.positions[14] == -1.0f && mesh.positions[15] == 5.0f,
+            "small obj positions are read wrong");
+        // 1 + 1 + 1 + 2 + 1 + 3 + 1 + 1 triangles, the short faces and the unknown lines add nothing
+        if (check(mesh.indices.size() == 33, "small obj has " + std::to_string(mesh.indices.size()) + " corners instead of 33"))
+        {
+            check(obj_corner(mesh, 0, 0, -1, -1) && obj_corner(mesh, 2, 2, -1, -1), "v only face has texcoord or normal indices");
+            check(obj_corner(mesh, 3, 0, -1, 0) && obj_corner(mesh, 5, 2, -1, 0), "v//vn face is read wrong");
+            check(obj_corner(mesh, 6, 0, 0, -1) && obj_corner(mesh, 8, 2, 2, -1), "v/vt face is read wrong");
+            check(obj_corner(mesh, 9, 0, 0, 0) && obj_corner(mesh, 10, 1, 1, 0) && obj_corner(mesh, 11, 2, 2, 0)
+                && obj_corner(mesh, 12, 0, 0, 0) && obj_corner(mesh, 13, 2, 2, 0) && obj_corner(mesh, 14, 3, 0, 0), "quad is not split into 0 1 2 and 0 2 3");
+            check(obj_corner(mesh, 15, 0, -1, -1) && obj_corner(mesh, 16, 1, -1, -1) && obj_corner(mesh, 17, 2, -1, -1), "negative indices do not count back from the last position");
+            bool fan = true;
+            for (int t = 0; t < 3; ++t)
+                fan = fan && obj_corner(mesh, 18 + t * 3, 0, -1, -1) && obj_corner(mesh, 19 + t * 3, t + 1, -1, -1) && obj_corner(mesh, 20 + t * 3, t + 2, -1, -1);
+            check(fan, "pentagon is not a triangle fan around its first corner");
+            check(obj_corner(mesh, 27, 5, 2, 0) && obj_corner(mesh, 28, 4, 1, 0) && obj_corner(mesh, 29, 3, 0, 0), "negative v/vt/vn indices are read wrong");
+            check(obj_corner(mesh, 30, 1, -1, -1) && obj_corner(mesh, 32, 3, -1, -1), "last face without a newline is read wrong");
+        }
+    }
+
+    // large enough to be split into chunks, negative indices have to count back across chunk boundaries
+    const int quads = TEST_OBJ_QUADS;
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        for (int q = 0; q < quads; ++q)
+        {
+            const std::string x = std::to_string(q);
+            file << "v " << x << " 0 0\nv " << x << " 1 0\nv " << x << " 1 1\nv " << x << " 0 1\n"
+                << "vt " << x << " 0\nvn 0 0 " << x << "\nf -4/-1/-1 -3/-1/-1 -2/-1/-1 -1/-1/-1\n";
+        }
+    }
+    mesh = it_ObjMesh();
+    if (check(parse_obj(path, temp_path(""), &mesh, &err), "chunked obj did not parse: " + err))
+    {
+        check(mesh.fileSize > 2 * (1 << 20), "chunked obj is only " + std::to_string(mesh.fileSize) + " bytes, too small to be split");
+        if (check(mesh.indices.size() == static_cast<size_t>(quads) * 6 && mesh.positions.size() == static_cast<size_t>(quads) * 12,
+            "chunked obj has " + std::to_string(mesh.indices.size()) + " corners instead of " + std::to_string(quads * 6)))
+        {
+            const int fan[6] = { 0, 1, 2, 0, 2, 3 };
+            size_t wrong = 0;
+            for (size_t c = 0; c < mesh.indices.size(); ++c)
+            {
+                const int q = static_cast<int>(c / 6);
+                wrong += !obj_corner(mesh, c, q * 4 + fan[c % 6], q, q);
+            }
+            check(wrong == 0, std::to_string(wrong) + " corners of the chunked obj point at the wrong quad");
+        }
+    }
+
+    err.clear();
+    check(!parse_obj(temp_path("test_obj_parser_missing.obj"), temp_path(""), &mesh, &err) && !err.empty(), "missing obj did not report an error");
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+    return s_failed - failedBefore;
+}
+
+// The vertex the welder should build for one OBJ corner
+static Vertex weld_reference(const it_ObjMesh& mesh, const tinyobj::index_t& index)
+{
+    Vertex vertex{};
+    vertex.pos = glm::vec3(mesh.positions[3 * index.vertex_index], mesh.positions[3 * index.vertex_index + 1], mesh.positions[3 * index.vertex_index + 2]);
+    if (index.normal_index >= 0)
+        vertex.normal = glm::vec3(mesh.normals[3 * index.normal_index], mesh.normals[3 * index.normal_index + 1], mesh.normals[3 * index.normal_index + 2]);
+    if (index.texcoord_index >= 0)
+        vertex.texCoord = glm::vec2(mesh.texcoords[2 * index.texcoord_index], 1.0f - mesh.texcoords[2 * index.texcoord_index + 1]);
+    vertex.color = glm::vec3(1.0f);
+    return vertex;
+}
+
+int test_vertex_welder()
+{
+    const int failedBefore = s_failed;
+
+    // two quads sharing an edge. Position 4 repeats position 1 and normal 1 is normal 0 with a negative zero, both
+    // weld. Texcoord 2 splits the shared edge into a UV seam, normal 2 gives corner 3 a hard edge.
+    it_ObjMesh mesh;
+    mesh.positions = { 0, 0, 0,  1, 0, 0,  1, 1, 0,  0, 1, 0,  1, 0, 0,  2, 0, 0,  2, 1, 0 };
+    mesh.texcoords = { 0, 0,  1, 0,  0, 0.5f };
+    mesh.normals = { 0, 0, 1,  -0.0f, 0, 1,  0, 1, 0 };
+    const int corners[][3] = {
+        { 0, 0, 0 }, { 1, 1, 0 }, { 2, 1, 0 },  { 0, 0, 0 }, { 2, 1, 0 }, { 3, 0, 2 },
+        { 4, 2, 1 }, { 5, 0, 0 }, { 6, 0, 0 },  { 4, 2, 1 }, { 6, 0, 0 }, { 2, 2, 0 },
+        { 4, 1, 1 }, { 1, -1, -1 }, { 1, -1, -1 },
+    };
+    for (const auto& corner : corners)
+    {
+        tinyobj::index_t index;
+        index.vertex_index = corner[0];
+        index.texcoord_index = corner[1];
+        index.normal_index = corner[2];
+        mesh.indices.push_back(index);
+    }
+
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    weld_obj_vertices(mesh, &vertices, &indices);
+
+    // new vertices are numbered in the order their first corner appears
+    const std::vector<uint32_t> expected = { 0, 1, 2,  0, 2, 3,  4, 5, 6,  4, 6, 7,  1, 8, 8 };
+    check(vertices.size() == 9, "welded " + std::to_string(vertices.size()) + " vertices instead of 9");
+    check(indices == expected, "welded index buffer is not 0 1 2 0 2 3 4 5 6 4 6 7 1 8 8");
+    check(indices.size() > 12 && indices[12] == 1, "duplicate position and negative zero normal did not weld");
+    check(indices.size() > 6 && indices[6] != indices[1], "UV seam on the shared edge was welded");
+    check(indices.size() > 11 && indices[11] != indices[2], "UV seam corner at the top of the shared edge was welded");
+    check(indices.size() > 5 && vertices.size() > 3 && vertices[indices[5]].normal == glm::vec3(0, 1, 0), "hard edge normal was lost");
+
+    size_t wrong = 0;
+    for (size_t c = 0; c < indices.size() && c < mesh.indices.size(); ++c)
+        wrong += indices[c] >= vertices.size() || !(vertices[indices[c]] == weld_reference(mesh, mesh.indices[c]));
+    check(wrong == 0, std::to_string(wrong) + " welded corners do not point at their own vertex");
+
+    // many duplicate triples and values, the tables start small and have to grow, against a value keyed map
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> value(0, 7);
+    mesh = it_ObjMesh();
+    for (int i = 0; i < 300; ++i)
+        mesh.positions.push_back(static_cast<float>(value(rng)));
+    for (int i = 0; i < 40; ++i)
+        mesh.texcoords.push_back(static_cast<float>(value(rng) % 2));
+    for (int i = 0; i < 30; ++i)
+        mesh.normals.push_back(static_cast<float>(value(rng) % 2));
+    for (int c = 0; c < 30000; ++c)
+    {
+        tinyobj::index_t index;
+        index.vertex_index = static_cast<int>(rng() % 100);
+        index.texcoord_index = static_cast<int>(rng() % 21) - 1;
+        index.normal_index = static_cast<int>(rng() % 11) - 1;
+        mesh.indices.push_back(index);
+    }
+    vertices.clear();
+    indices.clear();
+    weld_obj_vertices(mesh, &vertices, &indices);
+
+    std::map<std::array<float, 8>, uint32_t> reference;
+    std::vector<uint32_t> referenceIndices;
+    for (const auto& index : mesh.indices)
+    {
+        const Vertex vertex = weld_reference(mesh, index);
+        const std::array<float, 8> key = { vertex.pos.x, vertex.pos.y, vertex.pos.z, vertex.texCoord.x, vertex.texCoord.y, vertex.normal.x, vertex.normal.y, vertex.normal.z };
+        referenceIndices.push_back(reference.emplace(key, static_cast<uint32_t>(reference.size())).first->second);
+    }
+    check(vertices.size() == reference.size(), "random mesh welded to " + std::to_string(vertices.size()) + " vertices, a value keyed map gives " + std::to_string(reference.size()));
+    check(indices == referenceIndices, "random mesh index buffer differs from the value keyed map");
+    return s_failed - failedBefore;
+}
+
+
+int run_tests()
+{
+    s_failed = 0;
+    const struct { const char* name; int (*run)(); } tests[] = {
+        { "tangents", test_tangents },
+        { "vertex packing", test_vertex_packing },
+        { "mesh optimization", test_mesh_optimization },
+        { "simplification", test_simplification },
+        { "meshlets", test_meshlets },
+        { "range allocator", test_range_allocator },
+        { "staging ring", test_staging_ring },
+        { "virtual texture", test_virtual_texture },
+        { "transform store", test_transform_store },
+        { "transform hierarchy", test_transform_hierarchy },
+        { "job system", test_job_system },
+        { "texture compression", test_texture_compression },
+        { "mip generator", test_mip_generator },
+        { "obj parser", test_obj_parser },
+        { "vertex welder", test_vertex_welder },
+    };
+    for (const auto& test : tests)
+    {
+        const int failed = test.run();
+        if (failed)
+            tlog::error(std::string(test.name) + ": " + std::to_string(failed) + " checks failed");
+        else
+            tlog::info(std::string(test.name) + ": passed");
+    }
+    return s_failed;
+}
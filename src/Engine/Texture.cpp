@@ -1,196 +1,111 @@
 #include "Texture.h"
+#include "MappedFile.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-void generateMipmaps(VkDevice* device, VkPhysicalDevice* physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue,VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
+void decode_image(const std::string& path, it_ImageData* image)
 {
-    VkFormatProperties formatProperties;
-    vkGetPhysicalDeviceFormatProperties(*physicalDevice, imageFormat, &formatProperties);
-
-    if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-        throw std::runtime_error("texture image format does not support linear blitting!");
-    }
-
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
-
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.image = image;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-    barrier.subresourceRange.levelCount = 1;
-
-    int32_t mipWidth = texWidth;
-    int32_t mipHeight = texHeight;
-
-    for (uint32_t i = 1; i < mipLevels; i++) {
-        barrier.subresourceRange.baseMipLevel = i - 1;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-        vkCmdPipelineBarrier(commandBuffer,
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
-
-        VkImageBlit blit{};
-        blit.srcOffsets[0] = { 0, 0, 0 };
-        blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
-        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        blit.srcSubresource.mipLevel = i - 1;
-        blit.srcSubresource.baseArrayLayer = 0;
-        blit.srcSubresource.layerCount = 1;
-        blit.dstOffsets[0] = { 0, 0, 0 };
-        blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
-        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        blit.dstSubresource.mipLevel = i;
-        blit.dstSubresource.baseArrayLayer = 0;
-        blit.dstSubresource.layerCount = 1;
-
-        vkCmdBlitImage(commandBuffer,
-            image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-            image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            1, &blit,
-            VK_FILTER_LINEAR);
-
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-        if (mipWidth > 1) mipWidth /= 2;
-        if (mipHeight > 1) mipHeight /= 2;
+    it_MappedFile file;
+    if (!map_file(path, &file))
+        throw std::runtime_error("ERROR: failed to open image " + path + "!");
+    int channels;
+    image->pixels = stbi_load_from_memory(file.data, static_cast<int>(file.size), &image->width, &image->height, &channels, STBI_rgb_alpha);
+    unmap_file(&file);
+    if (!image->pixels)
+    {
+        throw std::runtime_error("ERROR: failed to load image " + path + "!");
     }
-
-    barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-    endSingleTimeCommands(device, commandBuffer, commandPool, graphicsQueue);
 }
 
-
-void create_texture_image(VkDevice* device, VkPhysicalDevice* physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue,Model* cModel)
+void free_image(it_ImageData* image)
 {
-    int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load((cModel->baseDir + cModel->TEXTURE_PATH).c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    VkDeviceSize imageSize = texWidth * texHeight * 4; // 4 channels
-    cModel->mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
-
-    if (!pixels)
-    {
-        throw std::runtime_error("ERROR: failed to load texture image!");
-    }
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-
-    create_buffer(device, physicalDevice, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-    void* data;
-    vkMapMemory(*device, stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(*device, stagingBufferMemory);
-    stbi_image_free(pixels);
-
-    createImage(device, physicalDevice, texWidth, texHeight, cModel->mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, cModel->textureImage, cModel->textureImageMemory);
-    transition_image_layout(device, commandPool, graphicsQueue, cModel->textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, cModel->mipLevels);
-    copy_buffer_to_image(device, commandPool, graphicsQueue, stagingBuffer, cModel->textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-    generateMipmaps(device, physicalDevice, commandPool, graphicsQueue, cModel->textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, cModel->mipLevels);
-
-    vkDestroyBuffer(*device, stagingBuffer, nullptr);
-    vkFreeMemory(*device, stagingBufferMemory, nullptr);
+    stbi_image_free(image->pixels);
+    image->pixels = nullptr;
 }
 
-
-
-void create_imageview(VkDevice* device, Model* cModel)
+size_t image_bytes(const it_ImageData* image)
 {
-    cModel->textureImageView = createImageView(*device, cModel->textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, cModel->mipLevels);
+    return image->pixels ? static_cast<size_t>(image->width) * image->height * 4 : 0; // 4 channels
 }
 
-void create_texture_sampler(VkDevice* device, VkPhysicalDevice* physicalDevice, Model* cModel)
+size_t model_images_bytes(const it_ModelImages* images)
 {
-    VkSamplerCreateInfo samplerInfo{};
-    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    samplerInfo.magFilter = VK_FILTER_LINEAR;
-    samplerInfo.minFilter = VK_FILTER_LINEAR;
-    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.anisotropyEnable = VK_TRUE;
+    return images->texture.pixels.size() + images->normal.pixels.size();
+}
 
-    VkPhysicalDeviceProperties properties{};
-    vkGetPhysicalDeviceProperties(*physicalDevice, &properties);
+void free_model_images(it_ModelImages* images)
+{
+    images->texture = it_MipChain{};
+    images->normal = it_MipChain{};
+}
 
-    samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
-    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-    samplerInfo.unnormalizedCoordinates = VK_FALSE;
-    samplerInfo.compareEnable = VK_FALSE;
-    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    samplerInfo.mipLodBias = 0.0f;
-    samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
 
-    if (vkCreateSampler(*device, &samplerInfo, nullptr, &cModel->textureSampler) != VK_SUCCESS)
-    {
-        throw std::runtime_error("ERROR: failed to create texture sampler!");
-    }
+uint32_t texture_mip_levels(int width, int height)
+{
+    return static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
 }
 
-void create_normal_image(VkDevice* device, VkPhysicalDevice* physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue, Model* cModel)
+// One region per level, level i at offsets[i] of the staged data
+static void record_level_copies(VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, VkDeviceSize stagingOffset, VkImage image, VkFormat format, uint32_t width, uint32_t height, const std::vector<VkDeviceSize>& offsets)
 {
-    int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load((cModel->baseDir + cModel->NORMAL_PATH).c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    VkDeviceSize imageSize = texWidth * texHeight * 4; // 4 channels
-    cModel->mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
-
-    if (!pixels)
+    const uint32_t mipLevels = static_cast<uint32_t>(offsets.size());
+    std::vector<VkBufferImageCopy> regions(mipLevels);
+    for (uint32_t i = 0; i < mipLevels; i++)
     {
-        throw std::runtime_error("ERROR: failed to load normal map image!");
+        VkBufferImageCopy& region = regions[i];
+        region.bufferOffset = stagingOffset + offsets[i];
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = i;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { std::max(width >> i, 1u), std::max(height >> i, 1u), 1 };
     }
 
+    record_image_layout_transition(commandBuffer, image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, regions.data());
+    record_image_layout_transition(commandBuffer, image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+}
+
+void create_texture_image(VkDevice* device, it_UploadContext* uploadContext, const it_MipChain* chain, VkFormat format, VkImage* textureImage, it_Allocation* textureImageMemory)
+{
     VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
+    VkDeviceSize stagingOffset;
+    void* staging = upload_context_stage(uploadContext, chain->pixels.size(), &stagingBuffer, &stagingOffset);
+    memcpy(staging, chain->pixels.data(), chain->pixels.size());
 
-    create_buffer(device, physicalDevice, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+    std::vector<VkDeviceSize> offsets;
+    for (const it_MipLevel& level : chain->levels)
+        offsets.push_back(level.offset);
 
-    void* data;
-    vkMapMemory(*device, stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(*device, stagingBufferMemory);
-    stbi_image_free(pixels);
+    const it_MipLevel& top = chain->levels[0];
+    createImage(device, top.width, top.height, static_cast<uint32_t>(offsets.size()), VK_SAMPLE_COUNT_1_BIT, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, *textureImage, *textureImageMemory);
+    record_level_copies(upload_context_commands(uploadContext), stagingBuffer, stagingOffset, *textureImage, format, top.width, top.height, offsets);
+}
 
-    createImage(device, physicalDevice, texWidth, texHeight, cModel->mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, cModel->normalImage, cModel->normalImageMemory);
-    transition_image_layout(device, commandPool, graphicsQueue, cModel->normalImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, cModel->mipLevels);
-    copy_buffer_to_image(device, commandPool, graphicsQueue, stagingBuffer, cModel->normalImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-    generateMipmaps(device, physicalDevice, commandPool, graphicsQueue, cModel->normalImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, cModel->mipLevels);
+void create_cooked_texture_image(VkDevice* device, it_UploadContext* uploadContext, const it_Ktx2File* ktx, VkImage* textureImage, it_Allocation* textureImageMemory)
+{
+    VkDeviceSize imageSize = 0;
+    for (const it_Ktx2Level& level : ktx->levels)
+        imageSize += level.size;  // multiples of the 16 byte block or the 4 byte texel, so every level stays aligned
 
-    vkDestroyBuffer(*device, stagingBuffer, nullptr);
-    vkFreeMemory(*device, stagingBufferMemory, nullptr);
-}
+    VkBuffer stagingBuffer;
+    VkDeviceSize stagingOffset;
+    uint8_t* staging = static_cast<uint8_t*>(upload_context_stage(uploadContext, imageSize, &stagingBuffer, &stagingOffset));
 
+    std::vector<VkDeviceSize> offsets;
+    VkDeviceSize offset = 0;
+    for (const it_Ktx2Level& level : ktx->levels)
+    {
+        memcpy(staging + offset, ktx->file.data + level.offset, static_cast<size_t>(level.size));
+        offsets.push_back(offset);
+        offset += level.size;
+    }
 
-void create_normalview(VkDevice* device, Model* cModel)
-{
-    cModel->normalImageView = createImageView(*device, cModel->normalImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, cModel->mipLevels);
+    createImage(device, ktx->width, ktx->height, static_cast<uint32_t>(offsets.size()), VK_SAMPLE_COUNT_1_BIT, ktx->format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, *textureImage, *textureImageMemory);
+    record_level_copies(upload_context_commands(uploadContext), stagingBuffer, stagingOffset, *textureImage, ktx->format, ktx->width, ktx->height, offsets);
 }
 
-void create_normal_sampler(VkDevice* device, VkPhysicalDevice* physicalDevice, Model* cModel)
+void create_texture_sampler(VkDevice* device, VkPhysicalDevice* physicalDevice, VkSampler* sampler)
 {
     VkSamplerCreateInfo samplerInfo{};
     samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -214,8 +129,8 @@ void create_normal_sampler(VkDevice* device, VkPhysicalDevice* physicalDevice, M
     samplerInfo.minLod = 0.0f;
     samplerInfo.maxLod = 0.0f;
 
-    if (vkCreateSampler(*device, &samplerInfo, nullptr, &cModel->normalSampler) != VK_SUCCESS)
+    if (vkCreateSampler(*device, &samplerInfo, nullptr, sampler) != VK_SUCCESS)
     {
-        throw std::runtime_error("ERROR: failed to create normal sampler!");
+        throw std::runtime_error("ERROR: failed to create texture sampler!");
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,288 @@
+#include "TextureCache.h"
+#include "Image.h"
+#include "TextureCook.h"
+#include "TextureCompression.h"
+#include "MipGenerator.h"
+#include "DescriptorSet.h"
+
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+
+#include <tinylogger.h>
+
+
+struct it_TextureCache
+{
+    VkDevice device = VK_NULL_HANDLE;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+    it_BindlessSet* bindless = nullptr;
+    bool cooked = false;  // the device samples BC7 and BC5, cooked textures are used where they are current
+
+    std::mutex mutex;
+    std::condition_variable uploaded;  // a texture finished uploading or its upload failed
+    std::unordered_map<std::string, it_Texture*> textures;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+static it_TextureCache s_cache;
+
+
+static std::string texture_key(const std::string& path, VkFormat format)
+{
+    return path + '|' + std::to_string(static_cast<int>(format));
+}
+
+static void destroy_texture(it_Texture* texture)
+{
+    bindless_remove_texture(s_cache.bindless, texture->index);
+    vkDestroyImageView(s_cache.device, texture->view, nullptr);
+    vkDestroyImage(s_cache.device, texture->image, nullptr);
+    free_device_memory(&texture->memory);
+    delete texture;
+}
+
+// Runs on the thread that polls the uploading context
+static void texture_uploaded(it_Texture* texture)
+{
+    bool destroy;
+    {
+        std::lock_guard<std::mutex> lock(s_cache.mutex);
+        texture->uploadContext = nullptr;
+        destroy = texture->released;
+    }
+    if (destroy)
+        destroy_texture(texture);
+    s_cache.uploaded.notify_all();
+}
+
+// Cooked or cached levels, straight from the mapped file
+static void upload_stored_texture(it_UploadContext* uploadContext, it_Texture* texture, it_Ktx2File* ktx, bool* recorded)
+{
+    try
+    {
+        texture->mipLevels = static_cast<uint32_t>(ktx->levels.size());
+        for (const it_Ktx2Level& level : ktx->levels)
+            texture->bytes += level.size;
+        create_cooked_texture_image(&s_cache.device, uploadContext, ktx, &texture->image, &texture->memory);
+        upload_context_on_complete(uploadContext, [texture]() { texture_uploaded(texture); });
+        *recorded = true;
+        texture->view = createImageView(s_cache.device, texture->image, ktx->format, VK_IMAGE_ASPECT_COLOR_BIT, texture->mipLevels);
+        texture->sampler = s_cache.sampler;
+        texture->index = bindless_add_texture(s_cache.bindless, texture->view, texture->sampler);
+    }
+    catch (...)
+    {
+        close_ktx2(ktx);
+        throw;
+    }
+    close_ktx2(ktx);
+}
+
+// The entry is already in the map, so acquires of the same texture wait instead of uploading it twice. Called without
+// the lock: staging can wait for older batches of the context, whose completions take it. recorded is set once the
+// copies into the image are in the context's batch and the completion that ends the upload is registered.
+static void upload_texture(it_UploadContext* uploadContext, it_Texture* texture, const it_MipChain* chain, bool* recorded)
+{
+    it_Ktx2File ktx;
+    if ((s_cache.cooked && open_cooked_texture(texture->path, texture->format, &ktx)) || open_cached_mips(texture->path, texture->format, &ktx))
+    {
+        upload_stored_texture(uploadContext, texture, &ktx, recorded);
+        return;
+    }
+
+    it_MipChain decoded;
+    if (!chain || chain->levels.empty())
+    {
+        texture_cache_decode(texture->path, texture->format, &decoded);
+        chain = &decoded;
+    }
+
+    texture->mipLevels = static_cast<uint32_t>(chain->levels.size());
+    texture->bytes = chain->pixels.size();
+    create_texture_image(&s_cache.device, uploadContext, chain, texture->format, &texture->image, &texture->memory);
+    upload_context_on_complete(uploadContext, [texture]() { texture_uploaded(texture); });
+    *recorded = true;
+    texture->view = createImageView(s_cache.device, texture->image, texture->format, VK_IMAGE_ASPECT_COLOR_BIT, texture->mipLevels);
+    texture->sampler = s_cache.sampler;
+    texture->index = bindless_add_texture(s_cache.bindless, texture->view, texture->sampler);
+}
+
+
+void init_texture_cache(VkDevice device, VkPhysicalDevice physicalDevice, it_BindlessSet* bindless)
+{
+    s_cache.device = device;
+    s_cache.physicalDevice = physicalDevice;
+    s_cache.bindless = bindless;
+    s_cache.hits = 0;
+    s_cache.misses = 0;
+    create_texture_sampler(&s_cache.device, &s_cache.physicalDevice, &s_cache.sampler);
+
+    // create_logical_device enables BC whenever the device has it
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+    s_cache.cooked = features.textureCompressionBC == VK_TRUE;
+#ifndef ENGINE_DISABLE_LOGGING
+    if (!s_cache.cooked)
+        tlog::warning("Texture cache: no BC texture support, cooked textures are ignored");
+#endif
+}
+
+void destroy_texture_cache()
+{
+    std::lock_guard<std::mutex> lock(s_cache.mutex);
+#ifndef ENGINE_DISABLE_LOGGING
+    if (!s_cache.textures.empty())
+        tlog::warning("Texture cache: " + std::to_string(s_cache.textures.size()) + " texture(s) still referenced");
+#endif
+    for (auto& entry : s_cache.textures)
+        destroy_texture(entry.second);
+    s_cache.textures.clear();
+    vkDestroySampler(s_cache.device, s_cache.sampler, nullptr);
+    s_cache.sampler = VK_NULL_HANDLE;
+    s_cache.device = VK_NULL_HANDLE;
+    s_cache.bindless = nullptr;
+}
+
+it_Texture* texture_cache_acquire(it_UploadContext* uploadContext, const std::string& path, VkFormat format, const it_MipChain* chain)
+{
+    const std::string key = texture_key(path, format);
+    std::unique_lock<std::mutex> lock(s_cache.mutex);
+    for (;;)
+    {
+        auto found = s_cache.textures.find(key);
+        if (found == s_cache.textures.end())
+            break;
+        it_Texture* texture = found->second;
+        // recorded into this context: any later batch of it finishes after the upload
+        if (texture->recorded && (texture->uploadContext == nullptr || texture->uploadContext == uploadContext))
+        {
+            texture->refCount++;
+            s_cache.hits++;
+            return texture;
+        }
+        // being recorded or in flight on another context. If that upload fails the entry is gone and this one retries.
+        // The other thread may in turn wait for a texture this context has not submitted yet, so submit and retire
+        // while waiting.
+        lock.unlock();
+        upload_context_submit(uploadContext);
+        upload_context_poll(uploadContext);
+        lock.lock();
+        s_cache.uploaded.wait_for(lock, std::chrono::milliseconds(1));
+    }
+
+    it_Texture* texture = new it_Texture;
+    texture->path = path;
+    texture->format = format;
+    texture->refCount = 1;
+    texture->uploadContext = uploadContext;
+    s_cache.textures[key] = texture;
+    s_cache.misses++;
+    lock.unlock();
+
+    bool recorded = false;
+    try
+    {
+        upload_texture(uploadContext, texture, chain, &recorded);
+    }
+    catch (...)
+    {
+        lock.lock();
+        s_cache.textures.erase(key);
+        // the batch copies into the image once submitted, the completion destroys it like a release during the upload
+        if (recorded)
+            texture->released = true;
+        lock.unlock();
+        s_cache.uploaded.notify_all();
+        // failed before the image was created, nothing recorded refers to it
+        if (!recorded)
+            destroy_texture(texture);
+        throw;
+    }
+
+    lock.lock();
+    texture->recorded = true;
+    lock.unlock();
+    s_cache.uploaded.notify_all();
+    return texture;
+}
+
+void texture_cache_release(it_Texture* texture)
+{
+    if (!texture)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(s_cache.mutex);
+        if (--texture->refCount > 0)
+            return;
+        s_cache.textures.erase(texture_key(texture->path, texture->format));
+        // the completion still points at it
+        if (texture->uploadContext)
+        {
+            texture->released = true;
+            return;
+        }
+    }
+    destroy_texture(texture);
+}
+
+void texture_cache_decode(const std::string& path, VkFormat format, it_MipChain* chain)
+{
+    it_ImageData image;
+    decode_image(path, &image);
+    try
+    {
+        generate_mip_chain(&image, format, MIP_FILTER_DEFAULT, chain);
+    }
+    catch (...)
+    {
+        free_image(&image);
+        throw;
+    }
+    free_image(&image);
+
+    if (!cache_mips(path, format, chain))
+    {
+#ifndef ENGINE_DISABLE_LOGGING
+        tlog::warning("Texture cache: could not cache the mip chain of " + path);
+#endif
+    }
+}
+
+bool texture_cache_needs_pixels(const std::string& path, VkFormat format)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_cache.mutex);
+        if (s_cache.textures.count(texture_key(path, format)))
+            return false;
+    }
+    it_Ktx2File ktx;
+    if ((s_cache.cooked && open_cooked_texture(path, format, &ktx)) || open_cached_mips(path, format, &ktx))
+    {
+        close_ktx2(&ktx);
+        return false;
+    }
+    return true;
+}
+
+it_TextureCacheStats texture_cache_stats()
+{
+    std::lock_guard<std::mutex> lock(s_cache.mutex);
+    it_TextureCacheStats stats;
+    stats.textures = static_cast<uint32_t>(s_cache.textures.size());
+    for (auto& entry : s_cache.textures)
+    {
+        const it_Texture* texture = entry.second;
+        stats.references += texture->refCount;
+        stats.residentBytes += texture->bytes;
+        stats.unsharedBytes += texture->bytes * texture->refCount;
+    }
+    stats.hits = s_cache.hits;
+    stats.misses = s_cache.misses;
+    return stats;
+}
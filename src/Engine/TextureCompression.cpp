@@ -0,0 +1,459 @@
+#include "TextureCompression.h"
+#include "Parallel.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+
+// Interpolation weights of 4 bit indices, out of 64
+static const int BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+
+// Little endian bit stream over one 128 bit block
+struct it_BlockBits
+{
+    uint8_t* bytes;
+    uint32_t position;
+};
+
+static void put_bits(it_BlockBits* bits, uint32_t value, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++, bits->position++)
+    {
+        if (value >> i & 1)
+            bits->bytes[bits->position >> 3] |= static_cast<uint8_t>(1u << (bits->position & 7));
+    }
+}
+
+static uint32_t get_bits(const uint8_t* bytes, uint32_t* position, uint32_t count)
+{
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < count; i++, (*position)++)
+        value |= static_cast<uint32_t>(bytes[*position >> 3] >> (*position & 7) & 1) << i;
+    return value;
+}
+
+
+struct it_Bc7Endpoints
+{
+    uint8_t color[2][4];  // 7 bit
+    uint8_t pbit[2];
+};
+
+static void bc7_palette(const it_Bc7Endpoints& endpoints, int palette[16][4])
+{
+    int e[2][4];
+    for (int i = 0; i < 2; i++)
+        for (int c = 0; c < 4; c++)
+            e[i][c] = endpoints.color[i][c] << 1 | endpoints.pbit[i];
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 4; c++)
+            palette[i][c] = ((64 - BC7_WEIGHTS4[i]) * e[0][c] + BC7_WEIGHTS4[i] * e[1][c] + 32) >> 6;
+}
+
+// Quantizes a float endpoint to 7 bits with the given p-bit, rounding to the nearest representable 8 bit value
+static void bc7_quantize(const float* value, uint8_t pbit, uint8_t* color)
+{
+    for (int c = 0; c < 4; c++)
+    {
+        int q = static_cast<int>(std::floor((value[c] - pbit) * 0.5f + 0.5f));
+        color[c] = static_cast<uint8_t>(std::min(std::max(q, 0), 127));
+    }
+}
+
+static uint32_t bc7_assign(const it_Bc7Endpoints& endpoints, const uint8_t* texels, uint8_t* indices)
+{
+    int palette[16][4];
+    bc7_palette(endpoints, palette);
+    uint32_t total = 0;
+    for (int t = 0; t < 16; t++)
+    {
+        const uint8_t* texel = texels + t * 4;
+        uint32_t best = UINT32_MAX;
+        for (int i = 0; i < 16; i++)
+        {
+            uint32_t error = 0;
+            for (int c = 0; c < 4; c++)
+            {
+                int d = palette[i][c] - texel[c];
+                error += d * d;
+            }
+            if (error < best)
+            {
+                best = error;
+                indices[t] = static_cast<uint8_t>(i);
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+// Tries the four p-bit combinations for a pair of float endpoints and keeps the best in *best
+static void bc7_try_endpoints(const float* e0, const float* e1, const uint8_t* texels, it_Bc7Endpoints* best, uint8_t* bestIndices, uint32_t* bestError)
+{
+    for (uint8_t p = 0; p < 4; p++)
+    {
+        it_Bc7Endpoints endpoints;
+        endpoints.pbit[0] = p & 1;
+        endpoints.pbit[1] = p >> 1;
+        bc7_quantize(e0, endpoints.pbit[0], endpoints.color[0]);
+        bc7_quantize(e1, endpoints.pbit[1], endpoints.color[1]);
+        uint8_t indices[16];
+        uint32_t error = bc7_assign(endpoints, texels, indices);
+        if (error < *bestError)
+        {
+            *bestError = error;
+            *best = endpoints;
+            memcpy(bestIndices, indices, 16);
+        }
+    }
+}
+
+void encode_bc7_block(const uint8_t* texels, uint8_t* block)
+{
+    // principal axis of the texels in RGBA, by power iteration on the covariance
+    float mean[4] = {};
+    for (int t = 0; t < 16; t++)
+        for (int c = 0; c < 4; c++)
+            mean[c] += texels[t * 4 + c] / 16.0f;
+    float covariance[4][4] = {};
+    for (int t = 0; t < 16; t++)
+    {
+        float d[4];
+        for (int c = 0; c < 4; c++)
+            d[c] = texels[t * 4 + c] - mean[c];
+        for (int a = 0; a < 4; a++)
+            for (int b = 0; b < 4; b++)
+                covariance[a][b] += d[a] * d[b];
+    }
+    float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        for (int a = 0; a < 4; a++)
+            for (int b = 0; b < 4; b++)
+                next[a] += covariance[a][b] * axis[b];
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 4; c++)
+            axis[c] = next[c] / length;
+    }
+
+    float tMin = 1e30f, tMax = -1e30f;
+    for (int t = 0; t < 16; t++)
+    {
+        float projection = 0.0f;
+        for (int c = 0; c < 4; c++)
+            projection += (texels[t * 4 + c] - mean[c]) * axis[c];
+        tMin = std::min(tMin, projection);
+        tMax = std::max(tMax, projection);
+    }
+    float e0[4], e1[4];
+    for (int c = 0; c < 4; c++)
+    {
+        e0[c] = mean[c] + axis[c] * tMin;
+        e1[c] = mean[c] + axis[c] * tMax;
+    }
+
+    it_Bc7Endpoints best{};
+    uint8_t indices[16] = {};
+    uint32_t bestError = UINT32_MAX;
+    bc7_try_endpoints(e0, e1, texels, &best, indices, &bestError);
+
+    // least squares endpoints for the chosen weights, then the weights again
+    for (int pass = 0; pass < BC7_REFINE_PASSES && bestError > 0; pass++)
+    {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[4] = {}, bx[4] = {};
+        for (int t = 0; t < 16; t++)
+        {
+            float w = BC7_WEIGHTS4[indices[t]] / 64.0f;
+            aa += (1.0f - w) * (1.0f - w);
+            ab += (1.0f - w) * w;
+            bb += w * w;
+            for (int c = 0; c < 4; c++)
+            {
+                ax[c] += (1.0f - w) * texels[t * 4 + c];
+                bx[c] += w * texels[t * 4 + c];
+            }
+        }
+        float det = aa * bb - ab * ab;
+        if (std::fabs(det) < 1e-6f)
+            break;
+        for (int c = 0; c < 4; c++)
+        {
+            e0[c] = std::min(std::max((ax[c] * bb - bx[c] * ab) / det, 0.0f), 255.0f);
+            e1[c] = std::min(std::max((bx[c] * aa - ax[c] * ab) / det, 0.0f), 255.0f);
+        }
+        bc7_try_endpoints(e0, e1, texels, &best, indices, &bestError);
+    }
+
+    // the anchor texel stores its index with 3 bits, so it has to be in the lower half
+    if (indices[0] & 8)
+    {
+        std::swap(best.color[0], best.color[1]);
+        std::swap(best.pbit[0], best.pbit[1]);
+        for (int t = 0; t < 16; t++)
+            indices[t] = static_cast<uint8_t>(15 - indices[t]);
+    }
+
+    memset(block, 0, BC_BLOCK_BYTES);
+    it_BlockBits bits{ block, 0 };
+    put_bits(&bits, 1u << 6, 7);
+    for (int c = 0; c < 4; c++)
+    {
+        put_bits(&bits, best.color[0][c], 7);
+        put_bits(&bits, best.color[1][c], 7);
+    }
+    put_bits(&bits, best.pbit[0], 1);
+    put_bits(&bits, best.pbit[1], 1);
+    put_bits(&bits, indices[0], 3);
+    for (int t = 1; t < 16; t++)
+        put_bits(&bits, indices[t], 4);
+}
+
+bool decode_bc7_block(const uint8_t* block, uint8_t* texels)
+{
+    if ((block[0] & 0x7F) != 0x40)
+        return false;
+
+    uint32_t position = 7;
+    it_Bc7Endpoints endpoints;
+    for (int c = 0; c < 4; c++)
+    {
+        endpoints.color[0][c] = static_cast<uint8_t>(get_bits(block, &position, 7));
+        endpoints.color[1][c] = static_cast<uint8_t>(get_bits(block, &position, 7));
+    }
+    endpoints.pbit[0] = static_cast<uint8_t>(get_bits(block, &position, 1));
+    endpoints.pbit[1] = static_cast<uint8_t>(get_bits(block, &position, 1));
+
+    int palette[16][4];
+    bc7_palette(endpoints, palette);
+    for (int t = 0; t < 16; t++)
+    {
+        uint32_t index = get_bits(block, &position, t == 0 ? 3 : 4);
+        for (int c = 0; c < 4; c++)
+            texels[t * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+    }
+    return true;
+}
+
+
+// BC4 with the eight value ramp (e0 > e1): the endpoints and six values between them
+static void bc4_palette(int e0, int e1, int palette[8])
+{
+    palette[0] = e0;
+    palette[1] = e1;
+    if (e0 > e1)
+    {
+        for (int i = 1; i < 7; i++)
+            palette[i + 1] = ((7 - i) * e0 + i * e1 + 3) / 7;
+    }
+    else
+    {
+        for (int i = 1; i < 5; i++)
+            palette[i + 1] = ((5 - i) * e0 + i * e1 + 2) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+static uint32_t bc4_assign(int e0, int e1, const uint8_t* values, uint8_t* indices)
+{
+    int palette[8];
+    bc4_palette(e0, e1, palette);
+    uint32_t total = 0;
+    for (int t = 0; t < 16; t++)
+    {
+        uint32_t best = UINT32_MAX;
+        for (int i = 0; i < 8; i++)
+        {
+            int d = palette[i] - values[t];
+            if (static_cast<uint32_t>(d * d) < best)
+            {
+                best = d * d;
+                indices[t] = static_cast<uint8_t>(i);
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+static void encode_bc4_block(const uint8_t* values, uint8_t* block)
+{
+    int lo = 255, hi = 0;
+    for (int t = 0; t < 16; t++)
+    {
+        lo = std::min(lo, static_cast<int>(values[t]));
+        hi = std::max(hi, static_cast<int>(values[t]));
+    }
+
+    uint8_t indices[16] = {};
+    int e0 = hi, e1 = lo;
+    if (hi > lo)
+    {
+        // pulling the endpoints in a little often lands the ramp closer to the values in between
+        uint32_t bestError = UINT32_MAX;
+        for (int inHi = 0; inHi < 3; inHi++)
+        {
+            for (int inLo = 0; inLo < 3; inLo++)
+            {
+                int a = hi - inHi, b = lo + inLo;
+                if (a <= b)
+                    continue;
+                uint8_t candidate[16];
+                uint32_t error = bc4_assign(a, b, values, candidate);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    e0 = a;
+                    e1 = b;
+                    memcpy(indices, candidate, 16);
+                }
+            }
+        }
+    }
+
+    block[0] = static_cast<uint8_t>(e0);
+    block[1] = static_cast<uint8_t>(e1);
+    uint64_t bits = 0;
+    for (int t = 0; t < 16; t++)
+        bits |= static_cast<uint64_t>(indices[t]) << (3 * t);
+    for (int i = 0; i < 6; i++)
+        block[2 + i] = static_cast<uint8_t>(bits >> (8 * i));
+}
+
+static void decode_bc4_block(const uint8_t* block, uint8_t* values, size_t stride)
+{
+    int palette[8];
+    bc4_palette(block[0], block[1], palette);
+    uint64_t bits = 0;
+    for (int i = 0; i < 6; i++)
+        bits |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+    for (int t = 0; t < 16; t++)
+        values[t * stride] = static_cast<uint8_t>(palette[bits >> (3 * t) & 7]);
+}
+
+void encode_bc5_block(const uint8_t* texels, uint8_t* block)
+{
+    uint8_t red[16], green[16];
+    for (int t = 0; t < 16; t++)
+    {
+        red[t] = texels[t * 4];
+        green[t] = texels[t * 4 + 1];
+    }
+    encode_bc4_block(red, block);
+    encode_bc4_block(green, block + 8);
+}
+
+void decode_bc5_block(const uint8_t* block, uint8_t* texels)
+{
+    decode_bc4_block(block, texels, 4);
+    decode_bc4_block(block + 8, texels + 1, 4);
+    for (int t = 0; t < 16; t++)
+    {
+        texels[t * 4 + 2] = 0;
+        texels[t * 4 + 3] = 255;
+    }
+}
+
+
+VkFormat compressed_texture_format(VkFormat format)
+{
+    if (format == TEXTURE_FORMAT_COLOR)
+        return VK_FORMAT_BC7_SRGB_BLOCK;
+    if (format == TEXTURE_FORMAT_NORMAL)
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    return VK_FORMAT_UNDEFINED;
+}
+
+static void compress_level(const uint8_t* pixels, uint32_t width, uint32_t height, VkFormat blockFormat, it_CompressedLevel* level)
+{
+    const uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    level->width = width;
+    level->height = height;
+    level->blocks.resize(static_cast<size_t>(blocksX) * blocksY * BC_BLOCK_BYTES);
+
+    parallel_for(blocksY, [&](size_t by) {
+        for (uint32_t bx = 0; bx < blocksX; bx++)
+        {
+            uint8_t texels[64];
+            for (uint32_t y = 0; y < 4; y++)
+            {
+                for (uint32_t x = 0; x < 4; x++)
+                {
+                    uint32_t sx = std::min(bx * 4 + x, width - 1), sy = std::min(static_cast<uint32_t>(by) * 4 + y, height - 1);
+                    memcpy(texels + (y * 4 + x) * 4, pixels + (static_cast<size_t>(sy) * width + sx) * 4, 4);
+                }
+            }
+            uint8_t* block = level->blocks.data() + (by * blocksX + bx) * BC_BLOCK_BYTES;
+            if (blockFormat == VK_FORMAT_BC5_UNORM_BLOCK)
+                encode_bc5_block(texels, block);
+            else
+                encode_bc7_block(texels, block);
+        }
+    });
+}
+
+void compress_mip_chain(const it_MipChain* chain, VkFormat blockFormat, std::vector<it_CompressedLevel>* levels)
+{
+    levels->assign(chain->levels.size(), it_CompressedLevel{});
+    for (size_t i = 0; i < chain->levels.size(); i++)
+    {
+        const it_MipLevel& level = chain->levels[i];
+        compress_level(chain->pixels.data() + level.offset, level.width, level.height, blockFormat, &(*levels)[i]);
+    }
+}
+
+void decompress_level(const it_CompressedLevel* level, VkFormat blockFormat, it_ImageData* image)
+{
+    const uint32_t blocksX = (level->width + 3) / 4, blocksY = (level->height + 3) / 4;
+    image->width = static_cast<int>(level->width);
+    image->height = static_cast<int>(level->height);
+    image->pixels = static_cast<unsigned char*>(malloc(static_cast<size_t>(level->width) * level->height * 4));
+
+    for (uint32_t by = 0; by < blocksY; by++)
+    {
+        for (uint32_t bx = 0; bx < blocksX; bx++)
+        {
+            uint8_t texels[64];
+            const uint8_t* block = level->blocks.data() + (static_cast<size_t>(by) * blocksX + bx) * BC_BLOCK_BYTES;
+            if (blockFormat == VK_FORMAT_BC5_UNORM_BLOCK)
+                decode_bc5_block(block, texels);
+            else if (!decode_bc7_block(block, texels))
+                memset(texels, 0, sizeof(texels));
+
+            for (uint32_t y = 0; y < 4 && by * 4 + y < level->height; y++)
+                for (uint32_t x = 0; x < 4 && bx * 4 + x < level->width; x++)
+                    memcpy(image->pixels + ((static_cast<size_t>(by) * 4 + y) * level->width + bx * 4 + x) * 4, texels + (y * 4 + x) * 4, 4);
+        }
+    }
+}
+
+double compressed_psnr(const it_ImageData* image, const it_CompressedLevel* level, VkFormat blockFormat)
+{
+    it_ImageData decoded;
+    decompress_level(level, blockFormat, &decoded);
+
+    const uint32_t channels = blockFormat == VK_FORMAT_BC5_UNORM_BLOCK ? 2 : 4;
+    const size_t texels = static_cast<size_t>(image->width) * image->height;
+    double squared = 0.0;
+    for (size_t i = 0; i < texels; i++)
+    {
+        for (uint32_t c = 0; c < channels; c++)
+        {
+            double d = static_cast<double>(image->pixels[i * 4 + c]) - decoded.pixels[i * 4 + c];
+            squared += d * d;
+        }
+    }
+    free(decoded.pixels);
+
+    double mse = squared / (static_cast<double>(texels) * channels);
+    if (mse <= 0.0)
+        return 99.0;
+    return std::min(99.0, 10.0 * std::log10(255.0 * 255.0 / mse));
+}
@@ -0,0 +1,290 @@
+#include "TextureCook.h"
+#include "TextureCompression.h"
+#include "MeshCache.h"
+#include "VirtualTexture.h"
+#include "MappedFile.h"
+#include "File.h"
+
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <set>
+#include <utility>
+#include <stdexcept>
+
+#include <tinylogger.h>
+
+
+static int64_t source_mtime(const std::string& path, uint64_t* size)
+{
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec)
+        return 0;
+    *size = static_cast<uint64_t>(std::filesystem::file_size(path, ec));
+    if (ec)
+        return 0;
+    return static_cast<int64_t>(mtime.time_since_epoch().count());
+}
+
+static bool source_hash(const std::string& path, uint64_t* hash)
+{
+    it_MappedFile source;
+    if (!map_file(path, &source))
+        return false;
+    *hash = hash_bytes(source.data, source.size);
+    unmap_file(&source);
+    return true;
+}
+
+// Whether value, the it_TextureCookSource stored with a file, describes the current sourcePath in format
+static bool source_is_current(const void* value, uint32_t size, const std::string& sourcePath, VkFormat format)
+{
+    if (!value || size != sizeof(it_TextureCookSource))
+        return false;
+    it_TextureCookSource cooked;
+    memcpy(&cooked, value, sizeof(cooked));
+
+    uint64_t sourceSize = 0;
+    int64_t sourceMTime = source_mtime(sourcePath, &sourceSize);
+    if (!sourceMTime || cooked.version != TEXTURE_COOK_VERSION || cooked.format != static_cast<uint32_t>(format)
+        || cooked.mipFilter != MIP_FILTER_DEFAULT || cooked.sourceSize != sourceSize)
+        return false;
+    if (cooked.sourceMTime == sourceMTime)
+        return true;
+    // touched but maybe unchanged (checkouts, copies)
+    uint64_t hash;
+    return source_hash(sourcePath, &hash) && hash == cooked.sourceHash;
+}
+
+// Whether the file was built from the current sourcePath in format, stored as storedFormat
+static bool cooked_is_current(const it_Ktx2File* ktx, const std::string& sourcePath, VkFormat format, VkFormat storedFormat)
+{
+    uint32_t size = 0;
+    const uint8_t* value = ktx2_value(ktx, TEXTURE_COOK_KEY, &size);
+    return ktx->format == storedFormat && source_is_current(value, size, sourcePath, format);
+}
+
+// sourcePath flattened into a file name in TEXTURE_COOK_DIR, the caller adds the extension
+static std::string cook_file_name(const std::string& sourcePath)
+{
+    std::string name = sourcePath;
+    for (auto& c : name)
+    {
+        if (c == '/' || c == '\\' || c == ':')
+            c = '_';
+    }
+    return std::string(TEXTURE_COOK_DIR) + name;
+}
+
+static std::string stored_texture_path(const std::string& sourcePath, VkFormat storedFormat)
+{
+    const char* suffix = storedFormat == VK_FORMAT_BC5_UNORM_BLOCK ? ".bc5" : storedFormat == VK_FORMAT_BC7_SRGB_BLOCK || storedFormat == VK_FORMAT_BC7_UNORM_BLOCK ? ".bc7" : ".rgba";
+    return cook_file_name(sourcePath) + suffix + ".ktx2";
+}
+
+static bool open_stored_texture(const std::string& sourcePath, VkFormat format, VkFormat storedFormat, it_Ktx2File* ktx)
+{
+    if (storedFormat == VK_FORMAT_UNDEFINED)
+        return false;
+    if (!open_ktx2(stored_texture_path(sourcePath, storedFormat), ktx))
+        return false;
+    if (cooked_is_current(ktx, sourcePath, format, storedFormat))
+        return true;
+    close_ktx2(ktx);
+    return false;
+}
+
+// Fills in everything but the hash, which only a write needs. False if the source cannot be stat'ed.
+static bool cook_source(const std::string& sourcePath, VkFormat format, it_TextureCookSource* source)
+{
+    *source = it_TextureCookSource{};
+    source->version = TEXTURE_COOK_VERSION;
+    source->format = static_cast<uint32_t>(format);
+    source->mipFilter = MIP_FILTER_DEFAULT;
+    source->sourceMTime = source_mtime(sourcePath, &source->sourceSize);
+    return source->sourceMTime != 0;
+}
+
+static bool write_stored_texture(const std::string& sourcePath, VkFormat storedFormat, uint32_t width, uint32_t height, const std::vector<it_Ktx2Level>& levels,
+    const uint8_t* data, const it_TextureCookSource* source)
+{
+    std::vector<std::pair<std::string, std::string>> keyValues;
+    keyValues.emplace_back("KTXwriter", std::string("VulkanEngine texture cooker") + '\0');
+    keyValues.emplace_back(TEXTURE_COOK_KEY, std::string(reinterpret_cast<const char*>(source), sizeof(*source)));
+    return write_ktx2(stored_texture_path(sourcePath, storedFormat), storedFormat, width, height, levels, data, keyValues);
+}
+
+
+std::string cooked_texture_path(const std::string& sourcePath, VkFormat format)
+{
+    return stored_texture_path(sourcePath, compressed_texture_format(format));
+}
+
+std::string virtual_texture_path(const std::string& sourcePath)
+{
+    return cook_file_name(sourcePath) + ".vtx";
+}
+
+bool virtual_texture_current(const std::string& sourcePath)
+{
+    std::string tag;
+    return read_virtual_texture_tag(virtual_texture_path(sourcePath), &tag)
+        && source_is_current(tag.data(), static_cast<uint32_t>(tag.size()), sourcePath, TEXTURE_FORMAT_COLOR);
+}
+
+bool open_cooked_texture(const std::string& sourcePath, VkFormat format, it_Ktx2File* ktx)
+{
+    return open_stored_texture(sourcePath, format, compressed_texture_format(format), ktx);
+}
+
+bool open_cached_mips(const std::string& sourcePath, VkFormat format, it_Ktx2File* ktx)
+{
+    return open_stored_texture(sourcePath, format, format, ktx);
+}
+
+bool cache_mips(const std::string& sourcePath, VkFormat format, const it_MipChain* chain)
+{
+    it_TextureCookSource source;
+    if (!cook_source(sourcePath, format, &source) || !source_hash(sourcePath, &source.sourceHash))
+        return false;
+    std::vector<it_Ktx2Level> levels;
+    for (const it_MipLevel& level : chain->levels)
+        levels.push_back({ level.offset, static_cast<uint64_t>(level.width) * level.height * 4 });
+    return write_stored_texture(sourcePath, format, chain->levels[0].width, chain->levels[0].height, levels, chain->pixels.data(), &source);
+}
+
+void cook_texture(const std::string& sourcePath, VkFormat format, bool force, it_TextureCookStats* stats)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    *stats = it_TextureCookStats{};
+    const VkFormat blockFormat = compressed_texture_format(format);
+    if (blockFormat == VK_FORMAT_UNDEFINED)
+        throw std::runtime_error("ERROR: no block format to cook " + sourcePath + " into!");
+
+    it_TextureCookSource source;
+    cook_source(sourcePath, format, &source);
+    stats->sourceBytes = source.sourceSize;
+
+    // a current KTX2 still has to be decoded once if its virtual texture is missing
+    it_Ktx2File existing;
+    if (!force && open_cooked_texture(sourcePath, format, &existing))
+    {
+        stats->levels = static_cast<uint32_t>(existing.levels.size());
+        stats->cookedBytes = existing.file.size;
+        stats->upToDate = true;
+        const bool large = std::max(existing.width, existing.height) >= TEXTURE_COOK_VIRTUAL_SIZE;
+        close_ktx2(&existing);
+        if (format != TEXTURE_FORMAT_COLOR || !large || virtual_texture_current(sourcePath))
+            return;
+    }
+
+    if (!source_hash(sourcePath, &source.sourceHash))
+        throw std::runtime_error("ERROR: failed to read " + sourcePath + "!");
+    it_ImageData image;
+    decode_image(sourcePath, &image);
+
+    it_MipChain chain;
+    std::vector<it_CompressedLevel> compressed;
+    try
+    {
+        generate_mip_chain(&image, format, MIP_FILTER_DEFAULT, &chain);
+        if (!stats->upToDate)
+        {
+            compress_mip_chain(&chain, blockFormat, &compressed);
+            stats->psnr = compressed_psnr(&image, &compressed[0], blockFormat);
+        }
+    }
+    catch (...)
+    {
+        free_image(&image);
+        throw;
+    }
+    free_image(&image);
+    stats->rgbaBytes = chain.pixels.size();
+
+    std::error_code ec;
+    if (format == TEXTURE_FORMAT_COLOR && std::max(chain.levels[0].width, chain.levels[0].height) >= TEXTURE_COOK_VIRTUAL_SIZE
+        && (force || !virtual_texture_current(sourcePath)))
+    {
+        const std::string path = virtual_texture_path(sourcePath);
+        if (!write_virtual_texture(path, &chain, format, &source, sizeof(source)))
+            throw std::runtime_error("ERROR: failed to write " + path + "!");
+        stats->virtualBytes = static_cast<uint64_t>(std::filesystem::file_size(path, ec));
+    }
+    if (stats->upToDate)
+    {
+        stats->seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        return;
+    }
+    stats->levels = static_cast<uint32_t>(compressed.size());
+
+    std::vector<it_Ktx2Level> levels;
+    std::vector<uint8_t> blocks;
+    for (const it_CompressedLevel& level : compressed)
+    {
+        levels.push_back({ blocks.size(), level.blocks.size() });
+        blocks.insert(blocks.end(), level.blocks.begin(), level.blocks.end());
+    }
+    if (!write_stored_texture(sourcePath, blockFormat, compressed[0].width, compressed[0].height, levels, blocks.data(), &source))
+        throw std::runtime_error("ERROR: failed to write " + cooked_texture_path(sourcePath, format) + "!");
+
+    stats->cookedBytes = static_cast<uint64_t>(std::filesystem::file_size(cooked_texture_path(sourcePath, format), ec));
+    stats->seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void cook_scene_textures(const std::string& scenePath, bool force)
+{
+    std::vector<Model*> scene;
+    size_t sceneSize = 0;
+    load_scene(scenePath, &scene, &sceneSize);
+
+    std::set<std::pair<std::string, VkFormat>> textures;
+    for (Model* model : scene)
+    {
+        textures.insert({ model->baseDir + model->TEXTURE_PATH, TEXTURE_FORMAT_COLOR });
+        if (!model->NORMAL_PATH.empty())
+            textures.insert({ model->baseDir + model->NORMAL_PATH, TEXTURE_FORMAT_NORMAL });
+        delete model;
+    }
+
+    uint32_t cooked = 0, current = 0, failed = 0;
+    uint64_t sourceBytes = 0, rgbaBytes = 0, cookedBytes = 0;
+    double psnrSum = 0.0, seconds = 0.0;
+    for (const auto& texture : textures)
+    {
+        it_TextureCookStats stats;
+        try
+        {
+            cook_texture(texture.first, texture.second, force, &stats);
+        }
+        catch (const std::exception& e)
+        {
+            tlog::error(e.what());
+            failed++;
+            continue;
+        }
+        if (stats.virtualBytes)
+            tlog::info(texture.first + " virtual texture: " + std::to_string(stats.virtualBytes >> 20) + " MB of " + std::to_string(VT_PAGE_SIZE) + " texel tiles");
+        if (stats.upToDate)
+        {
+            current++;
+            continue;
+        }
+        cooked++;
+        sourceBytes += stats.sourceBytes;
+        rgbaBytes += stats.rgbaBytes;
+        cookedBytes += stats.cookedBytes;
+        psnrSum += stats.psnr;
+        seconds += stats.seconds;
+        tlog::info(texture.first + (compressed_texture_format(texture.second) == VK_FORMAT_BC5_UNORM_BLOCK ? " BC5" : " BC7") + ", "
+            + std::to_string(stats.levels) + " levels: " + std::to_string(stats.sourceBytes >> 10) + " KB source, " + std::to_string(stats.rgbaBytes >> 10)
+            + " KB as RGBA8, " + std::to_string(stats.cookedBytes >> 10) + " KB cooked, PSNR " + std::to_string(stats.psnr) + " dB in "
+            + std::to_string(stats.seconds * 1000.0) + " ms");
+    }
+
+    tlog::info("Cooked " + std::to_string(cooked) + " textures (" + std::to_string(current) + " up to date, " + std::to_string(failed) + " failed) in "
+        + std::to_string(seconds) + " s. " + std::to_string(rgbaBytes >> 20) + " MB of RGBA8 mip chains became " + std::to_string(cookedBytes >> 20)
+        + " MB (sources " + std::to_string(sourceBytes >> 20) + " MB), mean PSNR " + std::to_string(cooked ? psnrSum / cooked : 0.0) + " dB");
+}
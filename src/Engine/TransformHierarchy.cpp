@@ -0,0 +1,163 @@
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+void hierarchy_reserve(it_TransformHierarchy* hierarchy, size_t capacity)
+{
+    transform_store_reserve(&hierarchy->local, capacity);
+    hierarchy->parent.reserve(capacity);
+    hierarchy->world.reserve(capacity);
+    hierarchy->dirty.reserve(capacity);
+    hierarchy->changed.reserve(capacity);
+}
+
+void hierarchy_clear(it_TransformHierarchy* hierarchy)
+{
+    transform_store_clear(&hierarchy->local);
+    hierarchy->parent.clear();
+    hierarchy->world.clear();
+    hierarchy->dirty.clear();
+    hierarchy->changed.clear();
+    hierarchy->firstDirty = SIZE_MAX;
+}
+
+uint32_t hierarchy_add(it_TransformHierarchy* hierarchy, uint32_t parent, const glm::vec3& position, const glm::vec3& euler, const glm::vec3& scale)
+{
+    const uint32_t node = transform_push(&hierarchy->local, position, euler, scale);
+    if (parent != HIERARCHY_ROOT && parent >= node)
+        throw std::runtime_error("ERROR: hierarchy parent " + std::to_string(parent) + " is not before node " + std::to_string(node) + "!");
+    hierarchy->parent.push_back(parent);
+    hierarchy->world.push_back(glm::mat4(1.0f));
+    hierarchy->dirty.push_back(1);
+    hierarchy->changed.push_back(0);
+    hierarchy->firstDirty = std::min<size_t>(hierarchy->firstDirty, node);
+    return node;
+}
+
+void hierarchy_set_local(it_TransformHierarchy* hierarchy, uint32_t node, const glm::vec3& position, const glm::vec3& euler, const glm::vec3& scale)
+{
+    transform_set(&hierarchy->local, node, position, euler, scale);
+    hierarchy->dirty[node] = 1;
+    hierarchy->firstDirty = std::min<size_t>(hierarchy->firstDirty, node);
+}
+
+// Both affine, the bottom rows stay (0, 0, 0, 1)
+static glm::mat4 affine_multiply(const glm::mat4& a, const glm::mat4& b)
+{
+    glm::mat4 m;
+    m[0] = a[0] * b[0].x + a[1] * b[0].y + a[2] * b[0].z;
+    m[1] = a[0] * b[1].x + a[1] * b[1].y + a[2] * b[1].z;
+    m[2] = a[0] * b[2].x + a[1] * b[2].y + a[2] * b[2].z;
+    m[3] = a[0] * b[3].x + a[1] * b[3].y + a[2] * b[3].z + a[3];
+    return m;
+}
+
+size_t hierarchy_update(it_TransformHierarchy* hierarchy)
+{
+    const size_t count = hierarchy->parent.size();
+    // parents come first, so nothing before the first dirty node changes
+    const size_t first = std::min(hierarchy->firstDirty, count);
+    std::fill(hierarchy->changed.begin(), hierarchy->changed.begin() + first, 0);
+    if (first == count)
+        return 0;
+
+    // local matrices in runs of consecutive dirty nodes, a fully dirty hierarchy is one parallel batch
+    for (size_t i = first; i < count;)
+    {
+        if (!hierarchy->dirty[i])
+        {
+            ++i;
+            continue;
+        }
+        const size_t runStart = i;
+        while (i < count && hierarchy->dirty[i])
+            ++i;
+        if (runStart == 0 && i == count)
+            transform_update_world(&hierarchy->local);
+        else
+            transform_update_range(&hierarchy->local, runStart, i - runStart);
+    }
+
+    // a parent's changed flag and world matrix are final when its children are reached
+    size_t rebuilt = 0;
+    for (size_t i = first; i < count; ++i)
+    {
+        const uint32_t parent = hierarchy->parent[i];
+        const bool changed = hierarchy->dirty[i] || (parent != HIERARCHY_ROOT && hierarchy->changed[parent]);
+        hierarchy->changed[i] = changed;
+        if (!changed)
+            continue;
+        hierarchy->world[i] = parent == HIERARCHY_ROOT ? hierarchy->local.world[i] : affine_multiply(hierarchy->world[parent], hierarchy->local.world[i]);
+        ++rebuilt;
+    }
+    std::memset(hierarchy->dirty.data() + first, 0, count - first);
+    hierarchy->firstDirty = SIZE_MAX;
+    return rebuilt;
+}
+
+bool hierarchy_sort(std::vector<uint32_t>* parents, std::vector<uint32_t>* order)
+{
+    const size_t count = parents->size();
+
+    // children lists as ranges of one array, siblings in input order
+    std::vector<uint32_t> childStart(count + 1, 0), children(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t& parent = (*parents)[i];
+        if (parent != HIERARCHY_ROOT && (parent >= count || parent == i))
+            parent = HIERARCHY_ROOT;
+        if (parent != HIERARCHY_ROOT)
+            childStart[parent + 1]++;
+    }
+    for (size_t i = 0; i < count; ++i)
+        childStart[i + 1] += childStart[i];
+    std::vector<uint32_t> fill(childStart.begin(), childStart.end() - 1);
+    for (size_t i = 0; i < count; ++i)
+        if ((*parents)[i] != HIERARCHY_ROOT)
+            children[fill[(*parents)[i]]++] = static_cast<uint32_t>(i);
+
+    order->clear();
+    order->reserve(count);
+    std::vector<uint8_t> visited(count, 0);
+    std::vector<uint32_t> stack;
+    auto visit = [&](uint32_t root) {
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            const uint32_t node = stack.back();
+            stack.pop_back();
+            visited[node] = 1;
+            order->push_back(node);
+            // reversed so the first child is visited first, a node cut off a cycle is no longer its old parent's child
+            for (uint32_t c = childStart[node + 1]; c-- > childStart[node];)
+                if ((*parents)[children[c]] == node)
+                    stack.push_back(children[c]);
+        }
+    };
+    for (size_t i = 0; i < count; ++i)
+        if ((*parents)[i] == HIERARCHY_ROOT)
+            visit(static_cast<uint32_t>(i));
+
+    // whatever is left is on a cycle or hangs off one: walk up until a node repeats, that one is on the cycle
+    bool acyclic = true;
+    std::vector<uint32_t> seen(count, HIERARCHY_ROOT);
+    for (size_t i = 0; i < count; ++i)
+    {
+        while (!visited[i])
+        {
+            acyclic = false;
+            uint32_t node = static_cast<uint32_t>(i);
+            while (seen[node] != i)
+            {
+                seen[node] = static_cast<uint32_t>(i);
+                node = (*parents)[node];
+            }
+            (*parents)[node] = HIERARCHY_ROOT;
+            visit(node);
+        }
+    }
+    return acyclic;
+}
@@ -0,0 +1,199 @@
+#include "TransformStore.h"
+#include "Parallel.h"
+
+#include <cmath>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TRANSFORM_AVX2_TARGET
+#else
+#define TRANSFORM_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+static bool s_useSimd = true;
+
+void transform_store_reserve(it_TransformStore* store, size_t capacity)
+{
+    for (std::vector<float>* stream : { &store->px, &store->py, &store->pz, &store->qx, &store->qy, &store->qz, &store->qw, &store->sx, &store->sy, &store->sz })
+        stream->reserve(capacity);
+    store->world.reserve(capacity);
+}
+
+void transform_store_clear(it_TransformStore* store)
+{
+    for (std::vector<float>* stream : { &store->px, &store->py, &store->pz, &store->qx, &store->qy, &store->qz, &store->qw, &store->sx, &store->sy, &store->sz })
+        stream->clear();
+    store->world.clear();
+    store->count = 0;
+}
+
+glm::vec4 euler_to_quaternion(const glm::vec3& euler)
+{
+    // qz * qy * qx, the same rotation as glm::rotate around z, then y, then x applied to a column vector
+    const float cx = std::cos(euler.x * 0.5f), sx = std::sin(euler.x * 0.5f);
+    const float cy = std::cos(euler.y * 0.5f), sy = std::sin(euler.y * 0.5f);
+    const float cz = std::cos(euler.z * 0.5f), sz = std::sin(euler.z * 0.5f);
+    return glm::vec4(sx * cy * cz - cx * sy * sz,
+                     cx * sy * cz + sx * cy * sz,
+                     cx * cy * sz - sx * sy * cz,
+                     cx * cy * cz + sx * sy * sz);
+}
+
+uint32_t transform_push(it_TransformStore* store, const glm::vec3& position, const glm::vec3& euler, const glm::vec3& scale)
+{
+    const uint32_t index = static_cast<uint32_t>(store->count++);
+    for (std::vector<float>* stream : { &store->px, &store->py, &store->pz, &store->qx, &store->qy, &store->qz, &store->qw, &store->sx, &store->sy, &store->sz })
+        stream->push_back(0.0f);
+    store->world.push_back(glm::mat4(1.0f));
+    transform_set(store, index, position, euler, scale);
+    return index;
+}
+
+void transform_set(it_TransformStore* store, uint32_t index, const glm::vec3& position, const glm::vec3& euler, const glm::vec3& scale)
+{
+    const glm::vec4 q = euler_to_quaternion(euler);
+    store->px[index] = position.x;
+    store->py[index] = position.y;
+    store->pz[index] = position.z;
+    store->qx[index] = q.x;
+    store->qy[index] = q.y;
+    store->qz[index] = q.z;
+    store->qw[index] = q.w;
+    store->sx[index] = scale.x;
+    store->sy[index] = scale.y;
+    store->sz[index] = scale.z;
+}
+
+static void update_scalar(it_TransformStore* s, size_t first, size_t end)
+{
+    for (size_t i = first; i < end; ++i)
+    {
+        const float x = s->qx[i], y = s->qy[i], z = s->qz[i], w = s->qw[i];
+        const float xx = x * x, yy = y * y, zz = z * z;
+        const float xy = x * y, xz = x * z, yz = y * z;
+        const float wx = w * x, wy = w * y, wz = w * z;
+
+        glm::mat4& m = s->world[i];
+        m[0] = glm::vec4((1.0f - 2.0f * (yy + zz)) * s->sx[i], 2.0f * (xy + wz) * s->sx[i], 2.0f * (xz - wy) * s->sx[i], 0.0f);
+        m[1] = glm::vec4(2.0f * (xy - wz) * s->sy[i], (1.0f - 2.0f * (xx + zz)) * s->sy[i], 2.0f * (yz + wx) * s->sy[i], 0.0f);
+        m[2] = glm::vec4(2.0f * (xz + wy) * s->sz[i], 2.0f * (yz - wx) * s->sz[i], (1.0f - 2.0f * (xx + yy)) * s->sz[i], 0.0f);
+        m[3] = glm::vec4(s->px[i], s->py[i], s->pz[i], 1.0f);
+    }
+}
+
+// r[k] holds one matrix element of eight transforms, afterwards it holds eight elements of transform k
+TRANSFORM_AVX2_TARGET static inline void transpose8(__m256 r[8])
+{
+    const __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]), t1 = _mm256_unpackhi_ps(r[0], r[1]);
+    const __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]), t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    const __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]), t5 = _mm256_unpackhi_ps(r[4], r[5]);
+    const __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]), t7 = _mm256_unpackhi_ps(r[6], r[7]);
+    const __m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)), u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)), u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0)), u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0)), u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+    r[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+    r[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+    r[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+    r[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+    r[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+    r[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+    r[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+    r[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+}
+
+// Returns where it stopped, the scalar kernel does the remaining transforms
+TRANSFORM_AVX2_TARGET static size_t update_avx2(it_TransformStore* s, size_t first, size_t end)
+{
+    const __m256 one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+    size_t i = first;
+    for (; i + TRANSFORM_BATCH <= end; i += TRANSFORM_BATCH)
+    {
+        const __m256 x = _mm256_loadu_ps(&s->qx[i]), y = _mm256_loadu_ps(&s->qy[i]), z = _mm256_loadu_ps(&s->qz[i]), w = _mm256_loadu_ps(&s->qw[i]);
+        const __m256 sx = _mm256_loadu_ps(&s->sx[i]), sy = _mm256_loadu_ps(&s->sy[i]), sz = _mm256_loadu_ps(&s->sz[i]);
+
+        // doubled products save the multiplications by two
+        const __m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y), z2 = _mm256_add_ps(z, z);
+        const __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+        const __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+        const __m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+
+        // columns 0 and 1 in the first half of each matrix, column 2 and the translation in the second
+        __m256 a[8], b[8];
+        a[0] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx);
+        a[1] = _mm256_mul_ps(_mm256_add_ps(xy, wz), sx);
+        a[2] = _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx);
+        a[3] = zero;
+        a[4] = _mm256_mul_ps(_mm256_sub_ps(xy, wz), sy);
+        a[5] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy);
+        a[6] = _mm256_mul_ps(_mm256_add_ps(yz, wx), sy);
+        a[7] = zero;
+        b[0] = _mm256_mul_ps(_mm256_add_ps(xz, wy), sz);
+        b[1] = _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz);
+        b[2] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz);
+        b[3] = zero;
+        b[4] = _mm256_loadu_ps(&s->px[i]);
+        b[5] = _mm256_loadu_ps(&s->py[i]);
+        b[6] = _mm256_loadu_ps(&s->pz[i]);
+        b[7] = one;
+
+        transpose8(a);
+        transpose8(b);
+        for (int k = 0; k < TRANSFORM_BATCH; ++k)
+        {
+            float* m = &s->world[i + k][0][0];
+            _mm256_storeu_ps(m, a[k]);
+            _mm256_storeu_ps(m + 8, b[k]);
+        }
+    }
+    return i;
+}
+
+bool transform_simd_supported()
+{
+    static const bool supported = []() {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+        // the OS must save the upper halves of the ymm registers
+        if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2") != 0;
+#endif
+    }();
+    return supported;
+}
+
+void transform_use_simd(bool enabled)
+{
+    s_useSimd = enabled;
+}
+
+void transform_update_range(it_TransformStore* store, size_t first, size_t count)
+{
+    size_t i = first;
+    if (s_useSimd && transform_simd_supported())
+        i = update_avx2(store, first, first + count);
+    update_scalar(store, i, first + count);
+}
+
+void transform_update_world(it_TransformStore* store)
+{
+    const size_t chunks = (store->count + TRANSFORM_CHUNK - 1) / TRANSFORM_CHUNK;
+    if (chunks <= 1)
+    {
+        transform_update_range(store, 0, store->count);
+        return;
+    }
+    parallel_for(chunks, [&](size_t chunk) {
+        const size_t first = chunk * TRANSFORM_CHUNK;
+        transform_update_range(store, first, std::min<size_t>(TRANSFORM_CHUNK, store->count - first));
+    });
+}
@@ -0,0 +1,222 @@
+#include "UploadContext.h"
+#include "Buffer.h"
+
+#include <chrono>
+#include <stdexcept>
+
+
+static double seconds_since(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static it_UploadBatch* batch_slot(it_UploadContext* context, uint64_t ticket)
+{
+    return &context->batches[ticket % UPLOAD_MAX_BATCHES];
+}
+
+// Called once the batch's fence has signaled
+static void retire_batch(it_UploadContext* context, it_UploadBatch* batch)
+{
+    for (size_t i = 0; i < batch->overflowBuffers.size(); ++i)
+    {
+        vkDestroyBuffer(context->device, batch->overflowBuffers[i], nullptr);
+        free_device_memory(&batch->overflowMemory[i]);
+    }
+    batch->overflowBuffers.clear();
+    batch->overflowMemory.clear();
+
+    vkResetFences(context->device, 1, &batch->fence);
+    vkResetCommandBuffer(batch->commandBuffer, 0);
+    context->completedTicket = batch->ticket;
+    batch->ticket = 0;
+
+    // swap out first, a completion may record into the context again
+    std::vector<std::function<void()>> completions;
+    completions.swap(batch->completions);
+    for (auto& completion : completions)
+        completion();
+}
+
+static void wait_for_ticket(it_UploadContext* context, uint64_t ticket)
+{
+    while (context->completedTicket < ticket)
+    {
+        it_UploadBatch* batch = batch_slot(context, context->completedTicket + 1);
+        auto start = std::chrono::high_resolution_clock::now();
+        vkWaitForFences(context->device, 1, &batch->fence, VK_TRUE, UINT64_MAX);
+        context->stats.stallSeconds += seconds_since(start);
+        retire_batch(context, batch);
+    }
+}
+
+// it_FenceSource over the batch fences. Batches on one queue finish in submission order, so polling stops at the
+// first fence that has not signaled.
+static uint64_t completed_ticket(void* userData)
+{
+    it_UploadContext* context = static_cast<it_UploadContext*>(userData);
+    uint64_t submittedTicket = context->nextTicket - 1;
+    while (context->completedTicket < submittedTicket)
+    {
+        it_UploadBatch* batch = batch_slot(context, context->completedTicket + 1);
+        if (vkGetFenceStatus(context->device, batch->fence) != VK_SUCCESS)
+            break;
+        retire_batch(context, batch);
+    }
+    return context->completedTicket;
+}
+
+static void wait_ticket(void* userData, uint64_t ticket)
+{
+    wait_for_ticket(static_cast<it_UploadContext*>(userData), ticket);
+}
+
+
+void create_upload_context(VkDevice* device, VkPhysicalDevice* physicalDevice, uint32_t queueFamily, VkQueue queue, std::mutex* queueMutex, it_UploadContext* context)
+{
+    context->device = *device;
+    context->physicalDevice = *physicalDevice;
+    context->queue = queue;
+    context->queueMutex = queueMutex;
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queueFamily;
+    if (vkCreateCommandPool(*device, &poolInfo, nullptr, &context->commandPool) != VK_SUCCESS)
+        throw std::runtime_error("ERROR: failed to create upload command pool!");
+
+    for (auto& batch : context->batches)
+    {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = context->commandPool;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(*device, &allocInfo, &batch.commandBuffer) != VK_SUCCESS)
+            throw std::runtime_error("ERROR: failed to allocate upload command buffer!");
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(*device, &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS)
+            throw std::runtime_error("ERROR: failed to create upload fence!");
+        batch.ticket = 0;
+    }
+    context->nextTicket = 1;
+    context->completedTicket = 0;
+    context->recording = false;
+
+    create_buffer(device, UPLOAD_STAGING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        context->stagingBuffer, context->stagingMemory);
+    staging_ring_init(&context->ring, UPLOAD_STAGING_SIZE, it_FenceSource{ context, completed_ticket, wait_ticket });
+}
+
+void destroy_upload_context(it_UploadContext* context)
+{
+    upload_context_flush(context);
+    vkDestroyBuffer(context->device, context->stagingBuffer, nullptr);
+    free_device_memory(&context->stagingMemory);
+    for (auto& batch : context->batches)
+        vkDestroyFence(context->device, batch.fence, nullptr);
+    vkDestroyCommandPool(context->device, context->commandPool, nullptr);
+    context->commandPool = VK_NULL_HANDLE;
+}
+
+VkCommandBuffer upload_context_commands(it_UploadContext* context)
+{
+    it_UploadBatch* batch = batch_slot(context, context->nextTicket);
+    if (!context->recording)
+    {
+        // the slot still belongs to the batch UPLOAD_MAX_BATCHES submits ago
+        if (context->nextTicket > UPLOAD_MAX_BATCHES)
+            wait_for_ticket(context, context->nextTicket - UPLOAD_MAX_BATCHES);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(batch->commandBuffer, &beginInfo);
+        batch->ticket = context->nextTicket;
+        context->recording = true;
+    }
+    return batch->commandBuffer;
+}
+
+void* upload_context_stage(it_UploadContext* context, VkDeviceSize size, VkBuffer* buffer, VkDeviceSize* offset)
+{
+    context->stats.uploads++;
+    context->stats.bytes += size;
+
+    if (size > UPLOAD_STAGING_SIZE)
+    {
+        VkBuffer overflow;
+        it_Allocation overflowMemory;
+        create_buffer(&context->device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            overflow, overflowMemory);
+        upload_context_commands(context);
+        it_UploadBatch* batch = batch_slot(context, context->nextTicket);
+        batch->overflowBuffers.push_back(overflow);
+        batch->overflowMemory.push_back(overflowMemory);
+        context->stats.overflows++;
+        *buffer = overflow;
+        *offset = 0;
+        return overflowMemory.mapped;
+    }
+
+    uint64_t ringOffset;
+    if (!staging_ring_alloc(&context->ring, size, UPLOAD_STAGING_ALIGNMENT, &ringOffset))
+    {
+        // the open batch holds the rest of the ring, hand it to the GPU and take space from the oldest batch
+        upload_context_submit(context);
+        if (!staging_ring_alloc(&context->ring, size, UPLOAD_STAGING_ALIGNMENT, &ringOffset))
+            throw std::runtime_error("ERROR: failed to allocate upload staging memory!");
+    }
+    *buffer = context->stagingBuffer;
+    *offset = ringOffset;
+    return static_cast<uint8_t*>(context->stagingMemory.mapped) + ringOffset;
+}
+
+void upload_context_on_complete(it_UploadContext* context, std::function<void()> completion)
+{
+    upload_context_commands(context);
+    batch_slot(context, context->nextTicket)->completions.push_back(std::move(completion));
+}
+
+void upload_context_submit(it_UploadContext* context)
+{
+    if (!context->recording)
+        return;
+
+    it_UploadBatch* batch = batch_slot(context, context->nextTicket);
+    vkEndCommandBuffer(batch->commandBuffer);
+    context->recording = false;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch->commandBuffer;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(*context->queueMutex);
+        if (vkQueueSubmit(context->queue, 1, &submitInfo, batch->fence) != VK_SUCCESS)
+            throw std::runtime_error("ERROR: failed to submit upload batch!");
+    }
+    context->stats.stallSeconds += seconds_since(start);
+    context->stats.submits++;
+
+    staging_ring_submit(&context->ring, context->nextTicket);
+    context->nextTicket++;
+}
+
+void upload_context_flush(it_UploadContext* context)
+{
+    upload_context_submit(context);
+    wait_for_ticket(context, context->nextTicket - 1);
+    staging_ring_retire(&context->ring);
+}
+
+void upload_context_poll(it_UploadContext* context)
+{
+    completed_ticket(context);
+    staging_ring_retire(&context->ring);
+}
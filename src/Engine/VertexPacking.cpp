@@ -0,0 +1,152 @@
+#include "VertexPacking.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+static int16_t to_snorm16(float value)
+{
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+static float from_snorm16(int16_t value)
+{
+    // same rule the vertex fetch uses for SNORM formats
+    return std::max(static_cast<float>(value) / 32767.0f, -1.0f);
+}
+
+static uint16_t to_unorm16(float value)
+{
+    return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+static float from_unorm16(uint16_t value)
+{
+    return static_cast<float>(value) / 65535.0f;
+}
+
+static float sign_not_zero(float value)
+{
+    return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+// atan2 keeps small angles exact, acos of a float dot product cannot resolve anything below about 0.02 degrees
+static float angle_degrees(glm::vec3 a, glm::vec3 b)
+{
+    a = glm::normalize(a);
+    b = glm::normalize(b);
+    return glm::degrees(std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)));
+}
+
+
+glm::vec2 oct_encode(glm::vec3 n)
+{
+    float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (l1 == 0.0f || !std::isfinite(l1))
+        return glm::vec2(0.0f);
+
+    glm::vec2 p = glm::vec2(n.x, n.y) / l1;
+    if (n.z < 0.0f)
+        p = glm::vec2((1.0f - std::fabs(p.y)) * sign_not_zero(p.x), (1.0f - std::fabs(p.x)) * sign_not_zero(p.y));
+    return p;
+}
+
+glm::vec3 oct_decode(glm::vec2 e)
+{
+    glm::vec3 n = glm::vec3(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+it_PackingParams compute_packing_params(const std::vector<Vertex>& vertices)
+{
+    it_PackingParams params;
+    if (vertices.empty())
+        return params;
+
+    glm::vec3 minPos = vertices[0].pos, maxPos = vertices[0].pos;
+    glm::vec2 minUV = vertices[0].texCoord, maxUV = vertices[0].texCoord;
+    for (const auto& vertex : vertices)
+    {
+        minPos = glm::min(minPos, vertex.pos);
+        maxPos = glm::max(maxPos, vertex.pos);
+        minUV = glm::min(minUV, vertex.texCoord);
+        maxUV = glm::max(maxUV, vertex.texCoord);
+    }
+
+    params.center = (minPos + maxPos) * 0.5f;
+    glm::vec3 half = (maxPos - minPos) * 0.5f;
+    params.extent = std::max(std::max(half.x, half.y), half.z);
+    if (params.extent <= 0.0f)
+        params.extent = 1.0f;
+
+    params.uvMin = minUV;
+    params.uvRange = maxUV - minUV;
+    if (params.uvRange.x <= 0.0f)
+        params.uvRange.x = 1.0f;
+    if (params.uvRange.y <= 0.0f)
+        params.uvRange.y = 1.0f;
+    return params;
+}
+
+PackedVertex pack_vertex(const Vertex& vertex, const it_PackingParams& params)
+{
+    PackedVertex packed{};
+    glm::vec3 p = (vertex.pos - params.center) / params.extent;
+    packed.position[0] = to_snorm16(p.x);
+    packed.position[1] = to_snorm16(p.y);
+    packed.position[2] = to_snorm16(p.z);
+    // the shader rebuilds the bitangent as cross(N, T), only its orientation is stored
+    bool flipped = glm::dot(glm::cross(vertex.normal, vertex.tangent), vertex.bitangent) < 0.0f;
+    packed.position[3] = flipped ? -32767 : 32767;
+
+    glm::vec2 uv = (vertex.texCoord - params.uvMin) / params.uvRange;
+    packed.texCoord[0] = to_unorm16(uv.x);
+    packed.texCoord[1] = to_unorm16(uv.y);
+
+    glm::vec2 n = oct_encode(vertex.normal);
+    glm::vec2 t = oct_encode(vertex.tangent);
+    packed.normalTangent[0] = to_snorm16(n.x);
+    packed.normalTangent[1] = to_snorm16(n.y);
+    packed.normalTangent[2] = to_snorm16(t.x);
+    packed.normalTangent[3] = to_snorm16(t.y);
+    return packed;
+}
+
+Vertex unpack_vertex(const PackedVertex& packed, const it_PackingParams& params)
+{
+    Vertex vertex{};
+    vertex.pos = params.center + params.extent * glm::vec3(from_snorm16(packed.position[0]), from_snorm16(packed.position[1]), from_snorm16(packed.position[2]));
+    vertex.color = glm::vec3(1.0f);
+    vertex.texCoord = params.uvMin + params.uvRange * glm::vec2(from_unorm16(packed.texCoord[0]), from_unorm16(packed.texCoord[1]));
+    vertex.normal = oct_decode(glm::vec2(from_snorm16(packed.normalTangent[0]), from_snorm16(packed.normalTangent[1])));
+    vertex.tangent = oct_decode(glm::vec2(from_snorm16(packed.normalTangent[2]), from_snorm16(packed.normalTangent[3])));
+    vertex.bitangent = glm::cross(vertex.normal, vertex.tangent) * from_snorm16(packed.position[3]);
+    return vertex;
+}
+
+it_PackingError measure_packing_error(const std::vector<Vertex>& vertices, const std::vector<PackedVertex>& packed, const it_PackingParams& params)
+{
+    it_PackingError error;
+    for (size_t i = 0; i < vertices.size() && i < packed.size(); ++i)
+    {
+        const Vertex& original = vertices[i];
+        Vertex decoded = unpack_vertex(packed[i], params);
+
+        glm::vec3 dp = glm::abs(decoded.pos - original.pos);
+        glm::vec2 duv = glm::abs(decoded.texCoord - original.texCoord);
+        error.position = std::max(error.position, std::max(std::max(dp.x, dp.y), dp.z));
+        error.texCoord = std::max(error.texCoord, std::max(duv.x, duv.y));
+
+        // degenerate input directions (zero or nan) carry no information to lose
+        if (glm::dot(original.normal, original.normal) > 0.0f)
+            error.normalDegrees = std::max(error.normalDegrees, angle_degrees(decoded.normal, original.normal));
+        if (glm::dot(original.tangent, original.tangent) > 0.0f)
+            error.tangentDegrees = std::max(error.tangentDegrees, angle_degrees(decoded.tangent, original.tangent));
+        if (glm::dot(decoded.bitangent, original.bitangent) < 0.0f)
+            error.handednessFlips++;
+    }
+    return error;
+}
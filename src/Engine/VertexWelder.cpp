@@ -0,0 +1,192 @@
+#include "VertexWelder.h"
+
+#include <cstring>
+
+
+#define WELDER_EMPTY 0xFFFFFFFFu
+
+
+static inline uint64_t mix_hash(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline uint64_t hash_corner(int v, int vt, int vn)
+{
+    return mix_hash((static_cast<uint64_t>(static_cast<uint32_t>(v)) << 32 | static_cast<uint32_t>(vt)) ^ (static_cast<uint64_t>(static_cast<uint32_t>(vn)) * 0x9E3779B97F4A7C15ull));
+}
+
+// -0.0f and 0.0f compare equal, so they have to hash the same as well
+static inline uint32_t float_key(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits == 0x80000000u ? 0u : bits;
+}
+
+static inline uint64_t hash_vertex(const Vertex& vertex)
+{
+    uint64_t h = 0;
+    const float values[8] = { vertex.pos.x, vertex.pos.y, vertex.pos.z, vertex.normal.x, vertex.normal.y, vertex.normal.z, vertex.texCoord.x, vertex.texCoord.y };
+    for (float value : values)
+        h = mix_hash(h ^ float_key(value));
+    return h;
+}
+
+static size_t table_capacity(size_t expected)
+{
+    size_t capacity = 64;
+    while (capacity < expected * 2)
+        capacity <<= 1;
+    return capacity;
+}
+
+
+static void corner_table_init(it_CornerTable* table, size_t expected)
+{
+    table->slots.assign(table_capacity(expected), it_CornerTable::Slot{ 0, 0, 0, WELDER_EMPTY });
+    table->count = 0;
+}
+
+static void corner_table_grow(it_CornerTable* table)
+{
+    std::vector<it_CornerTable::Slot> old;
+    old.swap(table->slots);
+    table->slots.assign(old.size() * 2, it_CornerTable::Slot{ 0, 0, 0, WELDER_EMPTY });
+    const size_t mask = table->slots.size() - 1;
+    for (const auto& slot : old)
+    {
+        if (slot.vertex == WELDER_EMPTY)
+            continue;
+        size_t i = hash_corner(slot.v, slot.vt, slot.vn) & mask;
+        while (table->slots[i].vertex != WELDER_EMPTY)
+            i = (i + 1) & mask;
+        table->slots[i] = slot;
+    }
+}
+
+// Returns the slot for the triple, either holding its vertex or empty and ready to be filled
+static it_CornerTable::Slot* corner_table_find(it_CornerTable* table, int v, int vt, int vn)
+{
+    if ((table->count + 1) * 2 > table->slots.size())
+        corner_table_grow(table);
+
+    const size_t mask = table->slots.size() - 1;
+    size_t i = hash_corner(v, vt, vn) & mask;
+    for (;;)
+    {
+        it_CornerTable::Slot* slot = &table->slots[i];
+        if (slot->vertex == WELDER_EMPTY || (slot->v == v && slot->vt == vt && slot->vn == vn))
+            return slot;
+        i = (i + 1) & mask;
+    }
+}
+
+
+static void vertex_table_init(it_VertexTable* table, size_t expected)
+{
+    table->slots.assign(table_capacity(expected), WELDER_EMPTY);
+    table->count = 0;
+}
+
+static void vertex_table_grow(it_VertexTable* table, const std::vector<Vertex>& vertices)
+{
+    std::vector<uint32_t> old;
+    old.swap(table->slots);
+    table->slots.assign(old.size() * 2, WELDER_EMPTY);
+    const size_t mask = table->slots.size() - 1;
+    for (uint32_t index : old)
+    {
+        if (index == WELDER_EMPTY)
+            continue;
+        size_t i = hash_vertex(vertices[index]) & mask;
+        while (table->slots[i] != WELDER_EMPTY)
+            i = (i + 1) & mask;
+        table->slots[i] = index;
+    }
+}
+
+// Looks the candidate up by value and appends it to vertices if no equal vertex exists yet
+static uint32_t vertex_table_insert(it_VertexTable* table, std::vector<Vertex>* vertices, const Vertex& candidate)
+{
+    if ((table->count + 1) * 2 > table->slots.size())
+        vertex_table_grow(table, *vertices);
+
+    const size_t mask = table->slots.size() - 1;
+    size_t i = hash_vertex(candidate) & mask;
+    for (;;)
+    {
+        uint32_t index = table->slots[i];
+        if (index == WELDER_EMPTY)
+            break;
+        if ((*vertices)[index] == candidate)
+            return index;
+        i = (i + 1) & mask;
+    }
+
+    uint32_t index = static_cast<uint32_t>(vertices->size());
+    vertices->push_back(candidate);
+    table->slots[i] = index;
+    table->count++;
+    return index;
+}
+
+
+void weld_obj_vertices(const it_ObjMesh& mesh, std::vector<Vertex>* vertices, std::vector<uint32_t>* indices)
+{
+    const size_t cornerCount = mesh.indices.size();
+
+    // the position count is a good guess for the number of unique vertices on real meshes, both tables grow if not
+    it_CornerTable corners;
+    it_VertexTable values;
+    corner_table_init(&corners, mesh.positions.size() / 3);
+    vertex_table_init(&values, mesh.positions.size() / 3);
+
+    vertices->reserve(vertices->size() + mesh.positions.size() / 3);
+    indices->reserve(indices->size() + cornerCount);
+
+    for (const auto& index : mesh.indices)
+    {
+        it_CornerTable::Slot* slot = corner_table_find(&corners, index.vertex_index, index.texcoord_index, index.normal_index);
+        if (slot->vertex != WELDER_EMPTY)
+        {
+            indices->push_back(slot->vertex);
+            continue;
+        }
+
+        Vertex vertex{};
+
+        vertex.pos = {
+            mesh.positions[3 * index.vertex_index + 0],
+            mesh.positions[3 * index.vertex_index + 1],
+            mesh.positions[3 * index.vertex_index + 2]
+        };
+
+        if (index.normal_index >= 0) {
+            vertex.normal = {
+                mesh.normals[3 * index.normal_index + 0],
+                mesh.normals[3 * index.normal_index + 1],
+                mesh.normals[3 * index.normal_index + 2]
+            };
+        }
+
+        if (index.texcoord_index >= 0) {
+            vertex.texCoord = {
+                mesh.texcoords[2 * index.texcoord_index + 0],
+                1.0f - mesh.texcoords[2 * index.texcoord_index + 1]
+            };
+        }
+
+        vertex.color = { 1.0f, 1.0f, 1.0f };
+
+        uint32_t welded = vertex_table_insert(&values, vertices, vertex);
+        *slot = { index.vertex_index, index.texcoord_index, index.normal_index, welded };
+        corners.count++;
+        indices->push_back(welded);
+    }
+}
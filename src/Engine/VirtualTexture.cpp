@@ -0,0 +1,465 @@
+#include "VirtualTexture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+#include <thread>
+#include <stdexcept>
+
+
+static void setup_levels(uint32_t width, uint32_t height, std::vector<it_VtLevel>* levels)
+{
+    levels->assign(texture_mip_levels(static_cast<int>(width), static_cast<int>(height)), it_VtLevel{});
+    uint32_t firstPage = 0;
+    for (it_VtLevel& level : *levels)
+    {
+        level.width = width;
+        level.height = height;
+        level.pagesX = (width + VT_PAGE_SIZE - 1) / VT_PAGE_SIZE;
+        level.pagesY = (height + VT_PAGE_SIZE - 1) / VT_PAGE_SIZE;
+        level.firstPage = firstPage;
+        firstPage += level.pagesX * level.pagesY;
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+    }
+}
+
+static uint32_t page_count(const std::vector<it_VtLevel>& levels)
+{
+    return levels.back().firstPage + levels.back().pagesX * levels.back().pagesY;
+}
+
+static uint32_t page_level(const it_VirtualTexture* vt, uint32_t page)
+{
+    uint32_t level = 0;
+    while (level + 1 < vt->levels.size() && page >= vt->levels[level + 1].firstPage)
+        level++;
+    return level;
+}
+
+// The page of the next level covering page, VT_INVALID on the last level
+static uint32_t parent_page(const it_VirtualTexture* vt, uint32_t page)
+{
+    const uint32_t level = page_level(vt, page);
+    if (level + 1 >= vt->levels.size())
+        return VT_INVALID;
+    const it_VtLevel& current = vt->levels[level];
+    const it_VtLevel& parent = vt->levels[level + 1];
+    const uint32_t index = page - current.firstPage;
+    // an odd level is one texel wider than twice the next, its last page can map just past the edge
+    const uint32_t x = std::min(index % current.pagesX / 2, parent.pagesX - 1);
+    const uint32_t y = std::min(index / current.pagesX / 2, parent.pagesY - 1);
+    return parent.firstPage + y * parent.pagesX + x;
+}
+
+static bool pinned_level(const it_VtLevel& level)
+{
+    return level.pagesX == 1 && level.pagesY == 1;
+}
+
+static void read_tile(const it_VirtualTexture* vt, uint32_t page, std::vector<uint8_t>* texels)
+{
+    texels->resize(VT_TILE_BYTES);
+    memcpy(texels->data(), vt->file.data + vt->tileOffset + static_cast<uint64_t>(page) * VT_TILE_BYTES, VT_TILE_BYTES);
+}
+
+
+static void lru_unlink(it_VirtualTexture* vt, uint32_t slot)
+{
+    it_VtSlot& s = vt->slots[slot];
+    if (s.prev != VT_INVALID)
+        vt->slots[s.prev].next = s.next;
+    else
+        vt->lruHead = s.next;
+    if (s.next != VT_INVALID)
+        vt->slots[s.next].prev = s.prev;
+    else
+        vt->lruTail = s.prev;
+    s.prev = s.next = VT_INVALID;
+}
+
+static void lru_push_front(it_VirtualTexture* vt, uint32_t slot)
+{
+    it_VtSlot& s = vt->slots[slot];
+    s.prev = VT_INVALID;
+    s.next = vt->lruHead;
+    if (vt->lruHead != VT_INVALID)
+        vt->slots[vt->lruHead].prev = slot;
+    vt->lruHead = slot;
+    if (vt->lruTail == VT_INVALID)
+        vt->lruTail = slot;
+}
+
+static void touch_slot(it_VirtualTexture* vt, uint32_t slot)
+{
+    vt->slots[slot].lastUsed = vt->frame;
+    if (vt->slots[slot].pinned || vt->lruHead == slot)
+        return;
+    lru_unlink(vt, slot);
+    lru_push_front(vt, slot);
+}
+
+// A free tile, else the least recently used one if the current frame did not touch it
+static uint32_t take_slot(it_VirtualTexture* vt)
+{
+    if (!vt->freeSlots.empty())
+    {
+        uint32_t slot = vt->freeSlots.back();
+        vt->freeSlots.pop_back();
+        return slot;
+    }
+    const uint32_t slot = vt->lruTail;
+    if (slot == VT_INVALID || vt->slots[slot].lastUsed >= vt->frame)
+        return VT_INVALID;
+
+    const uint32_t page = vt->slots[slot].page;
+    vt->pageState[page] = VT_PAGE_ABSENT;
+    vt->pageSlot[page] = VT_INVALID;
+    lru_unlink(vt, slot);
+    vt->slots[slot].page = VT_INVALID;
+    vt->stats.evictions++;
+    return slot;
+}
+
+static void request_page(it_VirtualTexture* vt, uint32_t page)
+{
+    vt->pageState[page] = VT_PAGE_LOADING;
+    vt->pending++;
+    const uint64_t sequence = vt->sequence++;
+    if (!vt->asyncLoads)
+    {
+        vt->queued.push_back(it_VtLoad{ page, sequence, {} });
+        return;
+    }
+    job_run([vt, page, sequence]() {
+        it_VtLoad load{ page, sequence, {} };
+        read_tile(vt, page, &load.texels);
+        std::lock_guard<std::mutex> lock(vt->loadMutex);
+        vt->loaded.push_back(std::move(load));
+    }, &vt->loads);
+}
+
+static void rebuild_page_table(it_VirtualTexture* vt)
+{
+    vt->pageTable.assign(vt->pageState.size(), 0);
+    for (uint32_t level = static_cast<uint32_t>(vt->levels.size()); level-- > 0;)
+    {
+        const it_VtLevel& l = vt->levels[level];
+        for (uint32_t page = l.firstPage; page < l.firstPage + l.pagesX * l.pagesY; page++)
+        {
+            const uint32_t slot = vt->pageSlot[page];
+            if (slot != VT_INVALID)
+                vt->pageTable[page] = vt_page_entry(slot % vt->cacheColumns, slot / vt->cacheColumns, level);
+            else if (level + 1 < vt->levels.size())
+                vt->pageTable[page] = vt->pageTable[parent_page(vt, page)];
+        }
+    }
+    vt->pageTableDirty = false;
+}
+
+
+bool write_virtual_texture(const std::string& path, const it_MipChain* chain, VkFormat format, const void* tag, uint32_t tagSize)
+{
+    const it_MipLevel& top = chain->levels[0];
+    std::vector<it_VtLevel> levels;
+    setup_levels(top.width, top.height, &levels);
+    if (levels.size() != chain->levels.size() || tagSize > VT_FILE_ALIGNMENT - sizeof(it_VtFileHeader))
+        return false;
+
+    it_VtFileHeader header{};
+    header.magic = VT_FILE_MAGIC;
+    header.version = VT_FILE_VERSION;
+    header.format = static_cast<uint32_t>(format);
+    header.width = top.width;
+    header.height = top.height;
+    header.levelCount = static_cast<uint32_t>(levels.size());
+    header.pageCount = page_count(levels);
+    header.tagSize = tagSize;
+    header.tileOffset = VT_FILE_ALIGNMENT;
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    const std::string tmpPath = path + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream f(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!f.is_open())
+            return false;
+        std::vector<uint8_t> padding(VT_FILE_ALIGNMENT - sizeof(header), 0);
+        if (tagSize)
+            memcpy(padding.data(), tag, tagSize);
+        f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        f.write(reinterpret_cast<const char*>(padding.data()), padding.size());
+
+        // every tile repeats VT_PAGE_BORDER texels of its neighbours, the texture's own edges are clamped
+        std::vector<uint8_t> tile(VT_TILE_BYTES);
+        for (size_t i = 0; i < levels.size(); i++)
+        {
+            const it_VtLevel& level = levels[i];
+            const uint8_t* pixels = chain->pixels.data() + chain->levels[i].offset;
+            for (uint32_t py = 0; py < level.pagesY; py++)
+            {
+                for (uint32_t px = 0; px < level.pagesX; px++)
+                {
+                    for (int ty = 0; ty < VT_TILE_SIZE; ty++)
+                    {
+                        const int64_t sy = std::clamp<int64_t>(static_cast<int64_t>(py) * VT_PAGE_SIZE + ty - VT_PAGE_BORDER, 0, level.height - 1);
+                        for (int tx = 0; tx < VT_TILE_SIZE; tx++)
+                        {
+                            const int64_t sx = std::clamp<int64_t>(static_cast<int64_t>(px) * VT_PAGE_SIZE + tx - VT_PAGE_BORDER, 0, level.width - 1);
+                            memcpy(&tile[(static_cast<size_t>(ty) * VT_TILE_SIZE + tx) * 4], pixels + (sy * level.width + sx) * 4, 4);
+                        }
+                    }
+                    f.write(reinterpret_cast<const char*>(tile.data()), tile.size());
+                }
+            }
+        }
+        if (!f.good())
+        {
+            f.close();
+            std::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+    }
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec)
+    {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool read_virtual_texture_tag(const std::string& path, std::string* tag)
+{
+    it_VtFileHeader header{};
+    std::ifstream f(path, std::ios::binary);
+    if (!f.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != VT_FILE_MAGIC || header.version != VT_FILE_VERSION
+        || header.tagSize > VT_FILE_ALIGNMENT - sizeof(header))
+        return false;
+    tag->resize(header.tagSize);
+    return header.tagSize == 0 || static_cast<bool>(f.read(&(*tag)[0], header.tagSize));
+}
+
+void open_virtual_texture(const std::string& path, uint32_t slotCount, it_VirtualTexture* vt)
+{
+    if (!map_file(path, &vt->file))
+        throw std::runtime_error("ERROR: failed to open virtual texture " + path + "!");
+
+    it_VtFileHeader header{};
+    bool valid = vt->file.size >= sizeof(header);
+    if (valid)
+    {
+        memcpy(&header, vt->file.data, sizeof(header));
+        valid = header.magic == VT_FILE_MAGIC && header.version == VT_FILE_VERSION && header.width > 0 && header.height > 0
+            && (header.format == VK_FORMAT_R8G8B8A8_SRGB || header.format == VK_FORMAT_R8G8B8A8_UNORM);
+    }
+    if (valid)
+    {
+        setup_levels(header.width, header.height, &vt->levels);
+        valid = header.levelCount == vt->levels.size() && header.pageCount == page_count(vt->levels)
+            && header.tileOffset + static_cast<uint64_t>(header.pageCount) * VT_TILE_BYTES <= vt->file.size;
+    }
+    if (!valid)
+    {
+        unmap_file(&vt->file);
+        throw std::runtime_error("ERROR: " + path + " is not a virtual texture!");
+    }
+
+    uint32_t pinned = 0;
+    for (const it_VtLevel& level : vt->levels)
+        pinned += pinned_level(level) ? 1 : 0;
+    vt->cacheColumns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(slotCount))));
+    if (slotCount <= pinned || vt->cacheColumns > 256)
+    {
+        unmap_file(&vt->file);
+        throw std::runtime_error("ERROR: a cache of " + std::to_string(slotCount) + " tiles does not suit " + path + "!");
+    }
+
+    vt->format = static_cast<VkFormat>(header.format);
+    vt->width = header.width;
+    vt->height = header.height;
+    vt->tileOffset = header.tileOffset;
+    vt->pageState.assign(header.pageCount, VT_PAGE_ABSENT);
+    vt->pageSlot.assign(header.pageCount, VT_INVALID);
+    vt->pageFrame.assign(header.pageCount, UINT64_MAX);
+    vt->pageHits.assign(header.pageCount, 0);
+    vt->slots.assign(slotCount, it_VtSlot{});
+    vt->freeSlots.clear();
+    for (uint32_t slot = slotCount; slot-- > 0;)
+        vt->freeSlots.push_back(slot);  // handed out from slot 0 up
+    vt->lruHead = vt->lruTail = VT_INVALID;
+    vt->frame = 0;
+    vt->sequence = 0;
+    vt->pending = 0;
+    vt->queued.clear();
+    vt->loaded.clear();
+    vt->stats = it_VtStats{};
+    vt->asyncLoads = job_system_running();
+    vt->pageTableDirty = true;
+
+    for (const it_VtLevel& level : vt->levels)
+    {
+        if (pinned_level(level))
+            request_page(vt, level.firstPage);
+    }
+}
+
+void close_virtual_texture(it_VirtualTexture* vt)
+{
+    if (vt->asyncLoads)
+        job_wait(&vt->loads);
+    unmap_file(&vt->file);
+    vt->levels.clear();
+    vt->pageState.clear();
+    vt->pageSlot.clear();
+    vt->pageFrame.clear();
+    vt->pageHits.clear();
+    vt->pageTable.clear();
+    vt->slots.clear();
+    vt->freeSlots.clear();
+    vt->queued.clear();
+    vt->loaded.clear();
+}
+
+uint32_t vt_feedback_entry(const it_VirtualTexture* vt, float u, float v, float lod)
+{
+    const uint32_t level = static_cast<uint32_t>(std::clamp(static_cast<int>(std::floor(lod)), 0, static_cast<int>(vt->levels.size()) - 1));
+    const it_VtLevel& l = vt->levels[level];
+    u -= std::floor(u);
+    v -= std::floor(v);
+    const uint32_t x = std::min(static_cast<uint32_t>(u * l.width) / VT_PAGE_SIZE, l.pagesX - 1);
+    const uint32_t y = std::min(static_cast<uint32_t>(v * l.height) / VT_PAGE_SIZE, l.pagesY - 1);
+    return vt_pack_page(level, x, y);
+}
+
+void vt_feedback(it_VirtualTexture* vt, const uint32_t* entries, size_t count, uint64_t frame)
+{
+    vt->frame = frame;
+
+    // distinct pages in the order they first appear, with their sample counts
+    std::vector<uint32_t> touched;
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint32_t entry = entries[i];
+        if (entry == VT_FEEDBACK_NONE)
+            continue;
+        const uint32_t level = entry >> 28;
+        if (level >= vt->levels.size())
+            continue;
+        vt->stats.feedbackEntries++;
+        const it_VtLevel& l = vt->levels[level];
+        const uint32_t x = std::min(entry & 0x3FFF, l.pagesX - 1), y = std::min(entry >> 14 & 0x3FFF, l.pagesY - 1);
+        const uint32_t page = l.firstPage + y * l.pagesX + x;
+        if (vt->pageFrame[page] != frame)
+        {
+            vt->pageFrame[page] = frame;
+            vt->pageHits[page] = 0;
+            touched.push_back(page);
+        }
+        vt->pageHits[page]++;
+    }
+    vt->stats.pagesTouched += touched.size();
+
+    // a missing page is drawn from its nearest resident ancestor, which must stay, and the ancestors in between come
+    // in first so the picture sharpens level by level
+    std::vector<uint32_t> missing;
+    for (uint32_t page : touched)
+    {
+        if (vt->pageState[page] == VT_PAGE_RESIDENT)
+        {
+            vt->stats.hits++;
+            touch_slot(vt, vt->pageSlot[page]);
+            continue;
+        }
+        vt->stats.misses++;
+        for (uint32_t p = page; p != VT_INVALID; p = parent_page(vt, p))
+        {
+            if (vt->pageState[p] == VT_PAGE_RESIDENT)
+            {
+                touch_slot(vt, vt->pageSlot[p]);
+                break;
+            }
+            if (p != page)
+            {
+                if (vt->pageFrame[p] != frame)
+                {
+                    vt->pageFrame[p] = frame;
+                    vt->pageHits[p] = 0;
+                }
+                vt->pageHits[p] += vt->pageHits[page];
+            }
+            if (vt->pageState[p] == VT_PAGE_ABSENT)
+                missing.push_back(p);
+        }
+    }
+
+    std::sort(missing.begin(), missing.end());
+    missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+    std::sort(missing.begin(), missing.end(), [vt](uint32_t a, uint32_t b) {
+        const uint32_t levelA = page_level(vt, a), levelB = page_level(vt, b);
+        if (levelA != levelB)
+            return levelA > levelB;
+        if (vt->pageHits[a] != vt->pageHits[b])
+            return vt->pageHits[a] > vt->pageHits[b];
+        return a < b;
+    });
+    for (uint32_t page : missing)
+    {
+        if (vt->pending >= VT_MAX_PENDING_LOADS)
+        {
+            vt->stats.dropped++;
+            continue;
+        }
+        request_page(vt, page);
+    }
+}
+
+void vt_update(it_VirtualTexture* vt, uint32_t maxUploads, std::vector<it_VtUpload>* uploads)
+{
+    uploads->clear();
+    if (vt->asyncLoads)
+    {
+        std::lock_guard<std::mutex> lock(vt->loadMutex);
+        for (it_VtLoad& load : vt->loaded)
+            vt->queued.push_back(std::move(load));
+        vt->loaded.clear();
+    }
+    std::sort(vt->queued.begin(), vt->queued.end(), [](const it_VtLoad& a, const it_VtLoad& b) { return a.sequence < b.sequence; });
+
+    size_t placed = 0;
+    for (; placed < vt->queued.size() && uploads->size() < maxUploads; placed++)
+    {
+        const uint32_t slot = take_slot(vt);
+        if (slot == VT_INVALID)
+            break;  // every tile is in use this frame, the rest waits
+
+        it_VtLoad& load = vt->queued[placed];
+        if (load.texels.empty())
+            read_tile(vt, load.page, &load.texels);
+        it_VtSlot& s = vt->slots[slot];
+        s.page = load.page;
+        s.lastUsed = vt->frame;
+        s.pinned = pinned_level(vt->levels[page_level(vt, load.page)]);
+        if (!s.pinned)
+            lru_push_front(vt, slot);
+        vt->pageState[load.page] = VT_PAGE_RESIDENT;
+        vt->pageSlot[load.page] = slot;
+        vt->pending--;
+        vt->stats.loads++;
+        vt->pageTableDirty = true;
+        uploads->push_back(it_VtUpload{ slot, load.page, std::move(load.texels) });
+    }
+    vt->queued.erase(vt->queued.begin(), vt->queued.begin() + placed);
+
+    if (vt->pageTableDirty)
+        rebuild_page_table(vt);
+}
+
+void vt_slot_origin(const it_VirtualTexture* vt, uint32_t slot, uint32_t* x, uint32_t* y)
+{
+    *x = slot % vt->cacheColumns * VT_TILE_SIZE;
+    *y = slot / vt->cacheColumns * VT_TILE_SIZE;
+}
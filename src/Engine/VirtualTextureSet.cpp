@@ -0,0 +1,475 @@
+#include "VirtualTextureSet.h"
+#include "TextureCook.h"
+#include "DescriptorSet.h"
+#include "RangeAllocator.h"
+#include "Buffer.h"
+#include "Image.h"
+
+#include <array>
+#include <mutex>
+#include <cstring>
+#include <stdexcept>
+
+#include <tinylogger.h>
+
+#define MAX_FRAMES_IN_FLIGHT 2
+
+#define VT_INFO_BYTES (VT_MAX_TEXTURES * sizeof(it_VtShaderInfo))
+#define VT_TABLE_BYTES (VT_INFO_BYTES + VT_PAGE_TABLE_CAPACITY * sizeof(uint32_t))
+#define VT_FEEDBACK_BYTES (VT_FEEDBACK_WIDTH * VT_FEEDBACK_HEIGHT * 2 * sizeof(uint32_t))
+#define VT_STAGING_BYTES (VT_MAX_UPLOADS * VT_TILE_BYTES)
+
+
+struct it_VtEntry
+{
+    std::string path;
+    uint32_t refCount = 0;
+    it_VirtualTexture vt;
+
+    VkImage cacheImage = VK_NULL_HANDLE;
+    it_Allocation cacheMemory;
+    VkImageView cacheView = VK_NULL_HANDLE;
+    uint32_t cacheTexture = BINDLESS_INVALID;
+    bool cacheWritten = false;      // out of VK_IMAGE_LAYOUT_UNDEFINED
+
+    uint64_t pageTableOffset = 0;   // in entries
+    uint32_t staleTables = 0;       // bit per frame whose page table region misses the latest vt_update
+    std::vector<it_VtUpload> uploads;  // taken by begin_frame, copied by the next record_virtual_texture_uploads
+    std::vector<uint32_t> feedback;    // this entry's part of the frame's feedback
+};
+
+struct it_VirtualTextureSet
+{
+    VkDevice device = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+    it_BindlessSet* bindless = nullptr;
+
+    // one region per frame in flight in each
+    VkBuffer tableBuffer = VK_NULL_HANDLE;
+    it_Allocation tableMemory;
+    VkDeviceSize tableStride = 0;
+    VkBuffer feedbackBuffer = VK_NULL_HANDLE;
+    it_Allocation feedbackMemory;
+    VkDeviceSize feedbackStride = 0;
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    it_Allocation stagingMemory;
+
+    std::mutex mutex;  // guards everything below and the page table regions
+    it_VtEntry* entries[VT_MAX_TEXTURES] = {};
+    it_RangeAllocator tableRanges;
+    uint32_t nextUpdate = 0;     // entry vt_update starts with, so no virtual texture starves the others of uploads
+    uint32_t pendingUploads = 0;
+};
+
+static it_VirtualTextureSet s_vt;
+
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Host cached memory makes reading the feedback back fast, coherent keeps the reads free of invalidates
+static VkMemoryPropertyFlags feedback_memory_properties(VkPhysicalDevice physicalDevice)
+{
+    const VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    {
+        if ((memoryProperties.memoryTypes[i].propertyFlags & cached) == cached)
+            return cached;
+    }
+    return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+static uint8_t* table_region(uint32_t frame)
+{
+    return static_cast<uint8_t*>(s_vt.tableMemory.mapped) + s_vt.tableStride * frame;
+}
+
+static uint32_t* feedback_region(uint32_t frame)
+{
+    return reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(s_vt.feedbackMemory.mapped) + s_vt.feedbackStride * frame);
+}
+
+static void write_shader_info(uint32_t index, const it_VtEntry* entry)
+{
+    it_VtShaderInfo info{};
+    info.width = entry->vt.width;
+    info.height = entry->vt.height;
+    info.levelCount = static_cast<uint32_t>(entry->vt.levels.size());
+    info.cacheTexture = entry->cacheTexture;
+    info.cacheColumns = entry->vt.cacheColumns;
+    info.pageTableOffset = static_cast<uint32_t>(entry->pageTableOffset);
+    for (size_t level = 0; level < entry->vt.levels.size(); level++)
+    {
+        info.levels[level][0] = entry->vt.levels[level].pagesX;
+        info.levels[level][1] = entry->vt.levels[level].pagesY;
+        info.levels[level][2] = entry->vt.levels[level].firstPage;
+    }
+    for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+    {
+        memcpy(table_region(frame) + index * sizeof(it_VtShaderInfo), &info, sizeof(info));
+        // nothing resident yet, the shader draws white until the first page table arrives
+        memset(table_region(frame) + VT_INFO_BYTES + entry->pageTableOffset * sizeof(uint32_t), 0, entry->vt.pageState.size() * sizeof(uint32_t));
+    }
+}
+
+// Without the lock: closing waits for the loads, and job_wait runs other jobs meanwhile
+static void destroy_entry(it_VtEntry* entry)
+{
+    close_virtual_texture(&entry->vt);
+    if (entry->cacheTexture != BINDLESS_INVALID)
+        bindless_remove_texture(s_vt.bindless, entry->cacheTexture);
+    if (entry->cacheView != VK_NULL_HANDLE)
+        vkDestroyImageView(s_vt.device, entry->cacheView, nullptr);
+    if (entry->cacheImage != VK_NULL_HANDLE)
+        vkDestroyImage(s_vt.device, entry->cacheImage, nullptr);
+    free_device_memory(&entry->cacheMemory);
+    delete entry;
+}
+
+// Opens path's virtual texture and its cache image, nullptr if the file does not suit
+static it_VtEntry* create_entry(const std::string& path)
+{
+    it_VtEntry* entry = new it_VtEntry;
+    entry->path = path;
+    entry->refCount = 1;
+    try
+    {
+        open_virtual_texture(virtual_texture_path(path), VT_CACHE_TILES, &entry->vt);
+    }
+    catch (const std::exception& e)
+    {
+#ifndef ENGINE_DISABLE_LOGGING
+        tlog::warning(std::string("Virtual textures: ") + e.what());
+#endif
+        delete entry;
+        return nullptr;
+    }
+    if (entry->vt.levels.size() > VT_MAX_LEVELS)
+    {
+#ifndef ENGINE_DISABLE_LOGGING
+        tlog::warning("Virtual textures: " + path + " has more than " + std::to_string(VT_MAX_LEVELS) + " levels");
+#endif
+        destroy_entry(entry);
+        return nullptr;
+    }
+
+    try
+    {
+        const uint32_t size = entry->vt.cacheColumns * VT_TILE_SIZE;
+        createImage(&s_vt.device, size, size, 1, VK_SAMPLE_COUNT_1_BIT, entry->vt.format, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, entry->cacheImage, entry->cacheMemory);
+        entry->cacheView = createImageView(s_vt.device, entry->cacheImage, entry->vt.format, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+        entry->cacheTexture = bindless_add_texture(s_vt.bindless, entry->cacheView, s_vt.sampler);
+    }
+    catch (...)
+    {
+        destroy_entry(entry);
+        throw;
+    }
+    return entry;
+}
+
+
+void init_virtual_textures(VkDevice device, VkPhysicalDevice physicalDevice, it_BindlessSet* bindless)
+{
+    s_vt.device = device;
+    s_vt.bindless = bindless;
+    s_vt.nextUpdate = 0;
+    s_vt.pendingUploads = 0;
+    range_allocator_init(&s_vt.tableRanges, VT_PAGE_TABLE_CAPACITY);
+
+    // the tiles carry their own borders, so the cache is sampled bilinear within one tile and never wraps
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = 0.0f;
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &s_vt.sampler) != VK_SUCCESS)
+        throw std::runtime_error("ERROR: failed to create virtual texture sampler!");
+
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    const VkDeviceSize alignment = properties.limits.minStorageBufferOffsetAlignment;
+    s_vt.tableStride = align_up(VT_TABLE_BYTES, alignment);
+    s_vt.feedbackStride = align_up(VT_FEEDBACK_BYTES, alignment);
+
+    create_buffer(&s_vt.device, s_vt.tableStride * MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, s_vt.tableBuffer, s_vt.tableMemory);
+    create_buffer(&s_vt.device, s_vt.feedbackStride * MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        feedback_memory_properties(physicalDevice), s_vt.feedbackBuffer, s_vt.feedbackMemory);
+    create_buffer(&s_vt.device, VT_STAGING_BYTES * MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, s_vt.stagingBuffer, s_vt.stagingMemory);
+
+    memset(s_vt.tableMemory.mapped, 0, s_vt.tableStride * MAX_FRAMES_IN_FLIGHT);
+    memset(s_vt.feedbackMemory.mapped, 0xFF, s_vt.feedbackStride * MAX_FRAMES_IN_FLIGHT);
+    bindless_set_virtual_textures(bindless, s_vt.tableBuffer, s_vt.tableStride, VT_TABLE_BYTES, s_vt.feedbackBuffer, s_vt.feedbackStride, VT_FEEDBACK_BYTES);
+}
+
+void destroy_virtual_textures()
+{
+    std::vector<it_VtEntry*> leftovers;
+    {
+        std::lock_guard<std::mutex> lock(s_vt.mutex);
+        for (it_VtEntry*& entry : s_vt.entries)
+        {
+            if (entry)
+                leftovers.push_back(entry);
+            entry = nullptr;
+        }
+    }
+#ifndef ENGINE_DISABLE_LOGGING
+    if (!leftovers.empty())
+        tlog::warning("Virtual textures: " + std::to_string(leftovers.size()) + " virtual texture(s) still referenced");
+#endif
+    for (it_VtEntry* entry : leftovers)
+        destroy_entry(entry);
+
+    vkDestroyBuffer(s_vt.device, s_vt.tableBuffer, nullptr);
+    free_device_memory(&s_vt.tableMemory);
+    vkDestroyBuffer(s_vt.device, s_vt.feedbackBuffer, nullptr);
+    free_device_memory(&s_vt.feedbackMemory);
+    vkDestroyBuffer(s_vt.device, s_vt.stagingBuffer, nullptr);
+    free_device_memory(&s_vt.stagingMemory);
+    vkDestroySampler(s_vt.device, s_vt.sampler, nullptr);
+    s_vt.tableBuffer = s_vt.feedbackBuffer = s_vt.stagingBuffer = VK_NULL_HANDLE;
+    s_vt.sampler = VK_NULL_HANDLE;
+    s_vt.device = VK_NULL_HANDLE;
+    s_vt.bindless = nullptr;
+}
+
+bool virtual_texture_available(const std::string& path)
+{
+    return s_vt.device != VK_NULL_HANDLE && virtual_texture_current(path);
+}
+
+uint32_t virtual_texture_acquire(const std::string& path)
+{
+    if (!virtual_texture_available(path))
+        return VT_INVALID;
+    {
+        std::lock_guard<std::mutex> lock(s_vt.mutex);
+        for (uint32_t i = 0; i < VT_MAX_TEXTURES; i++)
+        {
+            if (s_vt.entries[i] && s_vt.entries[i]->path == path)
+            {
+                s_vt.entries[i]->refCount++;
+                return i;
+            }
+        }
+    }
+
+    // opened without the lock like the texture cache uploads, so frames go on meanwhile
+    it_VtEntry* entry = create_entry(path);
+    if (!entry)
+        return VT_INVALID;
+
+    uint32_t index = VT_INVALID;
+    bool shared = false;
+    {
+        std::lock_guard<std::mutex> lock(s_vt.mutex);
+        uint32_t freeIndex = VT_INVALID;
+        for (uint32_t i = 0; i < VT_MAX_TEXTURES && index == VT_INVALID; i++)
+        {
+            if (s_vt.entries[i] && s_vt.entries[i]->path == path)
+            {
+                // another thread opened it meanwhile
+                s_vt.entries[i]->refCount++;
+                index = i;
+                shared = true;
+            }
+            else if (!s_vt.entries[i] && freeIndex == VT_INVALID)
+                freeIndex = i;
+        }
+        if (!shared && freeIndex != VT_INVALID && range_alloc(&s_vt.tableRanges, entry->vt.pageState.size(), &entry->pageTableOffset))
+        {
+            index = freeIndex;
+            s_vt.entries[index] = entry;
+            entry->staleTables = (1u << MAX_FRAMES_IN_FLIGHT) - 1;
+            write_shader_info(index, entry);
+        }
+    }
+    if (index == VT_INVALID || shared)
+    {
+#ifndef ENGINE_DISABLE_LOGGING
+        if (index == VT_INVALID)
+            tlog::warning("Virtual textures: no room for " + path + ", it is loaded whole");
+#endif
+        destroy_entry(entry);
+    }
+    return index;
+}
+
+void virtual_texture_release(uint32_t index)
+{
+    if (index == VT_INVALID)
+        return;
+    it_VtEntry* entry;
+    {
+        std::lock_guard<std::mutex> lock(s_vt.mutex);
+        entry = s_vt.entries[index];
+        if (--entry->refCount > 0)
+            return;
+        s_vt.entries[index] = nullptr;
+        s_vt.pendingUploads -= static_cast<uint32_t>(entry->uploads.size());
+        range_free(&s_vt.tableRanges, entry->pageTableOffset, entry->vt.pageState.size());
+    }
+    destroy_entry(entry);
+}
+
+void virtual_textures_begin_frame(uint32_t frame, uint64_t frameNumber)
+{
+    std::lock_guard<std::mutex> lock(s_vt.mutex);
+
+    // uvec2 per cell: the virtual texture and the page, all ones where no sample asked
+    uint32_t* feedback = feedback_region(frame);
+    for (it_VtEntry* entry : s_vt.entries)
+    {
+        if (entry)
+            entry->feedback.clear();
+    }
+    for (size_t cell = 0; cell < VT_FEEDBACK_WIDTH * VT_FEEDBACK_HEIGHT; cell++)
+    {
+        const uint32_t index = feedback[cell * 2];
+        if (index < VT_MAX_TEXTURES && s_vt.entries[index])
+            s_vt.entries[index]->feedback.push_back(feedback[cell * 2 + 1]);
+    }
+    memset(feedback, 0xFF, VT_FEEDBACK_BYTES);
+
+    std::vector<it_VtUpload> uploads;
+    for (uint32_t n = 0; n < VT_MAX_TEXTURES; n++)
+    {
+        const uint32_t index = (s_vt.nextUpdate + n) % VT_MAX_TEXTURES;
+        it_VtEntry* entry = s_vt.entries[index];
+        if (!entry)
+            continue;
+        vt_feedback(&entry->vt, entry->feedback.data(), entry->feedback.size(), frameNumber);
+        vt_update(&entry->vt, VT_MAX_UPLOADS - s_vt.pendingUploads, &uploads);
+        if (!uploads.empty())
+        {
+            s_vt.pendingUploads += static_cast<uint32_t>(uploads.size());
+            for (it_VtUpload& upload : uploads)
+                entry->uploads.push_back(std::move(upload));
+            entry->staleTables = (1u << MAX_FRAMES_IN_FLIGHT) - 1;
+        }
+
+        // the frames in flight keep their own page table, which points at tiles their copies put in place
+        if ((entry->staleTables & (1u << frame)) && entry->vt.pageTable.size() == entry->vt.pageState.size())
+        {
+            memcpy(table_region(frame) + VT_INFO_BYTES + entry->pageTableOffset * sizeof(uint32_t), entry->vt.pageTable.data(),
+                entry->vt.pageTable.size() * sizeof(uint32_t));
+            entry->staleTables &= ~(1u << frame);
+        }
+    }
+    s_vt.nextUpdate = (s_vt.nextUpdate + 1) % VT_MAX_TEXTURES;
+}
+
+void record_virtual_texture_uploads(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+    std::lock_guard<std::mutex> lock(s_vt.mutex);
+    if (s_vt.pendingUploads == 0)
+        return;
+
+    std::vector<VkImageMemoryBarrier> toTransfer, toShader;
+    for (it_VtEntry* entry : s_vt.entries)
+    {
+        if (!entry || entry->uploads.empty())
+            continue;
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = entry->cacheImage;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = 1;
+
+        // evicted tiles may still be sampled by the frames submitted before, the copies wait for them
+        barrier.oldLayout = entry->cacheWritten ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        toTransfer.push_back(barrier);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        toShader.push_back(barrier);
+    }
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+        static_cast<uint32_t>(toTransfer.size()), toTransfer.data());
+
+    // staged now rather than in begin_frame, a frame that returns before recording keeps its uploads for the next one
+    uint8_t* staging = static_cast<uint8_t*>(s_vt.stagingMemory.mapped) + VT_STAGING_BYTES * frame;
+    VkDeviceSize offset = VT_STAGING_BYTES * frame;
+    for (it_VtEntry* entry : s_vt.entries)
+    {
+        if (!entry || entry->uploads.empty())
+            continue;
+        for (const it_VtUpload& upload : entry->uploads)
+        {
+            memcpy(staging, upload.texels.data(), VT_TILE_BYTES);
+            uint32_t x, y;
+            vt_slot_origin(&entry->vt, upload.slot, &x, &y);
+
+            VkBufferImageCopy region{};
+            region.bufferOffset = offset;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = { static_cast<int32_t>(x), static_cast<int32_t>(y), 0 };
+            region.imageExtent = { VT_TILE_SIZE, VT_TILE_SIZE, 1 };
+            vkCmdCopyBufferToImage(commandBuffer, s_vt.stagingBuffer, entry->cacheImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+            staging += VT_TILE_BYTES;
+            offset += VT_TILE_BYTES;
+        }
+        entry->uploads.clear();
+        entry->cacheWritten = true;
+    }
+    s_vt.pendingUploads = 0;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
+        static_cast<uint32_t>(toShader.size()), toShader.data());
+}
+
+void record_virtual_texture_feedback(VkCommandBuffer commandBuffer)
+{
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+it_VtSetStats virtual_texture_stats()
+{
+    std::lock_guard<std::mutex> lock(s_vt.mutex);
+    it_VtSetStats stats;
+    for (const it_VtEntry* entry : s_vt.entries)
+    {
+        if (!entry)
+            continue;
+        const uint64_t size = entry->vt.cacheColumns * VT_TILE_SIZE;
+        stats.textures++;
+        stats.references += entry->refCount;
+        stats.cacheBytes += size * size * 4;
+        const it_VtStats& pages = entry->vt.stats;
+        stats.pages.feedbackEntries += pages.feedbackEntries;
+        stats.pages.pagesTouched += pages.pagesTouched;
+        stats.pages.hits += pages.hits;
+        stats.pages.misses += pages.misses;
+        stats.pages.loads += pages.loads;
+        stats.pages.evictions += pages.evictions;
+        stats.pages.dropped += pages.dropped;
+    }
+    return stats;
+}
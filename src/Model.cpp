@@ -1,13 +1,33 @@
 #include <Model.h>
 
-#define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
 #include <assimp/Importer.hpp>
 
 #include "Texture.h"
+#include "TextureCache.h"
+#include "VirtualTextureSet.h"
 #include "ResourceBuffer.h"
 #include "DescriptorSet.h"
+#include "MeshCache.h"
+#include "ObjParser.h"
+#include "VertexWelder.h"
+#include "MeshProcessing.h"
+#include "VertexPacking.h"
+#include "Parallel.h"
+
+#include <chrono>
+#include <unordered_map>
+
+
+// Screen space error in pixels a level may introduce before a finer level is drawn
+#define LOD_PIXEL_ERROR 1.0f
+// The error has to move this fraction past LOD_PIXEL_ERROR before the level changes, stops popping at the threshold
+#define LOD_HYSTERESIS 0.25f
+// Simplification stops before a collapse moves the surface further than this fraction of the bounds diagonal
+#define LOD_MAX_ERROR 0.05f
+// A level keeping more than this fraction of the previous level's triangles is not worth its index memory
+#define LOD_MIN_REDUCTION 0.85f
 
 
 void init_model(Model* cModel, std::string MODEL_PATH, std::string TEXTURE_PATH)
@@ -17,153 +37,206 @@ void init_model(Model* cModel, std::string MODEL_PATH, std::string TEXTURE_PATH)
     cModel->NORMAL_PATH = std::string("textures/neutral_normal.jpg");
 }
 
-void cleanup_model(VkDevice* device, Model* cModel)
+void cleanup_model(it_GeometryHeap* geometryHeap, it_BindlessSet* bindless, Model* cModel)
 {
-   
-    for (auto& ubo : cModel->uniformBuffers)
-        vkDestroyBuffer(*device, ubo, nullptr);
-    for (auto& mem : cModel->uniformBuffersMemory)
-        vkFreeMemory(*device, mem, nullptr);
-    vkDestroyDescriptorPool(*device, cModel->descriptorPool, nullptr);
-    if (!cModel->NORMAL_PATH.empty())
-    {
-        vkDestroySampler(*device, cModel->normalSampler, nullptr);
-        vkDestroyImageView(*device, cModel->normalImageView, nullptr);
-        vkDestroyImage(*device, cModel->normalImage, nullptr);
-        vkFreeMemory(*device, cModel->normalImageMemory, nullptr);
-        vkDestroyDescriptorSetLayout(*device, cModel->descriptorSetLayout, nullptr);
-    }
-
-    vkDestroySampler(*device, cModel->textureSampler, nullptr);
-    vkDestroyImageView(*device, cModel->textureImageView, nullptr);
-    vkDestroyImage(*device, cModel->textureImage, nullptr);
-    vkFreeMemory(*device, cModel->textureImageMemory, nullptr);
-    vkDestroyBuffer(*device, cModel->vertexBuffer, nullptr);
+    bindless_remove_object(bindless, cModel->objectIndex);
 
-    vkFreeMemory(*device, cModel->vertexBufferMemory, nullptr);
-    vkDestroyBuffer(*device, cModel->indexBuffer, nullptr);
-    vkFreeMemory(*device, cModel->indexBufferMemory, nullptr);
+    // the last model using an image evicts it
+    texture_cache_release(cModel->normal);
+    texture_cache_release(cModel->texture);
+    virtual_texture_release(cModel->virtualTexture);
 
-    
+    geometry_heap_release(geometryHeap, cModel->baseVertex, static_cast<uint32_t>(cModel->vertices.size()), cModel->baseIndex, static_cast<uint32_t>(cModel->indices.size()));
 
-    free(cModel);
+    delete cModel;
 }
 
 
-void load_model(Model* cModel) {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string err;
-    
+static void compute_model_bounds(Model* cModel)
+{
+    if (cModel->vertices.empty())
+        return;
 
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, (cModel->baseDir + cModel->MODEL_PATH).c_str(), "res/models/")) {
-        throw std::runtime_error(err);
+    cModel->boundsMin = cModel->vertices[0].pos;
+    cModel->boundsMax = cModel->vertices[0].pos;
+    for (const auto& vertex : cModel->vertices)
+    {
+        cModel->boundsMin = glm::min(cModel->boundsMin, vertex.pos);
+        cModel->boundsMax = glm::max(cModel->boundsMax, vertex.pos);
     }
-  
-    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-    std::vector<glm::vec3> tangents{};
-    std::vector<glm::vec3> bitangents{};
-
+}
 
-    static const int N = static_cast<const int>(shapes.size());
-#ifndef ENGINE_DISABLE_LOGGING
-    auto progress = tlog::progress(N);
-#endif
-    int prog = 0;
-    for (const auto& shape : shapes) {
-        for (const auto& index : shape.mesh.indices) {
-            Vertex vertex{};
 
-            vertex.pos = {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2]
-            };
+static void generate_model_tangents(Model* cModel)
+{
+    it_TangentStreams streams;
+    const size_t count = cModel->vertices.size();
+    streams.px.resize(count); streams.py.resize(count); streams.pz.resize(count);
+    streams.nx.resize(count); streams.ny.resize(count); streams.nz.resize(count);
+    streams.u.resize(count); streams.v.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const Vertex& vertex = cModel->vertices[i];
+        streams.px[i] = vertex.pos.x; streams.py[i] = vertex.pos.y; streams.pz[i] = vertex.pos.z;
+        streams.nx[i] = vertex.normal.x; streams.ny[i] = vertex.normal.y; streams.nz[i] = vertex.normal.z;
+        streams.u[i] = vertex.texCoord.x; streams.v[i] = vertex.texCoord.y;
+    }
 
-            vertex.normal = {
-                attrib.normals[3 * index.normal_index + 0],
-                attrib.normals[3 * index.normal_index + 1],
-                attrib.normals[3 * index.normal_index + 2]
-            };
+#ifdef ENGINE_ANGLE_WEIGHTED_TANGENTS
+    compute_tangents(&streams, cModel->indices.data(), cModel->indices.size(), TANGENT_MODE_ANGLE_WEIGHTED);
+#else
+    compute_tangents(&streams, cModel->indices.data(), cModel->indices.size(), TANGENT_MODE_LEGACY);
+#endif
 
+    for (size_t i = 0; i < count; i++) {
+        cModel->vertices[i].tangent = glm::vec3(streams.tx[i], streams.ty[i], streams.tz[i]);
+        cModel->vertices[i].bitangent = glm::vec3(streams.bx[i], streams.by[i], streams.bz[i]);
+    }
+}
 
-            vertex.texCoord = {
-                attrib.texcoords[2 * index.texcoord_index + 0],
-                1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-            };
 
-            
+static void optimize_model_mesh(Model* cModel)
+{
+    const size_t vertexCount = cModel->vertices.size();
+    it_VertexCacheStats before = analyze_vertex_cache(cModel->indices.data(), cModel->indices.size(), vertexCount, MESH_VERTEX_CACHE_SIZE);
 
-            vertex.color = { 1.0f, 1.0f, 1.0f };
-            
+    optimize_vertex_cache(cModel->indices.data(), cModel->indices.size(), vertexCount, MESH_VERTEX_CACHE_SIZE);
+    std::vector<uint32_t> remap = optimize_vertex_fetch(cModel->indices.data(), cModel->indices.size(), vertexCount);
 
-            if (uniqueVertices.count(vertex) == 0) {
-                uniqueVertices[vertex] = static_cast<uint32_t>(cModel->vertices.size());
-                cModel->vertices.push_back(vertex);
-                tangents.push_back(glm::vec3(0.0f));
-                bitangents.push_back(glm::vec3(0.0f));
-            }
+    std::vector<Vertex> vertices(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+        vertices[remap[i]] = cModel->vertices[i];
+    cModel->vertices.swap(vertices);
 
+#ifndef ENGINE_DISABLE_LOGGING
+    it_VertexCacheStats after = analyze_vertex_cache(cModel->indices.data(), cModel->indices.size(), vertexCount, MESH_VERTEX_CACHE_SIZE);
+    tlog::info(cModel->MODEL_PATH + " vertex cache ACMR " + std::to_string(before.acmr) + " -> " + std::to_string(after.acmr)
+        + ", ATVR " + std::to_string(before.atvr) + " -> " + std::to_string(after.atvr));
+#endif
+}
 
-            cModel->indices.push_back(uniqueVertices[vertex]);
 
-        }
+static void build_model_lods(Model* cModel)
+{
+    const size_t baseCount = cModel->indices.size();
+    cModel->lods.assign(1, it_MeshLod{ 0, static_cast<uint32_t>(baseCount), 0.0f });
+    if (cModel->vertices.empty())
+        return;
+
+    const float* positions = &cModel->vertices[0].pos.x;
+    const size_t vertexCount = cModel->vertices.size();
+    const float maxError = LOD_MAX_ERROR * glm::length(cModel->boundsMax - cModel->boundsMin);
+
+    // every level is simplified from the full mesh, so they do not depend on each other
+    std::vector<it_SimplifyResult> levels(MESH_MAX_LODS - 1);
+    parallel_for(levels.size(), [&](size_t i) {
+        size_t target = (baseCount >> (i + 1)) / 3 * 3;
+        levels[i] = simplify_mesh(positions, sizeof(Vertex), vertexCount, cModel->indices.data(), baseCount, target, maxError);
+#ifndef ENGINE_DISABLE_MESH_OPTIMIZATION
+        optimize_vertex_cache(levels[i].indices.data(), levels[i].indices.size(), vertexCount, MESH_VERTEX_CACHE_SIZE);
+#endif
+    });
+
+    for (size_t i = 0; i < levels.size(); i++) {
+        const it_SimplifyResult& level = levels[i];
+        const it_MeshLod previous = cModel->lods.back();
+        if (level.indices.empty() || level.indices.size() > previous.indexCount * LOD_MIN_REDUCTION)
+            break;
+
+        it_MeshLod lod;
+        lod.firstIndex = static_cast<uint32_t>(cModel->indices.size());
+        lod.indexCount = static_cast<uint32_t>(level.indices.size());
+        lod.error = std::max(level.error, previous.error);
+        cModel->indices.insert(cModel->indices.end(), level.indices.begin(), level.indices.end());
+        cModel->lods.push_back(lod);
 #ifndef ENGINE_DISABLE_LOGGING
-        prog++;
-        std::this_thread::sleep_for(std::chrono::milliseconds{ 100 });
-        progress.update(prog);
+        tlog::info(cModel->MODEL_PATH + " LOD " + std::to_string(cModel->lods.size() - 1) + ": " + std::to_string(lod.indexCount / 3)
+            + " triangles, error bound " + std::to_string(level.error));
 #endif
-
     }
-    for (size_t i = 0; i < cModel->indices.size(); i += 3) {
-        Vertex& v0 = cModel->vertices[cModel->indices[i + 0]];
-        Vertex& v1 = cModel->vertices[cModel->indices[i + 1]];
-        Vertex& v2 = cModel->vertices[cModel->indices[i + 2]];
+}
 
-        glm::vec3 edge1 = v1.pos - v0.pos;
-        glm::vec3 edge2 = v2.pos - v0.pos;
 
-        glm::vec2 deltaUV1 = v1.texCoord - v0.texCoord;
-        glm::vec2 deltaUV2 = v2.texCoord - v0.texCoord;
+static void build_model_meshlets(Model* cModel)
+{
+    const it_MeshLod& lod = cModel->lods[0];
+    const float* positions = &cModel->vertices[0].pos.x;
+    auto start = std::chrono::high_resolution_clock::now();
+    build_meshlets(positions, sizeof(Vertex), cModel->vertices.size(), cModel->indices.data() + lod.firstIndex, lod.indexCount, &cModel->meshlets);
+    std::chrono::duration<double, std::milli> buildTime = std::chrono::high_resolution_clock::now() - start;
 
-        float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-        // Check for division by zero
-        if (!std::isfinite(f)) {
-            f = 0.0f;
-        }
+#ifndef ENGINE_DISABLE_LOGGING
+    const double triangles = lod.indexCount / 3.0;
+    const size_t count = cModel->meshlets.meshlets.size();
+    tlog::info(cModel->MODEL_PATH + " " + std::to_string(count) + " meshlets, " + std::to_string(cModel->meshlets.vertices.size() / std::max<size_t>(count, 1))
+        + " vertices / " + std::to_string(static_cast<size_t>(triangles) / std::max<size_t>(count, 1)) + " triangles on average, built in "
+        + std::to_string(buildTime.count()) + " ms (" + std::to_string(buildTime.count() * 1e6 / std::max(triangles, 1.0)) + " ms per million triangles)");
+#endif
+}
 
-        glm::vec3 tangent, bitangent;
 
-        tangent.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-        tangent.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-        tangent.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-        tangent = glm::normalize(tangent);
+static void pack_model_vertices(Model* cModel)
+{
+    it_PackingParams params = compute_packing_params(cModel->vertices);
+    cModel->packedVertices.resize(cModel->vertices.size());
+    for (size_t i = 0; i < cModel->vertices.size(); i++)
+        cModel->packedVertices[i] = pack_vertex(cModel->vertices[i], params);
 
-        bitangent.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
-        bitangent.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
-        bitangent.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
-        bitangent = glm::normalize(bitangent);
+    cModel->dequantize = glm::translate(glm::mat4(1.0f), params.center) * glm::scale(glm::mat4(1.0f), glm::vec3(params.extent));
+    cModel->uvScaleBias = glm::vec4(params.uvRange, params.uvMin);
 
-        if (glm::dot(glm::cross(v0.normal, tangent), bitangent) < 0.0f) {
-            tangent = tangent * -1.0f;
-        }
+#ifndef ENGINE_DISABLE_LOGGING
+    tlog::info(cModel->MODEL_PATH + " packed " + std::to_string(sizeof(Vertex) * cModel->vertices.size()) + " -> " + std::to_string(sizeof(PackedVertex) * cModel->packedVertices.size()) + " bytes");
+#endif
+}
 
-        tangents[cModel->indices[i + 0]] += tangent;
-        tangents[cModel->indices[i + 1]] += tangent;
-        tangents[cModel->indices[i + 2]] += tangent;
 
-        bitangents[cModel->indices[i + 0]] += bitangent;
-        bitangents[cModel->indices[i + 1]] += bitangent;
-        bitangents[cModel->indices[i + 2]] += bitangent;
+void load_model(Model* cModel) {
+    auto start = std::chrono::high_resolution_clock::now();
+#ifndef ENGINE_DISABLE_MESH_CACHE
+    if (load_mesh_cache(cModel))
+    {
+#ifndef ENGINE_DISABLE_LOGGING
+        std::chrono::duration<double, std::milli> warm = std::chrono::high_resolution_clock::now() - start;
+        tlog::info(cModel->MODEL_PATH + " loaded from mesh cache in " + std::to_string(warm.count()) + " ms");
+#endif
+#ifdef ENGINE_PACKED_VERTICES
+        pack_model_vertices(cModel);
+#endif
+        return;
     }
+#endif
 
-    for (size_t i = 0; i < cModel->vertices.size(); i++) {
-        cModel->vertices[i].tangent = glm::normalize(tangents[i]);
-        cModel->vertices[i].bitangent = glm::normalize(bitangents[i]);
+    // the tokenize rate excludes the cache lookup above
+    auto parseStart = std::chrono::high_resolution_clock::now();
+    it_ObjMesh mesh;
+    std::string err;
+    if (!parse_obj(cModel->baseDir + cModel->MODEL_PATH, "res/models/", &mesh, &err)) {
+        throw std::runtime_error(err);
     }
+#ifndef ENGINE_DISABLE_LOGGING
+    std::chrono::duration<double> parseTime = std::chrono::high_resolution_clock::now() - parseStart;
+    tlog::info(cModel->MODEL_PATH + " tokenized at " + std::to_string(mesh.fileSize / (1024.0 * 1024.0) / parseTime.count()) + " MB/s");
+#endif
+  
+    auto weldStart = std::chrono::high_resolution_clock::now();
+    weld_obj_vertices(mesh, &cModel->vertices, &cModel->indices);
+#ifndef ENGINE_DISABLE_LOGGING
+    std::chrono::duration<double, std::milli> weldTime = std::chrono::high_resolution_clock::now() - weldStart;
+    tlog::info(cModel->MODEL_PATH + " welded " + std::to_string(mesh.indices.size()) + " corners into " + std::to_string(cModel->vertices.size()) + " vertices in " + std::to_string(weldTime.count()) + " ms");
+#endif
+
+    generate_model_tangents(cModel);
+#ifndef ENGINE_DISABLE_MESH_OPTIMIZATION
+    optimize_model_mesh(cModel);
+#endif
+    compute_model_bounds(cModel);
+    build_model_lods(cModel);
 
 
+    const std::vector<tinyobj::material_t>& materials = mesh.materials;
+    if (materials.empty()) {
+        throw std::runtime_error("ERROR: " + cModel->MODEL_PATH + " does not reference any material");
+    }
     cModel->material.ambient = glm::vec3(materials[0].ambient[0], materials[0].ambient[1], materials[0].ambient[2]);
     cModel->material.diffuse = glm::vec3(materials[0].diffuse[0], materials[0].diffuse[1], materials[0].diffuse[2]);
     cModel->material.specular = glm::vec3(materials[0].specular[0], materials[0].specular[1], materials[0].specular[2]);
@@ -171,76 +244,240 @@ void load_model(Model* cModel) {
     cModel->material.overrideColor = glm::vec3(1.0f, 1.0f, 1.0f);
     //cModel->NORMAL_PATH = "res/textures/" + materials[0].normal_texname;
     
-    cModel->statsFaces = static_cast<int>((cModel->indices.size() / 3));
+    cModel->statsFaces = cModel->lods[0].indexCount / 3;
+#ifdef ENGINE_BUILD_MESHLETS
+    build_model_meshlets(cModel);
+#endif
+#ifndef ENGINE_DISABLE_MESH_CACHE
+    write_mesh_cache(cModel);
+#endif
+#ifdef ENGINE_PACKED_VERTICES
+    pack_model_vertices(cModel);
+#endif
 #ifndef ENGINE_DISABLE_LOGGING
-    printf("\n");
-    tlog::none();
     tlog::success();
     printf("Material count: %d \n", static_cast<int>(materials.size()));
+    std::chrono::duration<double, std::milli> cold = std::chrono::high_resolution_clock::now() - start;
+    tlog::info(cModel->MODEL_PATH + " parsed from source in " + std::to_string(cold.count()) + " ms");
 #endif
 }
 
 
-//void init_model_resources(VkDevice* device, VkPhysicalDevice* physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue, VkDescriptorSetLayout descriptorSetLayout, Model* cModel) 
-void init_model_resources(VkDevice* device, VkPhysicalDevice* physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue, Model* cModel,it_ImageResource* depthRes, std::vector<VkBuffer>* lightBuffers)
+void init_model_resources(it_UploadContext* uploadContext, it_GeometryHeap* geometryHeap, it_BindlessSet* bindless, Model* cModel,
+    const it_ModelImages* images)
 {
-    create_descriptor_set_layout(device, cModel);
+    uint32_t vertexCount = 0, indexCount = 0;
+    try
+    {
+        cModel->virtualTexture = virtual_texture_acquire(cModel->baseDir + cModel->TEXTURE_PATH);
+        if (cModel->virtualTexture == VT_INVALID)
+            cModel->texture = texture_cache_acquire(uploadContext, cModel->baseDir + cModel->TEXTURE_PATH, TEXTURE_FORMAT_COLOR, images ? &images->texture : nullptr);
+        cModel->normal = texture_cache_acquire(uploadContext, cModel->baseDir + cModel->NORMAL_PATH, TEXTURE_FORMAT_NORMAL, images ? &images->normal : nullptr);
+
+        create_vertex_buffer(uploadContext, geometryHeap, cModel);
+        vertexCount = static_cast<uint32_t>(cModel->vertices.size());
+        create_index_buffer(uploadContext, geometryHeap, cModel);
+        indexCount = static_cast<uint32_t>(cModel->indices.size());
+        cModel->objectIndex = bindless_add_object(bindless);
+    }
+    catch (...)
+    {
+        // all or nothing, the caller only has to delete the model. The copies into the heap ranges are recorded
+        // already, they have to land before another model can be given the ranges.
+        upload_context_flush(uploadContext);
+        geometry_heap_release(geometryHeap, cModel->baseVertex, vertexCount, cModel->baseIndex, indexCount);
+        texture_cache_release(cModel->normal);
+        texture_cache_release(cModel->texture);
+        virtual_texture_release(cModel->virtualTexture);
+        cModel->normal = nullptr;
+        cModel->texture = nullptr;
+        cModel->virtualTexture = VT_INVALID;
+        throw;
+    }
+}
 
-    create_texture_image(device, physicalDevice, commandPool, graphicsQueue, cModel);
-    create_imageview(device, cModel);
-    create_texture_sampler(device, physicalDevice, cModel);
-    
-    create_normal_image(device, physicalDevice, commandPool, graphicsQueue, cModel);
-    create_normalview(device, cModel);
-    create_normal_sampler(device, physicalDevice, cModel);
 
-    
-    create_vertex_buffer(device, physicalDevice, commandPool, graphicsQueue, cModel);
-    create_index_buffer(device, physicalDevice, commandPool, graphicsQueue, cModel);
-    create_uniform_buffers(device, physicalDevice, cModel);
-    create_descriptor_pool(device, cModel);
-    create_descriptor_sets(device, cModel, depthRes, *lightBuffers);
-
-    return;
+bool update_model_transform(Model* cModel)
+{
+    if (!cModel->transformDirty)
+        return false;
+
+    glm::mat4 scaleMat = glm::scale(cModel->scaleVec);
+    glm::mat4 translateMat = glm::translate(glm::mat4(1.0f), cModel->translationVec);
+    glm::mat4 rotMat = glm::mat4(1.0f);
+    rotMat *= glm::rotate(glm::mat4(1.0f), cModel->rotationVec.z, glm::vec3(0.0f, 0.0f, 1.0f));
+    rotMat *= glm::rotate(glm::mat4(1.0f), cModel->rotationVec.y, glm::vec3(0.0f, 1.0f, 0.0f));
+    rotMat *= glm::rotate(glm::mat4(1.0f), cModel->rotationVec.x, glm::vec3(1.0f, 0.0f, 0.0f));
+    cModel->transform = translateMat * rotMat * scaleMat;
+    cModel->transformDirty = false;
+    return true;
 }
 
-void mt_init_model_resources(VkDevice* device, VkPhysicalDevice* physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue, Model* cModel, it_ImageResource* depthRes, std::vector<VkBuffer>* lightBuffers, std::mutex& queueMutex)
+static bool model_hierarchy_current(const std::vector<Model*>& scene, const it_ModelHierarchy* hierarchy)
 {
-    create_descriptor_set_layout(device, cModel);
+    if (scene.size() != hierarchy->models.size())
+        return false;
+    // every model on its own node, so with equal sizes both hold the same models
+    for (const Model* cModel : scene)
     {
-        std::lock_guard<std::mutex> lock(queueMutex);
-        create_texture_image(device, physicalDevice, commandPool, graphicsQueue, cModel);
+        const uint32_t node = cModel->hierarchyNode;
+        if (node >= hierarchy->models.size() || hierarchy->models[node] != cModel
+            || hierarchy->UUIDs[node] != cModel->UUID || hierarchy->parentUUIDs[node] != cModel->parentUUID)
+            return false;
     }
-    create_imageview(device, cModel);
-    create_texture_sampler(device, physicalDevice, cModel);
+    return true;
+}
+
+static void rebuild_model_hierarchy(std::vector<Model*>& scene, it_ModelHierarchy* hierarchy)
+{
+    std::unordered_map<std::string, uint32_t> byUUID;
+    byUUID.reserve(scene.size());
+    for (size_t i = 0; i < scene.size(); i++)
+        byUUID.emplace(scene[i]->UUID, static_cast<uint32_t>(i));
+
+    std::vector<uint32_t> parents(scene.size(), HIERARCHY_ROOT);
+    for (size_t i = 0; i < scene.size(); i++)
     {
-        std::lock_guard<std::mutex> lock(queueMutex);
-        create_normal_image(device, physicalDevice, commandPool, graphicsQueue, cModel);
+        const std::string& parentUUID = scene[i]->parentUUID;
+        if (parentUUID.empty())
+            continue;
+        auto found = byUUID.find(parentUUID);
+        if (found == byUUID.end() || found->second == i)
+            tlog::warning("Parent " + parentUUID + " of " + scene[i]->UUID + " is not in the scene, it stays a root");
+        else
+            parents[i] = found->second;
     }
-    create_normalview(device, cModel);
-    create_normal_sampler(device, physicalDevice, cModel);
+    std::vector<uint32_t> order;
+    if (!hierarchy_sort(&parents, &order))
+        tlog::warning("Parent links in the scene form a cycle, it is cut at one model");
+
+    std::vector<uint32_t> nodeOf(scene.size());
+    hierarchy_clear(&hierarchy->nodes);
+    hierarchy_reserve(&hierarchy->nodes, scene.size());
+    hierarchy->models.clear();
+    hierarchy->UUIDs.clear();
+    hierarchy->parentUUIDs.clear();
+    for (uint32_t i : order)
     {
-        std::lock_guard<std::mutex> lock(queueMutex);
-        create_vertex_buffer(device, physicalDevice, commandPool, graphicsQueue, cModel);
-        create_index_buffer(device, physicalDevice, commandPool, graphicsQueue, cModel);
+        Model* cModel = scene[i];
+        const uint32_t parent = parents[i] == HIERARCHY_ROOT ? HIERARCHY_ROOT : nodeOf[parents[i]];
+        nodeOf[i] = hierarchy_add(&hierarchy->nodes, parent, cModel->translationVec, cModel->rotationVec, cModel->scaleVec);
+        cModel->hierarchyNode = nodeOf[i];
+        cModel->parent = parents[i] == HIERARCHY_ROOT ? nullptr : scene[parents[i]];
+        cModel->transformDirty = false;
+        hierarchy->models.push_back(cModel);
+        hierarchy->UUIDs.push_back(cModel->UUID);
+        hierarchy->parentUUIDs.push_back(cModel->parentUUID);
     }
-    create_uniform_buffers(device, physicalDevice, cModel);
-    create_descriptor_pool(device, cModel);
-    create_descriptor_sets(device, cModel, depthRes ,*lightBuffers);
+}
 
-};
+size_t update_model_hierarchy(std::vector<Model*>& scene, it_ModelHierarchy* hierarchy)
+{
+    if (!model_hierarchy_current(scene, hierarchy))
+        rebuild_model_hierarchy(scene, hierarchy);
 
+    for (Model* cModel : scene)
+    {
+        if (!cModel->transformDirty)
+            continue;
+        hierarchy_set_local(&hierarchy->nodes, cModel->hierarchyNode, cModel->translationVec, cModel->rotationVec, cModel->scaleVec);
+        cModel->transformDirty = false;
+    }
 
-void draw_model(Model* cModel, VkCommandBuffer commandBuffer, VkPipelineLayout graphicsPipelineLayout, int currentFrame) {
-    VkDeviceSize offsets[] = { 0 };
+    const size_t rebuilt = hierarchy_update(&hierarchy->nodes);
+    if (rebuilt == 0)
+        return 0;
+    for (size_t node = 0; node < hierarchy->models.size(); node++)
+        if (hierarchy->nodes.changed[node])
+            hierarchy->models[node]->transform = hierarchy->nodes.world[node];
+    return rebuilt;
+}
 
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &cModel->vertexBuffer, offsets);
+void select_model_lod(Model* cModel, glm::vec3 cameraPos, float pixelsPerUnit)
+{
+    if (cModel->lods.size() < 2) {
+        cModel->currentLod = 0;
+        return;
+    }
 
-    vkCmdBindIndexBuffer(commandBuffer, cModel->indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    // world space bounding sphere, the largest axis scale bounds how much the object space error grows
+    glm::vec3 center = glm::vec3(cModel->transform * glm::vec4((cModel->boundsMin + cModel->boundsMax) * 0.5f, 1.0f));
+    float scale = std::max(glm::length(glm::vec3(cModel->transform[0])), std::max(glm::length(glm::vec3(cModel->transform[1])), glm::length(glm::vec3(cModel->transform[2]))));
+    float radius = glm::length(cModel->boundsMax - cModel->boundsMin) * 0.5f * scale;
+    float distance = std::max(glm::length(center - cameraPos) - radius, 1e-3f);
+    float pixelsPerError = scale * pixelsPerUnit / distance;
+
+    const int lodCount = static_cast<int>(cModel->lods.size());
+    int lod = std::min(cModel->currentLod, lodCount - 1);
+    while (lod > 0 && cModel->lods[lod].error * pixelsPerError > LOD_PIXEL_ERROR * (1.0f + LOD_HYSTERESIS))
+        lod--;
+    while (lod + 1 < lodCount && cModel->lods[lod + 1].error * pixelsPerError < LOD_PIXEL_ERROR * (1.0f - LOD_HYSTERESIS))
+        lod++;
+    cModel->currentLod = lod;
+}
 
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelineLayout, 0, 1, &cModel->descriptorSets[currentFrame], 0, nullptr);
+void cull_model_meshlets(Model* cModel, const glm::mat4& viewProj, glm::vec3 cameraPos)
+{
+    cModel->meshletCulling = cModel->currentLod == 0 && !cModel->meshlets.meshlets.empty();
+    if (!cModel->meshletCulling)
+        return;
+
+    // world space frustum planes (zero to one depth), moved into object space with the transpose of the model matrix.
+    // Normalizing them first keeps plane distances in world units, so only the radius needs scaling.
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; r++)
+        rows[r] = glm::vec4(viewProj[0][r], viewProj[1][r], viewProj[2][r], viewProj[3][r]);
+    const glm::vec4 worldPlanes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2] };
+    float planes[6][4];
+    for (int i = 0; i < 6; i++) {
+        glm::vec4 plane = worldPlanes[i] * (1.0f / glm::length(glm::vec3(worldPlanes[i])));
+        for (int k = 0; k < 4; k++)
+            planes[i][k] = glm::dot(cModel->transform[k], plane);
+    }
+    const glm::vec3 axisX = glm::vec3(cModel->transform[0]), axisY = glm::vec3(cModel->transform[1]), axisZ = glm::vec3(cModel->transform[2]);
+    const float scale = std::max(glm::length(axisX), std::max(glm::length(axisY), glm::length(axisZ)));
+
+    // facing is preserved by affine transforms unless they mirror, so the cone test runs in object space
+    const bool mirrored = glm::dot(glm::cross(axisX, axisY), axisZ) < 0.0f;
+    const glm::vec4 eye = glm::inverse(cModel->transform) * glm::vec4(cameraPos, 1.0f);
+    const float objectEye[3] = { eye.x, eye.y, eye.z };
+
+    cModel->visibleDraws.clear();
+    for (const it_Meshlet& meshlet : cModel->meshlets.meshlets) {
+        if (meshlet_outside_frustum(meshlet, planes, scale) || (!mirrored && meshlet_backfacing(meshlet, objectEye)))
+            continue;
+        // neighbouring survivors share one draw, meshlets are contiguous in the index buffer
+        if (!cModel->visibleDraws.empty() && cModel->visibleDraws.back().firstIndex + cModel->visibleDraws.back().indexCount == meshlet.firstIndex) {
+            cModel->visibleDraws.back().indexCount += meshlet.triangleCount * 3u;
+            continue;
+        }
+        VkDrawIndexedIndirectCommand draw{};
+        draw.indexCount = meshlet.triangleCount * 3u;
+        draw.instanceCount = 1;
+        draw.firstIndex = meshlet.firstIndex;
+        draw.firstInstance = cModel->objectIndex;
+        cModel->visibleDraws.push_back(draw);
+    }
+}
 
-    vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(cModel->indices.size()), 1, 0, 0, 0);
+void draw_model(Model* cModel, VkCommandBuffer commandBuffer, VkPipelineLayout graphicsPipelineLayout, it_FrameStats* stats) {
+    it_DrawIndices indices;
+    indices.texture = cModel->texture ? cModel->texture->index : 0;
+    indices.virtualTexture = cModel->virtualTexture;
+    indices.normal = cModel->normal->index;
+    vkCmdPushConstants(commandBuffer, graphicsPipelineLayout, DRAW_INDICES_STAGES, 0, sizeof(indices), &indices);
+
+    // the vertex shader finds the object's data at gl_InstanceIndex
+    const int32_t vertexOffset = static_cast<int32_t>(cModel->baseVertex);
+    if (cModel->meshletCulling) {
+        for (const auto& draw : cModel->visibleDraws) {
+            vkCmdDrawIndexed(commandBuffer, draw.indexCount, 1, cModel->baseIndex + draw.firstIndex, vertexOffset, draw.firstInstance);
+            stats->triangles += draw.indexCount / 3;
+        }
+        return;
+    }
 
+    const it_MeshLod& lod = cModel->lods[cModel->currentLod];
+    vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, cModel->baseIndex + lod.firstIndex, vertexOffset, cModel->objectIndex);
+    stats->triangles += lod.indexCount / 3;
 }
-
@@ -1,8 +1,48 @@
 #include <iostream>
+#include <cstring>
 #include "Engine.h"
+#include "Benchmark.h"
+#include "Tests.h"
+#include "TextureCook.h"
+#include "JobSystem.h"
 
-int main()
+int main(int argc, char** argv)
 {
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    {
+        run_benchmarks();
+        return EXIT_SUCCESS;
+    }
+    if (argc > 1 && strcmp(argv[1], "--test") == 0)
+    {
+        return run_tests() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // --cook [scene.json] [--force]: builds the KTX2 files of the scene's textures, main.json by default
+    if (argc > 1 && strcmp(argv[1], "--cook") == 0)
+    {
+        std::string scenePath = "main.json";
+        bool force = false;
+        for (int i = 2; i < argc; i++)
+        {
+            if (strcmp(argv[i], "--force") == 0)
+                force = true;
+            else
+                scenePath = argv[i];
+        }
+        job_system_init();
+        try {
+            cook_scene_textures(scenePath, force);
+        }
+        catch (const std::exception& e)
+        {
+            job_system_shutdown();
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        job_system_shutdown();
+        return EXIT_SUCCESS;
+    }
+
     Engine app(1600, 720, (char*)"Vulkan", (char*)"0.0.0.1");
     
     try {